@@ -2,6 +2,8 @@
 
 if [ -n "${DEBUG}" ]; then
 	build_master_meson setup build --buildtype=debug
+elif [ -n "${STATIC}" ]; then
+	build_master_meson setup build --buildtype=release -Dstatic_link=true
 else
 	build_master_meson setup build --buildtype=release
 fi
@@ -4,6 +4,8 @@ build_master_meson --version
 build_master --version
 build_master --meson-build-template-path
 
+echo "Running API tests"
+build_master_meson test -C build api
 echo "Running Primilary tests"
 python ./unit_test/preliminary_tests.py -v
 echo "Running Real World tests"
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+// The global operator new and delete are replaced (in new_delete.cpp) to count the heap allocations made by libbuild_master
+// It is meant for keeping the hot paths (like generation of meson.build) allocation free, see TestGenerationAllocations() in unit_test/api_tests.cpp
+// NOTE: the replacement is linked into api_tests only, not into build_master nor libbuild_master, so the counters stay at zero elsewhere
+
+// Counts an allocation of size bytes, called by the replaced operator new
+void CountAllocation(std::size_t size) noexcept;
+
+// Returns the number of allocations made so far (with operator new)
+std::size_t GetAllocationCount();
+// Returns the total number of bytes allocated so far (with operator new), the deallocations are not subtracted
+std::size_t GetAllocatedSize();
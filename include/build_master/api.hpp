@@ -0,0 +1,91 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// In-process API of libbuild_master, for the tools which embed build_master instead of spawning it for each query
+// Only the standard library types appear here (no json, no OutputBuffer), so that the internals can change without breaking the users of the API.
+// Example:
+// build_master::ProjectModel model = build_master::ProjectModel::Load("path/to/project");
+// build_master::StringOutputSink sink;
+// build_master::GenerateMesonBuild(model, sink);
+// std::cout << sink.rootScript;
+namespace build_master
+{
+	// Thrown by the API functions, e.g. build_master.json can't be parsed, or it references a source file which doesn't exist
+	class Error : public std::runtime_error
+	{
+	public:
+		using std::runtime_error::runtime_error;
+	};
+
+	class OutputSink;
+
+	// build_master.json of a project with its literal vars folded into the lists, meson.build is generated from it
+	// Copies are cheap, as they share the (immutable) parsed content
+	class ProjectModel
+	{
+	private:
+		struct Impl;
+
+		std::shared_ptr<const Impl> m_impl;
+
+		explicit ProjectModel(std::shared_ptr<const Impl> impl) noexcept;
+		const Impl& GetImpl() const noexcept { return *m_impl; }
+
+		// They read the parsed json
+		friend void GenerateMesonBuild(const ProjectModel& model, OutputSink& sink);
+		friend bool RunPreConfigHooks(const ProjectModel& model);
+
+	public:
+		// Parses <directory>/build_master.json
+		static ProjectModel Load(std::string_view directory);
+		// Parses the content of a build_master.json, the source paths in it are relative to directory
+		static ProjectModel Parse(std::string_view jsonText, std::string_view directory = ".");
+
+		// Root directory of the project
+		const std::string& GetDirectory() const noexcept;
+		// Value of the "project_name" key
+		std::string GetName() const;
+		// Names of the targets, in the order they are declared
+		std::vector<std::string> GetTargetNames() const;
+	};
+
+	// Receives the generated scripts
+	class OutputSink
+	{
+	public:
+		virtual ~OutputSink() = default;
+		// Called once with meson.build of the project's root
+		virtual void WriteRootScript(std::string_view content) = 0;
+		// Called with each target's fragment (.build_master/targets/<name>/meson.build) if "split_meson_build" is true
+		virtual void WriteTargetScript(std::string_view targetName, std::string_view content) { static_cast<void>(targetName); static_cast<void>(content); }
+	};
+
+	// Keeps the generated scripts in memory
+	class StringOutputSink : public OutputSink
+	{
+	public:
+		std::string rootScript;
+		// { target name, fragment }
+		std::vector<std::pair<std::string, std::string>> targetScripts;
+
+		void WriteRootScript(std::string_view content) override { rootScript.assign(content); }
+		void WriteTargetScript(std::string_view targetName, std::string_view content) override { targetScripts.emplace_back(targetName, content); }
+	};
+
+	// Generates meson.build of the project into sink, nothing is written into the project's directory
+	// Unlike 'build_master --update-meson-build', the environment snapshot (.build_master/env) and the simd dispatch stubs (.build_master/simd) aren't written.
+	void GenerateMesonBuild(const ProjectModel& model, OutputSink& sink);
+
+	// Runs "pre_config_hook" and "pre_config_root_hook" scripts of the project, in the project's directory
+	// Returns true if either of them is given, throws Error if they can't be run (i.e. bash isn't found)
+	bool RunPreConfigHooks(const ProjectModel& model);
+
+	// Returns version of the library, e.g. "1.4.9"
+	std::string_view GetVersionString() noexcept;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// Prebuilt dependencies (see "prebuilt_dependencies" in build_master.json) are restored into (or built into) this directory by default,
+// <prefix>/<name>, relative to the project's root
+static constexpr std::string_view gPrebuiltDependenciesDirPath = ".build_master/prebuilt";
+
+// Builds the "prebuilt_dependencies" of build_master.json, or restores them from the artifact cache if the same build is already there.
+// An artifact is keyed by the content of the dependency's sources and build script, its flags, the identity of the C/C++ compilers
+// (and CFLAGS, CXXFLAGS, LDFLAGS), the platform, and the version of build_master.
+// Then it prepends the pkgconfig directories of the dependencies to PKG_CONFIG_PATH of this process, so that meson and pkg-config (run by build_master) find them.
+// isSetup: true for 'meson setup', only then the outdated dependencies are restored or built, otherwise PKG_CONFIG_PATH is just extended
+// directory: value passed to --directory flag
+void PreparePrebuiltDependencies(std::string_view directory, bool isSetup);
+
+// Stores values of the arguments passed to 'cache' command
+// Example: build_master cache evict --max-size-mb 2048
+struct CacheCommandArgs
+{
+	// stats, evict, or clear
+	std::string action { "stats" };
+	// --max-size-mb <size>, 0 means the configured limit ("artifact_cache" : { "max_size_mb" : ... })
+	std::uint64_t maxSizeMb { 0 };
+};
+
+// build_master cache
+// stats: prints the hit/miss statistics and the size of the artifact cache
+// evict: evicts the least recently used artifacts until the cache fits in the size limit
+// clear: removes all of the artifacts (the statistics are kept)
+// directory: value passed to --directory flag
+int RunCacheCommand(std::string_view directory, const CacheCommandArgs& args);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Stores values of the arguments passed to 'bench' command
+// Example: build_master bench -C build --repetitions 10 --baseline main
+struct BenchCommandArgs
+{
+	// -C <build directory>, relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory { "build" };
+	// --warmups <count>, runs of each benchmark which are discarded
+	unsigned int warmupCount { 1 };
+	// --repetitions <count>, runs of each benchmark which are recorded
+	unsigned int repetitionCount { 5 };
+	// --history-file <path>, by default it is .build_master/bench_history.json in the project directory
+	std::string historyFilePath;
+	// --baseline <git revision>, results are compared against the latest recorded run of this commit
+	// empty means the results are compared against the previous recorded run
+	std::string baseline;
+	// --threshold <percent>, changes smaller than this are never reported as regressions
+	double threshold { 5.0 };
+	// --no-rebuild
+	bool isNoRebuild { false };
+	// Names of the benchmarks to run, empty means all
+	std::vector<std::string> benchNames;
+};
+
+// build_master bench
+// Rebuilds the project, runs the benchmarks (executable targets with "is_benchmark": true) registered with meson
+// with warmups and repetitions, records the timings into the history file, and compares them against a baseline.
+// The timings are parsed from google-benchmark JSON, nanobench JSON, or plain "<name>: <value> <unit>" lines,
+// otherwise the wall time of the benchmark process is recorded.
+// directory: value passed to --directory flag
+// Returns exit code, non-zero if a benchmark failed or a statistically significant regression has been detected
+int RunBenchmarks(std::string_view directory, const BenchCommandArgs& args);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Stores values of the arguments passed to 'build' command
+// Example: build_master build -C build -j 8 main_test
+struct BuildCommandArgs
+{
+	// -C <build directory>, relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory { "build" };
+	// -j <number of parallel jobs>, 0 means it is chosen from the available memory, see PlanBuildJobs()
+	unsigned int jobCount { 0 };
+	// -v
+	bool isVerbose { false };
+	// Names of the targets to build (as accepted by 'meson compile', i.e. NAME or NAME:TYPE), empty means the default targets
+	std::vector<std::string> targetNames;
+};
+
+// build_master build
+// Builds the project, if meson.build is upto date and the build directory is configured with the ninja backend
+// then ninja is executed directly (replacing the build_master process), which avoids starting python and meson just to call ninja.
+// Otherwise it regenerates meson.build and falls back to 'meson compile'.
+// Unless -j is given, the number of jobs is chosen from the available memory, and ninja runs as a child process instead
+// so that the peak memory of the jobs can be recorded for the next builds. The compile and link jobs of the targets with "heavy": true
+// run in a ninja pool of their own, limited by the memory they need.
+// A build directory configured by 'build_master configure' (see RunConfigure()) is always built with ninja directly, as meson isn't involved at all.
+// directory: value passed to --directory flag
+// Returns exit code, with -j it returns only if the build has gone through 'meson compile' (or ninja couldn't be started)
+int RunBuild(std::string_view directory, const BuildCommandArgs& args);
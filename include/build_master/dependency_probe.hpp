@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <set>
+#include <optional>
+#include <cstdint>
+
+// Dependencies resolved by ProbeDependencies() are written as declare_dependency() objects into meson.build in this directory
+// (relative to the project's root), the generated meson.build includes it with subdir() if it exists.
+static constexpr std::string_view gResolvedDependenciesDirPath = ".build_master/dependencies";
+
+// Result of probing one dependency with pkg-config
+struct ProbedDependency
+{
+	bool isFound { false };
+	std::string version;
+	std::vector<std::string> compileArgs;
+	std::vector<std::string> linkArgs;
+	// pkg-config --static --libs, i.e. including Libs.private, they are used if default_library is 'static'
+	std::vector<std::string> staticLinkArgs;
+	// Path to the .pc file and its last write time, the result is valid as long as the .pc file is unchanged
+	std::string pcFilePath;
+	std::int64_t pcFileTime { 0 };
+};
+
+struct ProbedDependencies
+{
+	// Indexed by the dependency name, it has all of the requested names (found or not)
+	std::map<std::string, ProbedDependency> dependencies;
+	// Number of the dependencies probed by pkg-config, the rest have been found in the cache
+	std::size_t probedCount { 0 };
+};
+
+// Probes the given dependencies with pkg-config in parallel, the ones in .build_master/dependency_cache.json are probed only if their .pc files
+// (or pkg-config's search paths) have changed, and the cache is updated with the results.
+// directory: value passed to --directory flag
+// Returns null if pkg-config couldn't be found
+std::optional<ProbedDependencies> ProbePkgConfigDependencies(std::string_view directory, const std::set<std::string>& names);
+
+// Probes all of the declared dependencies (project and target level, for the host platform) with pkg-config in parallel,
+// caches the results in .build_master/dependency_cache.json, and writes the resolved dependencies for meson.
+// Dependencies not found via pkg-config are reported all at once, and are left to meson's dependency() (it may find them via cmake or wraps).
+// So are the ones whose .pc files have changed since (the generated script compares them, and meson re-configures when they change).
+// It does nothing if "dependency_probe_cache" is not set to true in build_master.json
+// directory: value passed to --directory flag
+// excludedNames: dependencies which aren't probed, i.e. the library targets of the projects in the same workspace (they are resolved by meson.override_dependency())
+void ProbeDependencies(std::string_view directory, const std::set<std::string>& excludedNames = { });
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Stores values of the arguments passed to 'install' command
+// Example: build_master install -C build -j 16 --destdir /tmp/pkg
+struct InstallCommandArgs
+{
+	// -C <build directory>, relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory { "build" };
+	// --destdir <path>, prepended to the install paths (for packaging), same as --destdir of 'meson install'
+	std::string destDirectory;
+	// -j <number of parallel copies>, 0 means the number of hardware threads
+	unsigned int jobCount { 0 };
+	// --dry-run, only reports what would be installed
+	bool isDryRun { false };
+	// --no-rebuild
+	bool isNoRebuild { false };
+};
+
+// build_master install
+// Installs the project incrementally: 'meson install' installs into a staging directory in the build directory
+// (<build directory>/build_master_install_stage, only the changed files are copied into it with --only-changed),
+// then the staged files are copied into their install locations in parallel, and only those whose content hash differs from the installed file.
+// The unchanged installed files aren't touched at all (so their mtimes are preserved, and the downstream builds aren't invalidated).
+// The content hashes of the installed files are recorded in <build directory>/build_master_install_manifest.json,
+// so the installed files which haven't changed since (same size and mtime) aren't hashed again.
+// Each file is reflinked if the file system supports it, otherwise copied, into a temporary file which is then renamed over the installed file.
+// directory: value passed to --directory flag
+// Returns exit code
+int RunInstall(std::string_view directory, const InstallCommandArgs& args);
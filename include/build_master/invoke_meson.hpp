@@ -6,3 +6,7 @@
 
 
 void InvokeMeson(std::string_view directory, const std::vector<std::string>& args, bool isBuildMasterJsonAvailable = true);
+
+// Same as InvokeMeson() but it doesn't regenerate meson.build and returns the exit code of meson instead of exiting
+// Used by the sub-commands which need to do more work after meson (test, bench, etc.)
+int RunMesonCmd(std::string_view directory, const std::vector<std::string>& args);
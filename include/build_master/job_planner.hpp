@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+// Parallelism of a build, chosen from the available memory and the (hinted or learned) memory used by a compile/link job
+struct JobPlan
+{
+	// Number of parallel jobs (ninja -j), 0 means the default of ninja
+	unsigned int jobCount { 0 };
+	// Depth of the ninja pool the compile and link jobs of the heavy targets run in, 0 if there is no heavy target
+	unsigned int heavyJobCount { 0 };
+	// Names of the targets with "heavy": true (or "memory_hint_mb") in build_master.json
+	std::vector<std::string> heavyTargetNames;
+};
+
+// Plans the parallelism of the build, so that the compile/link jobs running at the same time fit in the available memory (RAM, and the cgroup's limit)
+// The memory used by a job is estimated with "memory_hint_mb" of the heavy targets, or with the peak memory learned from the previous builds (see RecordPeakJobMemory()),
+// otherwise with a default estimate.
+// directory: value passed to --directory flag
+// buildDirectory: path of the build directory relative to the current working directory
+// jobCount: value passed to -j, 0 means it is chosen from the available memory (heavyJobCount is still limited by the memory)
+JobPlan PlanBuildJobs(std::string_view directory, std::string_view buildDirectory, unsigned int jobCount);
+
+// Assigns the compile and link edges of the heavy targets in <build directory>/build.ninja to a ninja pool with depth plan.heavyJobCount,
+// the file is rewritten only if that changes anything. meson has no per-target pools, so it has to be done after meson has written build.ninja.
+// The edges which are in a pool already (e.g. the links in meson's link_pool) are left there, as an edge can be in only one pool.
+// It does nothing (but removing the pool of the previous plan) if there is no heavy target, build.ninja isn't read then (but its first line).
+void ApplyJobPlan(std::string_view buildDirectory, const JobPlan& plan);
+
+// Records the peak memory (in bytes) used by a single compile/link job of a build, see ProcessResult::peakMemory
+// The largest one recorded so far is kept, as an incremental build doesn't tell anything about the jobs it hasn't run,
+// but it decays slowly over the builds which don't reach it, so that a single outlier job doesn't lower the number of jobs for good.
+void RecordPeakJobMemory(std::string_view buildDirectory, std::uint64_t peakMemory);
@@ -9,6 +9,10 @@
 
 using json = nlohmann::ordered_json;
 
+// Parses a json file which may also contain C++ style single line comments
+json ParseJsonFile(std::string_view filePath);
+// Same as ParseJsonFile(), but parses the json text itself
+json ParseJsonText(std::string jsonStr);
 json ParseBuildMasterJson(std::string_view directory);
 
 template<typename T>
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Stores values of the arguments passed to 'matrix' command
+// Example: build_master matrix -j 16 debug release
+struct MatrixCommandArgs
+{
+	// -j <number of parallel jobs>, shared by all of the configurations, 0 means it is chosen from the available memory (see PlanBuildJobs())
+	unsigned int jobCount { 0 };
+	// Names of the configurations to build, empty means all
+	std::vector<std::string> configurationNames;
+};
+
+// build_master matrix
+// Builds every configuration of the "configurations" section of build_master.json, each one in its own build directory.
+// Example:
+// "configurations" : [
+// 	{ "name" : "debug", "options" : [ "--buildtype=debug" ] },
+// 	{ "name" : "static", "options" : [ "--buildtype=release", "--default-library=static" ], "build_directory" : "build-static" }
+// ]
+// The build directories (build-<name> by default) are set up (or reconfigured) in parallel, and are compiled concurrently,
+// each one with its share of the job budget, so the cores aren't oversubscribed. The output of meson is written into
+// .build_master/matrix/<name>_setup.txt and <name>_compile.txt, and a combined pass/fail and timing table is printed at the end.
+// directory: value passed to --directory flag
+// Returns exit code, 0 if all of the configurations have been built successfully
+int RunMatrix(std::string_view directory, const MatrixCommandArgs& args);
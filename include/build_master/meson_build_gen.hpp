@@ -1,5 +1,78 @@
 #pragma once
 
+#include <build_master/json_parse.hpp> // for json
+#include <build_master/output_buffer.hpp>
+
+#include <iostream>
+#include <string>
 #include <string_view>
+#include <stdexcept>
+#include <vector>
+
+enum class TargetType
+{
+	StaticLibrary,
+	SharedLibrary,
+	HeaderOnlyLibrary,
+	Executable
+};
+
+// Returns type of the target from its "is_executable", "is_static_library", "is_shared_library", or "is_header_only_library" key, executable if none is true
+TargetType DetectTargetType(const json& targetJson);
+
+// Returns the linkers (names for -fuse-ld=) the "linker" key allows, in the order they are tried
+// e.g. { "mold", "lld", "gold" } for "auto", { "lld" } for "lld", and empty if it isn't given (i.e. the compiler's default linker is used)
+// Throws ProjectModelError if it isn't one of auto, mold, lld, gold, or bfd
+std::vector<std::string_view> GetLinkerCandidates(const json& buildMasterJson);
+
+// Returns true if the token (of a list in build_master.json) is a literal, i.e. it is neither a variable, nor an environment variable, nor a link_dir: token
+bool IsLiteralToken(std::string_view str);
+
+// Thrown if build_master.json describes an invalid project, e.g. a missing source file, or a malformed "simd_sources"
+// The command line reports it and exits, whereas the library (see api.hpp) passes it on to the caller
+class ProjectModelError : public std::runtime_error
+{
+public:
+	using std::runtime_error::runtime_error;
+};
+
+// Generated meson.build fragment for a single target, it is included from the root meson.build with subdir()
+struct TargetScript
+{
+	std::string name;
+	OutputBuffer content;
+};
+
+// Folds the literal vars of the parsed build_master.json into the lists, and checks that the literal source files and include directories exist
+// Only the host platform's "<platform>_sources" are checked
+// directory: the project's root, the source paths are relative to it
+// isVerbose: reports the number of folded vars into output
+// isMissingPathError: throws ProjectModelError if any of them doesn't exist, otherwise reports them as a warning into output
+// 	(i.e. if the pre-config hooks, which may generate them, haven't run yet)
+json BuildProjectModel(json buildMasterJson, std::string_view directory, bool isVerbose = true, bool isMissingPathError = true, std::ostream& output = std::cout);
+
+// Parses build_master.json, folds its literal vars into the lists, and checks that the literal source files and include directories exist (exits if not)
+// It is the project model meson.build is generated from, the direct ninja backend (see ninja_build_gen.hpp) generates build.ninja from it too
+// directory: value passed to --directory flag
+// isMissingPathError: see BuildProjectModel()
+json LoadProjectModel(std::string_view directory, bool isMissingPathError = true);
+
+// Generates meson.build of the project model into buffer, nothing is written into the project's directory
+// targetScripts: populated with per-target fragments if "split_meson_build" is true, otherwise the targets go into the buffer
+// isVerbose: reports the size saved by not declaring the identical and empty target lists into output
+// isWorkspaceMember: see RegenerateMesonBuildScript()
+// Throws ProjectModelError if a target is invalid (e.g. a malformed "simd_sources")
+void GenerateMesonBuildScript(const json& buildMasterJson, OutputBuffer& buffer, std::vector<TargetScript>& targetScripts, bool isVerbose = true, bool isWorkspaceMember = false,
+								std::ostream& output = std::cout);
+
+// Regenerates meson.build if build_master.json is more recent (or isForce is true)
+// isWorkspaceMember: true if the project is a subproject of 'build_master workspace', then its library targets are registered with meson.override_dependency(),
+// 	so that dependency() calls in the other projects of the workspace resolve to them. It is also regenerated if it was generated for the other mode.
+// Returns true if meson.build has been regenerated, false if it was already upto date
+// Exits if build_master.json doesn't exist or is invalid
+bool RegenerateMesonBuildScript(std::string_view directory = "", bool isForce = false, bool isWorkspaceMember = false);
 
-void RegenerateMesonBuildScript(std::string_view directory = "", bool isForce = false);
+// Same as RegenerateMesonBuildScript(), but it can run in parallel for different projects (see InvokeMesonWorkspace())
+// output: receives the report (the generated paths, the warnings, etc.), which RegenerateMesonBuildScript() writes on stdout
+// Throws ProjectModelError instead of exiting
+bool TryRegenerateMesonBuildScript(std::string_view directory, bool isForce, bool isWorkspaceMember, std::ostream& output);
@@ -17,6 +17,10 @@ R"(
 # $ meson setup <builddir> --reconfigure --buildtype=release # reconfigure the build directory for debug build
 # $ meson compile -C <builddir> # compile the project
 #
+# Profile build (optimized, with debug info and frame pointers)
+# -------------------------
+# $ build_master profile -C <builddir> <target> # sets up a dedicated build directory for the profile build (debugoptimized, marked by build_master_profile.stamp)
+#
 # Static Library
 # -------------------------
 # $ meson setup --wipe <buildir> # wipe the build artifacts (like object files)
@@ -50,10 +54,11 @@ project($$project_name$$, 'c', 'cpp',
     'warning_level=3',
     'buildtype=debug',
     'c_std=c17',
-    'cpp_std=c++20'
+    'cpp_std=c++20'$$extra_default_options$$
   ]
 )
 
+$$env_vars$$
 # Variables
 $$vars$$
 
@@ -85,6 +90,7 @@ $$include_dirs$$
 # Library Install Directory
 lib_install_dir_bm_internal__ = get_option('libdir')/$$canonical_name$$
 
+$$resolved_dependencies$$
 # Dependencies
 dependencies_bm_internal__ = [
 $$dependencies$$
@@ -153,10 +159,15 @@ elif os_name_bm_internal__ == 'darwin'
 endif
 add_project_link_arguments(project_compile_link_args_bm_internal__, link_args_bm_internal__, language : 'c')
 add_project_link_arguments(project_compile_link_args_bm_internal__, link_args_bm_internal__, language : 'cpp')
+$$linker$$
+# Profile build, a debugoptimized build directory set up by 'build_master profile', which marks it with build_master_profile.stamp
+# The other debugoptimized build directories are debug builds, the same as before the profile build has been introduced
+is_profile_build_bm_internal__ = get_option('buildtype') == 'debugoptimized' and import('fs').is_file(meson.global_build_root() / 'build_master_profile.stamp')
+is_release_build_bm_internal__ = get_option('buildtype') == 'release' or is_profile_build_bm_internal__
 
 # Build type specific defines
 project_build_mode_defines_bm_internal__ = defines_bm_internal__
-if get_option('buildtype') == 'release'
+if is_release_build_bm_internal__
   add_project_arguments(release_defines_bm_internal__, language : 'c')
   add_project_arguments(release_defines_bm_internal__, language : 'cpp')
   project_build_mode_defines_bm_internal__ += release_defines_bm_internal__
@@ -166,35 +177,42 @@ else
   project_build_mode_defines_bm_internal__ += debug_defines_bm_internal__
 endif
 
+# Profile build, same as the release build but with debug info, and the frame pointers kept so that perf can walk the stacks cheaply
+# Each flag is probed with each language's compiler, as the C and C++ compilers may differ (e.g. gcc and clang++)
+if is_profile_build_bm_internal__
+  foreach lang_bm_internal__ : [ 'c', 'cpp' ]
+    add_project_arguments(meson.get_compiler(lang_bm_internal__).get_supported_arguments([ '-fno-omit-frame-pointer', '-mno-omit-leaf-frame-pointer' ]),
+                          language : lang_bm_internal__)
+  endforeach
+endif
+
+# Benchmark targets always use the release defines, the debug defines (added to the whole project in non-release builds) are undefined for them
+benchmark_defines_bm_internal__ = []
+if not is_release_build_bm_internal__
+  foreach define_bm_internal__ : debug_defines_bm_internal__
+    if define_bm_internal__.startswith('-D')
+      benchmark_defines_bm_internal__ += '-U' + define_bm_internal__.substring(2).split('=')[0]
+    endif
+  endforeach
+endif
+benchmark_defines_bm_internal__ += defines_bm_internal__ + release_defines_bm_internal__ + ['-DNDEBUG']
+$$dev_fast_link$$
+$$simd_dispatch$$
 # pkg-config package installation
 # Try PKG_CONFIG_PATH first, typicallly it succeeds on MINGW64 (MSYS2)
-python_pkg_config_path_result_bm_internal__ = run_command(find_program('python'), '-c', 'import os; print(os.environ["PKG_CONFIG_PATH"])', check : false)
+# NOTE: meson initializes 'pkg_config_path' option from PKG_CONFIG_PATH (already split), so no process needs to be spawned here
+pkg_config_path_bm_internal__ = get_option('pkg_config_path')
 pkgconfig_install_path_bm_internal__ = ''
-if python_pkg_config_path_result_bm_internal__.returncode() == 0
-  str = python_pkg_config_path_result_bm_internal__.stdout()
-  # Unix
-  if str.startswith('/')
-    pkgconfig_install_path_bm_internal__ = str.replace(';', ':').split(':')[0]
-  # Windows
-  else
-    pkgconfig_install_path_bm_internal__ = str.split(';')[0]
-  endif
+if pkg_config_path_bm_internal__.length() > 0
+  pkgconfig_install_path_bm_internal__ = pkg_config_path_bm_internal__[0]
 endif
+# Otherwise the first lookup directory of pkg-config, it is queried by build_master at the generation time (so pkg-config isn't spawned here)
+if pkgconfig_install_path_bm_internal__ == '' and import('fs').is_file($$pkg_config_dir_snapshot$$)
+  pkgconfig_install_path_bm_internal__ = import('fs').read($$pkg_config_dir_snapshot$$).strip()
+endif
+# Finally if the above attempts fail, use 'libdir' value
 if pkgconfig_install_path_bm_internal__ == ''
-  # Otherwise use pkg-config to query its lookup directories
-  message('PKG_CONFIG_PATH seems to be empty, trying another method')
-  python_pkg_config_path_result_bm_internal__ = run_command('pkg-config', '--variable', 'pc_path', 'pkg-config', check : false)
-  if python_pkg_config_path_result_bm_internal__.returncode() == 0
-    str = python_pkg_config_path_result_bm_internal__.stdout()
-    if str.startswith('/')
-      pkgconfig_install_path_bm_internal__ = str.replace(';', ':').split(':')[0]
-    else
-      pkgconfig_install_path_bm_internal__ = str.split(';')[0]
-    endif
-  # Finally if the above attempts fail, use 'libdir' value
-  else
-    pkgconfig_install_path_bm_internal__ = get_option('libdir')
-  endif
+  pkgconfig_install_path_bm_internal__ = get_option('libdir')
 endif
 message('pkg config path: ' + pkgconfig_install_path_bm_internal__)
 
@@ -3,6 +3,8 @@
 #include <string>
 #include <string_view>
 #include <vector>
+#include <cstdint>
+#include <filesystem>
 
 std::string LoadTextFile(std::string_view filePath);
 std::string GetPathStrRelativeToDir(std::string_view directoryBase, std::string_view relativePath);
@@ -12,3 +14,32 @@ std::string GetBuildMasterJsonFilePath(std::string_view directory);
 // 1. If the compilation platform is Windows then it chooses paths containing mingw, if not found then it looks for msys
 // 2. If the compilation platform is other than Windows then it chooses the first path at index 0.
 std::string SelectPath(const std::vector<std::string>& paths);
+
+// Returns full path of the running build_master executable (for the commands generated to run it later, e.g. by ninja)
+// Falls back to build_master in PATH where the running executable can't be found
+std::string GetSelfExecutablePath();
+
+// Quotes an argument for the shell, meson splits the compiler commands (CC, CXX) the same way
+// On Windows it is quoted as expected by CommandLineToArgvW() instead, which meson follows there (and RunProcess() builds the command lines with it)
+// Examples:
+// -DFOO=1 -> -DFOO=1
+// /opt/my tools/build_master -> '/opt/my tools/build_master'
+std::string QuoteShellArg(std::string_view arg);
+
+// Returns 64-bit FNV-1a hash of the given data, it is not cryptographic and only meant for change detection
+// hash: hash of the preceding data, so that the data can be hashed in chunks
+std::uint64_t ComputeContentHash(std::string_view data, std::uint64_t hash = 14695981039346656037ULL);
+
+// Clones the file (copy-on-write, the blocks are shared until either of them is modified) on the file systems which support it (btrfs, xfs, apfs, etc.)
+// toPath must not exist, it is created with the permissions of fromPath
+// Returns false if it isn't supported
+bool ReflinkFile(const std::filesystem::path& fromPath, const std::filesystem::path& toPath);
+
+// Creates (or truncates) the file at filePath and writes textData into it with a single write() call, the data isn't copied into a stream buffer
+// It also creates any intermediate directories if doesn't exist.
+void OverwriteTextFile(std::string_view filePath, std::string_view textData);
+
+// Writes textData into the file at filePath only if the content of the existing file differs (or the file doesn't exist)
+// It also creates any intermediate directories if doesn't exist.
+// Returns true if the file has been written, otherwise false
+bool WriteTextFileIfChanged(std::string_view filePath, std::string_view textData);
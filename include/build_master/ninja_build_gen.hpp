@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// The direct ninja backend records the configuration of a build directory in this file (relative to the build directory),
+// 'build_master build' executes ninja directly (without meson) in the build directories having it
+static constexpr std::string_view gNinjaBackendStateFileName = "build_master_ninja.json";
+
+// Stores values of the arguments passed to 'configure' command
+// Example: build_master configure -C build --buildtype release
+struct ConfigureCommandArgs
+{
+	// -C <build directory>, relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory { "build" };
+	// --buildtype <debug, release, or debugoptimized>, same as meson's buildtype
+	std::string buildType { "debug" };
+	// --regenerate, passed by build.ninja when it regenerates itself
+	// The pre-config hooks aren't run and the prebuilt dependencies aren't rebuilt (only found), i.e. a regeneration within a build doesn't have side effects
+	bool isRegenerate { false };
+};
+
+// build_master configure
+// Configures the build directory without meson (the direct ninja backend): build.ninja is generated from build_master.json (see LoadProjectModel())
+// with the compile (with depfiles), link, and regeneration rules, and the dependencies are resolved with pkg-config (cached, see ProbePkgConfigDependencies()).
+// The projects needing meson (meson expressions in "vars", environment variables, tests, benchmarks, dependencies not found via pkg-config, etc.)
+// are rejected with all of the reasons listed, those have to be configured with 'build_master meson setup'.
+// build.ninja regenerates itself (by running this command again) whenever build_master.json or the .pc files of the dependencies change.
+// The C++20 module interfaces ("module_sources") are built with GCC and Clang, ordered by their imports scanned at the configure time, see ProbeCxxModules().
+// directory: value passed to --directory flag
+// Returns exit code
+int RunConfigure(std::string_view directory, const ConfigureCommandArgs& args);
+
+// Returns true if the build directory has been configured by the direct ninja backend (i.e. by 'build_master configure')
+// buildDirectory: path of the build directory relative to the current working directory
+bool IsNinjaBackendBuildDirectory(std::string_view buildDirectory);
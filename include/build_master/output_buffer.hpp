@@ -0,0 +1,61 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <format>
+#include <iterator>
+#include <concepts>
+#include <utility>
+
+// Growable output buffer for the generated scripts
+// Everything is formatted directly into a single std::string (reserved upfront with an estimate of the final size),
+// so no temporary strings are created on the way, and the whole content can be written into the file at once.
+class OutputBuffer
+{
+private:
+	std::string m_data;
+
+public:
+	OutputBuffer() = default;
+	explicit OutputBuffer(std::size_t capacity) { m_data.reserve(capacity); }
+
+	void Reserve(std::size_t capacity) { m_data.reserve(capacity); }
+	// Keeps the capacity, so a scratch buffer can be reused without allocating again
+	void Clear() noexcept { m_data.clear(); }
+	std::size_t Size() const noexcept { return m_data.size(); }
+	std::size_t Capacity() const noexcept { return m_data.capacity(); }
+	std::string_view View() const noexcept { return m_data; }
+	// Moves the content out of the buffer
+	std::string Release() noexcept { return std::move(m_data); }
+
+	template<typename... Args>
+	void Format(std::format_string<Args...> fmt, Args&&... args)
+	{
+		std::format_to(std::back_inserter(m_data), fmt, std::forward<Args>(args)...);
+	}
+
+	OutputBuffer& operator<<(std::string_view str)
+	{
+		m_data.append(str);
+		return *this;
+	}
+
+	OutputBuffer& operator<<(const char* str)
+	{
+		m_data.append(str);
+		return *this;
+	}
+
+	OutputBuffer& operator<<(char ch)
+	{
+		m_data.push_back(ch);
+		return *this;
+	}
+
+	template<std::integral T> requires (!std::same_as<T, char> && !std::same_as<T, bool>)
+	OutputBuffer& operator<<(T value)
+	{
+		Format("{}", value);
+		return *this;
+	}
+};
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+
+// Stores values of the arguments passed to 'package' command
+// Example: build_master package -C build --format=deb -j 16
+struct PackageCommandArgs
+{
+	// -C <build directory>, relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory { "build" };
+	// --format=tar.zst|tar.xz|deb
+	std::string format { "tar.zst" };
+	// -o <path of the package>, by default it is <build directory>/<canonical_name>-<version>.tar.zst (or .tar.xz),
+	// and <build directory>/<canonical_name>_<version>_<architecture>.deb for deb
+	std::string outputPath;
+	// -j <number of parallel debug info splits, and compression threads>, 0 means the number of hardware threads
+	unsigned int jobCount { 0 };
+	// --level <compression level>, 0 means the default level of the compressor (19 for zstd, 6 for xz)
+	int compressionLevel { 0 };
+	// --no-split-debug, the debug info is left in the binaries
+	bool isNoSplitDebug { false };
+	// --no-rebuild
+	bool isNoRebuild { false };
+};
+
+// build_master package
+// Packages the project into a tarball (tar.zst or tar.xz) or a Debian package (deb):
+// 'meson install' installs into a staging directory (<build directory>/build_master_package_stage, so no root privileges are needed),
+// the debug info of the ELF binaries is split (with objcopy, in parallel) into a separate debug package (usr/lib/debug/<path of the binary>.debug),
+// then the staged files are archived and compressed with the multi threaded zstd or xz.
+// The archives are reproducible: the entries are sorted, their owner is root, and their mtime is fixed to SOURCE_DATE_EPOCH (0 if it isn't set),
+// so the identical staged files produce the identical package.
+// directory: value passed to --directory flag
+// Returns exit code
+int RunPackage(std::string_view directory, const PackageCommandArgs& args);
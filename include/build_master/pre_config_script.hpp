@@ -1,6 +1,22 @@
 #pragma once
 
+#include <build_master/json_parse.hpp> // for json
+
 #include <string_view>
+#include <stdexcept>
+
+// Thrown if the hook scripts can't be run, i.e. bash isn't found
+class PreConfigScriptError : public std::runtime_error
+{
+public:
+	using std::runtime_error::runtime_error;
+};
+
+// Runs the hooks of the (already parsed) build_master.json in the project's directory
+// Returns true if either of 'pre_config_hook' or 'pre_config_root_hook' is given
+// Throws PreConfigScriptError if bash isn't found
+bool RunPreConfigScript(const json& buildMasterJson, std::string_view directory);
 
+// Same as above, but parses build_master.json of the project, and exits if the hooks can't be run
 // Returns true if either of 'pre_config_hook' or 'pre_config_root_hook' is given
 bool RunPreConfigScript(std::string_view directory);
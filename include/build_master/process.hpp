@@ -0,0 +1,47 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <optional>
+#include <cstdint>
+
+struct ProcessResult
+{
+	// Exit code of the process, it is -1 if the process couldn't be started or it has been terminated by a signal
+	int exitCode { -1 };
+	// true if the process has been killed because it didn't finish within the timeout
+	bool isTimedOut { false };
+	// Wall time in seconds
+	double wallTime { 0 };
+	// CPU time (in seconds) spent in user mode and in the kernel by the process, and by its descendants which it has waited for
+	double userTime { 0 };
+	double systemTime { 0 };
+	// Peak resident set size (in bytes) of the process, or of the largest of its descendants (which it has waited for)
+	// i.e. for a build tool it is the memory used by the most memory hungry compile/link job, it is 0 if it isn't known (on Windows)
+	std::uint64_t peakMemory { 0 };
+};
+
+// Runs the executable without going through a shell, args[0] must be either a full path or an executable name in PATH
+// workDirectory: if not empty, the process runs in this directory
+// env: environment variables to set (in addition to the inherited ones)
+// outputFilePath: if not empty, stdout and stderr of the process are redirected (truncated) into this file
+// timeout: in seconds, 0 means no timeout, otherwise the process runs in its own process group (so that the whole group can be killed)
+//			without a timeout, it stays in the process group of build_master, so that Ctrl+C in the terminal reaches it too
+ProcessResult RunProcess(const std::vector<std::string>& args,
+						std::string_view workDirectory = "",
+						const std::vector<std::pair<std::string, std::string>>& env = { },
+						std::string_view outputFilePath = "",
+						double timeout = 0);
+
+// Replaces the current process with the executable (execvp) on POSIX, so that it gets the terminal's signals (Ctrl+C) directly
+// On Windows the executable is run as a child process and its exit code is returned.
+// args[0] must be either a full path or an executable name in PATH
+// Returns only if the executable couldn't be started (-1), or on Windows
+int ExecProcess(const std::vector<std::string>& args);
+
+// Runs the executable (without going through a shell, as RunProcess() does, stderr is discarded) and returns its stdout with the trailing whitespaces trimmed
+// args[0] must be either a full path or an executable name in PATH
+// Returns null if the command couldn't be run or it exits with non-zero code
+std::optional<std::string> RunCmdCaptureOutput(const std::vector<std::string>& args);
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Stores values of the arguments passed to 'profile' command
+// Example: build_master profile --top 30 my_app -- --input data.bin
+struct ProfileCommandArgs
+{
+	// -C <build directory>, relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory { "build-profile" };
+	// --frequency <Hz>, sampling frequency of perf record
+	unsigned int frequency { 999 };
+	// --top <count>, number of the hottest functions to print
+	unsigned int topCount { 20 };
+	// Name of the executable target to profile
+	std::string targetName;
+	// Arguments passed to the executable (after --)
+	std::vector<std::string> targetArgs;
+};
+
+// build_master profile
+// Builds the profile variant of the executable target (buildtype=debugoptimized, i.e. optimized, with debug info and frame pointers),
+// sets up the build directory first if needed (a build directory configured otherwise is refused), then runs the executable under 'perf record' (call graphs through the frame pointers).
+// The samples are folded into <build directory>/meson-logs/build_master_profile/<target>.folded (one "frame;frame;... count" line per stack),
+// rendered as a flamegraph into <target>.svg, and the hottest functions (by self samples) are printed.
+// directory: value passed to --directory flag
+// Returns exit code, non-zero if the target couldn't be built or perf couldn't record it
+int RunProfile(std::string_view directory, const ProfileCommandArgs& args);
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Name of the log 'build_master cc-wrap' appends to, in its working directory (the build directory, ninja runs the jobs there)
+static constexpr std::string_view gResourceLogFileName = "build_master_resource_log.bin";
+
+// build_master cc-wrap <compiler> <args...>
+// Compiler launcher (same as ccache, it is put in front of the compiler), injected into the build when "resource_accounting" is true in build_master.json.
+// Runs the compiler (it also links, as the compiler driver), and appends a record of the job to build_master_resource_log.bin in the working directory:
+// wall, user, and sys time, peak RSS (from wait4()), exit code, size of the output (-o), and the source file compiled (none for the links).
+// Each record is appended with a single write() (O_APPEND), so the parallel jobs don't interleave their records.
+// The response files (@<file>) are expanded to find -o, -c, and the source file, the compiler gets them as they are.
+// The jobs without -o (e.g. 'cc --version' of the compiler checks) aren't recorded.
+// args: the compiler and its arguments
+// Returns exit code of the compiler
+int RunCcWrap(const std::vector<std::string>& args);
+
+// Stores values of the arguments passed to 'report' command
+// Example: build_master report -C build --top 20
+struct ReportCommandArgs
+{
+	// -C <build directory>, relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory { "build" };
+	// --top <number of the compile jobs with the highest peak RSS to list>
+	unsigned int topCount { 10 };
+};
+
+// build_master report
+// Aggregates build_master_resource_log.bin of the build directory per target and per source directory,
+// only the latest record of each output counts (the log keeps the jobs of all of the builds).
+// The objects of a target are found from meson's layout (<target output>.p/<object>), same in the build directories configured by 'build_master configure'.
+// directory: value passed to --directory flag
+// Returns exit code
+int RunReport(std::string_view directory, const ReportCommandArgs& args);
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Stores values of the arguments passed to 'test' command
+// Example: build_master test -C build --shard 2/4 -j 8
+struct TestCommandArgs
+{
+	// -C <build directory>, relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory { "build" };
+	// --shard i/N, 1-based index of this shard and the total number of shards, empty means no sharding
+	// The shards are balanced by the durations if --durations-file is given (it must be shared by all of the shards),
+	// otherwise the tests are partitioned by the hashes of their names, which is the same on every machine
+	std::string shard;
+	// -j <number of tests to run in parallel>, 0 means number of hardware threads
+	unsigned int jobCount { 0 };
+	// --durations-file <path>, by default it is build_master_test_durations.json in the build directory
+	std::string durationsFilePath;
+	// --no-rebuild
+	bool isNoRebuild { false };
+	// Names of the tests to run, empty means all
+	std::vector<std::string> testNames;
+};
+
+// build_master test
+// Rebuilds the project, and runs the tests (executable targets with "is_test": true) registered with meson.
+// Tests are scheduled longest-first based on the durations recorded in the previous runs, and can be split into shards
+// (balanced by the durations of a shared --durations-file, otherwise by the name hashes) to run on multiple CI machines.
+// directory: value passed to --directory flag
+// Returns exit code, 0 if all tests passed (or skipped)
+int RunTests(std::string_view directory, const TestCommandArgs& args);
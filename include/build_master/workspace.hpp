@@ -0,0 +1,11 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+#include <string>
+
+// build_master workspace
+// Generates meson.build of each project listed in build_master_workspace.json (in parallel), and a root meson.build
+// which includes all of them as meson subprojects, and then invokes meson in the workspace directory.
+// directory: value passed to --directory flag
+void InvokeMesonWorkspace(std::string_view directory, const std::vector<std::string>& args);
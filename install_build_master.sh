@@ -33,15 +33,22 @@ else
 	BUILD_TYPE="release"
 fi
 
+# STATIC=1 links the libraries statically (see meson_options.txt), which reduces the startup time of build_master
+if [ -n "${STATIC}" ]; then
+	STATIC_LINK="true"
+else
+	STATIC_LINK="false"
+fi
+
 MESON_CMD="$DSTPATH/bin/build_master_meson"
 
 if INSTALL_PREFIX="$DSTPATH" ./install_meson.sh; then
 	if [[ "$PLATFORM" == "MINGW" ]]; then
-		($MESON_CMD setup build --reconfigure --buildtype=$BUILD_TYPE --prefix=$DSTPATH && \
+		($MESON_CMD setup build --reconfigure --buildtype=$BUILD_TYPE -Dstatic_link=$STATIC_LINK --prefix=$DSTPATH && \
 		$MESON_CMD compile -C build && \
 		$MESON_CMD install -C build --skip-subprojects)
 	else
-		($NO_ROOT $MESON_CMD setup build --reconfigure --buildtype=$BUILD_TYPE --prefix=$DSTPATH && \
+		($NO_ROOT $MESON_CMD setup build --reconfigure --buildtype=$BUILD_TYPE -Dstatic_link=$STATIC_LINK --prefix=$DSTPATH && \
 		$NO_ROOT $MESON_CMD compile -C build && \
 		$MESON_CMD install -C build --skip-subprojects)
 	fi
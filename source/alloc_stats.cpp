@@ -0,0 +1,23 @@
+#include <build_master/alloc_stats.hpp>
+
+#include <atomic>
+
+// Relaxed atomics, as the counters don't order any other memory access
+static std::atomic<std::size_t> gAllocationCount { 0 };
+static std::atomic<std::size_t> gAllocatedSize { 0 };
+
+void CountAllocation(std::size_t size) noexcept
+{
+	gAllocationCount.fetch_add(1, std::memory_order_relaxed);
+	gAllocatedSize.fetch_add(size, std::memory_order_relaxed);
+}
+
+std::size_t GetAllocationCount()
+{
+	return gAllocationCount.load(std::memory_order_relaxed);
+}
+
+std::size_t GetAllocatedSize()
+{
+	return gAllocatedSize.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,111 @@
+#include <build_master/api.hpp>
+#include <build_master/meson_build_gen.hpp> // for BuildProjectModel(), and GenerateMesonBuildScript()
+#include <build_master/pre_config_script.hpp> // for RunPreConfigScript()
+#include <build_master/json_parse.hpp> // for ParseBuildMasterJson(), and ParseJsonText()
+#include <build_master/misc.hpp> // for GetBuildMasterJsonFilePath()
+#include <build_master/output_buffer.hpp>
+#include <build_master/version.hpp>
+
+#include <filesystem>
+#include <format>
+#include <string>
+#include <string_view>
+
+namespace build_master
+{
+	struct ProjectModel::Impl
+	{
+		std::string directory;
+		json buildMasterJson;
+	};
+
+	ProjectModel::ProjectModel(std::shared_ptr<const Impl> impl) noexcept : m_impl(std::move(impl)) { }
+
+	// The internals report the invalid projects with ProjectModelError, and the malformed json with nlohmann::json::exception,
+	// both are translated into build_master::Error, so that the users of the API don't depend on json
+	template<typename Callable>
+	static auto TranslateErrors(const Callable& callable)
+	{
+		try
+		{
+			return callable();
+		}
+		catch(const ProjectModelError& error)
+		{
+			throw Error(error.what());
+		}
+		catch(const nlohmann::json::exception& error)
+		{
+			throw Error(std::format("Invalid build_master.json: {}", error.what()));
+		}
+	}
+
+	ProjectModel ProjectModel::Load(std::string_view directory)
+	{
+		// LoadTextFile() exits if the file doesn't exist
+		if(!std::filesystem::exists(GetBuildMasterJsonFilePath(directory)))
+			throw Error(std::format("{} doesn't exist", GetBuildMasterJsonFilePath(directory)));
+		return TranslateErrors([directory]()
+		{
+			return ProjectModel { std::make_shared<const Impl>(std::string { directory }, BuildProjectModel(ParseBuildMasterJson(directory), directory, false)) };
+		});
+	}
+
+	ProjectModel ProjectModel::Parse(std::string_view jsonText, std::string_view directory)
+	{
+		return TranslateErrors([jsonText, directory]()
+		{
+			return ProjectModel { std::make_shared<const Impl>(std::string { directory }, BuildProjectModel(ParseJsonText(std::string { jsonText }), directory, false)) };
+		});
+	}
+
+	const std::string& ProjectModel::GetDirectory() const noexcept
+	{
+		return m_impl->directory;
+	}
+
+	std::string ProjectModel::GetName() const
+	{
+		return TranslateErrors([this]() { return GetJsonKeyValue<std::string>(m_impl->buildMasterJson, "project_name", ""); });
+	}
+
+	std::vector<std::string> ProjectModel::GetTargetNames() const
+	{
+		std::vector<std::string> names;
+		if(auto it = m_impl->buildMasterJson.find("targets"); it != m_impl->buildMasterJson.end())
+			for(const auto& targetJson : it.value())
+				names.push_back(GetJsonKeyValue<std::string>(targetJson, "name", ""));
+		return names;
+	}
+
+	void GenerateMesonBuild(const ProjectModel& model, OutputSink& sink)
+	{
+		OutputBuffer buffer;
+		std::vector<TargetScript> targetScripts;
+		TranslateErrors([&]()
+		{
+			GenerateMesonBuildScript(model.GetImpl().buildMasterJson, buffer, targetScripts, false);
+		});
+		sink.WriteRootScript(buffer.View());
+		for(const auto& targetScript : targetScripts)
+			sink.WriteTargetScript(targetScript.name, targetScript.content.View());
+	}
+
+	bool RunPreConfigHooks(const ProjectModel& model)
+	{
+		// The model's json is used, build_master.json isn't read again (it may not even exist, see ProjectModel::Parse())
+		try
+		{
+			return RunPreConfigScript(model.GetImpl().buildMasterJson, model.GetDirectory());
+		}
+		catch(const PreConfigScriptError& error)
+		{
+			throw Error(error.what());
+		}
+	}
+
+	std::string_view GetVersionString() noexcept
+	{
+		return BUILDMASTER_VERSION_STRING;
+	}
+}
@@ -0,0 +1,564 @@
+#include <build_master/artifact_cache.hpp>
+#include <build_master/json_parse.hpp> // for ParseBuildMasterJson(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), GetBuildMasterJsonFilePath(), SelectPath(), ComputeContentHash(), and OverwriteTextFile()
+#include <build_master/process.hpp> // for RunProcess(), and RunCmdCaptureOutput()
+#include <build_master/version.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <format>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <initializer_list>
+#include <optional>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+
+#include <spdlog/spdlog.h>
+#include <invoke/invoke.hpp> // for invoke::FindExecutable()
+
+#ifdef _WIN32
+#	include <windows.h>
+#else
+#	include <unistd.h>
+#	include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+static constexpr std::string_view gHostPlatformName = "windows";
+static constexpr char gPathListSeparator = ';';
+#elif defined(__APPLE__)
+static constexpr std::string_view gHostPlatformName = "darwin";
+static constexpr char gPathListSeparator = ':';
+#else
+static constexpr std::string_view gHostPlatformName = "linux";
+static constexpr char gPathListSeparator = ':';
+#endif
+
+static constexpr std::string_view gBash = "bash";
+// Absolute path of the prefix is replaced with this in the .pc files of an artifact, so that it can be restored into any prefix
+static constexpr std::string_view gPrefixPlaceholder = "@BUILD_MASTER_PREFIX@";
+// Written into the prefix of a dependency once it is built or restored, holds the key of the artifact
+static constexpr std::string_view gKeyStampFileName = ".build_master_artifact_key";
+static constexpr std::string_view gManifestFileName = "manifest.json";
+static constexpr std::string_view gFilesDirName = "files";
+static constexpr std::string_view gStatsFileName = "stats.json";
+static constexpr std::uint64_t gDefaultMaxCacheSizeMb = 10 * 1024;
+static constexpr std::uint64_t gMiB = 1024 * 1024;
+
+struct CacheConfig
+{
+	std::filesystem::path directory;
+	// Base URL of the HTTP backend (GET and PUT of <url>/<key>.tar), empty if there is none
+	std::string url;
+	// In bytes
+	std::uint64_t maxSize { gDefaultMaxCacheSizeMb * gMiB };
+};
+
+// Counts of the files restored or stored in each way
+struct CopyStats
+{
+	std::size_t reflinkCount { 0 };
+	std::size_t hardlinkCount { 0 };
+	std::size_t copyCount { 0 };
+	std::uint64_t size { 0 };
+};
+
+struct CachedArtifact
+{
+	std::filesystem::path path;
+	std::uint64_t size { 0 };
+	std::filesystem::file_time_type lastUseTime;
+};
+
+static std::filesystem::path GetDefaultCacheDirectory()
+{
+#ifdef _WIN32
+	if(const char* localAppData = std::getenv("LOCALAPPDATA"); localAppData && *localAppData)
+		return std::filesystem::path(localAppData) / "build_master" / "artifacts";
+#else
+	if(const char* xdgCacheHome = std::getenv("XDG_CACHE_HOME"); xdgCacheHome && *xdgCacheHome)
+		return std::filesystem::path(xdgCacheHome) / "build_master" / "artifacts";
+	if(const char* home = std::getenv("HOME"); home && *home)
+		return std::filesystem::path(home) / ".cache" / "build_master" / "artifacts";
+#endif
+	return std::filesystem::temp_directory_path() / "build_master_artifacts";
+}
+
+// "artifact_cache" : { "directory" : ..., "url" : ..., "max_size_mb" : ... } in build_master.json,
+// the environment variables BUILD_MASTER_CACHE_DIR, BUILD_MASTER_CACHE_URL, and BUILD_MASTER_CACHE_MAX_SIZE_MB take the precedence (configuration of a CI runner)
+static CacheConfig GetCacheConfig(std::string_view directory, const json& buildMasterJson)
+{
+	CacheConfig config;
+	json cacheJson = GetJsonKeyValue<json>(buildMasterJson, "artifact_cache", json::object());
+	if(const char* value = std::getenv("BUILD_MASTER_CACHE_DIR"); value && *value)
+		config.directory = value;
+	else if(auto cacheDirectory = GetJsonKeyValueOrNull<std::string>(cacheJson, "directory"))
+		config.directory = GetPathStrRelativeToDir(directory, cacheDirectory.value());
+	else
+		config.directory = GetDefaultCacheDirectory();
+	if(const char* value = std::getenv("BUILD_MASTER_CACHE_URL"); value && *value)
+		config.url = value;
+	else
+		config.url = GetJsonKeyValue<std::string>(cacheJson, "url", "");
+	while(config.url.ends_with('/'))
+		config.url.pop_back();
+	std::uint64_t maxSizeMb = GetJsonKeyValue<std::uint64_t>(cacheJson, "max_size_mb", gDefaultMaxCacheSizeMb);
+	if(const char* value = std::getenv("BUILD_MASTER_CACHE_MAX_SIZE_MB"); value && *value)
+	{
+		try
+		{
+			maxSizeMb = std::stoull(value);
+		} catch(const std::exception&)
+		{
+			spdlog::warn("Ignoring invalid value {} of BUILD_MASTER_CACHE_MAX_SIZE_MB", value);
+		}
+	}
+	config.maxSize = maxSizeMb * gMiB;
+	return config;
+}
+
+static std::string LoadBinaryFile(const std::filesystem::path& path)
+{
+	std::ifstream stream(path, std::ios_base::binary);
+	std::ostringstream contentStream;
+	contentStream << stream.rdbuf();
+	return std::move(contentStream).str();
+}
+
+static unsigned long GetProcessId()
+{
+#ifdef _WIN32
+	return GetCurrentProcessId();
+#else
+	return static_cast<unsigned long>(getpid());
+#endif
+}
+
+// Adds the given counts to the statistics of the cache, they are approximate if multiple builds share the cache at the same time
+static void AddStats(const CacheConfig& config, std::initializer_list<std::pair<std::string_view, std::uint64_t>> counts)
+{
+	auto statsFilePath = config.directory / gStatsFileName;
+	json statsJson = json::object();
+	if(std::filesystem::exists(statsFilePath))
+	{
+		statsJson = json::parse(LoadBinaryFile(statsFilePath), nullptr, false);
+		if(statsJson.is_discarded() || !statsJson.is_object())
+			statsJson = json::object();
+	}
+	for(const auto& [name, count] : counts)
+		statsJson[std::string { name }] = GetJsonKeyValue<std::uint64_t>(statsJson, name, 0) + count;
+	OverwriteTextFile(statsFilePath.string(), statsJson.dump(4));
+}
+
+// Returns the identity of the compiler (output of '<compiler> --version'), CC and CXX environment variables are respected (they may contain a launcher, like ccache)
+static std::string GetCompilerIdentity(const char* envVarName, std::string_view defaultCompiler)
+{
+	const char* value = std::getenv(envVarName);
+	std::string_view compiler = (value && *value) ? std::string_view { value } : defaultCompiler;
+	std::vector<std::string> args;
+	for(std::size_t pos = 0; pos < compiler.size();)
+	{
+		auto endPos = std::min(compiler.find(' ', pos), compiler.size());
+		if(endPos > pos)
+			args.push_back(std::string { compiler.substr(pos, endPos - pos) });
+		pos = endPos + 1;
+	}
+	args.push_back("--version");
+	return std::format("{} {}\n{}", envVarName, compiler, RunCmdCaptureOutput(args).value_or("unknown"));
+}
+
+// Appends "source <path> <hash>" of each file under the source path (file or directory) to the key material, sorted by the path
+static void AppendSourceHashes(std::string_view directory, std::string_view sourcePath, std::string& material)
+{
+	std::filesystem::path path = GetPathStrRelativeToDir(directory, sourcePath);
+	if(!std::filesystem::exists(path))
+	{
+		spdlog::error("Source {} of a prebuilt dependency doesn't exist", path.string());
+		exit(EXIT_FAILURE);
+	}
+	std::vector<std::filesystem::path> filePaths;
+	if(std::filesystem::is_directory(path))
+	{
+		for(auto it = std::filesystem::recursive_directory_iterator(path); it != std::filesystem::recursive_directory_iterator(); ++it)
+		{
+			if(it->is_directory() && it->path().filename() == ".git")
+				it.disable_recursion_pending();
+			else if(it->is_regular_file())
+				filePaths.push_back(it->path());
+		}
+		std::ranges::sort(filePaths);
+	}
+	else
+		filePaths.push_back(path);
+	for(const auto& filePath : filePaths)
+	{
+		auto relativePath = (filePath == path) ? std::filesystem::path(sourcePath) : (std::filesystem::path(sourcePath) / filePath.lexically_relative(path));
+		material.append(std::format("source {} {:016x}\n", relativePath.generic_string(), ComputeContentHash(LoadBinaryFile(filePath))));
+	}
+}
+
+// Returns the key of the artifact and the material it has been computed from (which is recorded in the manifest, to tell why two keys differ)
+static std::pair<std::string, std::string> ComputeArtifactKey(std::string_view directory, const json& dependencyJson, std::string_view name, std::string_view scriptPath)
+{
+	std::string material = std::format("build_master {}\nplatform {}\nname {}\n", BUILDMASTER_VERSION_STRING, gHostPlatformName, name);
+	material.append(std::format("script {:016x}\n", ComputeContentHash(LoadBinaryFile(scriptPath))));
+	for(const auto& flag : GetJsonKeyValue<std::vector<std::string>>(dependencyJson, "flags", std::vector<std::string> { }))
+		material.append(std::format("flag {}\n", flag));
+	material.append(GetCompilerIdentity("CC", "cc")).push_back('\n');
+	material.append(GetCompilerIdentity("CXX", "c++")).push_back('\n');
+	for(const char* envVarName : { "CFLAGS", "CXXFLAGS", "LDFLAGS" })
+	{
+		const char* value = std::getenv(envVarName);
+		material.append(std::format("env {}={}\n", envVarName, value ? value : ""));
+	}
+	for(const auto& sourcePath : GetJsonKeyValue<std::vector<std::string>>(dependencyJson, "sources", std::vector<std::string> { }))
+		AppendSourceHashes(directory, sourcePath, material);
+	// The name makes the artifacts recognizable in the cache directory
+	std::string key { name };
+	std::ranges::replace_if(key, [](char ch) { return !std::isalnum(static_cast<unsigned char>(ch)) && ch != '-' && ch != '_' && ch != '.'; }, '_');
+	key.append(std::format("-{:016x}", ComputeContentHash(material)));
+	return { key, material };
+}
+
+// Copies the directory tree, each file is reflinked if possible, otherwise hardlinked (if isHardlink is true), otherwise copied.
+// .pc files are always copied with fromPrefix replaced by toPrefix, and the key stamp file is skipped.
+static void CopyTree(const std::filesystem::path& fromPath, const std::filesystem::path& toPath, bool isHardlink, std::string_view fromPrefix, std::string_view toPrefix, CopyStats& stats)
+{
+	std::filesystem::create_directories(toPath);
+	for(auto it = std::filesystem::recursive_directory_iterator(fromPath); it != std::filesystem::recursive_directory_iterator(); ++it)
+	{
+		const auto& entry = *it;
+		auto entryToPath = toPath / entry.path().lexically_relative(fromPath);
+		// Versioned shared libraries are symlinks (libfoo.so -> libfoo.so.1), they must stay so
+		if(entry.is_symlink())
+			std::filesystem::copy_symlink(entry.path(), entryToPath);
+		else if(entry.is_directory())
+			std::filesystem::create_directories(entryToPath);
+		else if(!entry.is_regular_file() || entry.path().filename() == gKeyStampFileName)
+			continue;
+		else if(entry.path().extension() == ".pc")
+		{
+			std::string content = LoadBinaryFile(entry.path());
+			for(std::size_t pos = 0; (pos = content.find(fromPrefix, pos)) != std::string::npos; pos += toPrefix.size())
+				content.replace(pos, fromPrefix.size(), toPrefix);
+			OverwriteTextFile(entryToPath.string(), content);
+			++stats.copyCount;
+		}
+		else
+		{
+			stats.size += entry.file_size();
+			std::error_code errorCode;
+			if(ReflinkFile(entry.path(), entryToPath))
+				++stats.reflinkCount;
+			else if(isHardlink && (std::filesystem::create_hard_link(entry.path(), entryToPath, errorCode), !errorCode))
+				++stats.hardlinkCount;
+			else
+			{
+				std::filesystem::copy_file(entry.path(), entryToPath, std::filesystem::copy_options::overwrite_existing);
+				++stats.copyCount;
+			}
+		}
+	}
+}
+
+// The stored files are hardlinked into the prefixes, so they are made read-only to protect the cache from in-place modifications
+static void MakeTreeReadOnly(const std::filesystem::path& path)
+{
+#ifndef _WIN32
+	// NOTE: Read-only files can't be deleted on Windows, that would break removal of the prefixes
+	for(const auto& entry : std::filesystem::recursive_directory_iterator(path))
+		if(entry.is_regular_file() && !entry.is_symlink())
+			std::filesystem::permissions(entry.path(), std::filesystem::perms::owner_write | std::filesystem::perms::group_write | std::filesystem::perms::others_write,
+											std::filesystem::perm_options::remove);
+#else
+	(void)path;
+#endif
+}
+
+static std::vector<CachedArtifact> ListArtifacts(const CacheConfig& config)
+{
+	std::vector<CachedArtifact> artifacts;
+	std::error_code errorCode;
+	for(const auto& entry : std::filesystem::directory_iterator(config.directory, errorCode))
+	{
+		auto manifestFilePath = entry.path() / gManifestFileName;
+		// Temporary directories of the artifacts being stored start with '.'
+		if(!entry.is_directory() || entry.path().filename().string().starts_with('.') || !std::filesystem::exists(manifestFilePath))
+			continue;
+		json manifestJson = json::parse(LoadBinaryFile(manifestFilePath), nullptr, false);
+		CachedArtifact artifact;
+		artifact.path = entry.path();
+		artifact.size = manifestJson.is_object() ? GetJsonKeyValue<std::uint64_t>(manifestJson, "size", 0) : 0;
+		artifact.lastUseTime = std::filesystem::last_write_time(manifestFilePath, errorCode);
+		artifacts.push_back(std::move(artifact));
+	}
+	return artifacts;
+}
+
+// Evicts the least recently used artifacts until the total size fits in maxSize, 0 evicts all of them
+// Returns number of the evicted artifacts
+static std::size_t EvictArtifacts(const CacheConfig& config, std::uint64_t maxSize)
+{
+	std::vector<CachedArtifact> artifacts = ListArtifacts(config);
+	std::uint64_t totalSize = 0;
+	for(const auto& artifact : artifacts)
+		totalSize += artifact.size;
+	std::ranges::sort(artifacts, [](const CachedArtifact& a, const CachedArtifact& b) { return a.lastUseTime < b.lastUseTime; });
+	std::size_t evictedCount = 0;
+	std::uint64_t evictedSize = 0;
+	for(const auto& artifact : artifacts)
+	{
+		if(maxSize && totalSize <= maxSize)
+			break;
+		// Renamed first, so that a concurrent build doesn't restore a half removed artifact
+		auto trashPath = config.directory / std::format(".trash-{}-{}", artifact.path.filename().string(), GetProcessId());
+		std::error_code errorCode;
+		std::filesystem::rename(artifact.path, trashPath, errorCode);
+		if(errorCode)
+			continue;
+		std::filesystem::remove_all(trashPath, errorCode);
+		totalSize -= artifact.size;
+		evictedSize += artifact.size;
+		++evictedCount;
+	}
+	if(evictedCount)
+		AddStats(config, { { "evictions", evictedCount }, { "evicted_size", evictedSize } });
+	return evictedCount;
+}
+
+// Copies the built prefix into the cache, it is written into a temporary directory first and renamed into place, so the concurrent builds never see a partial artifact
+// Returns false if it couldn't be stored
+static bool StoreArtifact(const CacheConfig& config, std::string_view key, std::string_view name, std::string_view material, const std::filesystem::path& prefixPath)
+{
+	auto artifactPath = config.directory / key;
+	if(std::filesystem::exists(artifactPath / gManifestFileName))
+		return true;
+	auto tempPath = config.directory / std::format(".tmp-{}-{}", key, GetProcessId());
+	std::error_code errorCode;
+	std::filesystem::remove_all(tempPath, errorCode);
+	CopyStats stats;
+	try
+	{
+		CopyTree(prefixPath, tempPath / gFilesDirName, false, prefixPath.string(), gPrefixPlaceholder, stats);
+		MakeTreeReadOnly(tempPath / gFilesDirName);
+	} catch(const std::filesystem::filesystem_error& except)
+	{
+		spdlog::warn("Failed to store prebuilt dependency {} into the artifact cache, {}", name, except.what());
+		std::filesystem::remove_all(tempPath, errorCode);
+		return false;
+	}
+	json manifestJson = json::object();
+	manifestJson["name"] = name;
+	manifestJson["key"] = key;
+	manifestJson["size"] = stats.size;
+	manifestJson["material"] = material;
+	OverwriteTextFile((tempPath / gManifestFileName).string(), manifestJson.dump(4));
+	std::filesystem::rename(tempPath, artifactPath, errorCode);
+	// Stored by a concurrent build in the meantime
+	if(errorCode)
+		std::filesystem::remove_all(tempPath, errorCode);
+	return true;
+}
+
+// Downloads <url>/<key>.tar from the HTTP backend into the cache directory
+// Returns false if it isn't there (or the backend isn't reachable)
+static bool FetchRemoteArtifact(const CacheConfig& config, std::string_view key)
+{
+	auto tempPath = config.directory / std::format(".tmp-{}-{}", key, GetProcessId());
+	auto archivePath = config.directory / std::format(".tmp-{}-{}.tar", key, GetProcessId());
+	std::error_code errorCode;
+	std::filesystem::remove_all(tempPath, errorCode);
+	std::filesystem::create_directories(tempPath);
+	// Missing artifacts are expected, so the errors aren't shown (no -S)
+	bool isFetched = RunProcess({ "curl", "-fs", "-o", archivePath.string(), std::format("{}/{}.tar", config.url, key) }).exitCode == 0
+					&& RunProcess({ "tar", "-xf", archivePath.string(), "-C", tempPath.string() }).exitCode == 0
+					&& std::filesystem::exists(tempPath / gManifestFileName);
+	std::filesystem::remove(archivePath, errorCode);
+	if(isFetched)
+	{
+		std::filesystem::rename(tempPath, config.directory / key, errorCode);
+		isFetched = !errorCode || std::filesystem::exists(config.directory / key / gManifestFileName);
+	}
+	std::filesystem::remove_all(tempPath, errorCode);
+	return isFetched;
+}
+
+// Uploads the artifact as <url>/<key>.tar to the HTTP backend with a PUT request
+static bool UploadArtifact(const CacheConfig& config, std::string_view key)
+{
+	auto archivePath = config.directory / std::format(".tmp-{}-{}.tar", key, GetProcessId());
+	bool isUploaded = RunProcess({ "tar", "-cf", archivePath.string(), "-C", (config.directory / key).string(), "." }).exitCode == 0
+					&& RunProcess({ "curl", "-fsS", "-T", archivePath.string(), std::format("{}/{}.tar", config.url, key) }).exitCode == 0;
+	std::error_code errorCode;
+	std::filesystem::remove(archivePath, errorCode);
+	return isUploaded;
+}
+
+static std::string LoadKeyStamp(const std::filesystem::path& prefixPath)
+{
+	std::ifstream stream(prefixPath / gKeyStampFileName);
+	std::string key;
+	stream >> key;
+	return key;
+}
+
+// Builds the dependency into its prefix, or restores it from the cache, unless the prefix already holds the same artifact
+static void PrepareDependency(std::string_view directory, const json& dependencyJson, const std::filesystem::path& prefixPath, const CacheConfig& config)
+{
+	std::string name = GetJsonKeyValue<std::string>(dependencyJson, "name");
+	auto scriptPath = GetPathStrRelativeToDir(directory, GetJsonKeyValue<std::string>(dependencyJson, "script"));
+	if(!std::filesystem::exists(scriptPath))
+	{
+		spdlog::error("Build script {} of prebuilt dependency {} doesn't exist", scriptPath, name);
+		exit(EXIT_FAILURE);
+	}
+	auto [key, material] = ComputeArtifactKey(directory, dependencyJson, name, scriptPath);
+	if(LoadKeyStamp(prefixPath) == key)
+		return;
+
+	std::filesystem::create_directories(config.directory);
+	auto artifactPath = config.directory / key;
+	bool isHit = std::filesystem::exists(artifactPath / gManifestFileName);
+	bool isRemoteHit = !isHit && config.url.size() && FetchRemoteArtifact(config, key);
+	if(isHit || isRemoteHit)
+	{
+		CopyStats stats;
+		try
+		{
+			std::filesystem::remove_all(prefixPath);
+			CopyTree(artifactPath / gFilesDirName, prefixPath, true, gPrefixPlaceholder, prefixPath.string(), stats);
+			// Recently used artifacts are the last ones to be evicted
+			std::filesystem::last_write_time(artifactPath / gManifestFileName, std::filesystem::file_time_type::clock::now());
+			AddStats(config, { { isRemoteHit ? "remote_hits" : "hits", 1 } });
+			OverwriteTextFile((prefixPath / gKeyStampFileName).string(), key);
+			spdlog::info("Restored prebuilt dependency {} from the artifact cache{}, {} files reflinked, {} hardlinked, {} copied",
+							name, isRemoteHit ? " (downloaded)" : "", stats.reflinkCount, stats.hardlinkCount, stats.copyCount);
+			return;
+		} catch(const std::filesystem::filesystem_error& except)
+		{
+			spdlog::warn("Failed to restore prebuilt dependency {} from the artifact cache, building it instead, {}", name, except.what());
+		}
+	}
+
+	AddStats(config, { { "misses", 1 } });
+	spdlog::info("Building prebuilt dependency {}, artifact {} is not in the cache", name, key);
+	std::filesystem::remove_all(prefixPath);
+	std::filesystem::create_directories(prefixPath);
+	auto bashPaths = invoke::FindExecutable(gBash);
+	if(!bashPaths)
+	{
+		spdlog::error("No path found for {}", gBash);
+		exit(EXIT_FAILURE);
+	}
+	std::vector<std::string> scriptArgs { SelectPath(bashPaths.value()), scriptPath };
+	for(const auto& flag : GetJsonKeyValue<std::vector<std::string>>(dependencyJson, "flags", std::vector<std::string> { }))
+		scriptArgs.push_back(flag);
+	ProcessResult result = RunProcess(scriptArgs, directory, { { "BUILD_MASTER_PREFIX", prefixPath.string() }, { "BUILD_MASTER_DEPENDENCY_NAME", name } });
+	if(result.exitCode != 0)
+	{
+		spdlog::error("Build script {} of prebuilt dependency {} failed with exit code {}", scriptPath, name, result.exitCode);
+		exit(EXIT_FAILURE);
+	}
+	if(StoreArtifact(config, key, name, material, prefixPath))
+	{
+		AddStats(config, { { "stores", 1 } });
+		if(config.url.size() && !UploadArtifact(config, key))
+			spdlog::warn("Failed to upload artifact {} to {}", key, config.url);
+		// 0 means no limit
+		if(config.maxSize)
+			EvictArtifacts(config, config.maxSize);
+	}
+	OverwriteTextFile((prefixPath / gKeyStampFileName).string(), key);
+}
+
+// Prepends the pkgconfig directories of the prefix to PKG_CONFIG_PATH of this process (and so of the processes it starts)
+static void PrependPkgConfigPath(const std::filesystem::path& prefixPath)
+{
+	const char* value = std::getenv("PKG_CONFIG_PATH");
+	std::string pkgConfigPath = value ? value : "";
+	for(std::string_view subdirPath : { "share/pkgconfig", "lib64/pkgconfig", "lib/pkgconfig" })
+	{
+		auto path = (prefixPath / subdirPath).string();
+		if(!std::filesystem::is_directory(path) || std::format("{}{}{}", gPathListSeparator, pkgConfigPath, gPathListSeparator).find(std::format("{}{}{}", gPathListSeparator, path, gPathListSeparator)) != std::string::npos)
+			continue;
+		pkgConfigPath = pkgConfigPath.size() ? std::format("{}{}{}", path, gPathListSeparator, pkgConfigPath) : path;
+	}
+#ifdef _WIN32
+	_putenv_s("PKG_CONFIG_PATH", pkgConfigPath.c_str());
+#else
+	setenv("PKG_CONFIG_PATH", pkgConfigPath.c_str(), 1);
+#endif
+}
+
+// directory: value passed to --directory flag
+void PreparePrebuiltDependencies(std::string_view directory, bool isSetup)
+{
+	json buildMasterJson = ParseBuildMasterJson(directory);
+	auto it = buildMasterJson.find("prebuilt_dependencies");
+	if(it == buildMasterJson.end())
+		return;
+	std::optional<CacheConfig> config;
+	for(const auto& dependencyJson : it.value())
+	{
+		std::string name = GetJsonKeyValue<std::string>(dependencyJson, "name");
+		auto prefix = GetJsonKeyValue<std::string>(dependencyJson, "prefix", std::format("{}/{}", gPrebuiltDependenciesDirPath, name));
+		auto prefixPath = std::filesystem::absolute(GetPathStrRelativeToDir(directory, prefix)).lexically_normal();
+		if(isSetup)
+		{
+			if(!config)
+				config = GetCacheConfig(directory, buildMasterJson);
+			PrepareDependency(directory, dependencyJson, prefixPath, config.value());
+		}
+		PrependPkgConfigPath(prefixPath);
+	}
+}
+
+// directory: value passed to --directory flag
+int RunCacheCommand(std::string_view directory, const CacheCommandArgs& args)
+{
+	// The cache may also be inspected outside of a project
+	json buildMasterJson = std::filesystem::exists(GetBuildMasterJsonFilePath(directory)) ? ParseBuildMasterJson(directory) : json::object();
+	CacheConfig config = GetCacheConfig(directory, buildMasterJson);
+	if(args.action == "stats")
+	{
+		json statsJson = json::object();
+		if(auto statsFilePath = config.directory / gStatsFileName; std::filesystem::exists(statsFilePath))
+			statsJson = json::parse(LoadBinaryFile(statsFilePath), nullptr, false);
+		if(!statsJson.is_object())
+			statsJson = json::object();
+		auto getStat = [&statsJson](std::string_view name) { return GetJsonKeyValue<std::uint64_t>(statsJson, name, 0); };
+		std::vector<CachedArtifact> artifacts = ListArtifacts(config);
+		std::uint64_t totalSize = 0;
+		for(const auto& artifact : artifacts)
+			totalSize += artifact.size;
+		std::uint64_t hitCount = getStat("hits") + getStat("remote_hits");
+		std::uint64_t lookupCount = hitCount + getStat("misses");
+		std::cout << std::format("Artifact cache: {}{}\n", config.directory.string(), config.url.size() ? std::format(" (HTTP backend: {})", config.url) : std::string { });
+		std::cout << std::format("Artifacts: {}, size: {:.1f} MiB (limit: {} MiB)\n", artifacts.size(), static_cast<double>(totalSize) / gMiB, config.maxSize / gMiB);
+		std::cout << std::format("Hits: {} (downloaded: {}), misses: {}, hit rate: {:.1f}%\n", hitCount, getStat("remote_hits"), getStat("misses"),
+									lookupCount ? (100.0 * static_cast<double>(hitCount) / static_cast<double>(lookupCount)) : 0.0);
+		std::cout << std::format("Stores: {}, evictions: {} ({:.1f} MiB)\n", getStat("stores"), getStat("evictions"), static_cast<double>(getStat("evicted_size")) / gMiB);
+		return EXIT_SUCCESS;
+	}
+	if(args.action == "evict" || args.action == "clear")
+	{
+		// maxSize 0 evicts everything, that is only for 'clear', otherwise a limit of 0 means the cache is unlimited (the same as when storing)
+		std::uint64_t maxSize = (args.action == "clear") ? 0 : (args.maxSizeMb ? (args.maxSizeMb * gMiB) : config.maxSize);
+		if(args.action == "evict" && !maxSize)
+		{
+			std::cout << std::format("Info: the size of {} is unlimited, nothing to evict\n", config.directory.string());
+			return EXIT_SUCCESS;
+		}
+		std::size_t evictedCount = EvictArtifacts(config, maxSize);
+		std::cout << std::format("Info: {} artifacts evicted from {}\n", evictedCount, config.directory.string());
+		return EXIT_SUCCESS;
+	}
+	spdlog::error("Unknown action {} for the cache command, expected stats, evict, or clear", args.action);
+	return EXIT_FAILURE;
+}
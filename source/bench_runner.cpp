@@ -0,0 +1,421 @@
+#include <build_master/bench_runner.hpp>
+#include <build_master/meson_build_gen.hpp> // for RegenerateMesonBuildScript()
+#include <build_master/invoke_meson.hpp> // for RunMesonCmd()
+#include <build_master/process.hpp> // for RunProcess(), and RunCmdCaptureOutput()
+#include <build_master/json_parse.hpp> // for ParseJsonFile(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), LoadTextFile(), and WriteTextFileIfChanged()
+
+#include <iostream>
+#include <cstdlib>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <cstdint>
+#include <regex>
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+
+static constexpr std::string_view gBenchHistoryFilePath = ".build_master/bench_history.json";
+static constexpr std::string_view gBenchLogsDirPath = "meson-logs/build_master_bench";
+// Older runs are dropped from the history file beyond this count
+static constexpr std::size_t gMaxHistoryRunCount = 200;
+
+struct Benchmark
+{
+	std::string name;
+	std::vector<std::string> cmd;
+	std::vector<std::pair<std::string, std::string>> env;
+	std::string workDirectory;
+	// In seconds, 0 means no timeout
+	double timeout;
+};
+
+// Name of a measurement reported by a benchmark executable, and its value in seconds
+struct Measurement
+{
+	std::string name;
+	double value;
+};
+
+// Samples (in seconds) of each measurement, the key is "<benchmark name>/<measurement name>"
+using BenchSamples = std::map<std::string, std::vector<double>>;
+
+struct BenchRun
+{
+	std::string commit;
+	// true if the working tree had uncommitted changes
+	bool isDirty { false };
+	// Seconds since epoch
+	std::int64_t timestamp { 0 };
+	BenchSamples samples;
+};
+
+// Loads the benchmarks registered with meson from <build directory>/meson-info/intro-benchmarks.json
+static std::vector<Benchmark> LoadBenchmarks(std::string_view buildDirectory)
+{
+	auto introFilePath = GetPathStrRelativeToDir(buildDirectory, "meson-info/intro-benchmarks.json");
+	if(!std::filesystem::exists(introFilePath))
+	{
+		spdlog::error("{} doesn't exist, please configure the build directory first with 'build_master meson setup {}'", introFilePath, buildDirectory);
+		exit(EXIT_FAILURE);
+	}
+	std::vector<Benchmark> benchmarks;
+	for(const auto& benchJson : ParseJsonFile(introFilePath))
+	{
+		Benchmark benchmark;
+		benchmark.name = GetJsonKeyValue<std::string>(benchJson, "name");
+		benchmark.cmd = GetJsonKeyValue<std::vector<std::string>>(benchJson, "cmd");
+		json envJson = GetJsonKeyValue<json>(benchJson, "env", json::object());
+		for(const auto& [name, value] : envJson.items())
+			benchmark.env.push_back({ name, value.template get<std::string>() });
+		auto workDirectory = GetJsonKeyValueOrNull<json>(benchJson, "workdir");
+		benchmark.workDirectory = (workDirectory && workDirectory->is_string()) ? workDirectory->template get<std::string>() : std::string { buildDirectory };
+		benchmark.timeout = std::max(GetJsonKeyValue<double>(benchJson, "timeout", 0), 0.0);
+		benchmarks.push_back(std::move(benchmark));
+	}
+	return benchmarks;
+}
+
+static double GetTimeUnitScale(std::string_view unit)
+{
+	if(unit == "ns") return 1e-9;
+	if(unit == "us" || unit == "µs") return 1e-6;
+	if(unit == "ms") return 1e-3;
+	return 1;
+}
+
+// google-benchmark's --benchmark_format=json output
+// { "context" : { ... }, "benchmarks" : [ { "name" : "BM_Foo", "run_type" : "iteration", "real_time" : 12.5, "time_unit" : "ns", ... } ] }
+static bool ParseGoogleBenchmarkJson(const json& outputJson, std::vector<Measurement>& measurements)
+{
+	auto benchmarksJson = GetJsonKeyValueOrNull<json>(outputJson, "benchmarks");
+	if(!benchmarksJson || !benchmarksJson->is_array())
+		return false;
+	for(const auto& entry : benchmarksJson.value())
+	{
+		// Aggregates (mean, median, stddev of --benchmark_repetitions) are computed here from the iterations
+		if(GetJsonKeyValue<std::string>(entry, "run_type", "iteration") == "aggregate" || GetJsonKeyValue<bool>(entry, "error_occurred", false))
+			continue;
+		double scale = GetTimeUnitScale(GetJsonKeyValue<std::string>(entry, "time_unit", "ns"));
+		measurements.push_back({ GetJsonKeyValue<std::string>(entry, "name"), GetJsonKeyValue<double>(entry, "real_time") * scale });
+	}
+	return true;
+}
+
+// nanobench's ankerl::nanobench::templates::json() output
+// { "results" : [ { "title" : "...", "name" : "foo", "unit" : "op", "median(elapsed)" : 1.2e-08, ... } ] }
+static bool ParseNanobenchJson(const json& outputJson, std::vector<Measurement>& measurements)
+{
+	auto resultsJson = GetJsonKeyValueOrNull<json>(outputJson, "results");
+	if(!resultsJson || !resultsJson->is_array())
+		return false;
+	for(const auto& entry : resultsJson.value())
+		measurements.push_back({ GetJsonKeyValue<std::string>(entry, "name"), GetJsonKeyValue<double>(entry, "median(elapsed)") });
+	return true;
+}
+
+// Lines like "parse_large_file: 12.5 ms" or "insert = 300ns"
+static bool ParsePlainTimings(const std::string& output, std::vector<Measurement>& measurements)
+{
+	static const std::regex timingRegex(R"(^\s*([^:=]+?)\s*[:=]\s*([0-9]*\.?[0-9]+(?:[eE][-+]?[0-9]+)?)\s*(ns|us|µs|ms|s)\s*$)");
+	std::size_t count = measurements.size();
+	std::istringstream stream(output);
+	std::smatch match;
+	for(std::string line; std::getline(stream, line);)
+	{
+		if(line.size() && line.back() == '\r')
+			line.pop_back();
+		if(std::regex_match(line, match, timingRegex))
+			measurements.push_back({ match[1].str(), std::stod(match[2].str()) * GetTimeUnitScale(match[3].str()) });
+	}
+	return measurements.size() > count;
+}
+
+static std::vector<Measurement> ParseBenchmarkOutput(const std::string& output)
+{
+	std::vector<Measurement> measurements;
+	// Benchmark executables may print other text around the JSON document
+	auto beginPos = output.find('{');
+	auto endPos = output.rfind('}');
+	if(beginPos != std::string::npos && endPos != std::string::npos && beginPos < endPos)
+	{
+		json outputJson = json::parse(output.begin() + beginPos, output.begin() + endPos + 1, nullptr, false);
+		if(!outputJson.is_discarded() && (ParseGoogleBenchmarkJson(outputJson, measurements) || ParseNanobenchJson(outputJson, measurements)))
+			return measurements;
+	}
+	ParsePlainTimings(output, measurements);
+	return measurements;
+}
+
+static std::vector<BenchRun> LoadBenchHistory(std::string_view filePath)
+{
+	std::vector<BenchRun> runs;
+	if(!std::filesystem::exists(filePath))
+		return runs;
+	try
+	{
+		json historyJson = ParseJsonFile(filePath);
+		for(const auto& runJson : GetJsonKeyValue<json>(historyJson, "runs", json::array()))
+		{
+			BenchRun run;
+			run.commit = GetJsonKeyValue<std::string>(runJson, "commit", "");
+			run.isDirty = GetJsonKeyValue<bool>(runJson, "is_dirty", false);
+			run.timestamp = GetJsonKeyValue<std::int64_t>(runJson, "timestamp", 0);
+			json samplesJson = GetJsonKeyValue<json>(runJson, "samples", json::object());
+			for(const auto& [name, values] : samplesJson.items())
+				run.samples.insert({ name, values.template get<std::vector<double>>() });
+			runs.push_back(std::move(run));
+		}
+	} catch(const std::exception& except)
+	{
+		spdlog::warn("Ignoring malformed benchmark history file {}, {}", filePath, except.what());
+		runs.clear();
+	}
+	return runs;
+}
+
+static void SaveBenchHistory(std::string_view filePath, const std::vector<BenchRun>& runs)
+{
+	json runsJson = json::array();
+	std::size_t firstIndex = (runs.size() > gMaxHistoryRunCount) ? (runs.size() - gMaxHistoryRunCount) : 0;
+	for(std::size_t i = firstIndex; i < runs.size(); ++i)
+	{
+		json samplesJson = json::object();
+		for(const auto& [name, values] : runs[i].samples)
+			samplesJson[name] = values;
+		runsJson.push_back(
+		{
+			{ "commit", runs[i].commit },
+			{ "is_dirty", runs[i].isDirty },
+			{ "timestamp", runs[i].timestamp },
+			{ "samples", std::move(samplesJson) }
+		});
+	}
+	json historyJson = { { "runs", std::move(runsJson) } };
+	WriteTextFileIfChanged(filePath, historyJson.dump(4));
+}
+
+static std::string GetGitDirectory(std::string_view directory)
+{
+	return directory.empty() ? std::string { "." } : std::string { directory };
+}
+
+// Returns full commit hash of the git revision, or null if it is not a git repository (or no such revision exists)
+static std::optional<std::string> ResolveGitRevision(std::string_view directory, std::string_view revision)
+{
+	return RunCmdCaptureOutput({ "git", "-C", GetGitDirectory(directory), "rev-parse", "--verify", "--quiet", std::format("{}^{{commit}}", revision) });
+}
+
+static bool IsGitWorkTreeDirty(std::string_view directory)
+{
+	auto status = RunCmdCaptureOutput({ "git", "-C", GetGitDirectory(directory), "status", "--porcelain", "--untracked-files=no" });
+	return status && status->size();
+}
+
+struct SampleStats
+{
+	double median { 0 };
+	double mean { 0 };
+	double variance { 0 };
+	std::size_t count { 0 };
+};
+
+static SampleStats ComputeStats(std::vector<double> samples)
+{
+	SampleStats stats;
+	stats.count = samples.size();
+	if(samples.empty())
+		return stats;
+	std::ranges::sort(samples);
+	std::size_t mid = samples.size() / 2;
+	stats.median = (samples.size() % 2) ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+	for(double value : samples)
+		stats.mean += value;
+	stats.mean /= samples.size();
+	if(samples.size() > 1)
+	{
+		for(double value : samples)
+			stats.variance += (value - stats.mean) * (value - stats.mean);
+		stats.variance /= (samples.size() - 1);
+	}
+	return stats;
+}
+
+// Welch's t-test (unequal variances), returns true if the means differ at 95% confidence (two-sided)
+static bool IsSignificantChange(const SampleStats& current, const SampleStats& baseline)
+{
+	if(current.count < 2 || baseline.count < 2)
+		return false;
+	double currentError = current.variance / current.count;
+	double baselineError = baseline.variance / baseline.count;
+	double standardError = std::sqrt(currentError + baselineError);
+	// Both are (practically) constant, any difference in the means is significant
+	if(standardError <= 0)
+		return current.mean != baseline.mean;
+	double t = std::abs(current.mean - baseline.mean) / standardError;
+	// Welch–Satterthwaite degrees of freedom
+	double df = std::pow(currentError + baselineError, 2) / (std::pow(currentError, 2) / (current.count - 1) + std::pow(baselineError, 2) / (baseline.count - 1));
+	// Critical value of Student's t-distribution (Cornish-Fisher expansion around z = 1.96), accurate enough for df >= 2
+	constexpr double z = 1.959964;
+	double tCritical = z + (std::pow(z, 3) + z) / (4 * df) + (5 * std::pow(z, 5) + 16 * std::pow(z, 3) + 3 * z) / (96 * df * df);
+	return t > tCritical;
+}
+
+static std::string FormatTime(double seconds)
+{
+	if(seconds < 1e-6)
+		return std::format("{:.2f} ns", seconds * 1e9);
+	if(seconds < 1e-3)
+		return std::format("{:.2f} us", seconds * 1e6);
+	if(seconds < 1)
+		return std::format("{:.2f} ms", seconds * 1e3);
+	return std::format("{:.3f} s", seconds);
+}
+
+// Runs the benchmark (warmups + repetitions) and adds the samples of each measurement into the samples
+// Returns false if the benchmark exited with non-zero code (or timed out)
+static bool RunBenchmark(const Benchmark& benchmark, const BenchCommandArgs& args, const std::filesystem::path& logsDirPath, BenchSamples& samples)
+{
+	std::string logFileName = benchmark.name;
+	std::ranges::replace_if(logFileName, [](char ch) { return ch == '/' || ch == '\\' || ch == ':' || ch == ' '; }, '_');
+	auto logFilePath = (logsDirPath / (logFileName + ".txt")).string();
+	for(unsigned int i = 0; i < args.warmupCount + args.repetitionCount; ++i)
+	{
+		ProcessResult result = RunProcess(benchmark.cmd, benchmark.workDirectory, benchmark.env, logFilePath, benchmark.timeout);
+		if(result.exitCode != 0)
+		{
+			spdlog::error("Benchmark {} {}, see {}", benchmark.name, result.isTimedOut ? "timed out" : std::format("failed with exit code {}", result.exitCode), logFilePath);
+			return false;
+		}
+		if(i < args.warmupCount)
+			continue;
+		auto measurements = ParseBenchmarkOutput(LoadTextFile(logFilePath));
+		// No timings reported by the benchmark itself, so measure the whole process
+		if(measurements.empty())
+			samples[benchmark.name].push_back(result.wallTime);
+		for(const auto& measurement : measurements)
+			samples[std::format("{}/{}", benchmark.name, measurement.name)].push_back(measurement.value);
+	}
+	return true;
+}
+
+// directory: value passed to --directory flag
+int RunBenchmarks(std::string_view directory, const BenchCommandArgs& args)
+{
+	auto buildDirectory = GetPathStrRelativeToDir(directory, args.buildDirectory);
+	if(!args.isNoRebuild)
+	{
+		RegenerateMesonBuildScript(directory);
+		if(int exitCode = RunMesonCmd(directory, { "compile", "-C", args.buildDirectory }); exitCode != 0)
+		{
+			spdlog::error("Failed to build the project, not running the benchmarks");
+			return exitCode;
+		}
+	}
+	if(args.repetitionCount == 0)
+	{
+		spdlog::error("--repetitions must be at least 1");
+		return EXIT_FAILURE;
+	}
+
+	std::vector<Benchmark> benchmarks = LoadBenchmarks(buildDirectory);
+	if(args.benchNames.size())
+	{
+		std::unordered_set<std::string_view> names { args.benchNames.begin(), args.benchNames.end() };
+		std::erase_if(benchmarks, [&names](const Benchmark& benchmark) { return !names.contains(benchmark.name); });
+	}
+	if(benchmarks.empty())
+	{
+		std::cout << "Info: No benchmarks to run\n";
+		return EXIT_SUCCESS;
+	}
+
+	auto historyFilePath = args.historyFilePath.size() ? args.historyFilePath : GetPathStrRelativeToDir(directory, gBenchHistoryFilePath);
+	std::vector<BenchRun> history = LoadBenchHistory(historyFilePath);
+
+	// Resolve the baseline first, so that a typo doesn't cost a whole benchmark run
+	const BenchRun* baselineRun = nullptr;
+	std::string baselineName = "previous run";
+	if(args.baseline.size())
+	{
+		auto baselineCommit = ResolveGitRevision(directory, args.baseline);
+		if(!baselineCommit)
+		{
+			spdlog::error("Couldn't resolve the baseline {} to a git commit", args.baseline);
+			return EXIT_FAILURE;
+		}
+		// The latest clean run of the commit is preferred over the dirty ones
+		for(auto it = history.rbegin(); it != history.rend(); ++it)
+			if(it->commit == baselineCommit.value() && (!baselineRun || (baselineRun->isDirty && !it->isDirty)))
+				baselineRun = &(*it);
+		if(!baselineRun)
+		{
+			spdlog::error("No results are recorded for the baseline {} ({}) in {}, check it out and run 'build_master bench' first", args.baseline, baselineCommit->substr(0, 12), historyFilePath);
+			return EXIT_FAILURE;
+		}
+		baselineName = std::format("{} ({})", args.baseline, baselineCommit->substr(0, 12));
+	}
+	else if(history.size())
+		baselineRun = &history.back();
+
+	auto logsDirPath = std::filesystem::path(buildDirectory) / gBenchLogsDirPath;
+	std::filesystem::create_directories(logsDirPath);
+
+	BenchRun currentRun;
+	currentRun.commit = ResolveGitRevision(directory, "HEAD").value_or("");
+	currentRun.isDirty = currentRun.commit.size() && IsGitWorkTreeDirty(directory);
+	currentRun.timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	// Benchmarks are run one by one, so that they don't disturb each other
+	bool isFailed = false;
+	for(const auto& benchmark : benchmarks)
+	{
+		std::cout << std::format("Running {} ({} warmups, {} repetitions)\n", benchmark.name, args.warmupCount, args.repetitionCount);
+		if(!RunBenchmark(benchmark, args, logsDirPath, currentRun.samples))
+			isFailed = true;
+	}
+
+	std::size_t regressionCount = 0;
+	std::cout << std::format("\n{:<48} {:>12} {:>12} {:>9}  {}\n", "Benchmark", "Median", "Baseline", "Change", "");
+	for(const auto& [name, values] : currentRun.samples)
+	{
+		SampleStats stats = ComputeStats(values);
+		std::string baselineStr = "-", changeStr = "-", verdict;
+		if(baselineRun)
+		{
+			if(auto it = baselineRun->samples.find(name); it != baselineRun->samples.end())
+			{
+				SampleStats baselineStats = ComputeStats(it->second);
+				double change = (baselineStats.median > 0) ? ((stats.median - baselineStats.median) * 100 / baselineStats.median) : 0;
+				baselineStr = FormatTime(baselineStats.median);
+				changeStr = std::format("{:+.1f}%", change);
+				if(std::abs(change) >= args.threshold && IsSignificantChange(stats, baselineStats))
+				{
+					verdict = (change > 0) ? "REGRESSION" : "improved";
+					if(change > 0)
+						++regressionCount;
+				}
+			}
+		}
+		std::cout << std::format("{:<48} {:>12} {:>12} {:>9}  {}\n", name, FormatTime(stats.median), baselineStr, changeStr, verdict);
+	}
+	if(baselineRun)
+		std::cout << std::format("\nBaseline: {}\n", baselineName);
+
+	// Results of the failed benchmarks are incomplete, so don't let them pollute the history
+	if(!isFailed)
+	{
+		history.push_back(std::move(currentRun));
+		SaveBenchHistory(historyFilePath, history);
+	}
+	if(regressionCount)
+		std::cout << std::format("Error: {} statistically significant regression(s) beyond {}% threshold\n", regressionCount, args.threshold);
+	return (isFailed || regressionCount) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+#include <build_master/build_command.hpp>
+#include <build_master/meson_build_gen.hpp> // for RegenerateMesonBuildScript()
+#include <build_master/invoke_meson.hpp> // for RunMesonCmd()
+#include <build_master/dependency_probe.hpp> // for ProbeDependencies()
+#include <build_master/artifact_cache.hpp> // for PreparePrebuiltDependencies()
+#include <build_master/process.hpp> // for ExecProcess(), and RunProcess()
+#include <build_master/ninja_build_gen.hpp> // for IsNinjaBackendBuildDirectory()
+#include <build_master/job_planner.hpp> // for PlanBuildJobs(), ApplyJobPlan(), and RecordPeakJobMemory()
+#include <build_master/json_parse.hpp> // for json, and HasJsonKey()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), GetBuildMasterJsonFilePath(), and SelectPath()
+
+#include <iostream>
+#include <cstdlib>
+#include <format>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <algorithm>
+#include <map>
+#include <cstdio>
+
+#include <spdlog/spdlog.h>
+#include <invoke/invoke.hpp> // for invoke::FindExecutable()
+
+// Names of the ninja executable in different distributions (samu is a ninja compatible implementation), in the order meson looks for them
+static constexpr std::string_view gNinjaExecutableNames[] = { "ninja", "ninja-build", "samu" };
+
+// Returns full path of the ninja executable, NINJA environment variable takes the precedence (as in meson)
+static std::optional<std::string> FindNinja()
+{
+	if(const char* ninjaPath = std::getenv("NINJA"); ninjaPath && *ninjaPath)
+		return { ninjaPath };
+	for(const auto& name : gNinjaExecutableNames)
+		if(auto paths = invoke::FindExecutable(name); paths && paths->size())
+			return { SelectPath(paths.value()) };
+	return { };
+}
+
+// Returns the reason if the build directory can't be built with ninja directly, otherwise null
+// buildDirectory: path of the build directory relative to the current working directory
+static std::optional<std::string> GetSlowPathReason(std::string_view directory, std::string_view buildDirectory)
+{
+	auto buildNinjaPath = std::filesystem::path(buildDirectory) / "build.ninja";
+	std::error_code errorCode;
+	auto buildNinjaTime = std::filesystem::last_write_time(buildNinjaPath, errorCode);
+	if(errorCode)
+		return { std::format("{} doesn't exist (the build directory isn't configured, or it doesn't use the ninja backend)", buildNinjaPath.string()) };
+	// ninja would reconfigure by itself, but let meson do it, as it also knows what else needs to be done for that
+	auto mesonBuildTime = std::filesystem::last_write_time(GetPathStrRelativeToDir(directory, "meson.build"), errorCode);
+	if(errorCode || mesonBuildTime > buildNinjaTime)
+		return { "the build directory needs to be reconfigured" };
+	return { };
+}
+
+// Converts the target names accepted by 'meson compile' (NAME or NAME:TYPE) into the names of the ninja targets (output file paths relative to the build directory)
+// Returns null if any of them can't be converted (unknown, ambiguous, or given with a path), then it is left to meson to resolve (or report) them
+static std::optional<std::vector<std::string>> GetNinjaTargetNames(std::string_view buildDirectory, const std::vector<std::string>& targetNames)
+{
+	std::vector<std::string> ninjaTargetNames;
+	if(targetNames.empty())
+		return { ninjaTargetNames };
+	std::ifstream stream(std::filesystem::path(buildDirectory) / "meson-info/intro-targets.json");
+	if(!stream.is_open())
+		return { };
+	json targetsJson = json::parse(stream, nullptr, false);
+	if(targetsJson.is_discarded() || !targetsJson.is_array())
+		return { };
+	for(const auto& targetName : targetNames)
+	{
+		std::string_view name { targetName };
+		// 'meson compile' accepts the types with underscores, intro-targets.json has them with spaces
+		std::string type;
+		if(auto colonPos = name.find(':'); colonPos != std::string_view::npos)
+		{
+			type = name.substr(colonPos + 1);
+			std::ranges::replace(type, '_', ' ');
+			name = name.substr(0, colonPos);
+		}
+		if(name.find('/') != std::string_view::npos)
+			return { };
+		const json* matchedTargetJson = nullptr;
+		for(const auto& targetJson : targetsJson)
+		{
+			if(targetJson.value("name", "") != name || (type.size() && targetJson.value("type", "") != type))
+				continue;
+			// Ambiguous, meson reports it
+			if(matchedTargetJson)
+				return { };
+			matchedTargetJson = &targetJson;
+		}
+		if(!matchedTargetJson)
+			return { };
+		auto it = matchedTargetJson->find("filename");
+		if(it == matchedTargetJson->end() || !it.value().is_array() || it.value().empty())
+			return { };
+		for(const auto& fileName : it.value())
+		{
+			std::error_code errorCode;
+			auto relativePath = std::filesystem::relative(fileName.template get<std::string>(), buildDirectory, errorCode);
+			if(errorCode || relativePath.empty())
+				return { };
+			ninjaTargetNames.push_back(relativePath.generic_string());
+		}
+	}
+	return { ninjaTargetNames };
+}
+
+// Returns true if build_master.json selects a linker ("linker"), then the link times are reported after the build
+static bool IsLinkerSelected(std::string_view directory)
+{
+	std::ifstream stream(GetBuildMasterJsonFilePath(directory));
+	if(!stream.is_open())
+		return false;
+	json buildMasterJson = json::parse(stream, nullptr, false, true);
+	return !buildMasterJson.is_discarded() && HasJsonKey(buildMasterJson, "linker");
+}
+
+// Returns the outputs (relative to the build directory) of the link steps in build.ninja, i.e. the executables and the shared libraries
+// Both meson and 'build_master configure' name the rules <language>_LINKER (and <language>_LINKER_RSP), the static libraries use STATIC_LINKER
+static std::vector<std::string> GetLinkOutputPaths(std::string_view buildDirectory)
+{
+	std::vector<std::string> outputPaths;
+	std::ifstream stream(std::filesystem::path(buildDirectory) / "build.ninja");
+	std::string line;
+	while(std::getline(stream, line))
+	{
+		if(!line.starts_with("build "))
+			continue;
+		// The outputs end at the first unescaped ':', '$' escapes ' ', ':', and itself
+		std::string outputPath;
+		std::size_t pos = 6;
+		for(; pos < line.size() && line[pos] != ':' && line[pos] != ' ' && line[pos] != '|'; ++pos)
+		{
+			if(line[pos] == '$' && pos + 1 < line.size())
+				++pos;
+			outputPath.push_back(line[pos]);
+		}
+		pos = line.find(':', pos);
+		if(pos == std::string::npos)
+			continue;
+		std::string_view rest = std::string_view(line).substr(pos + 1);
+		rest.remove_prefix(std::min(rest.find_first_not_of(' '), rest.size()));
+		std::string_view rule = rest.substr(0, rest.find(' '));
+		if((rule.ends_with("_LINKER") || rule.ends_with("_LINKER_RSP")) && !rule.starts_with("STATIC_LINKER"))
+			outputPaths.push_back(outputPath);
+	}
+	return outputPaths;
+}
+
+// Prints the time each target relinked by the build (its output is newer than buildStartTime) spent in the linker, slowest first
+// The times come from .ninja_log (version 5+: <start ms>\t<end ms>\t<mtime>\t<output>\t<command hash>), where the last entry of an output is the latest
+static void ReportLinkTimes(std::string_view buildDirectory, std::filesystem::file_time_type buildStartTime)
+{
+	std::map<std::string, std::uint64_t> linkTimes;
+	for(auto& outputPath : GetLinkOutputPaths(buildDirectory))
+	{
+		std::error_code errorCode;
+		auto outputTime = std::filesystem::last_write_time(std::filesystem::path(buildDirectory) / outputPath, errorCode);
+		if(!errorCode && outputTime >= buildStartTime)
+			linkTimes.emplace(std::move(outputPath), 0);
+	}
+	if(linkTimes.empty())
+		return;
+	std::ifstream stream(std::filesystem::path(buildDirectory) / ".ninja_log");
+	std::string line;
+	while(std::getline(stream, line))
+	{
+		if(line.starts_with('#'))
+			continue;
+		unsigned long long startTime = 0, endTime = 0;
+		char outputPath[4096];
+		if(std::sscanf(line.c_str(), "%llu\t%llu\t%*s\t%4095[^\t]", &startTime, &endTime, outputPath) != 3)
+			continue;
+		if(auto it = linkTimes.find(outputPath); it != linkTimes.end() && endTime >= startTime)
+			it->second = endTime - startTime;
+	}
+	std::vector<std::pair<std::string, std::uint64_t>> sortedLinkTimes(linkTimes.begin(), linkTimes.end());
+	std::ranges::stable_sort(sortedLinkTimes, std::ranges::greater { }, &std::pair<std::string, std::uint64_t>::second);
+	spdlog::info("Link times:");
+	for(const auto& [outputPath, linkTime] : sortedLinkTimes)
+		spdlog::info("  {:>8.3f} s  {}", linkTime / 1000.0, outputPath);
+}
+
+// Runs 'meson compile', it is what the build goes through whenever ninja can't be executed directly
+// jobCount: 0 means the default of ninja
+static int RunMesonCompile(std::string_view directory, const BuildCommandArgs& args, unsigned int jobCount)
+{
+	std::vector<std::string> mesonArgs { "compile", "-C", args.buildDirectory };
+	if(jobCount)
+		mesonArgs.insert(mesonArgs.end(), { "-j", std::to_string(jobCount) });
+	if(args.isVerbose)
+		mesonArgs.push_back("-v");
+	mesonArgs.insert(mesonArgs.end(), args.targetNames.begin(), args.targetNames.end());
+	return RunMesonCmd(directory, mesonArgs);
+}
+
+int RunBuild(std::string_view directory, const BuildCommandArgs& args)
+{
+	auto buildDirectory = GetPathStrRelativeToDir(directory, args.buildDirectory);
+	// A build directory configured by 'build_master configure' has no meson behind it, its build.ninja regenerates itself
+	bool isNinjaBackend = IsNinjaBackendBuildDirectory(buildDirectory);
+	std::optional<std::string> slowPathReason;
+	if(!isNinjaBackend)
+	{
+		bool isRegenerated = RegenerateMesonBuildScript(directory);
+		// meson may reconfigure during the build, so it needs to find the prebuilt dependencies too
+		PreparePrebuiltDependencies(directory, false);
+		// Revalidate the resolved dependencies (it is just a few stat() calls if nothing has changed), same as 'build_master meson'
+		ProbeDependencies(directory);
+		slowPathReason = isRegenerated ? std::optional<std::string> { "meson.build has been regenerated" } : GetSlowPathReason(directory, buildDirectory);
+	}
+
+	std::optional<std::vector<std::string>> ninjaTargetNames;
+	std::optional<std::string> ninjaPath;
+	if(!slowPathReason && !(ninjaTargetNames = GetNinjaTargetNames(buildDirectory, args.targetNames)))
+		slowPathReason = isNinjaBackend ? "some of the targets are unknown" : "the target names need to be resolved by meson";
+	if(!slowPathReason && !(ninjaPath = FindNinja()))
+		slowPathReason = "ninja is not found";
+	JobPlan plan = PlanBuildJobs(directory, buildDirectory, args.jobCount);
+	if(slowPathReason && isNinjaBackend)
+	{
+		spdlog::error("Can't build {} (configured without meson), {}", buildDirectory, slowPathReason.value());
+		return EXIT_FAILURE;
+	}
+	if(slowPathReason)
+	{
+		// meson might rewrite build.ninja, so the heavy targets' pool is only applied when ninja is executed directly
+		spdlog::info("Building with meson compile, {}", slowPathReason.value());
+		return RunMesonCompile(directory, args, plan.jobCount);
+	}
+
+	ApplyJobPlan(buildDirectory, plan);
+	std::vector<std::string> ninjaArgs { ninjaPath.value(), "-C", buildDirectory };
+	if(plan.jobCount)
+		ninjaArgs.insert(ninjaArgs.end(), { "-j", std::to_string(plan.jobCount) });
+	if(args.isVerbose)
+		ninjaArgs.push_back("-v");
+	ninjaArgs.insert(ninjaArgs.end(), ninjaTargetNames->begin(), ninjaTargetNames->end());
+	std::string cmdLine;
+	for(const auto& arg : ninjaArgs)
+		cmdLine.append(arg).append(" ");
+	spdlog::info("Command: {}", cmdLine);
+	// The number of jobs is chosen from the memory, so ninja runs as a child process to learn the peak memory of the jobs for the next builds
+	// It also does when a linker is selected, to report the link times after the build
+	bool isReportLinkTimes = IsLinkerSelected(directory);
+	if(!args.jobCount || isReportLinkTimes)
+	{
+		auto buildStartTime = std::filesystem::file_time_type::clock::now();
+		ProcessResult result = RunProcess(ninjaArgs);
+		if(!args.jobCount)
+			RecordPeakJobMemory(buildDirectory, result.peakMemory);
+		if(isReportLinkTimes && result.exitCode == 0)
+			ReportLinkTimes(buildDirectory, buildStartTime);
+		return result.exitCode;
+	}
+	int exitCode = ExecProcess(ninjaArgs);
+	if(exitCode == -1 && isNinjaBackend)
+		spdlog::error("Failed to execute {}", ninjaPath.value());
+	else if(exitCode == -1)
+	{
+		spdlog::warn("Failed to execute {}, falling back to meson compile", ninjaPath.value());
+		return RunMesonCompile(directory, args, plan.jobCount);
+	}
+	return exitCode;
+}
@@ -1,6 +1,17 @@
 #include <build_master/meson_build_gen.hpp> // for RegenerateMesonBuildScript()
 #include <build_master/invoke_meson.hpp> // for InvokeMeson()
+#include <build_master/workspace.hpp> // for InvokeMesonWorkspace()
+#include <build_master/test_runner.hpp> // for RunTests()
+#include <build_master/bench_runner.hpp> // for RunBenchmarks()
+#include <build_master/build_command.hpp> // for RunBuild()
 #include <build_master/pre_config_script.hpp> // for RunPreConfigScript()
+#include <build_master/artifact_cache.hpp> // for PreparePrebuiltDependencies(), and RunCacheCommand()
+#include <build_master/matrix_command.hpp> // for RunMatrix()
+#include <build_master/profile_command.hpp> // for RunProfile()
+#include <build_master/install_command.hpp> // for RunInstall()
+#include <build_master/package_command.hpp> // for RunPackage()
+#include <build_master/report_command.hpp> // for RunCcWrap(), and RunReport()
+#include <build_master/ninja_build_gen.hpp> // for RunConfigure()
 #include <build_master/misc.hpp> // for GetBuildMasterJsonFilePath()
 #include <build_master/json_parse.hpp>
 #include <build_master/version.hpp>
@@ -11,6 +22,8 @@
 #include <iterator>
 #include <filesystem>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include <CLI/CLI.hpp>
 #include <spdlog/spdlog.h>
@@ -204,8 +217,59 @@ static void PrintVersionInfo() noexcept
 	std::cout << "Git Commit ID: " << GIT_COMMIT_ID << "\n";
 }
 
+// Dispatches the invocations made on every build straight from argv, neither the CLI nor the privileges need to be set up for them:
+//	build_master [--directory=<dir>] --update-meson-build [--force] (also by the REGENERATE_BUILD target of build.ninja)
+//	build_master [--directory=<dir>] meson ...
+//	build_master cc-wrap ... (the compiler launcher of every compile and link job with "resource_accounting")
+// Returns false if argv is anything else (or has any other option), it goes through the CLI then
+static bool TryRunFastPath(int argc, const char* argv[], int& exitCode)
+{
+	std::string_view directory;
+	bool isUpdateMesonBuild = false, isForce = false;
+	for(int i = 1; i < argc; ++i)
+	{
+		std::string_view arg { argv[i] };
+		if(arg == "--directory" && (i + 1) < argc)
+			directory = argv[++i];
+		else if(arg.starts_with("--directory="))
+			directory = arg.substr(std::string_view { "--directory=" }.size());
+		else if(arg == "--update-meson-build")
+			isUpdateMesonBuild = true;
+		else if(arg == "--force")
+			isForce = true;
+		else if(arg == "meson" && !isUpdateMesonBuild && !isForce)
+		{
+			InvokeMeson(directory, std::vector<std::string>(argv + i + 1, argv + argc));
+			exitCode = EXIT_SUCCESS;
+			return true;
+		}
+		else if(arg == "cc-wrap" && i == 1)
+		{
+			exitCode = RunCcWrap(std::vector<std::string>(argv + i + 1, argv + argc));
+			return true;
+		}
+		else
+			return false;
+	}
+	if(!isUpdateMesonBuild)
+		return false;
+	RegenerateMesonBuildScript(directory, isForce);
+	exitCode = EXIT_SUCCESS;
+	return true;
+}
+
 int main(int argc, const char* argv[])
 {
+	// Fast path for the most frequent invocation by the tooling, neither the CLI nor the privileges need to be set up for it
+	if(argc == 2 && std::string_view { argv[1] } == "--version")
+	{
+		PrintVersionInfo();
+		return EXIT_SUCCESS;
+	}
+	int exitCode = EXIT_SUCCESS;
+	if(TryRunFastPath(argc, argv, exitCode))
+		return exitCode;
+
 #ifdef PLATFORM_LINUX
 	// Drop root privileges if the build_master command is executed under root privileges, root privileges need to be used where absolutely necessary,
 	// And any modifications by root should be kept at minimum.
@@ -226,14 +290,15 @@ int main(int argc, const char* argv[])
 	std::string directory;
 	app.add_flag("--version", isPrintVersion, "Prints version number of Build Master");
 	app.add_flag("--update-meson-build", isUpdateMesonBuild, "Regenerates the meson.build script if the build_master.json file is more recent");
-	app.add_flag("--execute-pre-config-hook", isExecutePreConfigHook, "Executes pre_config_hook (shell script) if any");
+	app.add_flag("--execute-pre-config-hook", isExecutePreConfigHook, "Builds (or restores from the artifact cache) the prebuilt_dependencies, and executes pre_config_hook (shell script) if any");
 	app.add_flag("--force", isForce, "if --update-meson-build flag is present along with this --force then meson.build script is generated even if it is upto date");
 	app.add_option("--directory", directory, "Directory path in which to look for build_master.json, by default it is the current working directory");
 
 	// Project Initialization Sub command	
 	{
 		CLI::App* scInit = app.add_subcommand("init", "Project initialization, creates build_master.json file");
-		ProjectInitCommandArgs args;
+		// static (here and in the other sub commands), as the options are parsed (by CLI11_PARSE) after this scope has ended
+		static ProjectInitCommandArgs args;
 		scInit->add_option("--name", args.projectName, "Name of the Project")->required();
 		scInit->add_option("--canonical_name", args.canonicalName, 
 			"Conanical name of the Project, typically used for naming files")->required();
@@ -256,7 +321,141 @@ int main(int argc, const char* argv[])
 	{
 		CLI::App* scMeson = app.add_subcommand("meson", "Invokes meson build system (cli), all the arguments passed to this subcommands goes to actual meson command");
 		scMeson->allow_extras();
-		scMeson->callback([&]() { InvokeMeson(directory, scMeson->remaining()); });
+		// 'build_master meson --help' shows the help of meson
+		scMeson->set_help_flag();
+		// scMeson goes out of scope before the callback is called (in app.parse()), so it is captured by value
+		scMeson->callback([&directory, scMeson]() { InvokeMeson(directory, scMeson->remaining()); });
+	}
+
+	// Configure Sub command
+	{
+		CLI::App* scConfigure = app.add_subcommand("configure", "Configures the build directory without meson, build.ninja is generated directly (only for the projects not needing meson's features)");
+		static ConfigureCommandArgs args;
+		scConfigure->add_option("-C", args.buildDirectory, "Build directory to configure, by default it is 'build'");
+		scConfigure->add_option("--buildtype", args.buildType, "debug, release, or debugoptimized (same as in meson), by default it is debug");
+		scConfigure->add_flag("--regenerate", args.isRegenerate, "Only regenerates build.ninja, the pre-config hooks aren't run and the prebuilt dependencies aren't rebuilt (build.ninja passes it when it regenerates itself)");
+		scConfigure->callback([&]() { exit(RunConfigure(directory, args)); });
+	}
+
+	// Build Sub command
+	{
+		CLI::App* scBuild = app.add_subcommand("build", "Builds the project, executes ninja directly if meson.build is upto date and the build directory is configured, otherwise goes through 'meson compile'");
+		static BuildCommandArgs args;
+		scBuild->add_option("-C", args.buildDirectory, "Build directory (already configured with 'build_master meson setup' or 'build_master configure'), by default it is 'build'");
+		scBuild->add_option("-j,--jobs", args.jobCount, "Number of parallel jobs, by default it is chosen from the available memory and the memory used by the jobs");
+		scBuild->add_flag("-v,--verbose", args.isVerbose, "Prints the full command lines");
+		scBuild->add_option("targets", args.targetNames, "Names of the targets to build (NAME or NAME:TYPE, as in 'meson compile'), by default the default targets are built");
+		scBuild->callback([&]() { exit(RunBuild(directory, args)); });
+	}
+
+	// Workspace Sub command
+	{
+		CLI::App* scWorkspace = app.add_subcommand("workspace", "Builds all the projects listed in build_master_workspace.json as one meson project, all the arguments passed to this subcommand goes to actual meson command");
+		scWorkspace->allow_extras();
+		scWorkspace->set_help_flag();
+		scWorkspace->callback([&directory, scWorkspace]() { InvokeMesonWorkspace(directory, scWorkspace->remaining()); });
+	}
+
+	// Test Sub command
+	{
+		CLI::App* scTest = app.add_subcommand("test", "Rebuilds and runs the tests (longest first), optionally only a shard of them");
+		static TestCommandArgs args;
+		scTest->add_option("-C", args.buildDirectory, "Build directory (already configured with 'build_master meson setup'), by default it is 'build'");
+		scTest->add_option("--shard", args.shard, "Runs only i-th out of N shards (i/N, 1-based), shards are balanced by the durations of --durations-file, or partitioned by the test name hashes without it");
+		scTest->add_option("-j,--jobs", args.jobCount, "Number of tests to run in parallel, by default it is the number of hardware threads");
+		scTest->add_option("--durations-file", args.durationsFilePath, "File to load/save the test durations from/to, by default it is build_master_test_durations.json in the build directory");
+		scTest->add_flag("--no-rebuild", args.isNoRebuild, "Doesn't rebuild the project before running the tests");
+		scTest->add_option("tests", args.testNames, "Names of the tests to run, by default all of the tests are run");
+		scTest->callback([&]() { exit(RunTests(directory, args)); });
+	}
+
+	// Bench Sub command
+	{
+		CLI::App* scBench = app.add_subcommand("bench", "Rebuilds and runs the benchmarks, records the results and reports regressions against a baseline");
+		static BenchCommandArgs args;
+		scBench->add_option("-C", args.buildDirectory, "Build directory (already configured with 'build_master meson setup'), by default it is 'build'");
+		scBench->add_option("--warmups", args.warmupCount, "Number of runs of each benchmark to discard, by default it is 1");
+		scBench->add_option("--repetitions", args.repetitionCount, "Number of runs of each benchmark to record, by default it is 5");
+		scBench->add_option("--history-file", args.historyFilePath, "File to record the results into, by default it is .build_master/bench_history.json");
+		scBench->add_option("--baseline", args.baseline, "Git revision to compare against (its results must have been recorded), by default the previous run is the baseline");
+		scBench->add_option("--threshold", args.threshold, "Changes (of the median) smaller than this percentage are never reported as regressions, by default it is 5");
+		scBench->add_flag("--no-rebuild", args.isNoRebuild, "Doesn't rebuild the project before running the benchmarks");
+		scBench->add_option("benchmarks", args.benchNames, "Names of the benchmarks to run, by default all of the benchmarks are run");
+		scBench->callback([&]() { exit(RunBenchmarks(directory, args)); });
+	}
+
+	// Cache Sub command
+	{
+		CLI::App* scCache = app.add_subcommand("cache", "Inspects or trims the artifact cache of the prebuilt dependencies");
+		static CacheCommandArgs args;
+		scCache->add_option("action", args.action, "stats (hit/miss statistics and size), evict (least recently used artifacts, down to the size limit), or clear, by default it is stats");
+		scCache->add_option("--max-size-mb", args.maxSizeMb, "Size limit for evict, by default it is the configured limit (artifact_cache.max_size_mb, or BUILD_MASTER_CACHE_MAX_SIZE_MB)");
+		scCache->callback([&]() { exit(RunCacheCommand(directory, args)); });
+	}
+
+	// Matrix Sub command
+	{
+		CLI::App* scMatrix = app.add_subcommand("matrix", "Sets up and builds the configurations listed in build_master.json (\"configurations\") in parallel, each one in its own build directory");
+		static MatrixCommandArgs args;
+		scMatrix->add_option("-j,--jobs", args.jobCount, "Number of parallel jobs, shared by all of the configurations, by default it is chosen from the available memory");
+		scMatrix->add_option("configurations", args.configurationNames, "Names of the configurations to build, by default all of the configurations are built");
+		scMatrix->callback([&]() { exit(RunMatrix(directory, args)); });
+	}
+
+	// Profile Sub command
+	{
+		CLI::App* scProfile = app.add_subcommand("profile", "Builds the profile variant (optimized, with debug info and frame pointers) of an executable target, runs it under perf and writes a flamegraph");
+		static ProfileCommandArgs args;
+		scProfile->add_option("-C", args.buildDirectory, "Dedicated build directory for the profile build (it is set up if doesn't exist, a build directory configured otherwise is refused), by default it is 'build-profile'");
+		scProfile->add_option("--frequency", args.frequency, "Sampling frequency (Hz) of perf record, by default it is 999");
+		scProfile->add_option("--top", args.topCount, "Number of the hottest functions to print, by default it is 20");
+		scProfile->add_option("target", args.targetName, "Name of the executable target to profile")->required();
+		scProfile->add_option("args", args.targetArgs, "Arguments passed to the executable, after --");
+		scProfile->callback([&]() { exit(RunProfile(directory, args)); });
+	}
+
+	// Install Sub command
+	{
+		CLI::App* scInstall = app.add_subcommand("install", "Installs the project incrementally, only the files whose content has changed are copied (in parallel), the others are left untouched");
+		static InstallCommandArgs args;
+		scInstall->add_option("-C", args.buildDirectory, "Build directory (already configured with 'build_master meson setup'), by default it is 'build'");
+		scInstall->add_option("--destdir", args.destDirectory, "Directory prepended to the install paths, useful for packaging");
+		scInstall->add_option("-j,--jobs", args.jobCount, "Number of files to copy in parallel, by default it is the number of hardware threads");
+		scInstall->add_flag("--dry-run", args.isDryRun, "Only prints the files which would be installed");
+		scInstall->add_flag("--no-rebuild", args.isNoRebuild, "Doesn't rebuild the project before installing");
+		scInstall->callback([&]() { exit(RunInstall(directory, args)); });
+	}
+
+	// Package Sub command
+	{
+		CLI::App* scPackage = app.add_subcommand("package", "Packages the project into a reproducible tarball or Debian package, the debug info is split into a separate package");
+		static PackageCommandArgs args;
+		scPackage->add_option("-C", args.buildDirectory, "Build directory (already configured with 'build_master meson setup'), by default it is 'build'");
+		scPackage->add_option("--format", args.format, "Format of the package: tar.zst, tar.xz, or deb, by default it is tar.zst");
+		scPackage->add_option("-o,--output", args.outputPath, "Path of the package, by default it is <canonical_name>-<version>.<format> in the build directory");
+		scPackage->add_option("-j,--jobs", args.jobCount, "Number of parallel debug info splits and compression threads, by default it is the number of hardware threads");
+		scPackage->add_option("--level", args.compressionLevel, "Compression level, by default it is 19 for zstd, and 6 for xz");
+		scPackage->add_flag("--no-split-debug", args.isNoSplitDebug, "Leaves the debug info in the binaries");
+		scPackage->add_flag("--no-rebuild", args.isNoRebuild, "Doesn't rebuild the project before packaging");
+		scPackage->callback([&]() { exit(RunPackage(directory, args)); });
+	}
+
+	// Cc-wrap Sub command
+	{
+		CLI::App* scCcWrap = app.add_subcommand("cc-wrap", "Compiler launcher injected by \"resource_accounting\", runs the compiler and records its time, peak RSS, and output size into the build directory");
+		// Everything from the compiler on is passed to the compiler as it is
+		scCcWrap->prefix_command();
+		scCcWrap->set_help_flag();
+		scCcWrap->callback([scCcWrap]() { exit(RunCcWrap(scCcWrap->remaining())); });
+	}
+
+	// Report Sub command
+	{
+		CLI::App* scReport = app.add_subcommand("report", "Reports the resource usage of the compile and link jobs recorded by 'cc-wrap', per target and per directory");
+		static ReportCommandArgs args;
+		scReport->add_option("-C", args.buildDirectory, "Build directory (configured with \"resource_accounting\" : true), by default it is 'build'");
+		scReport->add_option("--top", args.topCount, "Number of the translation units with the highest peak RSS to list, by default it is 10");
+		scReport->callback([&]() { exit(RunReport(directory, args)); });
 	}
 
 	CLI11_PARSE(app, argc, argv);
@@ -273,6 +472,7 @@ int main(int argc, const char* argv[])
 	}
 	if(isExecutePreConfigHook)
 	{
+		PreparePrebuiltDependencies(directory, true);
 		if(!RunPreConfigScript(directory))
 			spdlog::info("No pre_config_hook to run");
 	}
@@ -0,0 +1,377 @@
+#include <build_master/dependency_probe.hpp>
+#include <build_master/json_parse.hpp> // for ParseBuildMasterJson(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), SelectPath(), and WriteTextFileIfChanged()
+#include <build_master/process.hpp> // for RunCmdCaptureOutput()
+#include <build_master/version.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <format>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <future>
+#include <optional>
+#include <set>
+#include <map>
+#include <cctype>
+
+#include <spdlog/spdlog.h>
+#include <invoke/invoke.hpp> // for invoke::FindExecutable()
+
+static constexpr std::string_view gDependencyCacheFilePath = ".build_master/dependency_cache.json";
+static constexpr std::string_view gPkgConfigExecutableName = "pkg-config";
+// It is folded into the search paths key, so the caches written by the older versions (i.e. without the static link args) are probed again
+static constexpr int gDependencyCacheFormat = 2;
+
+#ifdef _WIN32
+static constexpr std::string_view gHostPlatformName = "windows";
+static constexpr char gPathListSeparator = ';';
+#elif defined(__APPLE__)
+static constexpr std::string_view gHostPlatformName = "darwin";
+static constexpr char gPathListSeparator = ':';
+#else
+static constexpr std::string_view gHostPlatformName = "linux";
+static constexpr char gPathListSeparator = ':';
+#endif
+
+static std::int64_t GetLastWriteTime(const std::filesystem::path& path)
+{
+	std::error_code errorCode;
+	auto time = std::filesystem::last_write_time(path, errorCode);
+	if(errorCode)
+		return 0;
+	return time.time_since_epoch().count();
+}
+
+// Splits pkg-config's output into arguments, it respects quotes and backslash escapes just like a shell does
+static std::vector<std::string> SplitArgs(std::string_view str)
+{
+	std::vector<std::string> args;
+	std::string arg;
+	bool isArg = false;
+	char quote = 0;
+	for(std::size_t i = 0; i < str.size(); ++i)
+	{
+		char ch = str[i];
+		if(quote)
+		{
+			if(ch == quote)
+				quote = 0;
+			else
+				arg.push_back(ch);
+		}
+		else if(ch == '\'' || ch == '"')
+		{
+			quote = ch;
+			isArg = true;
+		}
+		else if(ch == '\\' && (i + 1) < str.size())
+		{
+			arg.push_back(str[++i]);
+			isArg = true;
+		}
+		else if(std::isspace(static_cast<unsigned char>(ch)))
+		{
+			if(isArg)
+				args.push_back(std::move(arg));
+			arg.clear();
+			isArg = false;
+		}
+		else
+		{
+			arg.push_back(ch);
+			isArg = true;
+		}
+	}
+	if(isArg)
+		args.push_back(std::move(arg));
+	return args;
+}
+
+static std::vector<std::string> SplitPathList(std::string_view str)
+{
+	std::vector<std::string> paths;
+	std::size_t begin = 0;
+	while(begin <= str.size())
+	{
+		auto end = str.find(gPathListSeparator, begin);
+		if(end == std::string_view::npos)
+			end = str.size();
+		if(end > begin)
+			paths.push_back(std::string { str.substr(begin, end - begin) });
+		begin = end + 1;
+	}
+	return paths;
+}
+
+static ProbedDependency ProbeDependency(const std::string& pkgConfigPath, const std::string& name)
+{
+	ProbedDependency dependency;
+	auto version = RunCmdCaptureOutput({ pkgConfigPath, "--modversion", name });
+	if(!version)
+		return dependency;
+	auto cflags = RunCmdCaptureOutput({ pkgConfigPath, "--cflags", name });
+	auto libs = RunCmdCaptureOutput({ pkgConfigPath, "--libs", name });
+	auto staticLibs = RunCmdCaptureOutput({ pkgConfigPath, "--static", "--libs", name });
+	auto pcFileDir = RunCmdCaptureOutput({ pkgConfigPath, "--variable=pcfiledir", name });
+	if(!cflags || !libs || !staticLibs || !pcFileDir)
+		return dependency;
+	dependency.isFound = true;
+	dependency.version = std::move(version.value());
+	dependency.compileArgs = SplitArgs(cflags.value());
+	dependency.linkArgs = SplitArgs(libs.value());
+	dependency.staticLinkArgs = SplitArgs(staticLibs.value());
+	dependency.pcFilePath = (std::filesystem::path(pcFileDir.value()) / std::format("{}.pc", name)).string();
+	dependency.pcFileTime = GetLastWriteTime(dependency.pcFilePath);
+	return dependency;
+}
+
+static void to_json(json& jsonObj, const ProbedDependency& dependency)
+{
+	jsonObj = json {
+		{ "is_found", dependency.isFound },
+		{ "version", dependency.version },
+		{ "compile_args", dependency.compileArgs },
+		{ "link_args", dependency.linkArgs },
+		{ "static_link_args", dependency.staticLinkArgs },
+		{ "pc_file_path", dependency.pcFilePath },
+		{ "pc_file_time", dependency.pcFileTime }
+	};
+}
+
+static void from_json(const json& jsonObj, ProbedDependency& dependency)
+{
+	dependency.isFound = GetJsonKeyValue<bool>(jsonObj, "is_found", false);
+	dependency.version = GetJsonKeyValue<std::string>(jsonObj, "version", "");
+	dependency.compileArgs = GetJsonKeyValue<std::vector<std::string>>(jsonObj, "compile_args", std::vector<std::string> { });
+	dependency.linkArgs = GetJsonKeyValue<std::vector<std::string>>(jsonObj, "link_args", std::vector<std::string> { });
+	dependency.staticLinkArgs = GetJsonKeyValue<std::vector<std::string>>(jsonObj, "static_link_args", std::vector<std::string> { });
+	dependency.pcFilePath = GetJsonKeyValue<std::string>(jsonObj, "pc_file_path", "");
+	dependency.pcFileTime = GetJsonKeyValue<std::int64_t>(jsonObj, "pc_file_time", 0);
+}
+
+// Collects the names passed to dependency() for the host platform, both project and target level
+static std::set<std::string> CollectDependencyNames(const json& buildMasterJson)
+{
+	std::set<std::string> names;
+	auto collect = [&names](const json& jsonObj)
+	{
+		for(std::string keyName : { std::string { "dependencies" }, std::format("{}_dependencies", gHostPlatformName) })
+		{
+			auto it = jsonObj.find(keyName);
+			if(it == jsonObj.end())
+				continue;
+			for(const auto& value : it.value())
+			{
+				const auto& name = value.template get_ref<const std::string&>();
+				// Dependency names computed in meson (via variables) can't be probed here
+				if(name.find('$') == std::string::npos && !name.starts_with("env:"))
+					names.insert(name);
+			}
+		}
+	};
+	collect(buildMasterJson);
+	for(const auto& targetJson : GetJsonKeyValue<json>(buildMasterJson, "targets", json::array()))
+		collect(targetJson);
+	return names;
+}
+
+static std::string EscapeMesonStr(std::string_view str)
+{
+	std::string escapedStr;
+	escapedStr.reserve(str.size() + 2);
+	escapedStr.push_back('\'');
+	for(char ch : str)
+	{
+		if(ch == '\\' || ch == '\'')
+			escapedStr.push_back('\\');
+		// Single quoted meson strings can't span lines
+		if(ch == '\n')
+			escapedStr.append("\\n");
+		else
+			escapedStr.push_back(ch);
+	}
+	escapedStr.push_back('\'');
+	return escapedStr;
+}
+
+static std::string GetMesonListStr(const std::vector<std::string>& values)
+{
+	std::string str = "[";
+	for(std::size_t i = 0; const auto& value : values)
+	{
+		str.append(EscapeMesonStr(value));
+		if(++i < values.size())
+			str.append(", ");
+	}
+	str.append("]");
+	return str;
+}
+
+// Returns content of the .pc file as meson's fs.read() sees it (with the line endings normalized), or null if it can't be read
+static std::optional<std::string> ReadPcFile(const std::string& pcFilePath)
+{
+	std::ifstream stream(pcFilePath, std::ios_base::binary);
+	if(!stream)
+		return { };
+	std::string content { std::istreambuf_iterator<char> { stream }, std::istreambuf_iterator<char> { } };
+	std::erase(content, '\r');
+	return { std::move(content) };
+}
+
+// The generated meson.build looks up the dependencies in 'resolved_dependencies_bm_internal__' before calling dependency()
+// Each .pc file is read with fs.read(), which makes it a configure dependency of the build directory, so editing it re-runs meson (even if ninja triggers it).
+// A dependency is resolved only if its .pc file is still the probed one, otherwise meson's dependency() looks it up with the fresh flags.
+// Example:
+// resolved_dependencies_bm_internal__ = { }
+// is_static_dependencies_bm_internal__ = get_option('default_library') == 'static'
+// if fs_bm_internal__.is_file('/usr/lib/pkgconfig/zlib.pc') and fs_bm_internal__.read('/usr/lib/pkgconfig/zlib.pc') == 'prefix=/usr\n...'
+//   resolved_dependencies_bm_internal__ += { 'zlib' : declare_dependency(version : '1.2.13', compile_args : [],
+//     link_args : is_static_dependencies_bm_internal__ ? ['-lz'] : ['-lz']) }
+// endif
+static std::string GetResolvedDependenciesScript(const std::map<std::string, ProbedDependency>& dependencies)
+{
+	std::ostringstream stream;
+	stream << std::format("#------------- Generated By Build Master {} ------------------\n\n", BUILDMASTER_VERSION_STRING);
+	stream << "resolved_dependencies_bm_internal__ = { }\n";
+	stream << "fs_bm_internal__ = import('fs')\n";
+	stream << "is_static_dependencies_bm_internal__ = get_option('default_library') == 'static'\n";
+	for(const auto& [name, dependency] : dependencies)
+	{
+		if(!dependency.isFound)
+			continue;
+		auto pcFileContent = ReadPcFile(dependency.pcFilePath);
+		if(!pcFileContent)
+			continue;
+		auto pcFilePathStr = EscapeMesonStr(dependency.pcFilePath);
+		stream << std::format("if fs_bm_internal__.is_file({0}) and fs_bm_internal__.read({0}) == {1}\n", pcFilePathStr, EscapeMesonStr(pcFileContent.value()));
+		stream << std::format("  resolved_dependencies_bm_internal__ += {{ {} : declare_dependency(version : {}, compile_args : {},\n", EscapeMesonStr(name),
+			EscapeMesonStr(dependency.version), GetMesonListStr(dependency.compileArgs));
+		stream << std::format("    link_args : is_static_dependencies_bm_internal__ ? {} : {}) }}\n", GetMesonListStr(dependency.staticLinkArgs), GetMesonListStr(dependency.linkArgs));
+		stream << "endif\n";
+	}
+	return stream.str();
+}
+
+// Returns a key identifying pkg-config's search paths and their contents, the cached results are valid as long as it stays the same
+// Installing or removing a .pc file changes the last write time of its directory, so that changes the key too.
+static std::string GetSearchPathsKey(const std::string& pkgConfigPath, json& cacheJson)
+{
+	// pkg-config's default search path (pc_path) is compiled into it, so query it only if the pkg-config executable changes
+	auto pkgConfigTime = GetLastWriteTime(pkgConfigPath);
+	std::string pcPath;
+	if(GetJsonKeyValue<std::string>(cacheJson, "pkg_config_path", "") == pkgConfigPath && GetJsonKeyValue<std::int64_t>(cacheJson, "pkg_config_time", 0) == pkgConfigTime)
+		pcPath = GetJsonKeyValue<std::string>(cacheJson, "pc_path", "");
+	else
+	{
+		pcPath = RunCmdCaptureOutput({ pkgConfigPath, "--variable", "pc_path", "pkg-config" }).value_or("");
+		cacheJson["pkg_config_path"] = pkgConfigPath;
+		cacheJson["pkg_config_time"] = pkgConfigTime;
+		cacheJson["pc_path"] = pcPath;
+	}
+	std::string key = std::format("{}|{}", gDependencyCacheFormat, pkgConfigPath);
+	for(const char* envVarName : { "PKG_CONFIG_PATH", "PKG_CONFIG_LIBDIR", "PKG_CONFIG_SYSROOT_DIR" })
+	{
+		const char* value = std::getenv(envVarName);
+		key.append(std::format("|{}={}", envVarName, value ? value : ""));
+	}
+	const char* pkgConfigPathEnv = std::getenv("PKG_CONFIG_PATH");
+	const char* pkgConfigLibDirEnv = std::getenv("PKG_CONFIG_LIBDIR");
+	auto searchDirs = SplitPathList(pkgConfigPathEnv ? pkgConfigPathEnv : "");
+	for(auto& searchDir : SplitPathList(pkgConfigLibDirEnv ? pkgConfigLibDirEnv : pcPath))
+		searchDirs.push_back(std::move(searchDir));
+	for(const auto& searchDir : searchDirs)
+		key.append(std::format("|{}@{}", searchDir, GetLastWriteTime(searchDir)));
+	return std::format("{:016x}", ComputeContentHash(key));
+}
+
+// directory: value passed to --directory flag
+std::optional<ProbedDependencies> ProbePkgConfigDependencies(std::string_view directory, const std::set<std::string>& names)
+{
+	auto pkgConfigPaths = invoke::FindExecutable(gPkgConfigExecutableName);
+	if(!pkgConfigPaths)
+		return { };
+	std::string pkgConfigPath = SelectPath(pkgConfigPaths.value());
+
+	auto cacheFilePath = GetPathStrRelativeToDir(directory, gDependencyCacheFilePath);
+	json cacheJson = json::object();
+	if(std::filesystem::exists(cacheFilePath))
+	{
+		try
+		{
+			cacheJson = ParseJsonFile(cacheFilePath);
+		} catch(const std::exception& except)
+		{
+			spdlog::warn("Ignoring the corrupted dependency cache {}, {}", cacheFilePath, except.what());
+		}
+	}
+	auto searchPathsKey = GetSearchPathsKey(pkgConfigPath, cacheJson);
+	std::map<std::string, ProbedDependency> cachedDependencies;
+	if(GetJsonKeyValue<std::string>(cacheJson, "search_paths_key", "") == searchPathsKey)
+		cachedDependencies = GetJsonKeyValue<std::map<std::string, ProbedDependency>>(cacheJson, "dependencies", std::map<std::string, ProbedDependency> { });
+
+	// Probe the dependencies, which are either not in the cache or their .pc files have changed, in parallel
+	ProbedDependencies result;
+	auto& dependencies = result.dependencies;
+	std::vector<std::pair<std::string, std::future<ProbedDependency>>> futures;
+	for(const auto& name : names)
+	{
+		auto it = cachedDependencies.find(name);
+		if(it != cachedDependencies.end() && (!it->second.isFound || GetLastWriteTime(it->second.pcFilePath) == it->second.pcFileTime))
+			dependencies.insert(*it);
+		else
+			futures.push_back({ name, std::async(std::launch::async, ProbeDependency, pkgConfigPath, name) });
+	}
+	for(auto& [name, future] : futures)
+		dependencies.insert({ name, future.get() });
+	result.probedCount = futures.size();
+	if(futures.size())
+		spdlog::info("Probed {} dependencies, {} found in the cache", futures.size(), dependencies.size() - futures.size());
+
+	// The cached results of the other names are kept, the meson path and the direct ninja backend probe different sets of names
+	for(const auto& [name, dependency] : dependencies)
+		cachedDependencies[name] = dependency;
+	cacheJson["search_paths_key"] = searchPathsKey;
+	cacheJson["dependencies"] = cachedDependencies;
+	WriteTextFileIfChanged(cacheFilePath, cacheJson.dump(4));
+	return { std::move(result) };
+}
+
+// directory: value passed to --directory flag
+void ProbeDependencies(std::string_view directory, const std::set<std::string>& excludedNames)
+{
+	json buildMasterJson = ParseBuildMasterJson(directory);
+	if(!GetJsonKeyValue<bool>(buildMasterJson, "dependency_probe_cache", false))
+		return;
+	std::set<std::string> names = CollectDependencyNames(buildMasterJson);
+	// Otherwise an installed .pc file of a workspace library would shadow the target being built in the same tree
+	for(const auto& name : excludedNames)
+		names.erase(name);
+	auto result = ProbePkgConfigDependencies(directory, names);
+	if(!result)
+	{
+		spdlog::warn("Couldn't find {}, dependencies will be resolved by meson", gPkgConfigExecutableName);
+		return;
+	}
+	const auto& dependencies = result->dependencies;
+
+	// Report only if something has been probed, otherwise the same report would be printed on every invocation
+	std::vector<std::string_view> missingNames;
+	for(const auto& [name, dependency] : dependencies)
+		if(result->probedCount && !dependency.isFound)
+			missingNames.push_back(name);
+	if(missingNames.size())
+	{
+		std::string namesStr;
+		for(const auto& name : missingNames)
+			namesStr.append(std::format("\n\t{}", name));
+		spdlog::warn("The following dependencies are not found via pkg-config, meson will look them up (cmake, wraps, etc.):{}", namesStr);
+	}
+
+	auto scriptFilePath = (std::filesystem::path(GetPathStrRelativeToDir(directory, gResolvedDependenciesDirPath)) / "meson.build").string();
+	WriteTextFileIfChanged(scriptFilePath, GetResolvedDependenciesScript(dependencies));
+}
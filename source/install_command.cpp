@@ -0,0 +1,349 @@
+#include <build_master/install_command.hpp>
+#include <build_master/invoke_meson.hpp> // for RunMesonCmd()
+#include <build_master/json_parse.hpp> // for ParseJsonFile(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), ComputeContentHash(), ReflinkFile(), and WriteTextFileIfChanged()
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <cstdint>
+
+#include <spdlog/spdlog.h>
+
+static constexpr std::string_view gInstallStageDirPath = "build_master_install_stage";
+static constexpr std::string_view gInstallManifestFilePath = "build_master_install_manifest.json";
+// Written by 'meson install', it lists every file it has installed (or preserved with --only-changed)
+static constexpr std::string_view gMesonInstallLogFilePath = "meson-logs/install-log.txt";
+static constexpr std::string_view gPreservedFilePrefix = "# Preserving old file ";
+static constexpr std::size_t gHashChunkSize = 1024 * 1024;
+static constexpr double gMiB = 1024 * 1024;
+
+// An installed file as recorded in the install manifest, the key of the manifest is the install path
+struct InstalledFile
+{
+	// Content hash of the file (the installed file and the staged file it has been installed from, both have the same content)
+	std::uint64_t hash { 0 };
+	// Size and mtime of the staged file when it has been hashed
+	std::uint64_t stageSize { 0 };
+	std::int64_t stageTime { 0 };
+	// Size and mtime of the installed file right after it has been installed (or found to be upto date)
+	std::uint64_t size { 0 };
+	std::int64_t time { 0 };
+};
+
+using InstallManifest = std::unordered_map<std::string, InstalledFile>;
+
+enum class InstallAction
+{
+	Skip,
+	Reflink,
+	Copy,
+	Symlink,
+	Fail
+};
+
+struct InstallItem
+{
+	std::filesystem::path stagePath;
+	std::filesystem::path installPath;
+	InstallAction action { InstallAction::Skip };
+	std::uint64_t size { 0 };
+	// In seconds, time taken to write the installed file
+	double writeTime { 0 };
+	// The new manifest entry, valid only if the action isn't Fail and the file isn't a symlink
+	std::optional<InstalledFile> installedFile;
+};
+
+static std::int64_t GetFileTime(const std::filesystem::path& path)
+{
+	return static_cast<std::int64_t>(std::filesystem::last_write_time(path).time_since_epoch().count());
+}
+
+// Returns null if the file couldn't be read
+static std::optional<std::uint64_t> ComputeFileContentHash(const std::filesystem::path& path)
+{
+	std::ifstream stream(path, std::ios_base::binary);
+	if(!stream.is_open())
+		return { };
+	std::string buffer(gHashChunkSize, '\0');
+	std::uint64_t hash = ComputeContentHash("");
+	while(stream.read(buffer.data(), buffer.size()) || stream.gcount())
+		hash = ComputeContentHash(std::string_view { buffer.data(), static_cast<std::size_t>(stream.gcount()) }, hash);
+	if(stream.bad())
+		return { };
+	return { hash };
+}
+
+static InstallManifest LoadInstallManifest(const std::filesystem::path& manifestFilePath)
+{
+	InstallManifest manifest;
+	if(!std::filesystem::exists(manifestFilePath))
+		return manifest;
+	json filesJson = GetJsonKeyValue<json>(ParseJsonFile(manifestFilePath.string()), "files", json::object());
+	for(const auto& [installPath, fileJson] : filesJson.items())
+	{
+		InstalledFile installedFile;
+		installedFile.hash = std::stoull(GetJsonKeyValue<std::string>(fileJson, "hash"), nullptr, 16);
+		installedFile.stageSize = GetJsonKeyValue<std::uint64_t>(fileJson, "stage_size");
+		installedFile.stageTime = GetJsonKeyValue<std::int64_t>(fileJson, "stage_mtime");
+		installedFile.size = GetJsonKeyValue<std::uint64_t>(fileJson, "size");
+		installedFile.time = GetJsonKeyValue<std::int64_t>(fileJson, "mtime");
+		manifest.insert({ installPath, installedFile });
+	}
+	return manifest;
+}
+
+static void SaveInstallManifest(const std::filesystem::path& manifestFilePath, const std::vector<InstallItem>& items, InstallManifest manifest)
+{
+	for(const auto& item : items)
+		if(item.installedFile)
+			manifest[item.installPath.generic_string()] = item.installedFile.value();
+	// Sorted, so that the file doesn't change if nothing else has changed
+	std::vector<std::pair<std::string_view, const InstalledFile*>> files;
+	files.reserve(manifest.size());
+	for(const auto& [installPath, installedFile] : manifest)
+		files.push_back({ installPath, &installedFile });
+	std::ranges::sort(files);
+	json filesJson = json::object();
+	for(const auto& [installPath, installedFile] : files)
+		filesJson[std::string { installPath }] = json
+		{
+			{ "hash", std::format("{:016x}", installedFile->hash) },
+			{ "stage_size", installedFile->stageSize },
+			{ "stage_mtime", installedFile->stageTime },
+			{ "size", installedFile->size },
+			{ "mtime", installedFile->time }
+		};
+	WriteTextFileIfChanged(manifestFilePath.string(), json { { "files", filesJson } }.dump(4));
+}
+
+// Returns the staged files (and symlinks) listed in the install log of meson, i.e. only those which are still installed by the project
+static std::vector<std::filesystem::path> LoadStagedFiles(std::string_view buildDirectory, const std::filesystem::path& stagePath)
+{
+	std::vector<std::filesystem::path> files;
+	std::ifstream stream(GetPathStrRelativeToDir(buildDirectory, gMesonInstallLogFilePath));
+	for(std::string line; std::getline(stream, line);)
+	{
+		if(line.size() && line.back() == '\r')
+			line.pop_back();
+		std::string_view path = line;
+		if(path.starts_with(gPreservedFilePrefix))
+			path.remove_prefix(gPreservedFilePrefix.size());
+		else if(path.empty() || path.front() == '#')
+			continue;
+		std::filesystem::path filePath { path };
+		std::error_code errorCode;
+		auto status = std::filesystem::symlink_status(filePath, errorCode);
+		// The directories (of install_subdir()) are listed too, their files are listed separately
+		if(errorCode || !(std::filesystem::is_regular_file(status) || std::filesystem::is_symlink(status)))
+			continue;
+		auto relativePath = filePath.lexically_relative(stagePath);
+		if(relativePath.empty() || *relativePath.begin() == "..")
+			continue;
+		files.push_back(std::move(filePath));
+	}
+	return files;
+}
+
+// Brings the installed file upto date with the staged file, it is written only if the content differs
+static void InstallFile(InstallItem& item, const InstallManifest& manifest, bool isDryRun)
+{
+	// Versioned shared libraries are symlinks (libfoo.so -> libfoo.so.1)
+	if(std::filesystem::is_symlink(item.stagePath))
+	{
+		auto target = std::filesystem::read_symlink(item.stagePath);
+		std::error_code errorCode;
+		if(std::filesystem::is_symlink(item.installPath) && std::filesystem::read_symlink(item.installPath, errorCode) == target)
+			return;
+		item.action = InstallAction::Symlink;
+		if(isDryRun)
+			return;
+		std::filesystem::create_directories(item.installPath.parent_path());
+		std::filesystem::remove(item.installPath);
+		std::filesystem::create_symlink(target, item.installPath);
+		return;
+	}
+
+	InstalledFile installedFile;
+	installedFile.stageSize = std::filesystem::file_size(item.stagePath);
+	installedFile.stageTime = GetFileTime(item.stagePath);
+	item.size = installedFile.stageSize;
+	auto it = manifest.find(item.installPath.generic_string());
+	const InstalledFile* recordedFile = (it != manifest.end()) ? &it->second : nullptr;
+	// The staged file is hashed only if it has changed since it has been hashed
+	std::optional<std::uint64_t> hash;
+	if(recordedFile && recordedFile->stageSize == installedFile.stageSize && recordedFile->stageTime == installedFile.stageTime)
+		hash = recordedFile->hash;
+	else if(!(hash = ComputeFileContentHash(item.stagePath)))
+		throw std::runtime_error(std::format("Failed to read {}", item.stagePath.string()));
+	installedFile.hash = hash.value();
+
+	std::error_code errorCode;
+	if(std::filesystem::is_regular_file(item.installPath, errorCode) && std::filesystem::file_size(item.installPath) == installedFile.stageSize)
+	{
+		// The installed file is hashed only if it has been modified since it has been installed
+		std::uint64_t size = installedFile.stageSize;
+		std::int64_t time = GetFileTime(item.installPath);
+		std::optional<std::uint64_t> installedHash;
+		if(recordedFile && recordedFile->size == size && recordedFile->time == time)
+			installedHash = recordedFile->hash;
+		else
+			installedHash = ComputeFileContentHash(item.installPath);
+		if(installedHash == installedFile.hash)
+		{
+			installedFile.size = size;
+			installedFile.time = time;
+			item.installedFile = installedFile;
+			return;
+		}
+	}
+
+	item.action = InstallAction::Copy;
+	if(isDryRun)
+		return;
+	// Written next to the installed file and renamed over it, so that a concurrent reader (or a running executable) never sees a partially written file
+	auto startTime = std::chrono::steady_clock::now();
+	std::filesystem::create_directories(item.installPath.parent_path());
+	auto tempPath = item.installPath.parent_path() / std::format(".{}.build_master-tmp", item.installPath.filename().string());
+	std::filesystem::remove(tempPath);
+	if(ReflinkFile(item.stagePath, tempPath))
+		item.action = InstallAction::Reflink;
+	else
+		std::filesystem::copy_file(item.stagePath, tempPath);
+	std::filesystem::rename(tempPath, item.installPath);
+	item.writeTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	installedFile.size = std::filesystem::file_size(item.installPath);
+	installedFile.time = GetFileTime(item.installPath);
+	item.installedFile = installedFile;
+}
+
+// Returns the root path (i.e. "/", or the drive on Windows) the install paths of meson are relative to in the staging directory
+static std::filesystem::path GetInstallRootPath(std::string_view buildDirectory)
+{
+	std::filesystem::path rootPath { "/" };
+	for(const auto& optionJson : ParseJsonFile(GetPathStrRelativeToDir(buildDirectory, "meson-info/intro-buildoptions.json")))
+		if(GetJsonKeyValue<std::string>(optionJson, "name") == "prefix")
+		{
+			std::filesystem::path prefixPath { GetJsonKeyValue<std::string>(optionJson, "value") };
+			if(prefixPath.has_root_path())
+				rootPath = prefixPath.root_path();
+			break;
+		}
+	return rootPath;
+}
+
+int RunInstall(std::string_view directory, const InstallCommandArgs& args)
+{
+	auto buildDirectory = GetPathStrRelativeToDir(directory, args.buildDirectory);
+	if(!std::filesystem::exists(std::filesystem::path(buildDirectory) / "meson-info" / "intro-buildoptions.json"))
+	{
+		spdlog::error("{} isn't configured, please configure it first with 'build_master meson setup {}'", buildDirectory, args.buildDirectory);
+		return EXIT_FAILURE;
+	}
+	auto startTime = std::chrono::steady_clock::now();
+
+	// meson installs into the staging directory, it takes care of the install modes, the rpaths, stripping, etc.
+	// and with --only-changed it copies only the files which are newer than the staged ones.
+	auto stagePath = std::filesystem::absolute(GetPathStrRelativeToDir(buildDirectory, gInstallStageDirPath)).lexically_normal();
+	std::vector<std::string> mesonArgs { "install", "-C", args.buildDirectory, "--destdir", stagePath.string(), "--only-changed", "--quiet" };
+	if(args.isNoRebuild)
+		mesonArgs.push_back("--no-rebuild");
+	if(int exitCode = RunMesonCmd(directory, mesonArgs); exitCode != 0)
+		return exitCode;
+
+	std::filesystem::path installRootPath = args.destDirectory.empty() ? GetInstallRootPath(buildDirectory) : std::filesystem::path(args.destDirectory);
+	std::vector<InstallItem> items;
+	for(auto& stagedFilePath : LoadStagedFiles(buildDirectory, stagePath))
+	{
+		InstallItem item;
+		item.installPath = installRootPath / stagedFilePath.lexically_relative(stagePath);
+		item.stagePath = std::move(stagedFilePath);
+		items.push_back(std::move(item));
+	}
+	auto manifestFilePath = std::filesystem::path(GetPathStrRelativeToDir(buildDirectory, gInstallManifestFilePath));
+	InstallManifest manifest = LoadInstallManifest(manifestFilePath);
+
+	// The large files first, so that a large file doesn't start last and stretch the total time
+	std::vector<std::size_t> order(items.size());
+	for(std::size_t i = 0; i < order.size(); ++i)
+		order[i] = i;
+	std::error_code errorCode;
+	std::vector<std::uintmax_t> sizes(items.size());
+	for(std::size_t i = 0; i < items.size(); ++i)
+		sizes[i] = std::filesystem::is_regular_file(items[i].stagePath, errorCode) ? std::filesystem::file_size(items[i].stagePath, errorCode) : 0;
+	std::ranges::sort(order, [&sizes](std::size_t left, std::size_t right) { return sizes[left] > sizes[right]; });
+
+	unsigned int jobCount = args.jobCount ? args.jobCount : std::max(std::thread::hardware_concurrency(), 1u);
+	std::atomic<std::size_t> nextIndex { 0 };
+	std::mutex errorMutex;
+	std::vector<std::string> errors;
+	{
+		std::vector<std::jthread> workers;
+		for(unsigned int i = 0; i < std::min<std::size_t>(jobCount, items.size()); ++i)
+			workers.emplace_back([&]()
+			{
+				for(std::size_t index; (index = nextIndex.fetch_add(1)) < order.size();)
+				{
+					InstallItem& item = items[order[index]];
+					try
+					{
+						InstallFile(item, manifest, args.isDryRun);
+					}
+					catch(const std::exception& exception)
+					{
+						item.action = InstallAction::Fail;
+						std::lock_guard<std::mutex> lock(errorMutex);
+						errors.push_back(exception.what());
+					}
+				}
+			});
+	}
+	double elapsedTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	if(!args.isDryRun)
+		SaveInstallManifest(manifestFilePath, items, std::move(manifest));
+
+	std::size_t installedCount = 0, reflinkedCount = 0, skippedCount = 0;
+	std::uint64_t installedSize = 0, skippedSize = 0;
+	double writeTime = 0;
+	for(const auto& item : items)
+	{
+		switch(item.action)
+		{
+			case InstallAction::Skip: ++skippedCount; skippedSize += item.size; continue;
+			case InstallAction::Reflink: ++reflinkedCount; break;
+			case InstallAction::Fail: continue;
+			default: break;
+		}
+		++installedCount;
+		installedSize += item.size;
+		writeTime += item.writeTime;
+		if(args.isDryRun)
+			std::cout << std::format("Would install {}\n", item.installPath.string());
+	}
+	for(const auto& error : errors)
+		spdlog::error("{}", error);
+	spdlog::info("{} {} files ({:.1f} MiB, {} reflinked), skipped {} unchanged files ({:.1f} MiB) in {:.2f}s",
+					args.isDryRun ? "Would install" : "Installed", installedCount, installedSize / gMiB, reflinkedCount, skippedCount, skippedSize / gMiB, elapsedTime);
+	// The time saved is estimated from the average time taken to write an installed file in this install
+	if(skippedCount && installedCount && writeTime > 0)
+		spdlog::info("~{:.2f}s of writes saved by skipping the unchanged files", writeTime * skippedCount / installedCount);
+	if(errors.size())
+	{
+		spdlog::error("{} files couldn't be installed, run it with the root privileges (e.g. sudo) or pass --destdir if the install directories aren't writable", errors.size());
+		return EXIT_FAILURE;
+	}
+	return EXIT_SUCCESS;
+}
@@ -1,6 +1,9 @@
 #include <build_master/meson_build_gen.hpp>
 #include <build_master/pre_config_script.hpp>
-#include <build_master/misc.hpp> // for SelectPath()
+#include <build_master/misc.hpp> // for SelectPath(), GetSelfExecutablePath(), and QuoteShellArg()
+#include <build_master/json_parse.hpp> // for ParseBuildMasterJson(), and GetJsonKeyValue<>()
+#include <build_master/dependency_probe.hpp> // for ProbeDependencies()
+#include <build_master/artifact_cache.hpp> // for PreparePrebuiltDependencies()
 
 #include <iostream>
 #include <cstdlib>
@@ -57,6 +60,37 @@ static decltype(auto) RunCmd(std::string_view cmdName, std::string_view workDire
   	return invoke::Exec(finalArgs, workDirectory, isRoot);
 }
 
+// "resource_accounting": meson takes the compilers from CC and CXX at setup (and keeps them for the reconfigurations), so 'build_master cc-wrap' is put in front of them
+// Without CC (or CXX) meson would use ccache if it is installed, so it is kept in between then
+static void SetCompilerLauncher(std::string_view directory)
+{
+	if(!GetJsonKeyValue<bool>(ParseBuildMasterJson(directory), "resource_accounting", false))
+		return;
+	// Quoted, as meson splits CC and CXX like the shell (the path may have spaces)
+	std::string launcher = std::format("{} cc-wrap", QuoteShellArg(GetSelfExecutablePath()));
+	auto ccachePaths = invoke::FindExecutable("ccache");
+	bool isCcache = ccachePaths && ccachePaths->size();
+	for(auto [envVarName, defaultCompiler] : { std::pair { "CC", "cc" }, std::pair { "CXX", "c++" } })
+	{
+		const char* value = std::getenv(envVarName);
+		std::string compiler = (value && *value) ? value : std::format("{}{}", isCcache ? "ccache " : "", defaultCompiler);
+		if(compiler.starts_with(launcher))
+			continue;
+		compiler = std::format("{} {}", launcher, compiler);
+		spdlog::info("Resource accounting: {}={}", envVarName, compiler);
+#ifdef _WIN32
+		_putenv_s(envVarName, compiler.c_str());
+#else
+		setenv(envVarName, compiler.c_str(), 1);
+#endif
+	}
+}
+
+int RunMesonCmd(std::string_view directory, const std::vector<std::string>& args)
+{
+	return RunCmd(gMesonExecutableName, directory, args);
+}
+
 // build_master meson
 // directory: value passed to --directory flag
 void InvokeMeson(std::string_view directory, const std::vector<std::string>& args, bool isBuildMasterJsonAvailable)
@@ -65,9 +99,16 @@ void InvokeMeson(std::string_view directory, const std::vector<std::string>& arg
 	{
 		// Ensure the meson.build script is upto date
 		RegenerateMesonBuildScript(directory);
-		// Run pre-configure script if 'meson setup' command is executed
-		if(args.size() == 0 || args[0] == "setup")
+		// Build (or restore from the artifact cache) the prebuilt dependencies, and run pre-configure script if 'meson setup' command is executed
+		bool isSetup = args.size() == 0 || args[0] == "setup";
+		PreparePrebuiltDependencies(directory, isSetup);
+		if(isSetup)
+		{
 			RunPreConfigScript(directory);
+			SetCompilerLauncher(directory);
+		}
+		// Revalidate the resolved dependencies (it is just a few stat() calls if nothing has changed), as pre-config hooks may install some
+		ProbeDependencies(directory);
 	}
 
 #ifdef PLATFORM_LINUX
@@ -0,0 +1,337 @@
+#include <build_master/job_planner.hpp>
+#include <build_master/json_parse.hpp> // for ParseBuildMasterJson(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), and WriteTextFileIfChanged()
+
+#include <format>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <optional>
+#include <algorithm>
+#include <thread>
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#	include <windows.h>
+#elif defined(__APPLE__)
+#	include <mach/mach.h>
+#endif
+
+static constexpr std::uint64_t gMiB = 1024 * 1024;
+// Memory of a compile/link job if nothing is known about it, typical for a C++ translation unit of moderate size
+static constexpr std::uint64_t gDefaultJobMemory = 512 * gMiB;
+// Memory of a compile/link job of a heavy target if neither "memory_hint_mb" is given nor any build has been recorded yet
+static constexpr std::uint64_t gDefaultHeavyJobMemory = 2048 * gMiB;
+// Only this ratio of the available memory is planned for, the rest is left for the system, ninja itself, and the estimation errors
+static constexpr double gMemoryBudgetRatio = 0.9;
+// The recorded peak decays by this ratio on every build which doesn't reach it (half-life of about 14 builds), so that a single outlier job doesn't lower -j for good
+static constexpr double gPeakJobMemoryDecayRatio = 0.95;
+static constexpr std::string_view gJobMemoryFileName = "build_master_job_memory.json";
+static constexpr std::string_view gHeavyPoolName = "build_master_heavy_pool";
+// First line of the pool declaration prepended to build.ninja, it marks the file as already patched
+static constexpr std::string_view gHeavyPoolComment = "# build_master: pool of the compile and link jobs of the memory heavy targets, see 'build_master build'";
+
+#ifndef _WIN32
+// Returns the value (in bytes) of the given key in /proc/meminfo, e.g. "MemAvailable"
+static std::optional<std::uint64_t> GetMemInfoValue(std::string_view key)
+{
+	std::ifstream stream("/proc/meminfo");
+	std::string line;
+	while(std::getline(stream, line))
+	{
+		if(!line.starts_with(key) || line.size() <= key.size() || line[key.size()] != ':')
+			continue;
+		try
+		{
+			// Values are in kB
+			return { std::stoull(line.substr(key.size() + 1)) * 1024 };
+		} catch(const std::exception&) { return { }; }
+	}
+	return { };
+}
+
+// Returns the memory (in bytes) which can still be used under the limit of the cgroup (v2) the process runs in, i.e. in a container or CI runner
+static std::optional<std::uint64_t> GetCgroupAvailableMemory()
+{
+	std::ifstream maxStream("/sys/fs/cgroup/memory.max"), currentStream("/sys/fs/cgroup/memory.current");
+	std::string maxStr, currentStr;
+	if(!(maxStream >> maxStr) || !(currentStream >> currentStr) || maxStr == "max")
+		return { };
+	try
+	{
+		std::uint64_t max = std::stoull(maxStr), current = std::stoull(currentStr);
+		return { (max > current) ? (max - current) : 0 };
+	} catch(const std::exception&) { return { }; }
+}
+#endif // _WIN32
+
+// Returns the memory (in bytes) which can be used without swapping, or null if it can't be determined
+static std::optional<std::uint64_t> GetAvailableMemory()
+{
+#ifdef _WIN32
+	MEMORYSTATUSEX status { };
+	status.dwLength = sizeof(status);
+	if(!GlobalMemoryStatusEx(&status))
+		return { };
+	return { status.ullAvailPhys };
+#elif defined(__APPLE__)
+	// Free, inactive, and purgeable pages can be handed out without swapping
+	vm_statistics64_data_t vmStats { };
+	mach_msg_type_number_t count = HOST_VM_INFO64_COUNT;
+	if(host_statistics64(mach_host_self(), HOST_VM_INFO64, reinterpret_cast<host_info64_t>(&vmStats), &count) != KERN_SUCCESS)
+		return { };
+	return { (static_cast<std::uint64_t>(vmStats.free_count) + vmStats.inactive_count + vmStats.purgeable_count) * vm_page_size };
+#else
+	auto available = GetMemInfoValue("MemAvailable");
+	if(auto cgroupAvailable = GetCgroupAvailableMemory())
+		available = available ? std::min(available.value(), cgroupAvailable.value()) : cgroupAvailable;
+	return available;
+#endif
+}
+
+static std::string GetJobMemoryFilePath(std::string_view buildDirectory)
+{
+	return GetPathStrRelativeToDir(buildDirectory, gJobMemoryFileName);
+}
+
+// Returns the peak memory of a job recorded by RecordPeakJobMemory(), or 0 if nothing has been recorded
+static std::uint64_t LoadPeakJobMemory(std::string_view buildDirectory)
+{
+	auto filePath = GetJobMemoryFilePath(buildDirectory);
+	if(!std::filesystem::exists(filePath))
+		return 0;
+	try
+	{
+		return GetJsonKeyValue<std::uint64_t>(ParseJsonFile(filePath), "peak_job_memory", 0);
+	} catch(const std::exception& except)
+	{
+		spdlog::warn("Ignoring malformed job memory file {}, {}", filePath, except.what());
+	}
+	return 0;
+}
+
+void RecordPeakJobMemory(std::string_view buildDirectory, std::uint64_t peakMemory)
+{
+	// Not known on this platform
+	if(peakMemory == 0)
+		return;
+	std::uint64_t recordedPeakMemory = LoadPeakJobMemory(buildDirectory);
+	std::uint64_t decayedPeakMemory = static_cast<std::uint64_t>(static_cast<double>(recordedPeakMemory) * gPeakJobMemoryDecayRatio);
+	std::uint64_t newPeakMemory = std::max(peakMemory, decayedPeakMemory);
+	if(newPeakMemory == recordedPeakMemory)
+		return;
+	json memoryJson = json::object();
+	memoryJson["peak_job_memory"] = newPeakMemory;
+	WriteTextFileIfChanged(GetJobMemoryFilePath(buildDirectory), memoryJson.dump(4));
+}
+
+JobPlan PlanBuildJobs(std::string_view directory, std::string_view buildDirectory, unsigned int jobCount)
+{
+	JobPlan plan;
+	plan.jobCount = jobCount;
+	json buildMasterJson = ParseBuildMasterJson(directory);
+	// The largest hint of the heavy targets, 0 if any of them has no hint (then the learned or the default estimate is used)
+	std::uint64_t heavyJobMemoryHint = 0;
+	bool isAnyHintMissing = false;
+	if(auto it = buildMasterJson.find("targets"); it != buildMasterJson.end())
+	{
+		for(const auto& targetJson : it.value())
+		{
+			auto memoryHint = GetJsonKeyValueOrNull<std::uint64_t>(targetJson, "memory_hint_mb");
+			if(!memoryHint && !GetJsonKeyValue<bool>(targetJson, "heavy", false))
+				continue;
+			plan.heavyTargetNames.push_back(GetJsonKeyValue<std::string>(targetJson, "name"));
+			if(memoryHint)
+				heavyJobMemoryHint = std::max(heavyJobMemoryHint, memoryHint.value() * gMiB);
+			else
+				isAnyHintMissing = true;
+		}
+	}
+
+	// The learned peak is the most memory hungry job of the builds so far, which is a heavy one if there are heavy targets
+	std::uint64_t learnedJobMemory = LoadPeakJobMemory(buildDirectory);
+	bool isHeavy = plan.heavyTargetNames.size();
+	std::uint64_t jobMemory = (!isHeavy && learnedJobMemory) ? learnedJobMemory : gDefaultJobMemory;
+	std::uint64_t heavyJobMemory = heavyJobMemoryHint;
+	if(isAnyHintMissing)
+		heavyJobMemory = std::max(heavyJobMemory, learnedJobMemory ? learnedJobMemory : gDefaultHeavyJobMemory);
+
+	auto availableMemory = GetAvailableMemory();
+	if(!availableMemory)
+	{
+		// Nothing to plan with, so the heavy jobs are run one by one to be on the safe side
+		plan.heavyJobCount = isHeavy ? 1 : 0;
+		spdlog::warn("Failed to determine the available memory, the number of jobs is left to ninja");
+		return plan;
+	}
+
+	unsigned int cpuCount = std::max(std::thread::hardware_concurrency(), 1u);
+	auto budget = static_cast<std::uint64_t>(static_cast<double>(availableMemory.value()) * gMemoryBudgetRatio);
+	auto clampJobCount = [cpuCount](std::uint64_t count) { return static_cast<unsigned int>(std::clamp<std::uint64_t>(count, 1, cpuCount)); };
+	if(isHeavy)
+	{
+		plan.heavyJobCount = clampJobCount(budget / heavyJobMemory);
+		// The light jobs fill the memory left by the heavy jobs running at the same time
+		if(!plan.jobCount)
+			plan.jobCount = clampJobCount(plan.heavyJobCount + (budget - std::min(budget, plan.heavyJobCount * heavyJobMemory)) / jobMemory);
+		plan.heavyJobCount = std::min(plan.heavyJobCount, plan.jobCount);
+	}
+	else if(!plan.jobCount)
+		plan.jobCount = clampJobCount(budget / jobMemory);
+
+	std::string heavyInfo = isHeavy ? std::format(", {} heavy jobs at most (~{} MiB each)", plan.heavyJobCount, heavyJobMemory / gMiB) : std::string { };
+	spdlog::info("{:.1f} GiB of memory available, {} jobs (~{} MiB each){}", availableMemory.value() / (1024.0 * gMiB), plan.jobCount, jobMemory / gMiB, heavyInfo);
+	return plan;
+}
+
+// Returns the first output path of a 'build <outputs>: <rule> <inputs>' statement of build.ninja (unescaped), and its rule name
+static std::pair<std::string, std::string_view> ParseBuildStatement(std::string_view line)
+{
+	std::string output;
+	std::size_t pos = std::string_view { "build " }.size();
+	for(; pos < line.size(); ++pos)
+	{
+		char ch = line[pos];
+		// $<space>, $:, and $$ are the escaped characters
+		if(ch == '$' && (pos + 1) < line.size())
+		{
+			output.push_back(line[++pos]);
+			continue;
+		}
+		if(ch == ' ' || ch == ':' || ch == '|')
+			break;
+		output.push_back(ch);
+	}
+	// Skip the remaining outputs up to the unescaped ':'
+	for(; pos < line.size() && line[pos] != ':'; ++pos)
+		if(line[pos] == '$')
+			++pos;
+	std::string_view rule = (pos < line.size()) ? line.substr(pos + 1) : std::string_view { };
+	while(rule.starts_with(' '))
+		rule.remove_prefix(1);
+	return { output, rule.substr(0, rule.find(' ')) };
+}
+
+// Returns the output paths (relative to the build directory, as they appear in build.ninja) of the given targets
+static std::vector<std::string> GetTargetOutputPaths(std::string_view buildDirectory, const std::vector<std::string>& targetNames)
+{
+	std::vector<std::string> outputPaths;
+	std::ifstream stream(std::filesystem::path(buildDirectory) / "meson-info/intro-targets.json");
+	if(!stream.is_open())
+		return outputPaths;
+	json targetsJson = json::parse(stream, nullptr, false);
+	if(targetsJson.is_discarded() || !targetsJson.is_array())
+		return outputPaths;
+	std::unordered_set<std::string_view> names { targetNames.begin(), targetNames.end() };
+	for(const auto& targetJson : targetsJson)
+	{
+		auto nameIt = targetJson.find("name");
+		auto fileNameIt = targetJson.find("filename");
+		if(nameIt == targetJson.end() || fileNameIt == targetJson.end() || !fileNameIt.value().is_array()
+			|| !names.contains(nameIt.value().template get_ref<const std::string&>()))
+			continue;
+		for(const auto& fileName : fileNameIt.value())
+		{
+			std::error_code errorCode;
+			auto relativePath = std::filesystem::relative(fileName.template get<std::string>(), buildDirectory, errorCode);
+			if(!errorCode && !relativePath.empty())
+				outputPaths.push_back(relativePath.generic_string());
+		}
+	}
+	return outputPaths;
+}
+
+void ApplyJobPlan(std::string_view buildDirectory, const JobPlan& plan)
+{
+	auto buildNinjaPath = GetPathStrRelativeToDir(buildDirectory, "build.ninja");
+	if(plan.heavyTargetNames.empty())
+	{
+		// Only the first line tells if there is a pool of a previous plan to remove, the rest of build.ninja isn't read then
+		std::ifstream stream(buildNinjaPath, std::ios_base::binary);
+		std::string firstLine;
+		if(!std::getline(stream, firstLine) || firstLine != gHeavyPoolComment)
+			return;
+	}
+	std::string content;
+	{
+		// Read at once, build.ninja of a large project is tens of megabytes
+		std::ifstream stream(buildNinjaPath, std::ios_base::binary);
+		if(!stream.is_open())
+			return;
+		std::ostringstream contentStream;
+		contentStream << stream.rdbuf();
+		content = std::move(contentStream).str();
+	}
+	std::string_view contentView { content };
+	if(contentView.starts_with(gHeavyPoolComment))
+	{
+		// Strip the pool declaration of the previous plan, it ends with an empty line
+		auto endPos = contentView.find("\n\n");
+		contentView.remove_prefix((endPos == std::string_view::npos) ? contentView.size() : (endPos + 2));
+	}
+
+	// A heavy target's link edge outputs the target file itself, and its compile edges output into its private directory <target file>.p/
+	std::vector<std::string> outputPaths = GetTargetOutputPaths(buildDirectory, plan.heavyTargetNames);
+	auto isHeavyOutput = [&outputPaths](std::string_view output)
+	{
+		return std::ranges::any_of(outputPaths, [output](const std::string& path)
+		{
+			return output.starts_with(path) && (output.size() == path.size() || output.substr(path.size()).starts_with(".p/"));
+		});
+	};
+
+	std::string poolBinding = std::format(" pool = {}", gHeavyPoolName);
+	std::string patchedContent;
+	patchedContent.reserve(content.size() + 4096);
+	if(outputPaths.size())
+		patchedContent.append(std::format("{}\npool {}\n depth = {}\n\n", gHeavyPoolComment, gHeavyPoolName, std::max(plan.heavyJobCount, 1u)));
+	// An edge can be in only one pool, so the edges already in a pool (of their rule, or of their own) are left there,
+	// e.g. the links in meson's link_pool (backend_max_links, which the heavy targets set), otherwise they would escape that limit
+	std::unordered_set<std::string> pooledRuleNames;
+	std::string_view ruleName;
+	// The binding is added at the end of a heavy edge's variables, unless they bind a pool already
+	bool isPendingBinding = false;
+	std::size_t heavyEdgeCount = 0;
+	while(contentView.size())
+	{
+		auto endPos = contentView.find('\n');
+		std::string_view line = contentView.substr(0, endPos);
+		contentView.remove_prefix((endPos == std::string_view::npos) ? contentView.size() : (endPos + 1));
+		// Binding of the previous plan
+		if(line == poolBinding)
+			continue;
+		auto indentEndPos = line.find_first_not_of(' ');
+		bool isVariable = indentEndPos != 0 && indentEndPos != std::string_view::npos;
+		bool isPoolVariable = isVariable && line.substr(indentEndPos).starts_with("pool ");
+		if(isPoolVariable && ruleName.size())
+			pooledRuleNames.emplace(ruleName);
+		if(isPendingBinding && (!isVariable || isPoolVariable))
+		{
+			if(!isPoolVariable)
+			{
+				patchedContent.append(poolBinding).push_back('\n');
+				++heavyEdgeCount;
+			}
+			isPendingBinding = false;
+		}
+		patchedContent.append(line).push_back('\n');
+		if(isVariable)
+			continue;
+		ruleName = line.starts_with("rule ") ? line.substr(std::string_view { "rule " }.size()) : std::string_view { };
+		if(outputPaths.empty() || !line.starts_with("build "))
+			continue;
+		auto [output, rule] = ParseBuildStatement(line);
+		isPendingBinding = rule != "phony" && !pooledRuleNames.contains(std::string { rule }) && isHeavyOutput(output);
+	}
+	if(isPendingBinding)
+	{
+		patchedContent.append(poolBinding).push_back('\n');
+		++heavyEdgeCount;
+	}
+	if(WriteTextFileIfChanged(buildNinjaPath, patchedContent) && heavyEdgeCount)
+		spdlog::info("{} compile/link jobs of the heavy targets are limited to {} at a time", heavyEdgeCount, plan.heavyJobCount);
+}
@@ -42,15 +42,24 @@ static void EraseCppComments(std::string& str)
 	}
 }
 
-// directory: value passed to --directory flag
-json ParseBuildMasterJson(std::string_view directory)
+json ParseJsonFile(std::string_view filePath)
+{
+	return ParseJsonText(LoadTextFile(filePath));
+}
+
+json ParseJsonText(std::string jsonStr)
 {
-	std::string jsonStr = LoadTextFile(GetBuildMasterJsonFilePath(directory));
 	EraseCppComments(jsonStr);
 	json data = json::parse(jsonStr);
 	return data;
 }
 
+// directory: value passed to --directory flag
+json ParseBuildMasterJson(std::string_view directory)
+{
+	return ParseJsonFile(GetBuildMasterJsonFilePath(directory));
+}
+
 
 template<>
 std::optional<json> GetJsonKeyValueOrNull<json>(const json& jsonObj, std::string_view key)
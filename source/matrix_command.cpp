@@ -0,0 +1,190 @@
+#include <build_master/matrix_command.hpp>
+#include <build_master/meson_build_gen.hpp> // for RegenerateMesonBuildScript()
+#include <build_master/pre_config_script.hpp> // for RunPreConfigScript()
+#include <build_master/artifact_cache.hpp> // for PreparePrebuiltDependencies()
+#include <build_master/dependency_probe.hpp> // for ProbeDependencies()
+#include <build_master/job_planner.hpp> // for PlanBuildJobs(), and ApplyJobPlan()
+#include <build_master/process.hpp> // for RunProcess()
+#include <build_master/json_parse.hpp> // for ParseBuildMasterJson(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), and SelectPath()
+
+#include <iostream>
+#include <cstdlib>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+#include <invoke/invoke.hpp> // for invoke::FindExecutable()
+
+static constexpr std::string_view gMesonExecutableName = "build_master_meson";
+static constexpr std::string_view gMatrixLogsDirPath = ".build_master/matrix";
+
+enum class ConfigurationStatus
+{
+	Ok,
+	SetupFail,
+	BuildFail
+};
+
+struct Configuration
+{
+	std::string name;
+	std::vector<std::string> options;
+	// Relative to the --directory flag's value (if not absolute)
+	std::string buildDirectory;
+	ConfigurationStatus status { ConfigurationStatus::Ok };
+	// In seconds
+	double setupTime { 0 };
+	double buildTime { 0 };
+	unsigned int jobCount { 0 };
+	std::string logFilePath;
+};
+
+static std::vector<Configuration> LoadConfigurations(std::string_view directory, const std::vector<std::string>& names)
+{
+	json buildMasterJson = ParseBuildMasterJson(directory);
+	auto it = buildMasterJson.find("configurations");
+	if(it == buildMasterJson.end() || !it.value().is_array() || it.value().empty())
+	{
+		spdlog::error("No \"configurations\" in build_master.json, e.g. \"configurations\" : [ {{ \"name\" : \"release\", \"options\" : [ \"--buildtype=release\" ] }} ]");
+		exit(EXIT_FAILURE);
+	}
+	std::vector<Configuration> configurations;
+	std::unordered_set<std::string> buildDirectories;
+	for(const auto& configurationJson : it.value())
+	{
+		Configuration configuration;
+		configuration.name = GetJsonKeyValue<std::string>(configurationJson, "name");
+		configuration.options = GetJsonKeyValue<std::vector<std::string>>(configurationJson, "options", std::vector<std::string> { });
+		configuration.buildDirectory = GetJsonKeyValue<std::string>(configurationJson, "build_directory", std::format("build-{}", configuration.name));
+		// Two configurations can't be built in the same directory at the same time
+		if(!buildDirectories.insert(configuration.buildDirectory).second)
+		{
+			spdlog::error("Build directory {} is used by more than one configuration", configuration.buildDirectory);
+			exit(EXIT_FAILURE);
+		}
+		if(names.empty() || std::ranges::find(names, configuration.name) != names.end())
+			configurations.push_back(std::move(configuration));
+	}
+	for(const auto& name : names)
+		if(std::ranges::none_of(configurations, [&name](const Configuration& configuration) { return configuration.name == name; }))
+		{
+			spdlog::error("No such configuration: {}", name);
+			exit(EXIT_FAILURE);
+		}
+	return configurations;
+}
+
+static std::string_view GetStatusStr(ConfigurationStatus status)
+{
+	switch(status)
+	{
+		case ConfigurationStatus::Ok: return "PASS";
+		case ConfigurationStatus::SetupFail: return "FAIL (setup)";
+		case ConfigurationStatus::BuildFail: return "FAIL (build)";
+	}
+	return "";
+}
+
+// Runs meson, with its output written into the log file
+// Returns wall time of meson in seconds, or a negative value if it has failed
+static double RunMesonLogged(const std::string& mesonPath, std::string_view directory, std::vector<std::string> args, const std::string& logFilePath)
+{
+	args.insert(args.begin(), mesonPath);
+	ProcessResult result = RunProcess(args, directory, { }, logFilePath);
+	return (result.exitCode == 0) ? result.wallTime : -result.wallTime - 1e-9;
+}
+
+// directory: value passed to --directory flag
+int RunMatrix(std::string_view directory, const MatrixCommandArgs& args)
+{
+	std::vector<Configuration> configurations = LoadConfigurations(directory, args.configurationNames);
+	auto mesonPaths = invoke::FindExecutable(gMesonExecutableName);
+	if(!mesonPaths)
+	{
+		spdlog::error("Couldn't find paths for the executable: {}", gMesonExecutableName);
+		exit(EXIT_FAILURE);
+	}
+	std::string mesonPath = SelectPath(mesonPaths.value());
+
+	// Same as 'build_master meson setup', but done once for all of the configurations
+	RegenerateMesonBuildScript(directory);
+	PreparePrebuiltDependencies(directory, true);
+	RunPreConfigScript(directory);
+	ProbeDependencies(directory);
+
+	// The job budget is shared by the configurations, each one gets its (near) equal share, and its share of the heavy jobs too
+	JobPlan plan = PlanBuildJobs(directory, GetPathStrRelativeToDir(directory, configurations.front().buildDirectory), args.jobCount);
+	unsigned int totalJobCount = plan.jobCount ? plan.jobCount : std::max(std::thread::hardware_concurrency(), 1u);
+	unsigned int configurationCount = static_cast<unsigned int>(configurations.size());
+	for(unsigned int i = 0; i < configurationCount; ++i)
+		configurations[i].jobCount = std::max(totalJobCount / configurationCount + ((i < totalJobCount % configurationCount) ? 1 : 0), 1u);
+	spdlog::info("Building {} configurations with {} jobs in total", configurationCount, totalJobCount);
+
+	// Absolute, as meson runs in the project's directory
+	auto logsDirPath = std::filesystem::absolute(GetPathStrRelativeToDir(directory, gMatrixLogsDirPath));
+	std::filesystem::create_directories(logsDirPath);
+	std::mutex outputMutex;
+	auto startTime = std::chrono::steady_clock::now();
+	{
+		std::vector<std::jthread> workers;
+		for(auto& configuration : configurations)
+			workers.emplace_back([&, &configuration = configuration]()
+			{
+				auto buildDirectory = GetPathStrRelativeToDir(directory, configuration.buildDirectory);
+				// An already configured directory is reconfigured with the options, as the template's documentation does it
+				std::vector<std::string> setupArgs { "setup", configuration.buildDirectory };
+				if(std::filesystem::exists(std::filesystem::path(buildDirectory) / "meson-private" / "coredata.dat"))
+					setupArgs.push_back("--reconfigure");
+				setupArgs.insert(setupArgs.end(), configuration.options.begin(), configuration.options.end());
+				configuration.logFilePath = (logsDirPath / std::format("{}_setup.txt", configuration.name)).string();
+				double setupTime = RunMesonLogged(mesonPath, directory, setupArgs, configuration.logFilePath);
+				configuration.setupTime = std::abs(setupTime);
+				if(setupTime < 0)
+					configuration.status = ConfigurationStatus::SetupFail;
+				else
+				{
+					JobPlan configurationPlan = plan;
+					configurationPlan.jobCount = configuration.jobCount;
+					configurationPlan.heavyJobCount = plan.heavyJobCount ? std::max(plan.heavyJobCount / configurationCount, 1u) : 0;
+					ApplyJobPlan(buildDirectory, configurationPlan);
+					configuration.logFilePath = (logsDirPath / std::format("{}_compile.txt", configuration.name)).string();
+					double buildTime = RunMesonLogged(mesonPath, directory, { "compile", "-C", configuration.buildDirectory, "-j", std::to_string(configuration.jobCount) }, configuration.logFilePath);
+					configuration.buildTime = std::abs(buildTime);
+					if(buildTime < 0)
+						configuration.status = ConfigurationStatus::BuildFail;
+				}
+				std::lock_guard<std::mutex> lock(outputMutex);
+				std::cout << std::format("{:<20} {}\n", configuration.name, GetStatusStr(configuration.status));
+			});
+	}
+	double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	std::size_t nameWidth = std::string_view { "Configuration" }.size();
+	for(const auto& configuration : configurations)
+		nameWidth = std::max(nameWidth, configuration.name.size());
+	std::cout << std::format("\n{:<{}}  {:>5}  {:>9}  {:>9}  {}\n", "Configuration", nameWidth, "Jobs", "Setup", "Build", "Result");
+	std::size_t failCount = 0;
+	double totalTime = 0;
+	for(const auto& configuration : configurations)
+	{
+		std::cout << std::format("{:<{}}  {:>5}  {:>8.2f}s  {:>8.2f}s  {}\n", configuration.name, nameWidth, configuration.jobCount,
+									configuration.setupTime, configuration.buildTime, GetStatusStr(configuration.status));
+		if(configuration.status != ConfigurationStatus::Ok)
+		{
+			std::cout << std::format("{:<{}}  log: {}\n", "", nameWidth, configuration.logFilePath);
+			++failCount;
+		}
+		totalTime += configuration.setupTime + configuration.buildTime;
+	}
+	std::cout << std::format("\nPassed: {}, Failed: {}\n", configurations.size() - failCount, failCount);
+	std::cout << std::format("Total time: {:.2f}s, wall time: {:.2f}s\n", totalTime, wallTime);
+	return failCount ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -1,7 +1,11 @@
+#include <build_master/meson_build_gen.hpp>
 #include <build_master/misc.hpp> // for LoadTextFile(), and GetPathStrRelativeToDir()
 #include <build_master/json_parse.hpp> // for ParseBuildMasterJson(), and GetJsonKeyValue<>()
 #include <build_master/version.hpp>
 #include <build_master/meson_build_template.hpp>
+#include <build_master/dependency_probe.hpp> // for gResolvedDependenciesDirPath
+#include <build_master/output_buffer.hpp>
+#include <build_master/process.hpp> // for RunCmdCaptureOutput()
 
 #include <iostream>
 #include <cstdlib>
@@ -12,12 +16,44 @@
 #include <string_view>
 #include <type_traits>
 #include <fstream>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+#include <set>
+#include <regex>
+#include <thread>
+#include <optional>
+#include <span>
+#include <ranges>
+#include <cctype>
 
 #include <spdlog/spdlog.h>
 
 #include <common/StringUtility.hpp> // for com::string_join()
 
 static constexpr std::string_view gMesonBuildScriptFilePath = "meson.build";
+// Per-target meson.build fragments are generated in this directory (relative to the project's root) if "split_meson_build" is true
+static constexpr std::string_view gTargetScriptsDirPath = ".build_master/targets";
+// Relative path from a per-target fragment's directory to the project's root
+static constexpr std::string_view gTargetScriptToRootPath = "../../../";
+// Touched on every generation in split mode, as the root meson.build may not be rewritten when it is unchanged
+static constexpr std::string_view gGenerationStampFilePath = ".build_master/meson_build.stamp";
+// Exists if meson.build has been generated for 'build_master workspace', then the library targets are registered with meson.override_dependency()
+// It tells RegenerateMesonBuildScript() to regenerate when the project is built on its own again (and vice versa)
+static constexpr std::string_view gWorkspaceMemberStampFilePath = ".build_master/workspace_member.stamp";
+// Values of the environment variables referenced with env:<NAME> are snapshotted into files in this directory, one file per variable
+// The generated meson.build reads them with the fs module, so no process needs to be spawned at the configure time,
+// And meson reconfigures automatically whenever a snapshot file changes.
+static constexpr std::string_view gEnvSnapshotDirPath = ".build_master/env";
+// The first lookup directory of pkg-config is snapshotted into this file, the generated .pc files are installed there if PKG_CONFIG_PATH is empty
+// Same as the environment variables, it is queried at the generation time, so meson doesn't spawn pkg-config at every configure
+static constexpr std::string_view gPkgConfigDirSnapshotFilePath = ".build_master/pkg_config_dir";
+// Value of meson's backend_max_links if any target is heavy and "max_parallel_links" isn't given
+static constexpr unsigned int gDefaultHeavyMaxParallelLinks = 2;
+// Runtime dispatch stubs of the "simd_sources" are generated in this directory, one <target name>_dispatch.c per target
+static constexpr std::string_view gSimdDispatchDirPath = ".build_master/simd";
+// "linker": "auto" tries these in order, the first one which works with the compilers is used
+static constexpr std::string_view gAutoLinkerNames[] = { "mold", "lld", "gold" };
 
 // Use this function whenever you meant to get gMesonBuildScriptFilePath.
 // DO NOT use gMesonBuildScriptFilePath directory as that would not consider the --directory flag 
@@ -27,35 +63,165 @@ static std::string GetMesonBuildScriptFilePath(std::string_view directory = ".")
 }
 
 // directory: value passed to --directory flag
-static bool IsRegenerateMesonBuildScript(std::string_view directory)
+static bool IsRegenerateMesonBuildScript(std::string_view directory, bool isWorkspaceMember)
 {
+	if(std::filesystem::exists(GetPathStrRelativeToDir(directory, gWorkspaceMemberStampFilePath)) != isWorkspaceMember)
+		return true;
 	if(std::filesystem::exists(GetMesonBuildScriptFilePath(directory)))
 	{
 		auto mesonBuildScriptTime = std::filesystem::last_write_time(GetMesonBuildScriptFilePath(directory));
+		// In split mode the root meson.build is only rewritten if its content changes, so the stamp tells the last generation time
+		auto stampFilePath = GetPathStrRelativeToDir(directory, gGenerationStampFilePath);
+		if(std::filesystem::exists(stampFilePath))
+			mesonBuildScriptTime = std::max(mesonBuildScriptTime, std::filesystem::last_write_time(stampFilePath));
 		auto buildMasterJsonTime = std::filesystem::last_write_time(GetBuildMasterJsonFilePath(directory));
 		return buildMasterJsonTime >= mesonBuildScriptTime;
 	}
  	return true;
 }
 
-static std::string LoadMesonBuildScriptTemplate()
+template<typename T, typename ReturnType, typename... Args>
+concept Callable = requires(const T& callable)
 {
-	return std::string { MESON_BUILD_TEMPLATE_STR };
-}
+	{ callable(std::declval<Args>()...) } -> std::convertible_to<ReturnType>;
+};
 
-using TokenTransformCallback = std::function<std::string(std::string_view)>;
+// Writes a single element of a list (in build_master.json) as meson expression into the output buffer
+// Token writers are passed as templates (not std::function), so the calls get inlined and no temporary string is created
+template<typename T>
+concept TokenWriter = Callable<T, void, OutputBuffer&, std::string_view>;
 
 static std::string single_quoted_str(std::string_view str)
 {
 	return std::format("'{}'", str);
 }
 
+// Rebases a quoted literal path (relative to the project's root) so that it becomes relative to a per-target fragment's directory
+// Examples:
+// 'source/main.c' -> '../../../source/main.c'
+// '/usr/include' -> '/usr/include' (absolute paths are kept as is)
+// cuda_path + '/include' -> cuda_path + '/include' (expressions are kept as is)
+static std::string RebaseQuotedPathToTargetScript(std::string_view quotedToken)
+{
+	if(quotedToken.size() < 2 || quotedToken.front() != '\'' || quotedToken.back() != '\'')
+		return std::string { quotedToken };
+	std::string_view path = quotedToken.substr(1, quotedToken.size() - 2);
+	if(path.find('\'') != std::string_view::npos || std::filesystem::path(path).is_absolute() || path.starts_with('/'))
+		return std::string { quotedToken };
+	return std::format("'{}{}'", gTargetScriptToRootPath, path);
+}
+
+// env:CUDA_PATH, and also the python one-liner commonly used to read environment variables in "vars" (it spawns python at every configure)
+// run_command(find_program('python'), '-c', 'import os; print(os.environ["CUDA_PATH"])', check : false).stdout().strip()
+// The regexes are compiled on the first use, as most of the invocations of build_master (--version, meson compile, etc.) never use them
+static const std::regex& GetEnvMetaRegex()
+{
+	static const std::regex regex { R"re((^|[\s(+,])env:([A-Za-z_][A-Za-z0-9_]*))re" };
+	return regex;
+}
+
+static const std::regex& GetPythonEnvReadRegex()
+{
+	static const std::regex regex { R"re(run_command\(\s*find_program\(\s*'python3?'\s*\)\s*,\s*'-c'\s*,\s*'import os; ?print\(os\.environ\["([A-Za-z_][A-Za-z0-9_]*)"\]\)'\s*,\s*check\s*:\s*false\s*\)\.stdout\(\)\.strip\(\))re" };
+	return regex;
+}
+
+// Replaces the environment variable reads with lookups into env_bm_internal__ dictionary (populated from the snapshot files)
+// Returns true if any replacement is made
+// Examples:
+// env:CUDA_PATH -> env_bm_internal__['CUDA_PATH']
+// env:CUDA_PATH + '/include' -> env_bm_internal__['CUDA_PATH'] + '/include'
+static bool ResolveEnvMetaInfo(std::string& str)
+{
+	if(str.find("env:") == std::string::npos && str.find("os.environ") == std::string::npos)
+		return false;
+	std::string result = std::regex_replace(str, GetPythonEnvReadRegex(), "env_bm_internal__['$1']");
+	result = std::regex_replace(result, GetEnvMetaRegex(), "$1env_bm_internal__['$2']");
+	if(result == str)
+		return false;
+	str = std::move(result);
+	return true;
+}
+
+// Collects names of the environment variables read via env:<NAME> (or the python one-liner) anywhere in the json
+static void CollectEnvVarNames(const json& jsonObj, std::set<std::string>& names)
+{
+	if(jsonObj.is_string())
+	{
+		const auto& str = jsonObj.template get_ref<const std::string&>();
+		// Most of the strings are plain paths, no need to run the regex iterators (they allocate) on them
+		if(str.find("env:") == std::string::npos && str.find("os.environ") == std::string::npos)
+			return;
+		for(const auto* regex : { &GetEnvMetaRegex(), &GetPythonEnvReadRegex() })
+			for(auto it = std::sregex_iterator(str.begin(), str.end(), *regex); it != std::sregex_iterator(); ++it)
+				names.insert((*it)[it->size() - 1].str());
+	}
+	else if(jsonObj.is_structured())
+		for(const auto& value : jsonObj)
+			CollectEnvVarNames(value, names);
+}
+
+// Writes the current values of the environment variables into the snapshot files, only the changed ones are rewritten
+// Unset environment variables are written as empty files, which matches the behaviour of the python one-liner (it prints nothing)
+// directory: value passed to --directory flag
+static void WriteEnvSnapshot(std::string_view directory, const std::set<std::string>& names)
+{
+	auto snapshotDirPath = std::filesystem::path(GetPathStrRelativeToDir(directory, gEnvSnapshotDirPath));
+	if(std::filesystem::exists(snapshotDirPath))
+	{
+		for(const auto& entry : std::filesystem::directory_iterator(snapshotDirPath))
+			if(!names.contains(entry.path().filename().string()))
+				std::filesystem::remove(entry.path());
+	}
+	for(const auto& name : names)
+	{
+		const char* value = std::getenv(name.c_str());
+		WriteTextFileIfChanged((snapshotDirPath / name).string(), value ? value : "");
+	}
+}
+
+// Rewrites the existing snapshot files (if any) with the current values of the environment variables
+// directory: value passed to --directory flag
+static void RefreshEnvSnapshot(std::string_view directory)
+{
+	auto snapshotDirPath = std::filesystem::path(GetPathStrRelativeToDir(directory, gEnvSnapshotDirPath));
+	if(!std::filesystem::exists(snapshotDirPath))
+		return;
+	std::set<std::string> names;
+	for(const auto& entry : std::filesystem::directory_iterator(snapshotDirPath))
+		names.insert(entry.path().filename().string());
+	WriteEnvSnapshot(directory, names);
+}
+
+// Writes the first lookup directory of pkg-config into the snapshot file, or removes it if pkg-config can't be run
+// pkg-config is run only if the project has a library target, as the executables don't install .pc files
+// directory: value passed to --directory flag
+static void WritePkgConfigDirSnapshot(std::string_view directory, const json& buildMasterJson)
+{
+	auto snapshotFilePath = GetPathStrRelativeToDir(directory, gPkgConfigDirSnapshotFilePath);
+	bool isLibrary = false;
+	if(auto it = buildMasterJson.find("targets"); it != buildMasterJson.end())
+		isLibrary = std::ranges::any_of(it.value(), [](const json& targetJson) { return DetectTargetType(targetJson) != TargetType::Executable; });
+	std::optional<std::string> pcPath = isLibrary ? RunCmdCaptureOutput({ "pkg-config", "--variable", "pc_path", "pkg-config" }) : std::nullopt;
+	if(!pcPath || pcPath->empty())
+	{
+		std::error_code errorCode;
+		std::filesystem::remove(snapshotFilePath, errorCode);
+		return;
+	}
+	// ':' separated on POSIX (some builds use ';'), ';' separated on Windows where ':' follows the drive letters
+	std::string_view separators = pcPath->starts_with('/') ? ":;" : ";";
+	WriteTextFileIfChanged(snapshotFilePath, pcPath->substr(0, pcPath->find_first_of(separators)));
+}
+
 // Examples: 
 // link_dir: $cuda_lib_path -> '-L' + cuda_lib_path
 // link_dir: 'my/path/to/lib' -> '-L' + 'my/path/to/lib'
 // link_dir: $cuda_lib_path + '/windows_lib_path/' -> '-L' + cuda_lib_path + '/windows/lib_path/'
 // link_dir: $vulkan_sdk_path + $relative_lib_path -> '-L' + vulkan_sdk_path + relative_lib_path
+// link_dir: env:CUDA_LIB_PATH -> '-L' + env_bm_internal__['CUDA_LIB_PATH']
 // $vulkan_sdk_path -> vulkan_sdk_path
+// env:VULKAN_SDK -> env_bm_internal__['VULKAN_SDK']
 // my/path/to/vulkan/sdk -> 'my/path/to/vulkan/sdk'
 static std::string ApplyMetaInfo(std::string_view str)
 {
@@ -70,6 +236,9 @@ static std::string ApplyMetaInfo(std::string_view str)
 		copyStr.erase(index, 1);
 		isDollarSignFound = true;
 	}
+	// Environment variables are treated as variables, as their values are absolute paths too typically
+	if(ResolveEnvMetaInfo(copyStr))
+		isDollarSignFound = true;
 	const std::string_view linkDirStr = "link_dir:";
 	if(copyStr.find(linkDirStr) != std::string::npos)
 	{
@@ -88,68 +257,111 @@ static std::string ApplyMetaInfo(std::string_view str)
 	return copyStr;
 }
 
-static void ProcessStringListElements(const json& jsonObj, std::ostringstream& stream, std::string_view delimit = " ", std::optional<TokenTransformCallback> callback = { }, bool isMetaInfo = true)
+// A literal token is emitted as just a quoted string by ApplyMetaInfo(), so it can be inlined (and checked) at the generation time
+// Examples:
+// source/main.c -> true
+// $gui_sources, env:CUDA_PATH, link_dir:lib -> false
+bool IsLiteralToken(std::string_view str)
 {
-	for(std::size_t i = 0; const auto& value : jsonObj)
+	return str.find_first_of("$'\\") == std::string_view::npos
+		&& str.find("env:") == std::string_view::npos
+		&& str.find("link_dir:") == std::string_view::npos;
+}
+
+// Writes the token as meson expression, see ApplyMetaInfo()
+struct MetaInfoTokenWriter
+{
+	void operator()(OutputBuffer& buffer, std::string_view token) const
 	{
-		const auto& str = value.template get<std::string>();
-		std::string token = isMetaInfo ? ApplyMetaInfo(str) : str;
-		if(callback)
-			token = (*callback)(token);
-		stream << token;
-		if(++i < jsonObj.size())
-			stream << "," << delimit;
+		// Literals are the most common tokens by far, and they are just quoted
+		if(IsLiteralToken(token))
+			buffer << '\'' << token << '\'';
+		else
+			buffer << ApplyMetaInfo(token);
 	}
-}
+};
 
-static void ProcessStringListElements(const json& jsonObj, std::string_view keyName, std::ostringstream& stream, std::string_view delimit = " ", std::optional<TokenTransformCallback> callback = { }, bool isMetaInfo = true)
+// Writes the token as it is, for example, names of the targets in "link_with"
+struct RawTokenWriter
 {
-	auto it = jsonObj.find(keyName);
-	if(it == jsonObj.end())
-		return;
-	ProcessStringListElements(it.value(), stream, delimit, callback, isMetaInfo);
-}
+	void operator()(OutputBuffer& buffer, std::string_view token) const
+	{
+		buffer << token;
+	}
+};
 
-static std::string GetListStringOrEmpty(const json& jsonObj, std::string_view keyName, std::string_view delimit = " ", std::optional<TokenTransformCallback> callback = { })
+// Writes the token as a quoted string, without interpreting any meta info
+struct QuotedTokenWriter
 {
-	std::ostringstream stream;
-	ProcessStringListElements(jsonObj, keyName, stream, delimit, callback);
-	return stream.str();
-}
+	void operator()(OutputBuffer& buffer, std::string_view token) const
+	{
+		buffer << '\'' << token << '\'';
+	}
+};
 
-static void SubstitutePlaceholder(std::string& str, std::string_view placeholderName, std::string_view substitute)
+// Writes the token as meson expression, and rebases the literal paths for per-target fragments, see RebaseQuotedPathToTargetScript()
+struct RebasedPathTokenWriter
 {
-	auto it = str.find(placeholderName);
-	if(it != std::string::npos)
-		str.replace(it, placeholderName.size(), substitute);
-}
+	void operator()(OutputBuffer& buffer, std::string_view token) const
+	{
+		if(IsLiteralToken(token) && !token.starts_with('/') && !std::filesystem::path(token).is_absolute())
+			buffer << '\'' << gTargetScriptToRootPath << token << '\'';
+		else
+			buffer << RebaseQuotedPathToTargetScript(ApplyMetaInfo(token));
+	}
+};
 
-template<typename T, typename ReturnType, typename... Args>
-concept Callable = requires(const T& callable)
+// Wraps the expression written by the inner token writer in dependency() call
+// Example: 'zlib' -> dependency('zlib')
+// If the dependencies are resolved by build_master (see ProbeDependencies()), then only the unresolved ones are looked up by meson:
+// 'zlib' -> ('zlib' in resolved_dependencies_bm_internal__ ? resolved_dependencies_bm_internal__['zlib'] : dependency('zlib'))
+// NOTE: meson evaluates only the chosen branch of the ternary operator
+template<TokenWriter InnerTokenWriter>
+struct DependencyTokenWriter
 {
-	{ callable(std::declval<Args>()...) } -> std::convertible_to<ReturnType>;
+	bool isResolvedDependencies { false };
+	InnerTokenWriter writeToken { };
+
+	void operator()(OutputBuffer& buffer, std::string_view token) const
+	{
+		if(!isResolvedDependencies)
+		{
+			buffer << "dependency(";
+			writeToken(buffer, token);
+			buffer << ')';
+			return;
+		}
+		buffer << '(';
+		writeToken(buffer, token);
+		buffer << " in resolved_dependencies_bm_internal__ ? resolved_dependencies_bm_internal__[";
+		writeToken(buffer, token);
+		buffer << "] : dependency(";
+		writeToken(buffer, token);
+		buffer << "))";
+	}
 };
 
-template<Callable<std::string> Callback>
-static void SubstitutePlaceholder(std::string& str, std::string_view placeholderName, const Callback& callback)
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static void ProcessStringListElements(const json& jsonObj, OutputBuffer& buffer, std::string_view delimit = " ", const Writer& writeToken = { })
 {
-	auto it = str.find(placeholderName);
-	if(it != std::string::npos)
+	for(std::size_t i = 0; const auto& value : jsonObj)
 	{
-		std::string substitute = callback();
-		str.replace(it, placeholderName.size(), substitute);
+		writeToken(buffer, value.template get_ref<const std::string&>());
+		if(++i < jsonObj.size())
+			buffer << ',' << delimit;
 	}
 }
 
-enum class TargetType
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static void ProcessStringListElements(const json& jsonObj, std::string_view keyName, OutputBuffer& buffer, std::string_view delimit = " ", const Writer& writeToken = { })
 {
-	StaticLibrary,
-	SharedLibrary,
-	HeaderOnlyLibrary,
-	Executable
-};
+	auto it = jsonObj.find(keyName);
+	if(it == jsonObj.end())
+		return;
+	ProcessStringListElements(it.value(), buffer, delimit, writeToken);
+}
 
-static TargetType DetectTargetType(const json& targetJson)
+TargetType DetectTargetType(const json& targetJson)
 {
 	auto it = targetJson.find("is_executable");
 	if(it != targetJson.end() && it.value().template get<bool>())
@@ -166,35 +378,61 @@ static TargetType DetectTargetType(const json& targetJson)
 	return TargetType::Executable;
 }
 
-static void ProcessStringList(const json& jsonObj, std::ostringstream& stream, std::string_view delimit = " ", std::optional<TokenTransformCallback> callback = { }, bool isMetaInfo = true)
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static void ProcessStringList(const json& jsonObj, OutputBuffer& buffer, std::string_view delimit = " ", const Writer& writeToken = { })
 {
-	stream << "[\n";
-	ProcessStringListElements(jsonObj, stream, delimit, callback, isMetaInfo);
-	stream << "\n";
-	stream << "]\n";
+	buffer << "[\n";
+	ProcessStringListElements(jsonObj, buffer, delimit, writeToken);
+	buffer << "\n";
+	buffer << "]\n";
 }
 
-static void ProcessStringList(const json& jsonObj, std::string_view keyName, std::ostringstream& stream, std::string_view delimit = " ", std::optional<TokenTransformCallback> callback = { }, bool isMetaInfo = true)
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static void ProcessStringList(const json& jsonObj, std::string_view keyName, OutputBuffer& buffer, std::string_view delimit = " ", const Writer& writeToken = { })
 {
-	stream << "[\n";
-	ProcessStringListElements(jsonObj, keyName, stream, delimit, callback, isMetaInfo);
-	stream << "\n";
-	stream << "]\n";
+	buffer << "[\n";
+	ProcessStringListElements(jsonObj, keyName, buffer, delimit, writeToken);
+	buffer << "\n";
+	buffer << "]\n";
 }
 
-static std::vector<std::string_view> gPlatformNames = 
+static constexpr std::string_view gPlatformNames[] =
 {
 	"windows",
 	"linux",
 	"darwin"
 };
 
-static void ProcessStringListDeclare(const json& targetJson, std::ostringstream& stream, std::string_view listName, std::string_view suffix, std::optional<TokenTransformCallback> callback = { })
+#ifdef _WIN32
+static constexpr std::string_view gHostPlatformName = "windows";
+#elif defined(__APPLE__)
+static constexpr std::string_view gHostPlatformName = "darwin";
+#else
+static constexpr std::string_view gHostPlatformName = "linux";
+#endif
+
+// Names of the platform specific lists are formatted into a stack buffer, they are looked up for every list of every target
+// Example: ("linux", "sources") -> "linux_sources"
+class PlatformListName
 {
-	std::string name = GetJsonKeyValue<std::string>(targetJson, "name");
-	auto suffixedListName = com::string_join(name, suffix);
-	stream << suffixedListName << " = ";
-	ProcessStringList(targetJson, listName, stream, "\n", callback);
+private:
+	char m_buffer[64];
+	std::size_t m_size;
+
+public:
+	PlatformListName(std::string_view platformName, std::string_view listName)
+	{
+		m_size = std::min<std::size_t>(std::format_to_n(m_buffer, sizeof(m_buffer), "{}_{}", platformName, listName).size, sizeof(m_buffer));
+	}
+
+	std::string_view View() const noexcept { return { m_buffer, m_size }; }
+};
+
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static void ProcessStringListDeclare(const json& targetJson, OutputBuffer& buffer, std::string_view listName, std::string_view suffixedListName, const Writer& writeToken = { })
+{
+	buffer << suffixedListName << " = ";
+	ProcessStringList(targetJson, listName, buffer, "\n", writeToken);
 
 	// Generate platform specific code
 	// It should be as follows:
@@ -212,23 +450,23 @@ static void ProcessStringListDeclare(const json& targetJson, std::ostringstream&
 	bool ifStarted = false;
 	for(const auto& platformName : gPlatformNames)
 	{
-		auto platformSpecificListName = com::string_join(platformName, "_", listName);
-		if(HasJsonKey(targetJson, platformSpecificListName))
+		PlatformListName platformSpecificListName { platformName, listName };
+		if(HasJsonKey(targetJson, platformSpecificListName.View()))
 		{
 			if(ifStarted)
-				stream << "elif";
+				buffer << "elif";
 			else
 			{
-				stream << "if";
+				buffer << "if";
 				ifStarted = true;
 			}
-			stream << " os_name_bm_internal__ == " << single_quoted_str(platformName) << "\n";
-			stream << "\t" << suffixedListName << " += ";
-			ProcessStringList(targetJson, platformSpecificListName, stream, "\n", callback);
+			buffer << " os_name_bm_internal__ == '" << platformName << "'\n";
+			buffer << "\t" << suffixedListName << " += ";
+			ProcessStringList(targetJson, platformSpecificListName.View(), buffer, "\n", writeToken);
 		}
 	}
 	if(ifStarted)
-		stream << "endif\n";
+		buffer << "endif\n";
 }
 
 static constexpr std::string_view GetTargetTypeStr(TargetType targetType)
@@ -247,163 +485,589 @@ struct ProjectMetaInfo
 {
 	std::string name;
 	std::string description;
+	// true if "dependency_probe_cache" is true, then dependencies are first looked up in the ones resolved by build_master
+	bool isResolvedDependencies { false };
+	// true if "dev_fast_link" is true, then the static libraries are built as shared libraries in the non-release builds, see $$dev_fast_link$$
+	bool isDevFastLink { false };
+	// true if generating for 'build_master workspace', then the library targets are registered with meson.override_dependency()
+	bool isWorkspaceMember { false };
 };
 
-struct VarSuffixData
+// Name of a variable holding a list: <target name><suffix>, it is kept in two parts so that it doesn't need to be allocated
+// Both point into the target's json (or are literals), empty if the list is empty (it isn't declared then)
+struct ListVarName
 {
-	std::string_view sources;
-	std::string_view dependencies;
-	std::string_view linkArgs;
-	std::string_view includeDirs;
-	std::string_view platformSpecificSources;
-	std::string_view buildDefines;
-	std::string_view useDefines;
+	std::string_view targetName { };
+	std::string_view suffix { };
 };
 
+// Names of the variables holding the lists of a target
+// NOTE: a variable may have been declared by another target with identical list, see ListPool
+struct TargetListVars
+{
+	ListVarName sources;
+	ListVarName dependencies;
+	// dictionary indexed with the platform name
+	ListVarName linkArgs;
+	ListVarName includeDirs;
+	// dictionary indexed with the platform name
+	ListVarName platformSpecificSources;
+	ListVarName buildDefines;
+	ListVarName useDefines;
+	// Sources of the "simd_sources" to compile into the target (the dispatch stub, or the plain files if there is no dispatch)
+	ListVarName simdSources;
+	// Objects of the per instruction set variants of the "simd_sources"
+	ListVarName simdObjects;
+};
+
+static OutputBuffer& operator<<(OutputBuffer& buffer, const ListVarName& varName)
+{
+	return buffer << varName.targetName << varName.suffix;
+}
+
+// Operand of a list expression in a target's declaration
+struct ListExpr
+{
+	ListVarName varName;
+	// true if the variable holds a dictionary indexed with the platform name
+	bool isPlatformDict { false };
+};
+
+// Writes the non-empty list expressions concatenated with '+', or '[]' if all are empty
+static void WriteListExprs(OutputBuffer& buffer, std::initializer_list<ListExpr> exprs)
+{
+	bool isEmpty = true;
+	for(const auto& expr : exprs)
+	{
+		if(expr.varName.targetName.empty())
+			continue;
+		if(!isEmpty)
+			buffer << " + ";
+		buffer << expr.varName;
+		if(expr.isPlatformDict)
+			buffer << "[host_machine.system()]";
+		isEmpty = false;
+	}
+	if(isEmpty)
+		buffer << "[]";
+}
+
+// Writes ", <include dirs var>" if the target has include directories, see ProcessTarget()
+static void WriteIncludeDirsVar(OutputBuffer& buffer, const ListVarName& includeDirsVar)
+{
+	if(includeDirsVar.targetName.size())
+		buffer << ", " << includeDirsVar;
+}
+
+// Example:
+// test('main_test', main_test, args: ['--verbose'], timeout: 60, is_parallel: false)
+static void ProcessTestTarget(const json& targetJson, OutputBuffer& buffer, std::string_view name)
+{
+	buffer.Format("test('{}', {}", name, name);
+	if(HasJsonKey(targetJson, "test_args"))
+	{
+		buffer << ", args: ";
+		ProcessStringList(targetJson, "test_args", buffer);
+	}
+	if(auto timeout = GetJsonKeyValueOrNull<int>(targetJson, "test_timeout"))
+		buffer.Format(", timeout: {}", timeout.value());
+	// Exclusive tests don't run in parallel with any other test
+	bool isParallel = GetJsonKeyValue<bool>(targetJson, "is_parallel", true) && !GetJsonKeyValue<bool>(targetJson, "exclusive", false);
+	buffer.Format(", is_parallel: {})\n", isParallel ? "true" : "false");
+}
+
+// Example:
+// benchmark('main_bench', main_bench, args: ['--benchmark_format=json'], timeout: 600)
+// NOTE: meson runs the benchmarks one by one, so is_parallel isn't needed here
+static void ProcessBenchmarkTarget(const json& targetJson, OutputBuffer& buffer, std::string_view name)
+{
+	buffer.Format("benchmark('{}', {}", name, name);
+	if(HasJsonKey(targetJson, "bench_args"))
+	{
+		buffer << ", args: ";
+		ProcessStringList(targetJson, "bench_args", buffer);
+	}
+	if(auto timeout = GetJsonKeyValueOrNull<int>(targetJson, "bench_timeout"))
+		buffer.Format(", timeout: {}", timeout.value());
+	buffer << ")\n";
+}
+
+// Returns the string value of the key, or the default value if the key doesn't exist, without copying the string
+static std::string_view GetJsonStringView(const json& jsonObj, std::string_view key, std::string_view defaultValue)
+{
+	if(auto it = jsonObj.find(key); it != jsonObj.end())
+		return it.value().template get_ref<const std::string&>();
+	return defaultValue;
+}
+
+// Instruction sets the "simd_sources" can be compiled for, in the ascending order of capability
+// { name in build_master.json (which is also the name __builtin_cpu_supports() takes), compiler flag }
+static constexpr std::pair<std::string_view, std::string_view> gSimdIsas[] =
+{
+	{ "sse2", "-msse2" },
+	{ "sse3", "-msse3" },
+	{ "ssse3", "-mssse3" },
+	{ "sse4.1", "-msse4.1" },
+	{ "sse4.2", "-msse4.2" },
+	{ "avx", "-mavx" },
+	{ "avx2", "-mavx2" },
+	{ "avx512f", "-mavx512f" },
+	{ "avx512vl", "-mavx512vl" },
+	{ "avx512bw", "-mavx512bw" },
+	{ "avx512dq", "-mavx512dq" }
+};
+
+// Suffix of the symbols (and the static library) of the variant compiled without any instruction set flag
+static constexpr std::string_view gSimdBaselineSuffix = "baseline";
+
+// Returns suffix of the symbols (and the static library) of the variant compiled for the instruction set
+// Example: sse4.2 -> sse4_2
+static std::string GetSimdSuffix(std::string_view isaName)
+{
+	std::string suffix { isaName };
+	std::ranges::replace(suffix, '.', '_');
+	return suffix;
+}
+
+static bool IsCIdentifier(std::string_view str)
+{
+	return !str.empty() && !std::isdigit(static_cast<unsigned char>(str.front()))
+		&& std::ranges::all_of(str, [](char ch) { return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_'; });
+}
+
+// Returns indices (into gSimdIsas) of the instruction sets of the target's "simd_sources", in the ascending order of capability
+// Throws ProjectModelError if "simd_sources" is malformed
+// Example:
+// "simd_sources": { "files": [ "src/dot.c" ], "isa": [ "sse4.2", "avx2", "avx512f" ], "functions": [ "dot_product" ] }
+static std::vector<std::size_t> ParseSimdSources(const json& targetJson, const json& simdJson)
+{
+	const std::string& name = targetJson.at("name").template get_ref<const std::string&>();
+	auto isNonEmptyList = [&simdJson](std::string_view key)
+	{
+		auto it = simdJson.find(key);
+		return it != simdJson.end() && it->is_array() && !it->empty();
+	};
+	for(std::string_view key : { "files", "isa", "functions" })
+	{
+		if(!simdJson.is_object() || !isNonEmptyList(key))
+		{
+			throw ProjectModelError(std::format("\"simd_sources\" of the target '{}' must have a non-empty \"{}\" list", name, key));
+		}
+	}
+	if(DetectTargetType(targetJson) == TargetType::HeaderOnlyLibrary)
+	{
+		throw ProjectModelError(std::format("Header only library '{}' can't have \"simd_sources\", as it has nothing to link them into", name));
+	}
+	std::vector<std::size_t> isaIndices;
+	for(const auto& value : simdJson.at("isa"))
+	{
+		const std::string& isaName = value.template get_ref<const std::string&>();
+		auto it = std::ranges::find(gSimdIsas, std::string_view { isaName }, &std::pair<std::string_view, std::string_view>::first);
+		if(it == std::end(gSimdIsas))
+		{
+			std::string isaNames;
+			for(const auto& isa : gSimdIsas)
+				isaNames.append(isaNames.empty() ? "" : ", ").append(isa.first);
+			throw ProjectModelError(std::format("Unknown instruction set '{}' in \"simd_sources\" of the target '{}', the supported ones are: {}", isaName, name, isaNames));
+		}
+		isaIndices.push_back(static_cast<std::size_t>(std::distance(std::begin(gSimdIsas), it)));
+	}
+	std::ranges::sort(isaIndices);
+	auto duplicates = std::ranges::unique(isaIndices);
+	isaIndices.erase(duplicates.begin(), duplicates.end());
+	// The functions are renamed with -D<name>=<name>_<suffix>, and resolved by their plain names in the dispatch stub
+	for(const auto& value : simdJson.at("functions"))
+	{
+		const std::string& functionName = value.template get_ref<const std::string&>();
+		if(!IsCIdentifier(functionName))
+		{
+			throw ProjectModelError(std::format("'{}' in \"functions\" of \"simd_sources\" of the target '{}' is not a C identifier", functionName, name));
+		}
+	}
+	return isaIndices;
+}
+
+// Writes the dispatch stub of the target's "simd_sources", each function resolves (via ifunc, once when the binary is loaded)
+// to the variant compiled for the most capable instruction set the CPU supports, or the baseline variant.
+// The functions must have C linkage and take no arguments to be declared here, however, the actual signatures don't matter to the resolution.
+// Example:
+// extern void dot_product_baseline(void);
+// extern void dot_product_avx2(void);
+// static simd_function_bm_internal__ dot_product_resolver_bm_internal__(void)
+// {
+// 	__builtin_cpu_init();
+// 	if(__builtin_cpu_supports("avx2"))
+// 		return dot_product_avx2;
+// 	return dot_product_baseline;
+// }
+// void dot_product(void) __attribute__((ifunc("dot_product_resolver_bm_internal__")));
+static void WriteSimdDispatchStub(OutputBuffer& buffer, const json& targetJson, const json& simdJson)
+{
+	std::vector<std::size_t> isaIndices = ParseSimdSources(targetJson, simdJson);
+	// Exported from the shared libraries, the variants are hidden like the rest of the target's symbols
+	bool isShared = DetectTargetType(targetJson) == TargetType::SharedLibrary;
+	buffer.Format("//------------- Generated By Build Master {} ------------------\n", BUILDMASTER_VERSION_STRING);
+	buffer.Format("// Runtime dispatch of \"simd_sources\" of the target '{}'\n\n", targetJson.at("name").template get_ref<const std::string&>());
+	buffer << "typedef void (*simd_function_bm_internal__)(void);\n";
+	for(const auto& value : simdJson.at("functions"))
+	{
+		const std::string& functionName = value.template get_ref<const std::string&>();
+		buffer << '\n';
+		buffer.Format("extern void {}_{}(void);\n", functionName, gSimdBaselineSuffix);
+		for(std::size_t isaIndex : isaIndices)
+			buffer.Format("extern void {}_{}(void);\n", functionName, GetSimdSuffix(gSimdIsas[isaIndex].first));
+		buffer.Format("static simd_function_bm_internal__ {}_resolver_bm_internal__(void)\n", functionName);
+		buffer << "{\n";
+		buffer << "\t__builtin_cpu_init();\n";
+		for(std::size_t isaIndex : isaIndices | std::views::reverse)
+		{
+			buffer.Format("\tif(__builtin_cpu_supports(\"{}\"))\n", gSimdIsas[isaIndex].first);
+			buffer.Format("\t\treturn {}_{};\n", functionName, GetSimdSuffix(gSimdIsas[isaIndex].first));
+		}
+		buffer.Format("\treturn {}_{};\n", functionName, gSimdBaselineSuffix);
+		buffer << "}\n";
+		buffer.Format("{}void {}(void) __attribute__((ifunc(\"{}_resolver_bm_internal__\")));\n",
+						isShared ? "__attribute__((visibility(\"default\"))) " : "", functionName, functionName);
+	}
+}
+
+// Compiles the target's "simd_sources" once per instruction set (and once without any) into static libraries,
+// with the functions renamed with the variant's suffix, and adds their objects and the dispatch stub to the target (see WriteSimdDispatchStub()).
+// Where the dispatch isn't possible (not x86, or no ifunc support), the files are compiled into the target as they are.
+// Example:
+// # SIMD variants (see "simd_sources" in build_master.json)
+// main_simd_files_bm_internal__ = ['src/dot.c']
+// main_simd_objects_bm_internal__ = []
+// if simd_dispatch_bm_internal__
+// 	main_simd_sources_bm_internal__ = ['.build_master/simd/main_dispatch.c']
+// 	main_simd_avx2_bm_internal__ = static_library('main_simd_avx2', main_simd_files_bm_internal__,
+// 	...
+// 	c_args: main_defines_bm_internal__ + project_build_mode_defines_bm_internal__ + ['-mavx2', '-Ddot_product=dot_product_avx2'],
+// 	...)
+// 	main_simd_objects_bm_internal__ += main_simd_avx2_bm_internal__.extract_all_objects(recursive: false)
+// else
+// 	main_simd_sources_bm_internal__ = main_simd_files_bm_internal__
+// endif
+template<TokenWriter PathTokenWriter>
+static void ProcessSimdSources(const json& targetJson, const json& simdJson, OutputBuffer& buffer, TargetType targetType, TargetListVars& listVars, const PathTokenWriter& writePathToken)
+{
+	std::vector<std::size_t> isaIndices = ParseSimdSources(targetJson, simdJson);
+	const std::string& name = targetJson.at("name").template get_ref<const std::string&>();
+	bool isBenchmark = (targetType == TargetType::Executable) && GetJsonKeyValue<bool>(targetJson, "is_benchmark", false);
+	std::string_view buildModeDefines = isBenchmark ? "benchmark_defines_bm_internal__" : "project_build_mode_defines_bm_internal__";
+	buffer << "# SIMD variants (see \"simd_sources\" in build_master.json)\n";
+	buffer << name << "_simd_files_bm_internal__ = ";
+	ProcessStringList(simdJson, "files", buffer, "\n", writePathToken);
+	buffer << name << "_simd_objects_bm_internal__ = []\n";
+	buffer << "if simd_dispatch_bm_internal__\n";
+	buffer << "\t" << name << "_simd_sources_bm_internal__ = [";
+	writePathToken(buffer, std::format("{}/{}_dispatch.c", gSimdDispatchDirPath, name));
+	buffer << "]\n";
+	auto writeVariant = [&](std::string_view suffix, std::string_view isaFlag)
+	{
+		buffer.Format("\t{0}_simd_{1}_bm_internal__ = static_library('{0}_simd_{1}', {0}_simd_files_bm_internal__", name, suffix);
+		buffer << ",\n\tdependencies: ";
+		WriteListExprs(buffer, { { "dependencies_bm_internal__" }, { listVars.dependencies } });
+		buffer << ",\n\tinclude_directories: [inc_bm_internal__";
+		WriteIncludeDirsVar(buffer, listVars.includeDirs);
+		buffer << "]";
+		for(std::string_view argsName : { "c_args", "cpp_args" })
+		{
+			buffer << ",\n\t" << argsName << ": ";
+			WriteListExprs(buffer, { { listVars.buildDefines }, { buildModeDefines } });
+			buffer << " + [";
+			if(isaFlag.size())
+				buffer << '\'' << isaFlag << "', ";
+			ProcessStringListElements(simdJson, "functions", buffer, " ", [suffix](OutputBuffer& buffer, std::string_view functionName)
+			{
+				buffer.Format("'-D{0}={0}_{1}'", functionName, suffix);
+			});
+			buffer << "]";
+		}
+		if(isBenchmark)
+			buffer << ",\n\toverride_options: ['optimization=3', 'debug=false']";
+		buffer << ",\n\tgnu_symbol_visibility: 'hidden'";
+		buffer << ")\n";
+		buffer.Format("\t{0}_simd_objects_bm_internal__ += {0}_simd_{1}_bm_internal__.extract_all_objects(recursive: false)\n", name, suffix);
+	};
+	writeVariant(gSimdBaselineSuffix, "");
+	for(std::size_t isaIndex : isaIndices)
+		writeVariant(GetSimdSuffix(gSimdIsas[isaIndex].first), gSimdIsas[isaIndex].second);
+	buffer << "else\n";
+	buffer.Format("\t{0}_simd_sources_bm_internal__ = {0}_simd_files_bm_internal__\n", name);
+	buffer << "endif\n";
+	listVars.simdSources = { name, "_simd_sources_bm_internal__" };
+	listVars.simdObjects = { name, "_simd_objects_bm_internal__" };
+}
+
 static void ProcessTarget(const json& targetJson, 
-							std::ostringstream& stream,
+							OutputBuffer& buffer,
 							TargetType targetType,
 							ProjectMetaInfo& projMetaInfo,
-							VarSuffixData& suffixData)
+							TargetListVars& listVars)
 {
-	std::string name = GetJsonKeyValue<std::string>(targetJson, "name");
+	const std::string& name = targetJson.at("name").template get_ref<const std::string&>();
 	// Libraries have is_install set to true by default
 	// Executables have is_install set to false by default
 	bool isInstall = GetJsonKeyValue<bool>(targetJson, "is_install", (targetType == TargetType::Executable) ? false : true);
+	bool isBenchmark = (targetType == TargetType::Executable) && GetJsonKeyValue<bool>(targetJson, "is_benchmark", false);
+	// The build type is only known to meson, so the type of the library is chosen by meson (build_target() is the same as static_library() in the release builds)
+	bool isFastLinkLibrary = projMetaInfo.isDevFastLink && (targetType == TargetType::StaticLibrary);
 	if(targetType != TargetType::HeaderOnlyLibrary)
 	{
-		std::string_view targetTypeStr = GetTargetTypeStr(targetType);
-		stream << std::format("{} = {}('{}'", name, targetTypeStr, name);
-		stream << std::format(",\n\t{}{} + {}{}[host_machine.system()] + sources_bm_internal__", name, suffixData.sources, name, suffixData.platformSpecificSources);
-		stream << std::format(",\n\tdependencies: dependencies_bm_internal__ + {}{}", name, suffixData.dependencies);
+		std::string_view targetTypeStr = isFastLinkLibrary ? "build_target" : GetTargetTypeStr(targetType);
+		buffer.Format("{} = {}('{}'", name, targetTypeStr, name);
+		buffer << ",\n\t";
+		WriteListExprs(buffer, { { listVars.sources }, { listVars.platformSpecificSources, true }, { "sources_bm_internal__" }, { listVars.simdSources } });
+		if(listVars.simdObjects.targetName.size())
+			buffer << ",\n\tobjects: " << listVars.simdObjects;
+		buffer << ",\n\tdependencies: ";
+		WriteListExprs(buffer, { { "dependencies_bm_internal__" }, { listVars.dependencies } });
 		// NOTE: include_directies([...]) + include_directories([...]) is not possible in meson
 		// So we need to use arrays to combine them
-		stream << std::format(",\n\tinclude_directories: [inc_bm_internal__, {}{}]", name, suffixData.includeDirs);
-		stream << std::format(",\n\tinstall: {}", isInstall ? "true" : "false");
+		buffer << ",\n\tinclude_directories: [inc_bm_internal__";
+		WriteIncludeDirsVar(buffer, listVars.includeDirs);
+		buffer << "]";
+		buffer.Format(",\n\tinstall: {}", isInstall ? "true" : "false");
 		if(targetType != TargetType::Executable)
 		{
-			stream << ",\n\tinstall_dir: lib_install_dir_bm_internal__";
-			stream << std::format(",\n\tc_args: {}{} + project_build_mode_defines_bm_internal__", name, suffixData.buildDefines);
-			stream << std::format(",\n\tcpp_args: {}{} + project_build_mode_defines_bm_internal__", name, suffixData.buildDefines);
+			buffer << ",\n\tinstall_dir: lib_install_dir_bm_internal__";
+			buffer << ",\n\tc_args: ";
+			WriteListExprs(buffer, { { listVars.buildDefines }, { "project_build_mode_defines_bm_internal__" } });
+			buffer << ",\n\tcpp_args: ";
+			WriteListExprs(buffer, { { listVars.buildDefines }, { "project_build_mode_defines_bm_internal__" } });
 		}
 		else
 		{
-			stream << std::format(",\n\tc_args: {}{} + project_build_mode_defines_bm_internal__", name, suffixData.buildDefines);
-			stream << std::format(",\n\tcpp_args: {}{} + project_build_mode_defines_bm_internal__", name, suffixData.buildDefines);
+			// Benchmarks are always optimized and built with the release defines, whatever the buildtype of the build directory is
+			std::string_view buildModeDefines = isBenchmark ? "benchmark_defines_bm_internal__" : "project_build_mode_defines_bm_internal__";
+			buffer << ",\n\tc_args: ";
+			WriteListExprs(buffer, { { listVars.buildDefines }, { buildModeDefines } });
+			buffer << ",\n\tcpp_args: ";
+			WriteListExprs(buffer, { { listVars.buildDefines }, { buildModeDefines } });
+			if(isBenchmark)
+				buffer << ",\n\toverride_options: ['optimization=3', 'debug=false']";
+		}
+		buffer << ", \n\tlink_args: ";
+		WriteListExprs(buffer, { { listVars.linkArgs, true } });
+		if(auto it = targetJson.find("link_with"); it != targetJson.end())
+		{
+			buffer << ", \n\tlink_with: ";
+			ProcessStringList(it.value(), buffer, " ", RawTokenWriter { });
 		}
-		stream << std::format(", \n\tlink_args: {}{}[host_machine.system()]", name, suffixData.linkArgs);
-		if(auto listJson = GetJsonKeyValueOrNull<json>(targetJson, "link_with"))
+		if(isFastLinkLibrary)
 		{
-			stream << ", \n\tlink_with: ";
-			ProcessStringList(listJson.value(), stream, " ", { }, false);
+			// A shared library with hidden symbols would export nothing to the targets linking with it
+			buffer << ",\n\ttarget_type: dev_fast_link_bm_internal__ ? 'shared_library' : 'static_library'";
+			buffer << ",\n\tgnu_symbol_visibility: dev_fast_link_bm_internal__ ? 'default' : 'hidden'";
 		}
-		stream << ",\n\tgnu_symbol_visibility: 'hidden'";
-		stream << "\n)\n";
+		else
+			buffer << ",\n\tgnu_symbol_visibility: 'hidden'";
+		if(projMetaInfo.isDevFastLink)
+			buffer << ",\n\tinstall_rpath: dev_fast_link_install_rpath_bm_internal__";
+		buffer << "\n)\n";
 	}
 
+	if(targetType == TargetType::Executable && GetJsonKeyValue<bool>(targetJson, "is_test", false))
+		ProcessTestTarget(targetJson, buffer, name);
+	if(isBenchmark)
+		ProcessBenchmarkTarget(targetJson, buffer, name);
+
 	if(targetType != TargetType::Executable)
 	{
-		stream << std::format("{}_dep = declare_dependency(\n", name);
+		buffer.Format("{}_dep = declare_dependency(\n", name);
 		if(targetType != TargetType::HeaderOnlyLibrary)
-			stream << "\tlink_with: " << name << ",\n";
-		stream << std::format("\tinclude_directories: [inc_bm_internal__, {}{}],\n", name, suffixData.includeDirs);
-		stream << std::format("\tcompile_args: {}{} + project_build_mode_defines_bm_internal__\n", name, suffixData.useDefines);
-		stream << ")\n";
+			buffer << "\tlink_with: " << name << ",\n";
+		buffer << "\tinclude_directories: [inc_bm_internal__";
+		WriteIncludeDirsVar(buffer, listVars.includeDirs);
+		buffer << "],\n";
+		buffer << "\tcompile_args: ";
+		WriteListExprs(buffer, { { listVars.useDefines }, { "project_build_mode_defines_bm_internal__" } });
+		buffer << "\n)\n";
+		// dependency('<name>') in the other projects of a workspace resolves to this target instead of the installed .pc file
+		if(projMetaInfo.isWorkspaceMember)
+			buffer.Format("meson.override_dependency('{}', {}_dep)\n", name, name);
 		if(isInstall)
 		{
-			stream << "pkgmod.generate(";
+			buffer << "pkgmod.generate(";
 			if(targetType != TargetType::HeaderOnlyLibrary)
-				stream << name << ",\n";
-			stream << "\tname: " << single_quoted_str(GetJsonKeyValue<std::string>(targetJson, "friendly_name", projMetaInfo.name)) << ",\n";
-			stream << "\tdescription: " << single_quoted_str(GetJsonKeyValue<std::string>(targetJson, "description", projMetaInfo.description)) << ",\n";
-			stream << "\tfilebase: " << single_quoted_str(name) << ",\n";
-			stream << "\tinstall_dir: pkgconfig_install_path_bm_internal__,\n";
+				buffer << name << ",\n";
+			buffer.Format("\tname: '{}',\n", GetJsonStringView(targetJson, "friendly_name", projMetaInfo.name));
+			buffer.Format("\tdescription: '{}',\n", GetJsonStringView(targetJson, "description", projMetaInfo.description));
+			buffer.Format("\tfilebase: '{}',\n", name);
+			buffer << "\tinstall_dir: pkgconfig_install_path_bm_internal__,\n";
 			if(targetType == TargetType::HeaderOnlyLibrary)
 			{
-				stream << "\tsubdirs: ";
-				ProcessStringList(targetJson, "subdirs", stream);
-				stream << ", ";
+				buffer << "\tsubdirs: ";
+				ProcessStringList(targetJson, "subdirs", buffer);
+				buffer << ", ";
 			}
-			stream << std::format("\textra_cflags: {}{} + project_build_mode_defines_bm_internal__\n", name, suffixData.useDefines);
-			stream << ")\n";
+			buffer << "\textra_cflags: ";
+			WriteListExprs(buffer, { { listVars.useDefines }, { "project_build_mode_defines_bm_internal__" } });
+			buffer << "\n)\n";
 		}
 	}
 }
 
-static void ProcessStringListDict(const json& jsonObj, const std::vector<std::pair<std::string_view, std::string_view>>& jsonKeys, std::ostringstream& stream, const std::string_view delimit = " ", std::optional<TokenTransformCallback> callback = { })
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static void ProcessStringListDict(const json& jsonObj, std::span<const std::pair<std::string_view, std::string_view>> jsonKeys, OutputBuffer& buffer, const std::string_view delimit = " ", const Writer& writeToken = { })
 {
 	for(std::size_t i = 0; const auto& key : jsonKeys)
 	{
-		stream << std::format("'{}' : [{}]", key.first, GetListStringOrEmpty(jsonObj, key.second, " ", callback));
+		buffer << '\'' << key.first << "' : [";
+		ProcessStringListElements(jsonObj, key.second, buffer, " ", writeToken);
+		buffer << ']';
 		if(++i < jsonKeys.size())
-			stream << "," << delimit;
+			buffer << ',' << delimit;
 	}
 }
 
-static void ProcessStringListDictDeclare(const json& targetJson, std::ostringstream& stream, const std::vector<std::pair<std::string_view, std::string_view>>& jsonKeys, const std::string_view suffix, std::optional<TokenTransformCallback> callback = { })
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static void ProcessStringListDictDeclare(const json& targetJson, OutputBuffer& buffer, std::span<const std::pair<std::string_view, std::string_view>> jsonKeys, std::string_view suffixedListName, const Writer& writeToken = { })
 {
-	std::string name = GetJsonKeyValue<std::string>(targetJson, "name");
-	stream << name << suffix << " = {\n";
-	ProcessStringListDict(targetJson, jsonKeys, stream, "\n", callback);
-	stream << "\n";
-	stream << "}\n";
+	buffer << suffixedListName << " = {\n";
+	ProcessStringListDict(targetJson, jsonKeys, buffer, "\n", writeToken);
+	buffer << "\n";
+	buffer << "}\n";
 }
 
-static auto gDependencySyntaxAdjust = [](std::string_view quotedToken) -> std::string
+// Placeholder for the variable name in a list declaration, so that identical lists of different targets have identical declarations
+static constexpr std::string_view gListVarPlaceholder = "$$list_var$$";
+
+// Allows looking up the declarations (std::string keys) with std::string_view, without copying it into a std::string
+struct StringViewHash
 {
-	return std::format("dependency({})", quotedToken);
+	using is_transparent = void;
+	std::size_t operator()(std::string_view str) const noexcept { return std::hash<std::string_view> { }(str); }
 };
 
-static void ProcessTargetJson(const json& targetJson, std::ostringstream& stream, ProjectMetaInfo& projMetaInfo)
-{
-	stream << "# -------------- Target: " << GetJsonKeyValue<std::string>(targetJson, "name") << " ------------------\n";
-	VarSuffixData suffixData { };
-	suffixData.sources = "_sources_bm_internal__";
-	suffixData.dependencies = "_dependencies_bm_internal__";
-	suffixData.linkArgs = "_link_args_bm_internal__";
-	suffixData.includeDirs = "_include_dirs_bm_internal__";
-	suffixData.platformSpecificSources = "_platform_src_bm_internal__";
-	ProcessStringListDeclare(targetJson, stream, "sources", suffixData.sources);
-	ProcessStringListDeclare(targetJson, stream, "include_dirs", suffixData.includeDirs);
-	ProcessStringListDeclare(targetJson, stream, "dependencies", suffixData.dependencies, gDependencySyntaxAdjust);
-	ProcessStringListDictDeclare(targetJson, stream, 
-		{ 
-			{ "windows", "windows_link_args" },
-			{ "linux", "linux_link_args" },
-			{ "darwin", "darwin_link_args" }
-		}, suffixData.linkArgs);
-	ProcessStringListDictDeclare(targetJson, stream,
-		{
-			{ "windows", "windows_sources" },
-			{ "linux", "linux_sources" },
-			{ "darwin", "darwin_sources" }
-		}, suffixData.platformSpecificSources);
-	TargetType targetType = DetectTargetType(targetJson);
-	if(targetType == TargetType::Executable)
+// Identical list declarations (of different targets) are declared only once, and the empty ones aren't declared at all.
+// Large projects with many similar targets (per-module tests, for example) repeat the same include directories, link arguments, etc.,
+// and meson parses and interprets each of these declarations.
+struct ListPool
+{
+	// false in split mode, as a per-target fragment must not depend on variables declared in another fragment
+	bool isShareIdentical { true };
+	// Declaration (with gListVarPlaceholder as the variable name) -> name of the variable declared with it
+	std::unordered_map<std::string, ListVarName, StringViewHash, std::equal_to<>> declaredLists;
+	std::size_t sharedCount { 0 };
+	std::size_t emptyCount { 0 };
+	// Size (in bytes) of the declarations not emitted
+	std::size_t elidedSize { 0 };
+	// Scratch buffers the declarations are rendered into, reused for every list
+	OutputBuffer declBuffer;
+	OutputBuffer emptyDeclBuffer;
+};
+
+// declare: writes the declaration of the list with the given variable name
+// Returns name of the variable holding the list (<target name><suffix>), or empty name if the list is empty
+template<Callable<void, OutputBuffer&, const json&, std::string_view> DeclareCallback>
+static ListVarName DeclareList(const json& targetJson, OutputBuffer& buffer, ListPool& listPool, std::string_view targetName, std::string_view suffix, const DeclareCallback& declare)
+{
+	listPool.declBuffer.Clear();
+	listPool.emptyDeclBuffer.Clear();
+	declare(listPool.declBuffer, targetJson, gListVarPlaceholder);
+	// Rendered in place of the target's json to detect the empty lists
+	static const json emptyJson = json::object();
+	declare(listPool.emptyDeclBuffer, emptyJson, gListVarPlaceholder);
+	std::string_view declaration = listPool.declBuffer.View();
+	if(declaration == listPool.emptyDeclBuffer.View())
 	{
-		suffixData.buildDefines = "_defines_bm_internal__";
-		ProcessStringListDeclare(targetJson, stream, "defines", suffixData.buildDefines);
-		ProcessTarget(targetJson, stream, TargetType::Executable, projMetaInfo, suffixData);
+		++listPool.emptyCount;
+		listPool.elidedSize += declaration.size();
+		return { };
 	}
-	// Static Library, Shared Library, and Header Only Library targets
-	else
+	ListVarName varName { targetName, suffix };
+	if(listPool.isShareIdentical)
 	{
-		suffixData.buildDefines = "_build_defines_bm_internal__";
-		suffixData.useDefines = "_use_defines_bm_internal__";
-		ProcessStringListDeclare(targetJson, stream, "build_defines", suffixData.buildDefines);
-		ProcessStringListDeclare(targetJson, stream, "use_defines", suffixData.useDefines);
-		ProcessTarget(targetJson, stream, targetType, projMetaInfo, suffixData);
+		if(auto it = listPool.declaredLists.find(declaration); it != listPool.declaredLists.end())
+		{
+			++listPool.sharedCount;
+			listPool.elidedSize += declaration.size();
+			return it->second;
+		}
+		listPool.declaredLists.emplace(declaration, varName);
 	}
+	// Copy the declaration into the output, replacing the placeholders with the variable name
+	for(std::size_t pos = 0;;)
+	{
+		auto placeholderPos = declaration.find(gListVarPlaceholder, pos);
+		buffer << declaration.substr(pos, placeholderPos - pos);
+		if(placeholderPos == std::string_view::npos)
+			break;
+		buffer << varName;
+		pos = placeholderPos + gListVarPlaceholder.size();
+	}
+	return varName;
 }
 
-static void SubstitutePlaceholderJson(std::string& str, const json& jsonObj, const std::string_view placeholderName, const std::string_view jsonKey, std::optional<TokenTransformCallback> callback = { })
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static ListVarName DeclareTargetList(const json& targetJson, OutputBuffer& buffer, ListPool& listPool, std::string_view targetName, std::string_view listName, std::string_view suffix, const Writer& writeToken = { })
 {
-	SubstitutePlaceholder(str, placeholderName, [&jsonObj, &jsonKey, &callback]()
+	return DeclareList(targetJson, buffer, listPool, targetName, suffix, [&](OutputBuffer& declBuffer, const json& jsonObj, std::string_view name)
 	{
-		return GetListStringOrEmpty(jsonObj, jsonKey, " ", callback);
+		ProcessStringListDeclare(jsonObj, declBuffer, listName, name, writeToken);
 	});
 }
 
+template<TokenWriter Writer = MetaInfoTokenWriter>
+static ListVarName DeclareTargetListDict(const json& targetJson, OutputBuffer& buffer, ListPool& listPool, std::string_view targetName, std::span<const std::pair<std::string_view, std::string_view>> jsonKeys, std::string_view suffix, const Writer& writeToken = { })
+{
+	return DeclareList(targetJson, buffer, listPool, targetName, suffix, [&](OutputBuffer& declBuffer, const json& jsonObj, std::string_view name)
+	{
+		ProcessStringListDictDeclare(jsonObj, declBuffer, jsonKeys, name, writeToken);
+	});
+}
+
+static constexpr std::pair<std::string_view, std::string_view> gLinkArgsDictKeys[] =
+{
+	{ "windows", "windows_link_args" },
+	{ "linux", "linux_link_args" },
+	{ "darwin", "darwin_link_args" }
+};
+
+static constexpr std::pair<std::string_view, std::string_view> gPlatformSourcesDictKeys[] =
+{
+	{ "windows", "windows_sources" },
+	{ "linux", "linux_sources" },
+	{ "darwin", "darwin_sources" }
+};
+
+// writePathToken: writes tokens of source and include directory lists, RebasedPathTokenWriter for per-target fragments
+template<TokenWriter PathTokenWriter = MetaInfoTokenWriter>
+static void ProcessTargetJson(const json& targetJson, OutputBuffer& buffer, ProjectMetaInfo& projMetaInfo, ListPool& listPool, const PathTokenWriter& writePathToken = { })
+{
+	const std::string& name = targetJson.at("name").template get_ref<const std::string&>();
+	buffer << "# -------------- Target: " << name << " ------------------\n";
+	// meson doesn't build the C++20 modules with GCC and Clang, the target is built in header mode (see "module_sources" in the direct ninja backend)
+	if(HasJsonKey(targetJson, "module_sources"))
+		buffer << "# \"module_sources\" are built only by 'build_master configure', the target is built in header mode here\n";
+	TargetListVars listVars { };
+	listVars.sources = DeclareTargetList(targetJson, buffer, listPool, name, "sources", "_sources_bm_internal__", writePathToken);
+	listVars.includeDirs = DeclareTargetList(targetJson, buffer, listPool, name, "include_dirs", "_include_dirs_bm_internal__", writePathToken);
+	listVars.dependencies = DeclareTargetList(targetJson, buffer, listPool, name, "dependencies", "_dependencies_bm_internal__",
+												DependencyTokenWriter<MetaInfoTokenWriter> { projMetaInfo.isResolvedDependencies });
+	listVars.linkArgs = DeclareTargetListDict(targetJson, buffer, listPool, name, gLinkArgsDictKeys, "_link_args_bm_internal__");
+	listVars.platformSpecificSources = DeclareTargetListDict(targetJson, buffer, listPool, name, gPlatformSourcesDictKeys, "_platform_src_bm_internal__", writePathToken);
+	TargetType targetType = DetectTargetType(targetJson);
+	if(targetType == TargetType::Executable)
+	{
+		listVars.buildDefines = DeclareTargetList(targetJson, buffer, listPool, name, "defines", "_defines_bm_internal__");
+		if(auto it = targetJson.find("simd_sources"); it != targetJson.end())
+			ProcessSimdSources(targetJson, it.value(), buffer, targetType, listVars, writePathToken);
+		ProcessTarget(targetJson, buffer, TargetType::Executable, projMetaInfo, listVars);
+	}
+	// Static Library, Shared Library, and Header Only Library targets
+	else
+	{
+		listVars.buildDefines = DeclareTargetList(targetJson, buffer, listPool, name, "build_defines", "_build_defines_bm_internal__");
+		listVars.useDefines = DeclareTargetList(targetJson, buffer, listPool, name, "use_defines", "_use_defines_bm_internal__");
+		if(auto it = targetJson.find("simd_sources"); it != targetJson.end())
+			ProcessSimdSources(targetJson, it.value(), buffer, targetType, listVars, writePathToken);
+		ProcessTarget(targetJson, buffer, targetType, projMetaInfo, listVars);
+	}
+}
+
 static constexpr std::pair<std::string_view, std::string_view> gPlaceHolderToJsonKeyMappings[] =
 {
 	{ "$$release_defines$$", "release_defines" },
@@ -426,125 +1090,757 @@ static constexpr std::pair<std::string_view, std::string_view> gDepPlaceHolderTo
 	{ "$$darwin_dependencies$$", "darwin_dependencies" }
 };
 
-static std::string ProcessTemplate(std::string_view templateStr, const json& buildMasterJson)
+static bool IsSplitMesonBuild(const json& buildMasterJson)
+{
+	return GetJsonKeyValue<bool>(buildMasterJson, "split_meson_build", false);
+}
+
+enum class PathVarKind
+{
+	Sources,
+	IncludeDirs
+};
+
+// Returns the names of the variables (in "vars") which are referenced from the source or include directory lists of the targets
+// Example: "sources" : [ "$gui_sources" ] -> { "gui_sources", PathVarKind::Sources }
+static std::unordered_map<std::string, PathVarKind> CollectPathVars(const json& buildMasterJson)
 {
-	std::string str { templateStr };
-	SubstitutePlaceholder(str, "$$project_name$$", single_quoted_str(GetJsonKeyValue<std::string>(buildMasterJson, "project_name")));
-	SubstitutePlaceholder(str, "$$canonical_name$$", single_quoted_str(GetJsonKeyValue<std::string>(buildMasterJson, "canonical_name")));
-	for(const auto& pair : gPlaceHolderToJsonKeyMappings)
-		SubstitutePlaceholderJson(str, buildMasterJson, pair.first, pair.second);
-	// Substitute the platform specific dependencies separately as they also need to be wrapped in 'dependency()' function.
-	for(const auto& pair : gDepPlaceHolderToJsonKeyMappings)
-		SubstitutePlaceholderJson(str, buildMasterJson, pair.first, pair.second, gDependencySyntaxAdjust);
-	SubstitutePlaceholder(str, "$$vars$$", [&buildMasterJson]() -> std::string
+	std::unordered_map<std::string, PathVarKind> pathVars;
+	auto it = buildMasterJson.find("targets");
+	if(it == buildMasterJson.end())
+		return pathVars;
+	auto collect = [&pathVars](const json& targetJson, std::string_view keyName, PathVarKind kind)
 	{
-		auto it = buildMasterJson.find("vars");
-		if(it == buildMasterJson.end())
-			return "";
-		std::string str;
-		 for (const auto& [key, value] : it->items())
-		 {
-			if(value.is_array())
+		auto listIt = targetJson.find(keyName);
+		if(listIt == targetJson.end() || !listIt.value().is_array())
+			return;
+		for(const auto& value : listIt.value())
+		{
+			const auto& str = value.template get_ref<const std::string&>();
+			if(str.starts_with('$'))
+				pathVars.insert({ str.substr(1), kind });
+		}
+	};
+	for(const auto& targetJson : it.value())
+	{
+		collect(targetJson, "sources", PathVarKind::Sources);
+		for(const auto& platformName : gPlatformNames)
+			collect(targetJson, com::string_join(platformName, "_sources"), PathVarKind::Sources);
+		collect(targetJson, "include_dirs", PathVarKind::IncludeDirs);
+	}
+	return pathVars;
+}
+
+// Resolves the var to its literal elements, recursively through "$var" elements
+// Returns null if the var is a meson expression, or any of its elements (recursively) is not a literal
+// Examples:
+// "common_sources" : [ "source/a.c", "source/b.c" ] -> [ "source/a.c", "source/b.c" ]
+// "gui_sources" : [ "$common_sources", "source/gui.c" ] -> [ "source/a.c", "source/b.c", "source/gui.c" ]
+// "gui_dir" : "'source/gui'" -> [ "source/gui" ]
+// "cuda_path" : "env:CUDA_PATH", "my_dir" : "'source' / 'gui'" -> null
+static std::optional<std::vector<std::string>> ResolveLiteralVar(const json& varsJson, const std::string& name,
+																std::unordered_map<std::string, std::optional<std::vector<std::string>>>& resolvedVars,
+																std::unordered_set<std::string>& visitingVars)
+{
+	if(auto it = resolvedVars.find(name); it != resolvedVars.end())
+		return it->second;
+	auto varIt = varsJson.find(name);
+	// Cyclic references are left to meson to report
+	if(varIt == varsJson.end() || visitingVars.contains(name))
+		return { };
+	visitingVars.insert(name);
+	std::optional<std::vector<std::string>> values { std::vector<std::string> { } };
+	const json& value = varIt.value();
+	if(value.is_string())
+	{
+		// Only a single quoted string literal, anything else is a meson expression
+		const auto& str = value.template get_ref<const std::string&>();
+		std::string_view unquotedStr = std::string_view { str }.substr(1, str.size() - std::min<std::size_t>(str.size(), 2));
+		if(str.size() >= 2 && str.front() == '\'' && str.back() == '\'' && IsLiteralToken(unquotedStr))
+			values->push_back(std::string { unquotedStr });
+		else
+			values = { };
+	}
+	else if(value.is_array())
+	{
+		for(const auto& element : value)
+		{
+			const auto& str = element.template get_ref<const std::string&>();
+			if(IsLiteralToken(str))
+				values->push_back(str);
+			else if(auto elements = str.starts_with('$') ? ResolveLiteralVar(varsJson, str.substr(1), resolvedVars, visitingVars) : std::nullopt)
+				values->insert(values->end(), elements->begin(), elements->end());
+			else
 			{
-			    std::ostringstream stream;
-			    stream << key << " = ";
-			    ProcessStringList(value, stream, "\n");
-			    str.append(stream.str());
+				values = { };
+				break;
+			}
+		}
+	}
+	else
+		values = { };
+	visitingVars.erase(name);
+	resolvedVars.insert({ name, values });
+	return values;
+}
+
+// Replaces "$var" elements of the lists with the literal elements of the var
+static void InlineLiteralVars(json& jsonObj, const std::unordered_map<std::string, std::optional<std::vector<std::string>>>& resolvedVars)
+{
+	if(jsonObj.is_array())
+	{
+		json inlinedArray = json::array();
+		for(auto& element : jsonObj)
+		{
+			if(element.is_string())
+			{
+				const auto& str = element.template get_ref<const std::string&>();
+				auto it = str.starts_with('$') ? resolvedVars.find(str.substr(1)) : resolvedVars.end();
+				if(it != resolvedVars.end() && it->second)
+				{
+					for(const auto& value : it->second.value())
+						inlinedArray.push_back(value);
+					continue;
+				}
 			}
 			else
-				str.append(std::format("{} = {}\n", key, value.template get<std::string>()));
+				InlineLiteralVars(element, resolvedVars);
+			inlinedArray.push_back(std::move(element));
 		}
-		return str;
-	});
-	// TODO: Use ProcessStringListDeclare() instead
-	SubstitutePlaceholder(str, "$$dependencies$$", [&buildMasterJson]() -> std::string
+		jsonObj = std::move(inlinedArray);
+	}
+	else if(jsonObj.is_object())
+		for(auto& [key, value] : jsonObj.items())
+			InlineLiteralVars(value, resolvedVars);
+}
+
+// Returns true if name appears as an identifier in any of the non-literal strings of the json (excluding the key names)
+static bool IsReferenced(const json& jsonObj, std::string_view name)
+{
+	if(jsonObj.is_string())
+	{
+		const auto& str = jsonObj.template get_ref<const std::string&>();
+		if(IsLiteralToken(str))
+			return false;
+		auto isIdentifierChar = [](char ch) { return std::isalnum(static_cast<unsigned char>(ch)) || ch == '_'; };
+		for(auto pos = str.find(name); pos != std::string::npos; pos = str.find(name, pos + 1))
+		{
+			bool isBeginBoundary = (pos == 0) || !isIdentifierChar(str[pos - 1]);
+			bool isEndBoundary = (pos + name.size() == str.size()) || !isIdentifierChar(str[pos + name.size()]);
+			if(isBeginBoundary && isEndBoundary)
+				return true;
+		}
+		return false;
+	}
+	if(jsonObj.is_structured())
+		for(const auto& value : jsonObj)
+			if(IsReferenced(value, name))
+				return true;
+	return false;
+}
+
+// Constant-folds the "vars" whose values are literals (or lists of literals), i.e. "$var" elements of the lists are replaced with the var's elements,
+// and the folded vars which are no longer referenced from anywhere (for example, from a meson expression var) are removed.
+// Vars holding meson expressions (env:, run_command(), '...' / '...', etc.) are left to meson.
+// isVerbose: reports the number of folded vars
+static void FoldLiteralVars(json& buildMasterJson, bool isVerbose, std::ostream& output)
+{
+	auto varsIt = buildMasterJson.find("vars");
+	if(varsIt == buildMasterJson.end() || !varsIt.value().is_object())
+		return;
+	json varsJson = std::move(varsIt.value());
+	buildMasterJson.erase("vars");
+	std::unordered_map<std::string, std::optional<std::vector<std::string>>> resolvedVars;
+	std::unordered_set<std::string> visitingVars;
+	for(const auto& [name, value] : varsJson.items())
+		ResolveLiteralVar(varsJson, name, resolvedVars, visitingVars);
+	InlineLiteralVars(buildMasterJson, resolvedVars);
+	InlineLiteralVars(varsJson, resolvedVars);
+	json remainingVarsJson = json::object();
+	std::size_t foldCount = 0;
+	for(auto& [name, value] : varsJson.items())
+	{
+		if(resolvedVars[name] && !IsReferenced(buildMasterJson, name) && !IsReferenced(varsJson, name))
+			++foldCount;
+		else
+			remainingVarsJson[name] = std::move(value);
+	}
+	buildMasterJson["vars"] = std::move(remainingVarsJson);
+	if(foldCount && isVerbose)
+		output << std::format("Info: {} out of {} vars are folded", foldCount, varsJson.size()) << "\n";
+}
+
+// Checks existence of the literal source files and include directories (relative to the project's root) with parallel stat() calls,
+// And reports all of the missing ones at once, instead of meson stopping at the first one.
+// Only the host platform's "<platform>_sources" are checked, the other platforms' sources may legitimately be absent (e.g. in a sparse checkout).
+// It must be called after FoldLiteralVars(), so that the literal vars are checked too.
+// directory: value passed to --directory flag
+// isMissingPathError: throws ProjectModelError if any of them doesn't exist, otherwise reports them as a warning,
+// 	as "pre_config_hook" and the prebuilt dependencies may generate them yet (they run after meson.build is generated)
+// output: receives the warning
+static void ValidateSourcePaths(std::string_view directory, const json& buildMasterJson, bool isMissingPathError, std::ostream& output)
+{
+	// { path, owner }
+	std::vector<std::pair<std::string, std::string>> paths;
+	auto collect = [&paths](const json& jsonObj, std::string_view owner)
 	{
-		auto it = buildMasterJson.find("dependencies");
+		auto collectValues = [&paths, owner](const json& valuesJson)
+		{
+			// "include_dirs" : "include" is also allowed
+			for(const auto& value : valuesJson.is_array() ? valuesJson : json::array({ valuesJson }))
+				if(value.is_string() && IsLiteralToken(value.template get_ref<const std::string&>()))
+					paths.push_back({ value.template get<std::string>(), std::string { owner } });
+		};
+		const std::string keyNames[] { "sources", "include_dirs", "module_sources", com::string_join(gHostPlatformName, "_sources") };
+		for(const auto& keyName : keyNames)
+			if(auto it = jsonObj.find(keyName); it != jsonObj.end())
+				collectValues(it.value());
+		// The malformed "simd_sources" are reported while generating, see ParseSimdSources()
+		if(auto it = jsonObj.find("simd_sources"); it != jsonObj.end() && it->is_object())
+			if(auto filesIt = it->find("files"); filesIt != it->end())
+				collectValues(filesIt.value());
+	};
+	collect(buildMasterJson, "project");
+	if(auto it = buildMasterJson.find("targets"); it != buildMasterJson.end())
+		for(const auto& targetJson : it.value())
+			collect(targetJson, std::format("target '{}'", GetJsonKeyValue<std::string>(targetJson, "name", "")));
+	if(paths.empty())
+		return;
+
+	// Each thread checks a contiguous chunk, the small projects are checked in the calling thread alone
+	constexpr std::size_t minChunkSize = 256;
+	std::size_t threadCount = std::clamp<std::size_t>(paths.size() / minChunkSize, 1, std::max(std::thread::hardware_concurrency(), 1u));
+	std::size_t chunkSize = (paths.size() + threadCount - 1) / threadCount;
+	std::vector<char> isMissing(paths.size(), 0);
+	auto check = [&](std::size_t beginIndex, std::size_t endIndex)
+	{
+		for(std::size_t i = beginIndex; i < endIndex; ++i)
+		{
+			std::error_code errorCode;
+			isMissing[i] = !std::filesystem::exists(std::filesystem::path(directory) / paths[i].first, errorCode);
+		}
+	};
+	{
+		std::vector<std::jthread> threads;
+		for(std::size_t i = 1; i < threadCount; ++i)
+			threads.emplace_back(check, i * chunkSize, std::min(paths.size(), (i + 1) * chunkSize));
+		check(0, std::min(paths.size(), chunkSize));
+	}
+
+	std::size_t missingCount = std::ranges::count(isMissing, 1);
+	if(!missingCount)
+		return;
+	std::string message = std::format("{} source file(s) or include directories referenced in build_master.json don't exist:", missingCount);
+	for(std::size_t i = 0; i < paths.size(); ++i)
+		if(isMissing[i])
+			message.append(std::format("\n\t{} ({})", paths[i].first, paths[i].second));
+	if(isMissingPathError)
+		throw ProjectModelError(message);
+	output << "Warning: " << message << "\n";
+}
+
+static void WriteGeneratedHeader(OutputBuffer& buffer)
+{
+	buffer.Format("#------------- Generated By Build Master {} ------------------\n\n", BUILDMASTER_VERSION_STRING);
+}
+
+// Returns the total size of the strings (keys and values) in the json
+static std::size_t GetStringsSize(const json& jsonObj)
+{
+	if(jsonObj.is_string())
+		return jsonObj.template get_ref<const std::string&>().size();
+	std::size_t size = 0;
+	if(jsonObj.is_object())
+		for(const auto& [key, value] : jsonObj.items())
+			size += key.size() + GetStringsSize(value);
+	else if(jsonObj.is_array())
+		for(const auto& value : jsonObj)
+			size += GetStringsSize(value);
+	return size;
+}
+
+// Estimates size of the generated script, so that the output buffer is allocated only once
+// A string in build_master.json is written a few times on average (quoted, and also in the empty checks of the dependencies),
+// and each target comes with a fixed boilerplate of the declarations.
+static std::size_t EstimateScriptSize(std::size_t templateSize, const json& jsonObj)
+{
+	constexpr std::size_t targetBoilerplateSize = 768;
+	std::size_t targetCount = 0;
+	if(auto it = jsonObj.find("targets"); it != jsonObj.end() && it.value().is_array())
+		targetCount = it.value().size();
+	return templateSize + GetStringsSize(jsonObj) * 3 + targetCount * targetBoilerplateSize;
+}
+
+static bool IsPlaceholderNameChar(char ch)
+{
+	return std::islower(static_cast<unsigned char>(ch)) || ch == '_';
+}
+
+// Expands the $$<name>$$ placeholders of the template in a single pass, the text in between is copied as it is
+// writePlaceholder: writes the substitute of the placeholder (given with the $$ delimiters) into the buffer,
+// 					 returns false if the placeholder is unknown, then it is copied as it is
+template<Callable<bool, OutputBuffer&, std::string_view> PlaceholderWriter>
+static void ExpandTemplate(std::string_view templateStr, OutputBuffer& buffer, const PlaceholderWriter& writePlaceholder)
+{
+	constexpr std::string_view delimiter = "$$";
+	std::size_t pos = 0;
+	for(auto beginPos = templateStr.find(delimiter); beginPos != std::string_view::npos; beginPos = templateStr.find(delimiter, pos))
+	{
+		auto nameEndPos = beginPos + delimiter.size();
+		while(nameEndPos < templateStr.size() && IsPlaceholderNameChar(templateStr[nameEndPos]))
+			++nameEndPos;
+		// Not a placeholder, "$$" is just a part of the text
+		if(nameEndPos == beginPos + delimiter.size() || templateStr.substr(nameEndPos, delimiter.size()) != delimiter)
+		{
+			buffer << templateStr.substr(pos, nameEndPos - pos);
+			pos = nameEndPos;
+			continue;
+		}
+		buffer << templateStr.substr(pos, beginPos - pos);
+		std::string_view placeholder = templateStr.substr(beginPos, nameEndPos + delimiter.size() - beginPos);
+		if(!writePlaceholder(buffer, placeholder))
+			buffer << placeholder;
+		pos = beginPos + placeholder.size();
+	}
+	buffer << templateStr.substr(pos);
+}
+
+// Validates the "linker" key, the names are passed to -fuse-ld= by the $$linker$$ snippet (and by the direct ninja backend)
+std::vector<std::string_view> GetLinkerCandidates(const json& buildMasterJson)
+{
+	auto it = buildMasterJson.find("linker");
+	if(it == buildMasterJson.end())
+		return { };
+	std::string_view linker = it->is_string() ? std::string_view { it->template get_ref<const std::string&>() } : std::string_view { };
+	if(linker == "auto")
+		return { std::begin(gAutoLinkerNames), std::end(gAutoLinkerNames) };
+	if(linker == "bfd" || std::ranges::find(gAutoLinkerNames, linker) != std::end(gAutoLinkerNames))
+		return { linker };
+	throw ProjectModelError(std::format("\"linker\" must be one of auto, mold, lld, gold, or bfd, but it is {}", it->dump()));
+}
+
+// envVarNames: names of the environment variables read in build_master.json, see CollectEnvVarNames()
+// buffer: the concrete script is appended to it
+// targetScripts: populated with per-target fragments if "split_meson_build" is true, otherwise the targets go into the buffer
+// isVerbose: reports the size saved by not declaring the identical and empty target lists
+// isWorkspaceMember: registers the library targets with meson.override_dependency(), see RegenerateMesonBuildScript()
+static void ProcessTemplate(std::string_view templateStr, const json& buildMasterJson, const std::set<std::string>& envVarNames, OutputBuffer& buffer, std::vector<TargetScript>& targetScripts,
+							bool isVerbose, bool isWorkspaceMember, std::ostream& output)
+{
+	bool isSplit = IsSplitMesonBuild(buildMasterJson);
+	bool isResolvedDependencies = GetJsonKeyValue<bool>(buildMasterJson, "dependency_probe_cache", false);
+	auto writeEnvVars = [&names = envVarNames](OutputBuffer& buffer)
+	{
+		if(names.empty())
+			return;
+		// Example:
+		// env_bm_internal__ = {
+		// 'CUDA_PATH' : fs_bm_internal__.is_file('.build_master/env/CUDA_PATH') ? fs_bm_internal__.read('.build_master/env/CUDA_PATH').strip() : ''
+		// }
+		buffer << "# Environment variables (snapshotted by build_master into " << gEnvSnapshotDirPath << ")\n";
+		buffer << "fs_bm_internal__ = import('fs')\n";
+		buffer << "env_bm_internal__ = {\n";
+		for(std::size_t i = 0; const auto& name : names)
+		{
+			buffer.Format("'{0}' : fs_bm_internal__.is_file('{1}/{0}') ? fs_bm_internal__.read('{1}/{0}').strip() : ''", name, gEnvSnapshotDirPath);
+			if(++i < names.size())
+				buffer << ",";
+			buffer << "\n";
+		}
+		buffer << "}\n";
+	};
+	auto writeVars = [&buildMasterJson, isSplit](OutputBuffer& buffer)
+	{
+		auto it = buildMasterJson.find("vars");
 		if(it == buildMasterJson.end())
-			return "";
-		std::string str; 
-		for(std::size_t i = 0; const auto& value : it.value())
+			return;
+		// Per-target fragments live in their own sub directories, and meson resolves plain path strings relative to the current sub directory.
+		// Hence the literal path lists referenced by the targets are resolved here, in the root, as files() or include_directories() objects.
+		std::unordered_map<std::string, PathVarKind> pathVars;
+		if(isSplit)
+			pathVars = CollectPathVars(buildMasterJson);
+		for(const auto& [key, value] : it->items())
 		{
-			str.append(std::format("dependency('{}')", value.template get<std::string>()));
-			if(++i < it.value().size())
-				str.append(",\n");
+			if(value.is_array())
+			{
+				buffer << key << " = ";
+				auto pathVarIt = pathVars.find(key);
+				if(pathVarIt != pathVars.end())
+				{
+					buffer << ((pathVarIt->second == PathVarKind::Sources) ? "files(" : "include_directories(");
+					ProcessStringList(value, buffer, "\n");
+					buffer << ")\n";
+				}
+				else
+					ProcessStringList(value, buffer, "\n");
+			}
+			else
+			{
+				std::string valueStr = value.template get<std::string>();
+				ResolveEnvMetaInfo(valueStr);
+				buffer.Format("{} = {}\n", key, valueStr);
+			}
 		}
-		return str;
-	});
-	SubstitutePlaceholder(str, "$$install_subdirs$$", [&buildMasterJson]() -> std::string
+	};
+	auto writeResolvedDependencies = [isResolvedDependencies](OutputBuffer& buffer)
+	{
+		if(!isResolvedDependencies)
+			return;
+		buffer << "# Dependencies resolved by build_master with pkg-config (in parallel, before meson runs)\n";
+		buffer << "resolved_dependencies_bm_internal__ = { }\n";
+		buffer.Format("if import('fs').is_file('{}/meson.build')\n", gResolvedDependenciesDirPath);
+		buffer.Format("  subdir('{}')\n", gResolvedDependenciesDirPath);
+		buffer << "endif\n";
+	};
+	auto writeInstallSubdirs = [&buildMasterJson](OutputBuffer& buffer)
 	{
 		auto it = buildMasterJson.find("install_header_dirs");
 		if(it == buildMasterJson.end())
-			return "";
-		std::string str;
+			return;
 		for(const auto& value : it.value())
-			str.append(std::format("install_subdir('{}', install_dir : get_option('includedir'))\n", value.template get<std::string>()));
-		return str;
-	});
-	SubstitutePlaceholder(str, "$$install_headers$$", [&buildMasterJson]() -> std::string
+			buffer.Format("install_subdir('{}', install_dir : get_option('includedir'))\n", value.template get_ref<const std::string&>());
+	};
+	auto writeInstallHeaders = [&buildMasterJson](OutputBuffer& buffer)
 	{
 		auto it = buildMasterJson.find("install_headers");
 		if(it == buildMasterJson.end())
-			return "";
-		std::ostringstream stream;
+			return;
 		for(const auto& value : it.value())
 		{
-			stream << "install_headers(";
-			ProcessStringList(value, "files", stream, "\n");
+			buffer << "install_headers(";
+			ProcessStringList(value, "files", buffer, "\n");
 			auto it = value.find("subdir");
 			if(it != value.end())
-				stream << ", subdir: " << single_quoted_str((*it).template get<std::string>());
-			stream << ")\n";
+				buffer.Format(", subdir: '{}'", (*it).template get_ref<const std::string&>());
+			buffer << ")\n";
 		}
-		return stream.str();
-	});
-	SubstitutePlaceholder(str, "$$build_targets$$", [&buildMasterJson]() -> std::string
+	};
+	// Links of the heavy targets (LTO, large executables) may take gigabytes each, so meson's link pool limits the number of parallel links
+	// 'build_master build' also limits the heavy compile and link jobs by the available memory, see PlanBuildJobs()
+	auto writeExtraDefaultOptions = [&buildMasterJson](OutputBuffer& buffer)
+	{
+		auto maxParallelLinks = GetJsonKeyValueOrNull<unsigned int>(buildMasterJson, "max_parallel_links");
+		if(!maxParallelLinks)
+		{
+			auto it = buildMasterJson.find("targets");
+			if(it == buildMasterJson.end() || std::ranges::none_of(it.value(), [](const json& targetJson)
+				{
+					return GetJsonKeyValue<bool>(targetJson, "heavy", false) || HasJsonKey(targetJson, "memory_hint_mb");
+				}))
+				return;
+			maxParallelLinks = gDefaultHeavyMaxParallelLinks;
+		}
+		buffer.Format(",\n    'backend_max_links={}'", maxParallelLinks.value());
+	};
+	auto writeSimdDispatch = [&buildMasterJson](OutputBuffer& buffer)
+	{
+		auto it = buildMasterJson.find("targets");
+		if(it == buildMasterJson.end() || std::ranges::none_of(it.value(), [](const json& targetJson) { return HasJsonKey(targetJson, "simd_sources"); }))
+			return;
+		buffer << "# Runtime dispatch of the \"simd_sources\", the best variant for the CPU is picked by an ifunc resolver when the binary is loaded\n";
+		buffer << "# Elsewhere (not x86, or the toolchain doesn't support ifunc, e.g. Windows and macOS) the files are compiled as plain sources\n";
+		buffer << "simd_dispatch_bm_internal__ = host_machine.cpu_family() in [ 'x86', 'x86_64' ] and meson.get_compiler('c').has_function_attribute('ifunc')\n";
+	};
+	auto writeDevFastLink = [&buildMasterJson](OutputBuffer& buffer)
+	{
+		if(!GetJsonKeyValue<bool>(buildMasterJson, "dev_fast_link", false))
+			return;
+		buffer << "\n# \"dev_fast_link\": the static libraries are built as shared libraries (exporting their symbols) in the non-release builds,\n";
+		buffer << "# so that an edit relinks only the changed library instead of every executable linking with it, the release builds are unchanged\n";
+		buffer << "dev_fast_link_bm_internal__ = get_option('buildtype') not in [ 'release', 'debugoptimized' ]\n";
+		buffer << "dev_fast_link_install_rpath_bm_internal__ = dev_fast_link_bm_internal__ ? get_option('prefix') / lib_install_dir_bm_internal__ : ''\n";
+	};
+	// Example ("linker": "auto"):
+	// linker_bm_internal__ = 'default'
+	// foreach candidate_linker_bm_internal__ : [ 'mold', 'lld', 'gold' ]
+	//   if meson.get_compiler('c').has_link_argument('-fuse-ld=' + candidate_linker_bm_internal__) and meson.get_compiler('cpp').has_link_argument(...)
+	//     linker_bm_internal__ = candidate_linker_bm_internal__
+	//     break
+	//   endif
+	// endforeach
+	auto writeLinker = [&buildMasterJson](OutputBuffer& buffer)
+	{
+		auto candidates = GetLinkerCandidates(buildMasterJson);
+		if(candidates.empty())
+			return;
+		buffer << "\n# Linker selection (\"linker\" in build_master.json), the first one which works with both of the compilers is used\n";
+		buffer << "# has_link_argument() links a test program, so a linker which is installed but doesn't work with the compiler isn't picked\n";
+		buffer << "linker_bm_internal__ = 'default'\n";
+		buffer << "foreach candidate_linker_bm_internal__ : [";
+		for(std::string_view delimit = " "; const auto& candidate : candidates)
+		{
+			buffer << delimit << single_quoted_str(candidate);
+			delimit = ", ";
+		}
+		buffer << " ]\n";
+		buffer << "  candidate_link_arg_bm_internal__ = '-fuse-ld=' + candidate_linker_bm_internal__\n";
+		buffer << "  if meson.get_compiler('c').has_link_argument(candidate_link_arg_bm_internal__) and meson.get_compiler('cpp').has_link_argument(candidate_link_arg_bm_internal__)\n";
+		buffer << "    linker_bm_internal__ = candidate_linker_bm_internal__\n";
+		buffer << "    add_project_link_arguments(candidate_link_arg_bm_internal__, language : 'c')\n";
+		buffer << "    add_project_link_arguments(candidate_link_arg_bm_internal__, language : 'cpp')\n";
+		buffer << "    break\n";
+		buffer << "  endif\n";
+		buffer << "endforeach\n";
+		if(candidates.size() == 1)
+		{
+			buffer << "if linker_bm_internal__ == 'default'\n";
+			buffer.Format("  error('The linker {} (\"linker\" in build_master.json) doesn\\'t work with the compilers, is it installed?')\n", candidates.front());
+			buffer << "endif\n";
+		}
+		buffer << "message('Linker: ' + linker_bm_internal__)\n";
+	};
+	auto writeBuildTargets = [&buildMasterJson, &targetScripts, isSplit, isResolvedDependencies, isVerbose, isWorkspaceMember, &output](OutputBuffer& buffer)
 	{
 		ProjectMetaInfo projMetaInfo;
+		projMetaInfo.isResolvedDependencies = isResolvedDependencies;
+		projMetaInfo.isDevFastLink = GetJsonKeyValue<bool>(buildMasterJson, "dev_fast_link", false);
+		projMetaInfo.isWorkspaceMember = isWorkspaceMember;
 		projMetaInfo.name = GetJsonKeyValue<std::string>(buildMasterJson, "project_name");
 		projMetaInfo.description = GetJsonKeyValue<std::string>(buildMasterJson, "description", "Description not provided");
+		ListPool listPool;
+		listPool.isShareIdentical = !isSplit && GetJsonKeyValue<bool>(buildMasterJson, "deduplicate_lists", true);
 		auto& targets = buildMasterJson["targets"];
-		std::ostringstream stream;
+		std::size_t beginSize = buffer.Size();
+		std::size_t generatedSize = 0;
+		if(isSplit)
+			targetScripts.reserve(targets.size());
 		for(const auto& target : targets)
 		{
-			ProcessTargetJson(target, stream, projMetaInfo);
-			stream << "\n";
+			if(isSplit)
+			{
+				const std::string& name = target.at("name").template get_ref<const std::string&>();
+				auto& targetScript = targetScripts.emplace_back(name, OutputBuffer { EstimateScriptSize(0, target) });
+				WriteGeneratedHeader(targetScript.content);
+				std::size_t headerSize = targetScript.content.Size();
+				ProcessTargetJson(target, targetScript.content, projMetaInfo, listPool, RebasedPathTokenWriter { });
+				buffer.Format("subdir('{}/{}')\n", gTargetScriptsDirPath, name);
+				generatedSize += targetScript.content.Size() - headerSize;
+				continue;
+			}
+			ProcessTargetJson(target, buffer, projMetaInfo, listPool);
+			buffer << "\n";
 		}
-		return stream.str();
+		generatedSize += buffer.Size() - beginSize;
+		if((listPool.sharedCount || listPool.emptyCount) && isVerbose)
+			output << std::format("Info: {} identical and {} empty target lists are not declared, the targets are {:.1f} KiB instead of {:.1f} KiB",
+										listPool.sharedCount, listPool.emptyCount, generatedSize / 1024.0, (generatedSize + listPool.elidedSize) / 1024.0) << "\n";
+	};
+
+	ExpandTemplate(templateStr, buffer, [&](OutputBuffer& buffer, std::string_view placeholder) -> bool
+	{
+		for(const auto& [placeholderName, jsonKey] : gPlaceHolderToJsonKeyMappings)
+			if(placeholder == placeholderName)
+			{
+				ProcessStringListElements(buildMasterJson, jsonKey, buffer);
+				return true;
+			}
+		// Platform specific dependencies also need to be wrapped in 'dependency()' function.
+		for(const auto& [placeholderName, jsonKey] : gDepPlaceHolderToJsonKeyMappings)
+			if(placeholder == placeholderName)
+			{
+				ProcessStringListElements(buildMasterJson, jsonKey, buffer, " ", DependencyTokenWriter<MetaInfoTokenWriter> { isResolvedDependencies });
+				return true;
+			}
+		if(placeholder == "$$project_name$$")
+			buffer << '\'' << buildMasterJson.at("project_name").template get_ref<const std::string&>() << '\'';
+		else if(placeholder == "$$canonical_name$$")
+			buffer << '\'' << buildMasterJson.at("canonical_name").template get_ref<const std::string&>() << '\'';
+		else if(placeholder == "$$env_vars$$")
+			writeEnvVars(buffer);
+		else if(placeholder == "$$vars$$")
+			writeVars(buffer);
+		else if(placeholder == "$$resolved_dependencies$$")
+			writeResolvedDependencies(buffer);
+		// TODO: Use ProcessStringListDeclare() instead
+		else if(placeholder == "$$dependencies$$")
+			ProcessStringListElements(buildMasterJson, "dependencies", buffer, "\n", DependencyTokenWriter<QuotedTokenWriter> { isResolvedDependencies });
+		else if(placeholder == "$$install_subdirs$$")
+			writeInstallSubdirs(buffer);
+		else if(placeholder == "$$install_headers$$")
+			writeInstallHeaders(buffer);
+		else if(placeholder == "$$build_targets$$")
+			writeBuildTargets(buffer);
+		else if(placeholder == "$$extra_default_options$$")
+			writeExtraDefaultOptions(buffer);
+		else if(placeholder == "$$dev_fast_link$$")
+			writeDevFastLink(buffer);
+		else if(placeholder == "$$simd_dispatch$$")
+			writeSimdDispatch(buffer);
+		else if(placeholder == "$$linker$$")
+			writeLinker(buffer);
+		else if(placeholder == "$$pkg_config_dir_snapshot$$")
+			buffer << '\'' << gPkgConfigDirSnapshotFilePath << '\'';
+		else
+			return false;
+		return true;
 	});
-	return str;
 }
 
+// Writes each target's fragment into .build_master/targets/<name>/meson.build, only if its content has changed
+// It also removes fragments of the targets which no longer exist in build_master.json
 // directory: value passed to --directory flag
-static void GenerateMesonBuildScript(std::string_view directory)
+// output: receives the report
+static void WriteTargetScripts(std::string_view directory, const std::vector<TargetScript>& targetScripts, std::ostream& output)
 {
-	auto mesonBuildScriptFilePath = GetMesonBuildScriptFilePath(directory);
-	std::cout << std::format("Generating {}", mesonBuildScriptFilePath) << "\n";
-	json buildMasterJson = ParseBuildMasterJson(directory);
-	std::string templateStr = LoadMesonBuildScriptTemplate();
-	std::string concreteStr = ProcessTemplate(templateStr, buildMasterJson);
-	std::ofstream stream(mesonBuildScriptFilePath.data(), std::ios_base::trunc);
-	if(!stream.is_open())
-	{
-		std::cerr << "Error: Failed to open/create " << mesonBuildScriptFilePath << "\n";
-		exit(EXIT_FAILURE);
+	auto targetScriptsDirPath = std::filesystem::path(GetPathStrRelativeToDir(directory, gTargetScriptsDirPath));
+	std::unordered_set<std::string> targetNames;
+	std::size_t writeCount = 0;
+	for(const auto& targetScript : targetScripts)
+	{
+		auto filePath = targetScriptsDirPath / targetScript.name / gMesonBuildScriptFilePath;
+		if(WriteTextFileIfChanged(filePath.string(), targetScript.content.View()))
+			++writeCount;
+		targetNames.insert(targetScript.name);
+	}
+	if(std::filesystem::exists(targetScriptsDirPath))
+	{
+		for(const auto& entry : std::filesystem::directory_iterator(targetScriptsDirPath))
+		{
+			if(entry.is_directory() && !targetNames.contains(entry.path().filename().string()))
+			{
+				output << std::format("Info: Removing stale target script directory {}", entry.path().string()) << "\n";
+				std::filesystem::remove_all(entry.path());
+			}
+		}
 	}
-	stream << std::format("#------------- Generated By Build Master {} ------------------\n\n", BUILDMASTER_VERSION_STRING);
-	stream << concreteStr;
+	output << std::format("Info: {} out of {} target scripts are regenerated", writeCount, targetScripts.size()) << "\n";
 }
 
+// Writes the dispatch stub of each target with "simd_sources" into .build_master/simd/<name>_dispatch.c, only if its content has changed
+// It also removes stubs of the targets which no longer have "simd_sources", see WriteSimdDispatchStub()
 // directory: value passed to --directory flag
-void RegenerateMesonBuildScript(std::string_view directory, bool isForce)
+static void WriteSimdDispatchStubs(std::string_view directory, const json& buildMasterJson)
 {
-	if(!std::filesystem::exists(GetBuildMasterJsonFilePath(directory)))
+	auto simdDispatchDirPath = std::filesystem::path(GetPathStrRelativeToDir(directory, gSimdDispatchDirPath));
+	std::unordered_set<std::string> fileNames;
+	if(auto it = buildMasterJson.find("targets"); it != buildMasterJson.end())
+	{
+		OutputBuffer buffer;
+		for(const auto& targetJson : it.value())
+		{
+			auto simdIt = targetJson.find("simd_sources");
+			if(simdIt == targetJson.end())
+				continue;
+			buffer.Clear();
+			WriteSimdDispatchStub(buffer, targetJson, simdIt.value());
+			auto& fileName = *fileNames.insert(std::format("{}_dispatch.c", targetJson.at("name").template get_ref<const std::string&>())).first;
+			WriteTextFileIfChanged((simdDispatchDirPath / fileName).string(), buffer.View());
+		}
+	}
+	if(!std::filesystem::exists(simdDispatchDirPath))
+		return;
+	for(const auto& entry : std::filesystem::directory_iterator(simdDispatchDirPath))
+		if(!fileNames.contains(entry.path().filename().string()))
+			std::filesystem::remove(entry.path());
+	if(fileNames.empty())
+		std::filesystem::remove(simdDispatchDirPath);
+}
+
+json BuildProjectModel(json buildMasterJson, std::string_view directory, bool isVerbose, bool isMissingPathError, std::ostream& output)
+{
+	FoldLiteralVars(buildMasterJson, isVerbose, output);
+	ValidateSourcePaths(directory, buildMasterJson, isMissingPathError, output);
+	return buildMasterJson;
+}
+
+// directory: value passed to --directory flag
+json LoadProjectModel(std::string_view directory, bool isMissingPathError)
+{
+	try
 	{
-		std::cerr << "Error: build_master.json doesn't exists, please execute the following:\n"
-					"build_master init --name <your project name> --canonical_name <filename friendly project name>\n";
+		return BuildProjectModel(ParseBuildMasterJson(directory), directory, true, isMissingPathError);
+	}
+	catch(const ProjectModelError& error)
+	{
+		std::cerr << "Error: " << error.what() << "\n";
 		exit(EXIT_FAILURE);
 	}
+}
 
-	if(isForce || IsRegenerateMesonBuildScript(directory))
-		GenerateMesonBuildScript(directory);
+void GenerateMesonBuildScript(const json& buildMasterJson, OutputBuffer& buffer, std::vector<TargetScript>& targetScripts, bool isVerbose, bool isWorkspaceMember, std::ostream& output)
+{
+	std::set<std::string> envVarNames;
+	CollectEnvVarNames(buildMasterJson, envVarNames);
+	// The whole script is generated into a single buffer, allocated once with the estimated size
+	buffer.Reserve(buffer.Size() + EstimateScriptSize(MESON_BUILD_TEMPLATE_STR.size(), buildMasterJson));
+	WriteGeneratedHeader(buffer);
+	ProcessTemplate(MESON_BUILD_TEMPLATE_STR, buildMasterJson, envVarNames, buffer, targetScripts, isVerbose, isWorkspaceMember, output);
+}
+
+// directory: value passed to --directory flag
+// isWorkspaceMember: see RegenerateMesonBuildScript()
+// output: see TryRegenerateMesonBuildScript()
+static void GenerateMesonBuildScript(std::string_view directory, bool isWorkspaceMember, std::ostream& output)
+{
+	auto mesonBuildScriptFilePath = GetMesonBuildScriptFilePath(directory);
+	output << std::format("Generating {}", mesonBuildScriptFilePath) << "\n";
+	// meson.build is generated before the pre-config hooks run, so the sources they generate don't exist yet
+	json buildMasterJson = BuildProjectModel(ParseBuildMasterJson(directory), directory, true, false, output);
+	OutputBuffer buffer;
+	std::vector<TargetScript> targetScripts;
+	GenerateMesonBuildScript(buildMasterJson, buffer, targetScripts, true, isWorkspaceMember, output);
+	std::set<std::string> envVarNames;
+	CollectEnvVarNames(buildMasterJson, envVarNames);
+	WriteEnvSnapshot(directory, envVarNames);
+	WritePkgConfigDirSnapshot(directory, buildMasterJson);
+	WriteSimdDispatchStubs(directory, buildMasterJson);
+	auto workspaceMemberStampFilePath = std::filesystem::path(GetPathStrRelativeToDir(directory, gWorkspaceMemberStampFilePath));
+	if(isWorkspaceMember)
+	{
+		std::filesystem::create_directories(workspaceMemberStampFilePath.parent_path());
+		std::ofstream { workspaceMemberStampFilePath, std::ios_base::trunc };
+	}
 	else
-		std::cout << "Info: meson.build is upto date\n";
+	{
+		std::error_code errorCode;
+		std::filesystem::remove(workspaceMemberStampFilePath, errorCode);
+	}
+	auto targetScriptsDirPath = std::filesystem::path(GetPathStrRelativeToDir(directory, gTargetScriptsDirPath));
+	if(IsSplitMesonBuild(buildMasterJson))
+	{
+		WriteTargetScripts(directory, targetScripts, output);
+		if(!WriteTextFileIfChanged(mesonBuildScriptFilePath, buffer.View()))
+			output << std::format("Info: {} is unchanged", mesonBuildScriptFilePath) << "\n";
+		// Remember the generation time, so that IsRegenerateMesonBuildScript() doesn't keep regenerating
+		auto stampFilePath = std::filesystem::path(GetPathStrRelativeToDir(directory, gGenerationStampFilePath));
+		std::filesystem::create_directories(stampFilePath.parent_path());
+		std::ofstream { stampFilePath, std::ios_base::trunc };
+		return;
+	}
+	// Left overs of the split mode, if it has been switched off
+	std::error_code errorCode;
+	std::filesystem::remove_all(targetScriptsDirPath, errorCode);
+	std::filesystem::remove(GetPathStrRelativeToDir(directory, gGenerationStampFilePath), errorCode);
+	OverwriteTextFile(mesonBuildScriptFilePath, buffer.View());
+}
+
+// directory: value passed to --directory flag
+bool TryRegenerateMesonBuildScript(std::string_view directory, bool isForce, bool isWorkspaceMember, std::ostream& output)
+{
+	if(!std::filesystem::exists(GetBuildMasterJsonFilePath(directory)))
+		throw ProjectModelError("build_master.json doesn't exists, please execute the following:\n"
+								"build_master init --name <your project name> --canonical_name <filename friendly project name>");
+
+	if(isForce || IsRegenerateMesonBuildScript(directory, isWorkspaceMember))
+	{
+		GenerateMesonBuildScript(directory, isWorkspaceMember, output);
+		return true;
+	}
+	output << "Info: meson.build is upto date\n";
+	// Environment variables might have changed even if build_master.json hasn't
+	RefreshEnvSnapshot(directory);
+	return false;
+}
+
+bool RegenerateMesonBuildScript(std::string_view directory, bool isForce, bool isWorkspaceMember)
+{
+	try
+	{
+		return TryRegenerateMesonBuildScript(directory, isForce, isWorkspaceMember, std::cout);
+	}
+	catch(const ProjectModelError& error)
+	{
+		std::cerr << "Error: " << error.what() << "\n";
+		exit(EXIT_FAILURE);
+	}
 }
@@ -2,8 +2,25 @@
 #include <fstream>
 #include <iostream>
 #include <filesystem>
+#include <iterator>
+#include <cstdio>
+#include <cctype>
+#include <algorithm>
 
 #include <spdlog/spdlog.h>
+#include <invoke/invoke.hpp> // for invoke::FindExecutable()
+
+#ifndef _WIN32
+#	include <unistd.h>
+#	include <fcntl.h>
+#	include <sys/stat.h>
+#	ifdef __linux__
+#		include <sys/ioctl.h>
+#		include <linux/fs.h> // for FICLONE
+#	elif defined(__APPLE__)
+#		include <sys/clonefile.h>
+#	endif
+#endif
 
 std::string LoadTextFile(std::string_view filePath)
 {
@@ -39,6 +56,82 @@ std::string GetBuildMasterJsonFilePath(std::string_view directory)
 	return GetPathStrRelativeToDir(directory, gBuildMasterJsonFilePath);
 }
 
+std::uint64_t ComputeContentHash(std::string_view data, std::uint64_t hash)
+{
+	for(unsigned char ch : data)
+	{
+		hash ^= ch;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+void OverwriteTextFile(std::string_view filePath, std::string_view textData)
+{
+	std::filesystem::path path { filePath };
+	if(path.has_parent_path() && !std::filesystem::exists(path.parent_path()))
+		std::filesystem::create_directories(path.parent_path());
+	std::FILE* file = std::fopen(path.string().c_str(), "wb");
+	if(!file)
+	{
+		spdlog::error("Failed to open/create {}", filePath);
+		exit(EXIT_FAILURE);
+	}
+	// Unbuffered, so the whole data goes into a single write() call instead of being copied into the stdio buffer first
+	std::setvbuf(file, nullptr, _IONBF, 0);
+	bool isWritten = std::fwrite(textData.data(), 1, textData.size(), file) == textData.size();
+	if((std::fclose(file) != 0) || !isWritten)
+	{
+		spdlog::error("Failed to write {}", filePath);
+		exit(EXIT_FAILURE);
+	}
+}
+
+bool ReflinkFile(const std::filesystem::path& fromPath, const std::filesystem::path& toPath)
+{
+#ifdef __linux__
+	int fromFd = open(fromPath.c_str(), O_RDONLY);
+	if(fromFd < 0)
+		return false;
+	struct stat fromStat { };
+	fstat(fromFd, &fromStat);
+	int toFd = open(toPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, fromStat.st_mode & 0777);
+	if(toFd < 0)
+	{
+		close(fromFd);
+		return false;
+	}
+	bool isCloned = ioctl(toFd, FICLONE, fromFd) == 0;
+	close(toFd);
+	close(fromFd);
+	if(!isCloned)
+		unlink(toPath.c_str());
+	return isCloned;
+#elif defined(__APPLE__)
+	return clonefile(fromPath.c_str(), toPath.c_str(), 0) == 0;
+#else
+	(void)fromPath;
+	(void)toPath;
+	return false;
+#endif
+}
+
+bool WriteTextFileIfChanged(std::string_view filePath, std::string_view textData)
+{
+	std::filesystem::path path { filePath };
+	std::error_code errorCode;
+	// A file of a different size differs, it isn't read at all
+	if(auto fileSize = std::filesystem::file_size(path, errorCode); !errorCode && fileSize == textData.size())
+	{
+		std::ifstream stream(path, std::ios_base::binary);
+		std::string contents { std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+		if(contents == textData)
+			return false;
+	}
+	OverwriteTextFile(filePath, textData);
+	return true;
+}
+
 std::string SelectPath(const std::vector<std::string>& paths)
 {
 	#ifdef _WIN32
@@ -56,3 +149,59 @@ std::string SelectPath(const std::vector<std::string>& paths)
 		return paths[0];
 	#endif
 }
+
+std::string QuoteShellArg(std::string_view arg)
+{
+#ifdef _WIN32
+	if(!arg.empty() && arg.find_first_of(" \t\n\v\"") == std::string_view::npos)
+		return std::string { arg };
+	std::string quotedArg = "\"";
+	std::size_t backslashCount = 0;
+	for(char ch : arg)
+	{
+		if(ch == '\\')
+			++backslashCount;
+		else if(ch == '"')
+		{
+			quotedArg.append(backslashCount * 2 + 1, '\\');
+			backslashCount = 0;
+		}
+		else
+			backslashCount = 0;
+		quotedArg.push_back(ch);
+	}
+	quotedArg.append(backslashCount, '\\');
+	quotedArg.push_back('"');
+	return quotedArg;
+#else
+	bool isSafe = !arg.empty() && std::ranges::all_of(arg, [](char ch)
+	{
+		return std::isalnum(static_cast<unsigned char>(ch)) || std::string_view { "_@%+=:,./-" }.find(ch) != std::string_view::npos;
+	});
+	if(isSafe)
+		return std::string { arg };
+	std::string quotedArg = "'";
+	for(char ch : arg)
+	{
+		if(ch == '\'')
+			quotedArg.append("'\\''");
+		else
+			quotedArg.push_back(ch);
+	}
+	quotedArg.push_back('\'');
+	return quotedArg;
+#endif
+}
+
+std::string GetSelfExecutablePath()
+{
+#ifdef __linux__
+	std::error_code errorCode;
+	auto path = std::filesystem::read_symlink("/proc/self/exe", errorCode);
+	if(!errorCode)
+		return path.string();
+#endif
+	if(auto paths = invoke::FindExecutable("build_master"); paths && paths->size())
+		return SelectPath(paths.value());
+	return "build_master";
+}
@@ -0,0 +1,55 @@
+// Linked into api_tests only (see meson.build), the build_master executable and libbuild_master use the standard operator new
+#include <build_master/alloc_stats.hpp> // for CountAllocation()
+
+#include <cstdlib>
+#include <new>
+
+static void* Allocate(std::size_t size)
+{
+	CountAllocation(size);
+	// malloc(0) may return null, but operator new must return a unique pointer
+	if(size == 0)
+		size = 1;
+	// Same as the standard operator new, the new_handler is called until it frees enough memory, throws, or is removed
+	while(true)
+	{
+		if(void* ptr = std::malloc(size))
+			return ptr;
+		std::new_handler handler = std::get_new_handler();
+		if(!handler)
+			throw std::bad_alloc { };
+		handler();
+	}
+}
+
+// The nothrow and the sized variants of the standard library forward to these
+// NOTE: the over-aligned variants (std::align_val_t) are not replaced, so they are not counted
+void* operator new(std::size_t size)
+{
+	return Allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+	return Allocate(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept
+{
+	std::free(ptr);
+}
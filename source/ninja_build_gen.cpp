@@ -0,0 +1,949 @@
+#include <build_master/ninja_build_gen.hpp>
+#include <build_master/meson_build_gen.hpp> // for LoadProjectModel(), DetectTargetType(), and IsLiteralToken()
+#include <build_master/dependency_probe.hpp> // for ProbePkgConfigDependencies()
+#include <build_master/artifact_cache.hpp> // for PreparePrebuiltDependencies()
+#include <build_master/pre_config_script.hpp> // for RunPreConfigScript()
+#include <build_master/output_buffer.hpp>
+#include <build_master/json_parse.hpp> // for GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), GetBuildMasterJsonFilePath(), SelectPath(), GetSelfExecutablePath(), QuoteShellArg(), OverwriteTextFile(), and WriteTextFileIfChanged()
+#include <build_master/process.hpp> // for RunProcess()
+#include <build_master/version.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <optional>
+#include <functional>
+#include <fstream>
+#include <regex>
+#include <map>
+#include <set>
+#include <cctype>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+#include <invoke/invoke.hpp> // for invoke::FindExecutable()
+
+static constexpr std::string_view gBuildTypes[] = { "debug", "release", "debugoptimized" };
+// Same as the default of 'max_parallel_links' in the generated meson.build if any target is heavy
+static constexpr unsigned int gDefaultHeavyMaxParallelLinks = 2;
+
+#ifdef __APPLE__
+static constexpr std::string_view gHostPlatformName = "darwin";
+static constexpr std::string_view gSharedLibrarySuffix = ".dylib";
+#else
+static constexpr std::string_view gHostPlatformName = "linux";
+static constexpr std::string_view gSharedLibrarySuffix = ".so";
+#endif
+
+enum class SourceLanguage
+{
+	Unsupported,
+	// Headers listed in the sources, they aren't compiled (same as in meson)
+	Header,
+	C,
+	Cpp
+};
+
+static SourceLanguage GetSourceLanguage(std::string_view filePath)
+{
+	auto extension = std::filesystem::path(filePath).extension().string();
+	if(extension == ".c")
+		return SourceLanguage::C;
+	if(extension == ".cpp" || extension == ".cc" || extension == ".cxx" || extension == ".c++" || extension == ".C")
+		return SourceLanguage::Cpp;
+	if(extension == ".h" || extension == ".hpp" || extension == ".hh" || extension == ".hxx" || extension == ".inl" || extension == ".ipp")
+		return SourceLanguage::Header;
+	return SourceLanguage::Unsupported;
+}
+
+// Escapes a path for the build statements of build.ninja
+// Example: my dir/a:b.c -> my$ dir/a$:b.c
+static std::string EscapeNinjaPath(std::string_view path)
+{
+	std::string escapedPath;
+	escapedPath.reserve(path.size());
+	for(char ch : path)
+	{
+		if(ch == '$' || ch == ' ' || ch == ':')
+			escapedPath.push_back('$');
+		escapedPath.push_back(ch);
+	}
+	return escapedPath;
+}
+
+// Quotes an argument for the shell (ninja runs the commands through /bin/sh), then escapes it for a variable of build.ninja
+// Examples:
+// -DFOO=1 -> -DFOO=1
+// -DNAME="my app" -> '-DNAME="my app"'
+// -Wl,-rpath,$ORIGIN -> '-Wl,-rpath,$$ORIGIN'
+static std::string QuoteArg(std::string_view arg)
+{
+	std::string quotedArg;
+	for(char ch : QuoteShellArg(arg))
+	{
+		if(ch == '$')
+			quotedArg.append("$$");
+		else
+			quotedArg.push_back(ch);
+	}
+	return quotedArg;
+}
+
+static void AppendArgs(OutputBuffer& buffer, const std::vector<std::string>& args)
+{
+	for(const auto& arg : args)
+		buffer << ' ' << QuoteArg(arg);
+}
+
+// Value of an environment variable (CC, CFLAGS, etc.) as it is, it is a shell fragment already
+// Example: CFLAGS="-O2 -pipe" -> " -O2 -pipe"
+static std::string GetEnvShellFragment(const char* envVarName, std::string_view defaultValue = "")
+{
+	const char* value = std::getenv(envVarName);
+	std::string_view fragment { (value && *value) ? std::string_view { value } : defaultValue };
+	std::string escapedFragment;
+	if(fragment.size())
+		escapedFragment.push_back(' ');
+	for(char ch : fragment)
+	{
+		if(ch == '$')
+			escapedFragment.push_back('$');
+		escapedFragment.push_back(ch);
+	}
+	return escapedFragment;
+}
+
+// How the C++ compiler builds the C++20 module interfaces ("module_sources"), see ProbeCxxModules()
+enum class CxxModules
+{
+	// Not supported (or disabled with BUILD_MASTER_CXX_MODULES=0), the module interfaces are left out, i.e. the targets are compiled in header mode
+	None,
+	// GCC 11 or newer, -fmodules-ts, the compiled module interfaces are written into gcm.cache/ (of the working directory, i.e. of the build directory)
+	Gcc,
+	// Clang 16 or newer, -fmodule-output=, the compiled module interfaces are written into gClangModulesDirPath, and looked up there
+	Clang
+};
+
+// Directory (relative to the build directory) of the compiled module interfaces built by Clang
+static constexpr std::string_view gClangModulesDirPath = "modules";
+
+// Compiled module interface (CMI) of the module, relative to the build directory
+// Examples: (Gcc, math.vec) -> gcm.cache/math.vec.gcm, (Clang, math:detail) -> modules/math-detail.pcm
+static std::string GetModuleInterfacePath(CxxModules cxxModules, std::string_view moduleName)
+{
+	std::string fileName { moduleName };
+	std::ranges::replace(fileName, ':', '-');
+	if(cxxModules == CxxModules::Gcc)
+		return std::format("gcm.cache/{}.gcm", fileName);
+	return std::format("{}/{}.pcm", gClangModulesDirPath, fileName);
+}
+
+// A module interface unit of "module_sources"
+struct ModuleInterface
+{
+	// Relative to the project's root (or absolute)
+	std::string sourcePath;
+	// Name of the module it declares, <module>:<partition> for the partitions
+	std::string name;
+	// Names of the modules it imports
+	std::vector<std::string> imports;
+};
+
+// Scans the module declaration and the imports of a module interface unit at the configure time, instead of at the build time (with ninja's dyndep),
+// build.ninja is regenerated whenever a module interface changes (see GenerateNinjaBuildScript()), so the order of the interfaces is kept up to date
+// Only the named modules are recognized, the header units (import <vector>;) are left to the compiler
+// Returns null if the file can't be read or it doesn't declare a module (export module <name>;)
+static std::optional<ModuleInterface> ScanModuleInterface(std::string_view directory, std::string_view sourcePath)
+{
+	std::ifstream stream(std::filesystem::path(directory) / sourcePath);
+	if(!stream)
+		return { };
+	static const std::regex moduleRegex { R"(^\s*export\s+module\s+([\w.]+(:[\w.]+)?)\s*;)" };
+	static const std::regex importRegex { R"(^\s*(export\s+)?import\s+([\w.]+)?(:[\w.]+)?\s*;)" };
+	ModuleInterface moduleInterface;
+	moduleInterface.sourcePath = sourcePath;
+	std::smatch match;
+	for(std::string line; std::getline(stream, line);)
+	{
+		if(line.find("module") == std::string::npos && line.find("import") == std::string::npos)
+			continue;
+		if(moduleInterface.name.empty() && std::regex_search(line, match, moduleRegex))
+			moduleInterface.name = match[1].str();
+		else if(std::regex_search(line, match, importRegex) && (match[2].matched || match[3].matched))
+			moduleInterface.imports.push_back(match[2].str() + match[3].str());
+	}
+	if(moduleInterface.name.empty())
+		return { };
+	// import :detail; imports a partition of the module it is in
+	std::string_view primaryName = std::string_view { moduleInterface.name }.substr(0, moduleInterface.name.find(':'));
+	for(auto& import : moduleInterface.imports)
+		if(import.starts_with(':'))
+			import.insert(0, primaryName);
+	return moduleInterface;
+}
+
+// Args of the C++ sources of the targets using modules (their own, or of the libraries they link with)
+// moduleInterface: the module interface compiled with the args, or null for the other sources
+static std::vector<std::string> GetCxxModulesArgs(CxxModules cxxModules, const ModuleInterface* moduleInterface)
+{
+	// The sources can check it to import the modules instead of including the headers
+	std::vector<std::string> args { "-DBUILD_MASTER_CXX_MODULES=1" };
+	if(cxxModules == CxxModules::Gcc)
+	{
+		// The imports are in build.ninja already, and ninja expects only the object file as the target of a depfile
+		args.insert(args.end(), { "-fmodules-ts", "-Mno-modules" });
+		// .cppm, .ixx, etc. aren't known to GCC
+		if(moduleInterface)
+			args.insert(args.end(), { "-x", "c++" });
+	}
+	else
+	{
+		args.push_back(std::format("-fprebuilt-module-path={}", gClangModulesDirPath));
+		if(moduleInterface)
+			args.insert(args.end(), { "-x", "c++-module", std::format("-fmodule-output={}", GetModuleInterfacePath(cxxModules, moduleInterface->name)) });
+	}
+	return args;
+}
+
+// A target of build_master.json resolved for build.ninja
+struct NinjaTarget
+{
+	const json* targetJson { nullptr };
+	std::string name;
+	TargetType type { TargetType::Executable };
+	// Relative to the build directory, same as the file name meson would give it
+	std::string outputPath;
+	// Relative to the project's root (or absolute)
+	std::vector<std::string> sources;
+	// Defines, include directories, and the compile args of the dependencies
+	std::vector<std::string> compileArgs;
+	// Link args of the target and of its external dependencies
+	std::vector<std::string> linkArgs;
+	// Names of the library targets it links with ("link_with", and the dependencies naming a library target of the project)
+	std::vector<std::string> linkWith;
+	// Compile args the targets depending on it get (its include directories and "use_defines"), only for the libraries
+	std::vector<std::string> usageCompileArgs;
+	// "module_sources", compiled before the other C++ sources of the target, and of the targets linking with it
+	std::vector<ModuleInterface> moduleInterfaces;
+	bool isCpp { false };
+	// A static library built as a shared library ("dev_fast_link"), its symbols are exported
+	bool isFastLinkLibrary { false };
+};
+
+// Reasons the project can't be configured without meson, they are reported all at once
+using RejectReasons = std::vector<std::string>;
+
+// Appends the literal elements of a list (or of a single string, as "include_dirs" : "include" is allowed) to values,
+// the elements which aren't literals (variables, env:, link_dir:) need meson
+static void CollectLiterals(const json& jsonObj, std::string_view keyName, std::string_view owner, std::vector<std::string>& values, RejectReasons& rejectReasons)
+{
+	auto it = jsonObj.find(keyName);
+	if(it == jsonObj.end())
+		return;
+	for(const auto& value : it.value().is_array() ? it.value() : json::array({ it.value() }))
+	{
+		const auto& str = value.template get_ref<const std::string&>();
+		if(IsLiteralToken(str))
+			values.push_back(str);
+		else
+			rejectReasons.push_back(std::format("{}: '{}' in \"{}\" is not a literal", owner, str, keyName));
+	}
+}
+
+// Same as CollectLiterals(), and the <host platform>_<keyName> list too
+static void CollectHostLiterals(const json& jsonObj, std::string_view keyName, std::string_view owner, std::vector<std::string>& values, RejectReasons& rejectReasons)
+{
+	CollectLiterals(jsonObj, keyName, owner, values, rejectReasons);
+	CollectLiterals(jsonObj, std::format("{}_{}", gHostPlatformName, keyName), owner, values, rejectReasons);
+}
+
+// Same as the file names given by meson
+static std::string GetOutputPath(std::string_view name, TargetType type)
+{
+	switch(type)
+	{
+		case TargetType::StaticLibrary: return std::format("lib{}.a", name);
+		case TargetType::SharedLibrary: return std::format("lib{}{}", name, gSharedLibrarySuffix);
+		case TargetType::HeaderOnlyLibrary: return { };
+		case TargetType::Executable: return std::string { name };
+	}
+	return std::string { name };
+}
+
+// Same as the target types in meson's intro-targets.json
+static std::string_view GetTargetTypeStr(TargetType type)
+{
+	switch(type)
+	{
+		case TargetType::StaticLibrary: return "static library";
+		case TargetType::SharedLibrary: return "shared library";
+		case TargetType::HeaderOnlyLibrary: return "header only library";
+		case TargetType::Executable: return "executable";
+	}
+	return "executable";
+}
+
+// Object file of a source, in the private directory of the target (same as in meson, see ApplyJobPlan())
+// Example: (libmylib.a, source/main.c) -> libmylib.a.p/source_main.c.o
+static std::string GetObjectPath(std::string_view outputPath, std::string_view sourcePath)
+{
+	std::string objectName { sourcePath };
+	std::ranges::replace(objectName, '/', '_');
+	std::ranges::replace(objectName, ':', '_');
+	return std::format("{}.p/{}.o", outputPath, objectName);
+}
+
+// Returns the first word of the command (CC="ccache gcc" -> ccache), to check that it exists
+static std::string_view GetCommandExecutable(std::string_view command)
+{
+	auto beginPos = command.find_first_not_of(' ');
+	if(beginPos == std::string_view::npos)
+		return { };
+	command.remove_prefix(beginPos);
+	return command.substr(0, command.find(' '));
+}
+
+// Returns the absolute path without the trailing separator
+// Example: . -> /home/user/project
+static std::filesystem::path GetAbsolutePath(std::string_view path)
+{
+	auto absolutePath = std::filesystem::absolute(path).lexically_normal();
+	if(!absolutePath.has_filename() && absolutePath.has_relative_path())
+		absolutePath = absolutePath.parent_path();
+	return absolutePath;
+}
+
+struct NinjaProject
+{
+	std::vector<NinjaTarget> targets;
+	// Target name -> index into targets
+	std::unordered_map<std::string, std::size_t> targetIndices;
+	// .pc files of the external dependencies, build.ninja is regenerated if any of them changes
+	std::set<std::string> pcFilePaths;
+	std::vector<std::string> projectLinkArgs;
+	// Names of the modules declared by the module interfaces of the targets
+	std::unordered_set<std::string> moduleNames;
+	// Module interfaces relative to the build directory (or absolute), build.ninja is regenerated if any of them changes
+	std::vector<std::string> moduleSourcePaths;
+	CxxModules cxxModules { CxxModules::None };
+	// Selected with "linker" (passed as -fuse-ld=<linker>), empty means the compiler's default linker, see ProbeLinker()
+	std::string linker;
+	bool isC { false };
+	bool isCpp { false };
+};
+
+// Resolves the targets of build_master.json (and the dependencies with pkg-config), everything needing meson is added into rejectReasons
+// sourceRootPath: path of the project's root relative to the build directory
+static NinjaProject ResolveProject(std::string_view directory, const json& buildMasterJson, std::string_view buildType, const std::filesystem::path& sourceRootPath, RejectReasons& rejectReasons)
+{
+	NinjaProject project;
+	// Relative to the build directory, the absolute paths are kept as they are
+	auto getPathFromBuildDir = [&sourceRootPath](std::string_view path) -> std::string
+	{
+		if(std::filesystem::path(path).is_absolute())
+			return std::string { path };
+		return (sourceRootPath / path).lexically_normal().generic_string();
+	};
+
+	if(auto it = buildMasterJson.find("vars"); it != buildMasterJson.end() && it.value().size())
+		for(const auto& [name, value] : it.value().items())
+			rejectReasons.push_back(std::format("var '{}' is a meson expression (or refers to one)", name));
+
+	// Common to all of the targets, see MESON_BUILD_TEMPLATE_STR
+	std::vector<std::string> projectSources, projectIncludeDirs, projectDependencyNames, projectDefines;
+	CollectHostLiterals(buildMasterJson, "sources", "project", projectSources, rejectReasons);
+	CollectLiterals(buildMasterJson, "include_dirs", "project", projectIncludeDirs, rejectReasons);
+	CollectHostLiterals(buildMasterJson, "dependencies", "project", projectDependencyNames, rejectReasons);
+	CollectLiterals(buildMasterJson, std::format("{}_link_args", gHostPlatformName), "project", project.projectLinkArgs, rejectReasons);
+	CollectLiterals(buildMasterJson, "defines", "project", projectDefines, rejectReasons);
+	// debugoptimized is a debug build, same as in the generated meson.build (only the profile build directories set up by 'build_master profile' get the release defines)
+	bool isReleaseDefines = buildType == "release";
+	CollectLiterals(buildMasterJson, isReleaseDefines ? "release_defines" : "debug_defines", "project", projectDefines, rejectReasons);
+	// Same as the generated meson.build, only the debug builds link with the static libraries built as shared libraries
+	bool isDevFastLink = (buildType == "debug") && GetJsonKeyValue<bool>(buildMasterJson, "dev_fast_link", false);
+
+	static const json emptyJson = json::array();
+	auto targetsIt = buildMasterJson.find("targets");
+	for(const auto& targetJson : (targetsIt != buildMasterJson.end()) ? targetsIt.value() : emptyJson)
+	{
+		NinjaTarget target;
+		target.targetJson = &targetJson;
+		target.name = GetJsonKeyValue<std::string>(targetJson, "name");
+		target.type = DetectTargetType(targetJson);
+		if(isDevFastLink && target.type == TargetType::StaticLibrary)
+		{
+			target.type = TargetType::SharedLibrary;
+			target.isFastLinkLibrary = true;
+		}
+		target.outputPath = GetOutputPath(target.name, target.type);
+		if(!project.targetIndices.insert({ target.name, project.targets.size() }).second)
+			rejectReasons.push_back(std::format("target '{}' is declared more than once", target.name));
+		project.targets.push_back(std::move(target));
+	}
+	auto isLibrary = [&project](const std::string& name)
+	{
+		auto it = project.targetIndices.find(name);
+		return it != project.targetIndices.end() && project.targets[it->second].type != TargetType::Executable;
+	};
+
+	// The dependencies naming a library target of the project resolve to the target (as meson.override_dependency() does), the others are looked up with pkg-config
+	std::set<std::string> externalDependencyNames;
+	for(const auto& name : projectDependencyNames)
+		if(!isLibrary(name))
+			externalDependencyNames.insert(name);
+	std::vector<std::vector<std::string>> targetDependencyNames(project.targets.size());
+	for(std::size_t i = 0; i < project.targets.size(); ++i)
+	{
+		auto owner = std::format("target '{}'", project.targets[i].name);
+		CollectHostLiterals(*project.targets[i].targetJson, "dependencies", owner, targetDependencyNames[i], rejectReasons);
+		for(const auto& name : targetDependencyNames[i])
+			if(!isLibrary(name))
+				externalDependencyNames.insert(name);
+	}
+	std::map<std::string, ProbedDependency> externalDependencies;
+	if(externalDependencyNames.size())
+	{
+		if(auto result = ProbePkgConfigDependencies(directory, externalDependencyNames))
+		{
+			for(auto& [name, dependency] : result->dependencies)
+			{
+				if(!dependency.isFound)
+					rejectReasons.push_back(std::format("dependency '{}' is not found via pkg-config (meson may find it via cmake or wraps)", name));
+				else if(dependency.pcFilePath.size())
+					project.pcFilePaths.insert(dependency.pcFilePath);
+			}
+			externalDependencies = std::move(result->dependencies);
+		}
+		else
+			rejectReasons.push_back("pkg-config is not found, the dependencies can't be resolved");
+	}
+	auto addExternalDependency = [&externalDependencies](NinjaTarget& target, const std::string& name)
+	{
+		auto it = externalDependencies.find(name);
+		if(it == externalDependencies.end())
+			return;
+		target.compileArgs.insert(target.compileArgs.end(), it->second.compileArgs.begin(), it->second.compileArgs.end());
+		target.linkArgs.insert(target.linkArgs.end(), it->second.linkArgs.begin(), it->second.linkArgs.end());
+	};
+
+	std::vector<std::string> projectIncludeArgs { std::format("-I{}", getPathFromBuildDir(".")) };
+	for(const auto& includeDir : projectIncludeDirs)
+		projectIncludeArgs.push_back(std::format("-I{}", getPathFromBuildDir(includeDir)));
+	for(std::size_t i = 0; i < project.targets.size(); ++i)
+	{
+		auto& target = project.targets[i];
+		const json& targetJson = *target.targetJson;
+		auto owner = std::format("target '{}'", target.name);
+		if(GetJsonKeyValue<bool>(targetJson, "is_test", false))
+			rejectReasons.push_back(std::format("{}: tests are registered with and run by meson", owner));
+		if(GetJsonKeyValue<bool>(targetJson, "is_benchmark", false))
+			rejectReasons.push_back(std::format("{}: benchmarks are registered with and run by meson", owner));
+		if(HasJsonKey(targetJson, "simd_sources"))
+			rejectReasons.push_back(std::format("{}: \"simd_sources\" needs meson's compiler checks for the runtime dispatch", owner));
+
+		std::vector<std::string> includeDirs, defines, sources;
+		CollectLiterals(targetJson, "include_dirs", owner, includeDirs, rejectReasons);
+		target.compileArgs = projectIncludeArgs;
+		for(const auto& includeDir : includeDirs)
+			target.compileArgs.push_back(std::format("-I{}", getPathFromBuildDir(includeDir)));
+		// The project's include directories and defines are common to all of the targets already
+		if(target.type != TargetType::Executable)
+		{
+			target.usageCompileArgs.assign(target.compileArgs.begin() + projectIncludeArgs.size(), target.compileArgs.end());
+			CollectLiterals(targetJson, "use_defines", owner, target.usageCompileArgs, rejectReasons);
+		}
+		CollectLiterals(targetJson, (target.type == TargetType::Executable) ? "defines" : "build_defines", owner, defines, rejectReasons);
+		defines.insert(defines.end(), projectDefines.begin(), projectDefines.end());
+
+		std::vector<std::string> moduleSources;
+		CollectLiterals(targetJson, "module_sources", owner, moduleSources, rejectReasons);
+		if(target.type == TargetType::HeaderOnlyLibrary && moduleSources.size())
+			rejectReasons.push_back(std::format("{}: header only library can't have \"module_sources\", the module interfaces have to be compiled", owner));
+		for(const auto& moduleSource : moduleSources)
+		{
+			auto moduleInterface = ScanModuleInterface(directory, moduleSource);
+			if(!moduleInterface)
+				rejectReasons.push_back(std::format("{}: '{}' in \"module_sources\" is not a module interface unit (export module <name>;)", owner, moduleSource));
+			else if(!project.moduleNames.insert(moduleInterface->name).second)
+				rejectReasons.push_back(std::format("{}: module '{}' is declared more than once", owner, moduleInterface->name));
+			else
+			{
+				project.moduleSourcePaths.push_back(getPathFromBuildDir(moduleSource));
+				target.moduleInterfaces.push_back(std::move(moduleInterface.value()));
+				target.isCpp = project.isCpp = true;
+			}
+		}
+
+		// Header only libraries have nothing to build
+		if(target.type == TargetType::HeaderOnlyLibrary)
+			continue;
+		for(const auto& name : projectDependencyNames)
+			addExternalDependency(target, name);
+		for(const auto& name : targetDependencyNames[i])
+			addExternalDependency(target, name);
+		CollectLiterals(targetJson, std::format("{}_link_args", gHostPlatformName), owner, target.linkArgs, rejectReasons);
+		CollectLiterals(targetJson, "link_with", owner, target.linkWith, rejectReasons);
+		for(const auto& name : target.linkWith)
+		{
+			auto it = project.targetIndices.find(name);
+			if(it == project.targetIndices.end() || (project.targets[it->second].type != TargetType::StaticLibrary && project.targets[it->second].type != TargetType::SharedLibrary))
+				rejectReasons.push_back(std::format("{}: '{}' in \"link_with\" is not a static or shared library target", owner, name));
+		}
+		// Internal dependencies: include directories and "use_defines" of the library, and the library itself to link with
+		for(const auto& names : { std::cref(projectDependencyNames), std::cref(targetDependencyNames[i]) })
+			for(const auto& name : names.get())
+			{
+				if(!isLibrary(name) || name == target.name)
+					continue;
+				const auto& library = project.targets[project.targetIndices.at(name)];
+				target.compileArgs.insert(target.compileArgs.end(), library.usageCompileArgs.begin(), library.usageCompileArgs.end());
+				if(library.type != TargetType::HeaderOnlyLibrary && std::ranges::find(target.linkWith, name) == target.linkWith.end())
+					target.linkWith.push_back(name);
+			}
+		target.compileArgs.insert(target.compileArgs.end(), defines.begin(), defines.end());
+		if(!target.isFastLinkLibrary)
+			target.compileArgs.push_back("-fvisibility=hidden");
+		if(target.type != TargetType::Executable)
+			target.compileArgs.push_back("-fPIC");
+
+		CollectHostLiterals(targetJson, "sources", owner, sources, rejectReasons);
+		sources.insert(sources.end(), projectSources.begin(), projectSources.end());
+		for(const auto& source : sources)
+		{
+			auto language = GetSourceLanguage(source);
+			if(language == SourceLanguage::Unsupported)
+				rejectReasons.push_back(std::format("{}: source '{}' is neither C nor C++", owner, source));
+			else if(language != SourceLanguage::Header)
+			{
+				target.isCpp |= (language == SourceLanguage::Cpp);
+				project.isCpp |= (language == SourceLanguage::Cpp);
+				project.isC |= (language == SourceLanguage::C);
+				target.sources.push_back(source);
+			}
+		}
+	}
+	return project;
+}
+
+// Appends the libraries the target links with, and recursively the ones the static libraries among them link with (as meson does)
+static void CollectLinkLibraries(const NinjaProject& project, const NinjaTarget& target, std::vector<const NinjaTarget*>& libraries, std::unordered_set<const NinjaTarget*>& visited)
+{
+	for(const auto& name : target.linkWith)
+	{
+		auto it = project.targetIndices.find(name);
+		if(it == project.targetIndices.end())
+			continue;
+		const NinjaTarget* library = &project.targets[it->second];
+		if(!visited.insert(library).second)
+			continue;
+		libraries.push_back(library);
+		if(library->type == TargetType::StaticLibrary)
+			CollectLinkLibraries(project, *library, libraries, visited);
+	}
+}
+
+// sourceRootPath: path of the project's root relative to the build directory
+static void WriteTargetBuildStatements(OutputBuffer& buffer, const NinjaProject& project, const NinjaTarget& target, const std::filesystem::path& sourceRootPath, bool isLinkPool)
+{
+	buffer << "# Target: " << target.name << "\n\n";
+	std::string escapedOutputPath = EscapeNinjaPath(target.outputPath);
+	std::vector<const NinjaTarget*> libraries;
+	std::unordered_set<const NinjaTarget*> visited { &target };
+	CollectLinkLibraries(project, target, libraries, visited);
+	auto getSourcePath = [&sourceRootPath](const std::string& source)
+	{
+		auto sourcePath = std::filesystem::path(source).is_absolute() ? std::filesystem::path(source) : (sourceRootPath / source).lexically_normal();
+		return EscapeNinjaPath(sourcePath.generic_string());
+	};
+
+	// The module interfaces are compiled first, each after the ones it imports, and their compiled interfaces (CMIs) are shared
+	// with the targets linking with the library (as the CMIs are in one directory of the build directory, see GetModuleInterfacePath())
+	std::vector<std::string> objectPaths;
+	std::string importableInterfacePaths;
+	if(project.cxxModules != CxxModules::None)
+	{
+		std::vector<const NinjaTarget*> owners { &target };
+		owners.insert(owners.end(), libraries.begin(), libraries.end());
+		for(const auto* owner : owners)
+			for(const auto& moduleInterface : owner->moduleInterfaces)
+				importableInterfacePaths.append(" ").append(EscapeNinjaPath(GetModuleInterfacePath(project.cxxModules, moduleInterface.name)));
+		for(const auto& moduleInterface : target.moduleInterfaces)
+		{
+			auto& objectPath = objectPaths.emplace_back(EscapeNinjaPath(GetObjectPath(target.outputPath, moduleInterface.sourcePath)));
+			buffer.Format("build {} | {}: cpp_COMPILER {}", objectPath, EscapeNinjaPath(GetModuleInterfacePath(project.cxxModules, moduleInterface.name)),
+							getSourcePath(moduleInterface.sourcePath));
+			// The imports of the other modules (e.g. std) are left to the compiler
+			for(bool isFirst = true; const auto& import : moduleInterface.imports)
+			{
+				if(!project.moduleNames.contains(import) || import == moduleInterface.name)
+					continue;
+				buffer << (isFirst ? " | " : " ") << EscapeNinjaPath(GetModuleInterfacePath(project.cxxModules, import));
+				isFirst = false;
+			}
+			buffer << "\n ARGS =";
+			AppendArgs(buffer, target.compileArgs);
+			AppendArgs(buffer, GetCxxModulesArgs(project.cxxModules, &moduleInterface));
+			buffer << "\n";
+		}
+	}
+	std::vector<std::string> cxxModulesArgs;
+	if(importableInterfacePaths.size())
+		cxxModulesArgs = GetCxxModulesArgs(project.cxxModules, nullptr);
+	for(const auto& source : target.sources)
+	{
+		auto& objectPath = objectPaths.emplace_back(EscapeNinjaPath(GetObjectPath(target.outputPath, source)));
+		bool isCpp = GetSourceLanguage(source) == SourceLanguage::Cpp;
+		buffer.Format("build {}: {}_COMPILER {}", objectPath, isCpp ? "cpp" : "c", getSourcePath(source));
+		// Any of the C++ sources may import the modules, so they are compiled after all of the module interfaces (and recompiled if any changes)
+		if(isCpp && importableInterfacePaths.size())
+			buffer << " |" << importableInterfacePaths;
+		buffer << "\n ARGS =";
+		AppendArgs(buffer, target.compileArgs);
+		if(isCpp)
+			AppendArgs(buffer, cxxModulesArgs);
+		buffer << "\n";
+	}
+
+	bool isCpp = target.isCpp || std::ranges::any_of(libraries, [](const NinjaTarget* library) { return library->isCpp; });
+	if(target.type == TargetType::StaticLibrary)
+		buffer.Format("build {}: STATIC_LINKER", escapedOutputPath);
+	else
+		buffer.Format("build {}: {}_LINKER", escapedOutputPath, isCpp ? "cpp" : "c");
+	for(const auto& objectPath : objectPaths)
+		buffer << ' ' << objectPath;
+	if(target.type != TargetType::StaticLibrary && libraries.size())
+	{
+		buffer << " |";
+		for(const auto* library : libraries)
+			buffer << ' ' << EscapeNinjaPath(library->outputPath);
+	}
+	buffer << "\n";
+	if(target.type == TargetType::StaticLibrary)
+	{
+		if(isLinkPool)
+			buffer << " pool = link_pool\n";
+		buffer << "\n";
+		return;
+	}
+
+	std::vector<std::string> linkArgs;
+#ifdef __APPLE__
+	if(target.type == TargetType::SharedLibrary)
+		linkArgs.insert(linkArgs.end(), { "-dynamiclib", std::format("-Wl,-install_name,@rpath/{}", target.outputPath) });
+	if(std::ranges::any_of(libraries, [](const NinjaTarget* library) { return library->type == TargetType::SharedLibrary; }))
+		linkArgs.push_back("-Wl,-rpath,@loader_path");
+	for(const auto* library : libraries)
+		linkArgs.push_back(library->outputPath);
+#else
+	linkArgs.push_back("-Wl,--as-needed");
+	linkArgs.push_back("-Wl,--no-undefined");
+	if(target.type == TargetType::SharedLibrary)
+		linkArgs.insert(linkArgs.end(), { "-shared", "-fPIC", std::format("-Wl,-soname,{}", target.outputPath) });
+	// The shared libraries of the project are found next to the executable (or the library) linking them, same as meson's build rpath
+	if(std::ranges::any_of(libraries, [](const NinjaTarget* library) { return library->type == TargetType::SharedLibrary; }))
+		linkArgs.push_back("-Wl,-rpath,$ORIGIN");
+	if(libraries.size())
+	{
+		linkArgs.push_back("-Wl,--start-group");
+		for(const auto* library : libraries)
+			linkArgs.push_back(library->outputPath);
+		linkArgs.push_back("-Wl,--end-group");
+	}
+#endif
+	linkArgs.insert(linkArgs.end(), target.linkArgs.begin(), target.linkArgs.end());
+	for(const auto* library : libraries)
+		if(library->type == TargetType::StaticLibrary)
+			linkArgs.insert(linkArgs.end(), library->linkArgs.begin(), library->linkArgs.end());
+	linkArgs.insert(linkArgs.end(), project.projectLinkArgs.begin(), project.projectLinkArgs.end());
+	buffer << " LINK_ARGS =";
+	AppendArgs(buffer, linkArgs);
+	buffer << "\n";
+	if(isLinkPool)
+		buffer << " pool = link_pool\n";
+	buffer << "\n";
+}
+
+// buildDirectoryPath: absolute path of the build directory
+// sourceRootPath: path of the project's root relative to the build directory
+static std::string GenerateNinjaBuildScript(std::string_view directory, const json& buildMasterJson, const NinjaProject& project, const ConfigureCommandArgs& args,
+											const std::filesystem::path& buildDirectoryPath, const std::filesystem::path& sourceRootPath)
+{
+	OutputBuffer buffer { 4096 + project.targets.size() * 1024 };
+	buffer.Format("# Generated By Build Master {} (direct ninja backend), do not edit\n", BUILDMASTER_VERSION_STRING);
+	buffer << "# It is regenerated by 'build_master configure' whenever build_master.json or the .pc files of the dependencies change\n\n";
+	buffer << "ninja_required_version = 1.8.2\n\n";
+
+	// Same as the options of the generated meson.build (warning_level=3, c_std=c17, cpp_std=c++20, and the buildtype), see MESON_BUILD_TEMPLATE_STR
+	std::vector<std::string> commonArgs { "-D_FILE_OFFSET_BITS=64", "-Wall", "-Winvalid-pch", "-Wextra", "-Wpedantic" };
+	if(args.buildType == "debug")
+		commonArgs.insert(commonArgs.end(), { "-O0", "-g" });
+	else if(args.buildType == "release")
+		commonArgs.push_back("-O3");
+	else
+		commonArgs.insert(commonArgs.end(), { "-O2", "-g" });
+	std::vector<std::string> machineArgs;
+	// -m64 is meant for the x86_64 hosts, a 32-bit x86 host is built for its own architecture
+#if defined(__x86_64__)
+	machineArgs.push_back("-m64");
+#endif
+	commonArgs.insert(commonArgs.end(), machineArgs.begin(), machineArgs.end());
+	// CC, CXX, CFLAGS, CXXFLAGS, and LDFLAGS are taken at the configure time, same as meson
+	// "resource_accounting": the compile and link jobs run through 'build_master cc-wrap', which records their resource usage (see RunCcWrap())
+	std::string launcher;
+	if(GetJsonKeyValue<bool>(buildMasterJson, "resource_accounting", false))
+		launcher = std::format(" {} cc-wrap", QuoteArg(GetSelfExecutablePath()));
+	buffer << "cc =" << launcher << GetEnvShellFragment("CC", "cc") << "\n";
+	buffer << "cxx =" << launcher << GetEnvShellFragment("CXX", "c++") << "\n";
+	buffer << "ar =" << GetEnvShellFragment("AR", "ar") << "\n";
+	buffer << "c_args = -std=c17";
+	AppendArgs(buffer, commonArgs);
+	buffer << GetEnvShellFragment("CPPFLAGS") << GetEnvShellFragment("CFLAGS") << "\n";
+	buffer << "cpp_args = -std=c++20";
+	AppendArgs(buffer, commonArgs);
+	buffer << GetEnvShellFragment("CPPFLAGS") << GetEnvShellFragment("CXXFLAGS") << "\n";
+	buffer << "link_args =";
+	AppendArgs(buffer, machineArgs);
+	if(project.linker.size())
+		buffer << " -fuse-ld=" << project.linker;
+	buffer << GetEnvShellFragment("LDFLAGS") << "\n\n";
+
+	// Links of the heavy targets may take gigabytes each, so the links are limited the same as meson's backend_max_links (see "max_parallel_links")
+	auto maxParallelLinks = GetJsonKeyValueOrNull<unsigned int>(buildMasterJson, "max_parallel_links");
+	if(!maxParallelLinks && std::ranges::any_of(project.targets, [](const NinjaTarget& target)
+		{
+			return GetJsonKeyValue<bool>(*target.targetJson, "heavy", false) || HasJsonKey(*target.targetJson, "memory_hint_mb");
+		}))
+		maxParallelLinks = gDefaultHeavyMaxParallelLinks;
+	if(maxParallelLinks)
+		buffer.Format("pool link_pool\n depth = {}\n\n", maxParallelLinks.value());
+
+	buffer << "rule c_COMPILER\n command = $cc $c_args $ARGS -MD -MQ $out -MF $out.d -o $out -c $in\n deps = gcc\n depfile = $out.d\n description = Compiling C object $out\n\n";
+	buffer << "rule cpp_COMPILER\n command = $cxx $cpp_args $ARGS -MD -MQ $out -MF $out.d -o $out -c $in\n deps = gcc\n depfile = $out.d\n description = Compiling C++ object $out\n\n";
+	buffer << "rule STATIC_LINKER\n command = rm -f $out && $ar crs $out $in\n description = Linking static target $out\n\n";
+	buffer << "rule c_LINKER\n command = $cc $link_args -o $out $in $LINK_ARGS\n description = Linking target $out\n\n";
+	buffer << "rule cpp_LINKER\n command = $cxx $link_args -o $out $in $LINK_ARGS\n description = Linking target $out\n\n";
+	buffer.Format("rule REGENERATE_BUILD\n command = {} --directory {} configure -C {} --buildtype {} --regenerate\n description = Regenerating build files\n generator = 1\n\n",
+					QuoteArg(GetSelfExecutablePath()), QuoteArg(GetAbsolutePath(directory).string()),
+					QuoteArg(buildDirectoryPath.string()), args.buildType);
+
+	std::vector<std::string_view> outputPaths;
+	for(const auto& target : project.targets)
+	{
+		if(target.type == TargetType::HeaderOnlyLibrary)
+			continue;
+		WriteTargetBuildStatements(buffer, project, target, sourceRootPath, maxParallelLinks.has_value());
+		outputPaths.push_back(target.outputPath);
+		// A target can be built by its name, as with 'meson compile <name>'
+		if(target.name != target.outputPath)
+			buffer.Format("build {}: phony {}\n\n", EscapeNinjaPath(target.name), EscapeNinjaPath(target.outputPath));
+	}
+
+	buffer << "# Regeneration\n\n";
+	buffer.Format("build build.ninja: REGENERATE_BUILD {}", EscapeNinjaPath((sourceRootPath / "build_master.json").lexically_normal().generic_string()));
+	for(const auto& pcFilePath : project.pcFilePaths)
+		buffer << ' ' << EscapeNinjaPath(pcFilePath);
+	if(project.cxxModules != CxxModules::None)
+		for(const auto& moduleSourcePath : project.moduleSourcePaths)
+			buffer << ' ' << EscapeNinjaPath(moduleSourcePath);
+	buffer << "\n pool = console\n\n";
+	buffer << "build all: phony";
+	for(const auto& outputPath : outputPaths)
+		buffer << ' ' << EscapeNinjaPath(outputPath);
+	buffer << "\n\ndefault all\n";
+	return buffer.Release();
+}
+
+// Returns the reasons the compilers (CC and CXX, or cc and c++) can't be used, if they are needed
+static void CheckCompilers(const NinjaProject& project, RejectReasons& rejectReasons)
+{
+	auto check = [&rejectReasons](const char* envVarName, std::string_view defaultCommand)
+	{
+		const char* value = std::getenv(envVarName);
+		auto executable = GetCommandExecutable((value && *value) ? std::string_view { value } : defaultCommand);
+		if(executable.empty() || (!std::filesystem::path(executable).is_absolute() && !invoke::FindExecutable(executable)))
+			rejectReasons.push_back(std::format("compiler '{}' is not found (set {} to use another one)", executable, envVarName));
+	};
+	if(project.isC)
+		check("CC", "cc");
+	if(project.isCpp)
+		check("CXX", "c++");
+}
+
+// Compiles a module interface with the C++ compiler (CXX) the GCC way, then the Clang way, to find out how it builds the C++20 modules (if at all)
+static CxxModules ProbeCxxModules()
+{
+	if(const char* value = std::getenv("BUILD_MASTER_CXX_MODULES"); value && std::string_view { value } == "0")
+		return CxxModules::None;
+	std::error_code errorCode;
+	auto probeDirPath = std::filesystem::temp_directory_path(errorCode)
+						/ std::format("build_master_modules_probe_{}", std::chrono::steady_clock::now().time_since_epoch().count());
+	std::filesystem::create_directories(probeDirPath / gClangModulesDirPath, errorCode);
+	OverwriteTextFile((probeDirPath / "probe.cppm").string(), "export module build_master_probe;\nexport int build_master_probe() { return 0; }\n");
+	const char* cxx = std::getenv("CXX");
+	const char* cxxFlags = std::getenv("CXXFLAGS");
+	auto tryCompile = [&](CxxModules cxxModules, std::string_view args)
+	{
+		auto command = std::format("{} {} -std=c++20 {} -c probe.cppm -o probe.o", (cxx && *cxx) ? cxx : "c++", cxxFlags ? cxxFlags : "", args);
+		return RunProcess({ "/bin/sh", "-c", command }, probeDirPath.string(), { }, (probeDirPath / "probe.log").string()).exitCode == 0
+			&& std::filesystem::exists(probeDirPath / GetModuleInterfacePath(cxxModules, "build_master_probe"));
+	};
+	CxxModules cxxModules = CxxModules::None;
+	if(tryCompile(CxxModules::Gcc, "-fmodules-ts -x c++"))
+		cxxModules = CxxModules::Gcc;
+	else if(tryCompile(CxxModules::Clang, std::format("-x c++-module -fmodule-output={}", GetModuleInterfacePath(CxxModules::Clang, "build_master_probe"))))
+		cxxModules = CxxModules::Clang;
+	std::filesystem::remove_all(probeDirPath, errorCode);
+	return cxxModules;
+}
+
+// Returns the first of the candidates (see GetLinkerCandidates()) which links a test program with the compilers (CC and CXX) the project uses, or null if none does
+static std::optional<std::string_view> ProbeLinker(const NinjaProject& project, const std::vector<std::string_view>& candidates)
+{
+	std::error_code errorCode;
+	auto probeDirPath = std::filesystem::temp_directory_path(errorCode)
+						/ std::format("build_master_linker_probe_{}", std::chrono::steady_clock::now().time_since_epoch().count());
+	std::filesystem::create_directories(probeDirPath, errorCode);
+	OverwriteTextFile((probeDirPath / "probe.c").string(), "int main(void) { return 0; }\n");
+	auto tryLink = [&](std::string_view linker, const char* compilerEnvVarName, std::string_view defaultCompiler, const char* flagsEnvVarName, std::string_view language)
+	{
+		const char* compiler = std::getenv(compilerEnvVarName);
+		const char* flags = std::getenv(flagsEnvVarName);
+		const char* ldFlags = std::getenv("LDFLAGS");
+		auto command = std::format("{} {} {} -fuse-ld={} -x {} probe.c -o probe", (compiler && *compiler) ? compiler : defaultCompiler, flags ? flags : "", ldFlags ? ldFlags : "", linker, language);
+		return RunProcess({ "/bin/sh", "-c", command }, probeDirPath.string(), { }, (probeDirPath / "probe.log").string()).exitCode == 0;
+	};
+	std::optional<std::string_view> result;
+	for(const auto& linker : candidates)
+	{
+		if((!project.isC || tryLink(linker, "CC", "cc", "CFLAGS", "c")) && (!project.isCpp || tryLink(linker, "CXX", "c++", "CXXFLAGS", "c++")))
+		{
+			result = linker;
+			break;
+		}
+	}
+	std::filesystem::remove_all(probeDirPath, errorCode);
+	return result;
+}
+
+// directory: value passed to --directory flag
+int RunConfigure(std::string_view directory, const ConfigureCommandArgs& args)
+{
+	if(std::ranges::find(gBuildTypes, args.buildType) == std::end(gBuildTypes))
+	{
+		spdlog::error("Unsupported buildtype {}, it must be one of: debug, release, or debugoptimized", args.buildType);
+		return EXIT_FAILURE;
+	}
+	if(!std::filesystem::exists(GetBuildMasterJsonFilePath(directory)))
+	{
+		spdlog::error("build_master.json doesn't exist in {}", std::filesystem::absolute(directory).string());
+		return EXIT_FAILURE;
+	}
+	auto buildDirectory = GetPathStrRelativeToDir(directory, args.buildDirectory);
+	if(std::filesystem::exists(std::filesystem::path(buildDirectory) / "meson-private" / "coredata.dat"))
+	{
+		spdlog::error("{} is configured by meson, use another build directory (or remove it) for the direct ninja backend", buildDirectory);
+		return EXIT_FAILURE;
+	}
+	auto startTime = std::chrono::steady_clock::now();
+	// Same as 'build_master meson setup', the prebuilt dependencies extend PKG_CONFIG_PATH so that pkg-config finds them
+	// While regenerating (within a build) they are only found and the hooks aren't run, as meson's own regeneration doesn't run them either
+	PreparePrebuiltDependencies(directory, !args.isRegenerate);
+	if(!args.isRegenerate)
+		RunPreConfigScript(directory);
+	json buildMasterJson = LoadProjectModel(directory);
+
+	auto buildDirectoryPath = GetAbsolutePath(buildDirectory);
+	auto sourceRootPath = GetAbsolutePath(directory).lexically_relative(buildDirectoryPath);
+	// On another drive (Windows)
+	if(sourceRootPath.empty())
+		sourceRootPath = GetAbsolutePath(directory);
+	RejectReasons rejectReasons;
+#ifdef _WIN32
+	rejectReasons.push_back("Windows (MSVC and MinGW) isn't supported by the direct ninja backend");
+#endif
+	NinjaProject project = ResolveProject(directory, buildMasterJson, args.buildType, sourceRootPath, rejectReasons);
+	CheckCompilers(project, rejectReasons);
+	if(rejectReasons.size())
+	{
+		std::string reasonsStr;
+		for(const auto& reason : rejectReasons)
+			reasonsStr.append(std::format("\n\t{}", reason));
+		spdlog::error("The project can't be configured without meson, use 'build_master meson setup {}' instead:{}", args.buildDirectory, reasonsStr);
+		return EXIT_FAILURE;
+	}
+	if(HasJsonKey(buildMasterJson, "install_headers") || HasJsonKey(buildMasterJson, "install_header_dirs"))
+		spdlog::info("Installing needs a build directory configured by meson, the install keys of build_master.json are ignored");
+	if(project.moduleNames.size())
+	{
+		project.cxxModules = ProbeCxxModules();
+		if(project.cxxModules == CxxModules::None)
+			spdlog::info("The C++ compiler doesn't support C++20 modules (or BUILD_MASTER_CXX_MODULES=0), the targets are built in header mode, without their \"module_sources\"");
+		else
+			spdlog::info("C++20 modules are built the {} way", (project.cxxModules == CxxModules::Gcc) ? "GCC (-fmodules-ts)" : "Clang (-fmodule-output)");
+	}
+	std::vector<std::string_view> linkerCandidates;
+	try
+	{
+		linkerCandidates = GetLinkerCandidates(buildMasterJson);
+	}
+	catch(const ProjectModelError& error)
+	{
+		spdlog::error("{}", error.what());
+		return EXIT_FAILURE;
+	}
+	if(linkerCandidates.size())
+	{
+		auto linker = ProbeLinker(project, linkerCandidates);
+		if(!linker && linkerCandidates.size() == 1)
+		{
+			spdlog::error("The linker {} (\"linker\" in build_master.json) doesn't work with the compilers, is it installed?", linkerCandidates.front());
+			return EXIT_FAILURE;
+		}
+		project.linker = linker.value_or("");
+		spdlog::info("Linker: {}", linker.value_or("default"));
+	}
+
+	std::filesystem::create_directories(buildDirectoryPath);
+	if(project.cxxModules == CxxModules::Clang)
+		std::filesystem::create_directories(buildDirectoryPath / gClangModulesDirPath);
+	// Always rewritten, ninja would keep regenerating it if it stayed older than build_master.json
+	OverwriteTextFile((buildDirectoryPath / "build.ninja").string(), GenerateNinjaBuildScript(directory, buildMasterJson, project, args, buildDirectoryPath, sourceRootPath));
+
+	// The targets in meson's introspection format, so that the target lookups of 'build_master build' and the heavy targets' pool (see ApplyJobPlan()) work the same
+	json targetsJson = json::array();
+	for(const auto& target : project.targets)
+		if(target.type != TargetType::HeaderOnlyLibrary)
+			targetsJson.push_back({
+				{ "name", target.name },
+				{ "type", GetTargetTypeStr(target.type) },
+				{ "filename", json::array({ (buildDirectoryPath / target.outputPath).string() }) }
+			});
+	WriteTextFileIfChanged((buildDirectoryPath / "meson-info" / "intro-targets.json").string(), targetsJson.dump(4));
+	json stateJson = {
+		{ "build_master_version", BUILDMASTER_VERSION_STRING },
+		{ "source_directory", GetAbsolutePath(directory).string() },
+		{ "buildtype", args.buildType }
+	};
+	WriteTextFileIfChanged((buildDirectoryPath / gNinjaBackendStateFileName).string(), stateJson.dump(4));
+
+	double configureTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	std::cout << std::format("Configured {} ({} targets, buildtype {}) in {:.1f} ms, build it with 'build_master build -C {}'",
+								buildDirectory, project.targets.size(), args.buildType, configureTime, args.buildDirectory) << "\n";
+	return EXIT_SUCCESS;
+}
+
+// buildDirectory: path of the build directory relative to the current working directory
+bool IsNinjaBackendBuildDirectory(std::string_view buildDirectory)
+{
+	auto buildDirectoryPath = std::filesystem::path(buildDirectory);
+	return std::filesystem::exists(buildDirectoryPath / gNinjaBackendStateFileName)
+		&& !std::filesystem::exists(buildDirectoryPath / "meson-private" / "coredata.dat");
+}
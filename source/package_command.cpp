@@ -0,0 +1,725 @@
+#include <build_master/package_command.hpp>
+#include <build_master/invoke_meson.hpp> // for RunMesonCmd()
+#include <build_master/json_parse.hpp> // for ParseJsonFile(), ParseBuildMasterJson(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), and SelectPath()
+#include <build_master/process.hpp> // for RunProcess(), and RunCmdCaptureOutput()
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <optional>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <cstdint>
+#include <cctype>
+#include <bit>
+#include <functional>
+#include <iterator>
+
+#include <spdlog/spdlog.h>
+#include <invoke/invoke.hpp> // for invoke::FindExecutable()
+
+static constexpr std::string_view gPackageStageDirPath = "build_master_package_stage";
+static constexpr std::string_view gPackageDebugStageDirPath = "build_master_package_debug_stage";
+// The split debug info of <path of the binary> goes into usr/lib/debug/<path of the binary>.debug, where gdb looks for it
+static constexpr std::string_view gDebugDirPath = "usr/lib/debug";
+static constexpr std::size_t gTarBlockSize = 512;
+// GNU tar pads the archive to a multiple of 20 blocks
+static constexpr std::size_t gTarRecordSize = 20 * gTarBlockSize;
+static constexpr std::size_t gCopyChunkSize = 1024 * 1024;
+static constexpr double gMiB = 1024 * 1024;
+
+enum class PackageFormat
+{
+	TarZst,
+	TarXz,
+	Deb
+};
+
+// A file, symlink or directory in the staging directory
+struct PackageEntry
+{
+	// Path relative to the staging directory, with '/' separators
+	std::string path;
+	std::filesystem::path sourcePath;
+	std::filesystem::file_type type { std::filesystem::file_type::regular };
+	// Normalized (see GetNormalizedPerms()), it isn't copied from the staging directory
+	std::filesystem::perms perms { std::filesystem::perms::none };
+	std::uint64_t size { 0 };
+	std::string linkTarget;
+};
+
+// Returns 0755 for the directories and the executables (any of the execute bits is set), and 0644 for the other files
+// The modes in the staging directory depend on the umask of the packager, so the archives wouldn't be reproducible across machines otherwise
+static std::filesystem::perms GetNormalizedPerms(std::filesystem::file_type type, std::filesystem::perms stagedPerms)
+{
+	using Perms = std::filesystem::perms;
+	constexpr auto executablePerms = Perms::owner_exec | Perms::group_exec | Perms::others_exec;
+	if(type == std::filesystem::file_type::directory || (stagedPerms & executablePerms) != Perms::none)
+		return Perms::owner_all | Perms::group_read | Perms::group_exec | Perms::others_read | Perms::others_exec;
+	return Perms::owner_read | Perms::owner_write | Perms::group_read | Perms::others_read;
+}
+
+// Returns the entries under the root path sorted by their paths, so that the archives don't depend on the order of the directory listing
+static std::vector<PackageEntry> CollectEntries(const std::filesystem::path& rootPath)
+{
+	std::vector<PackageEntry> entries;
+	if(!std::filesystem::exists(rootPath))
+		return entries;
+	for(const auto& dirEntry : std::filesystem::recursive_directory_iterator(rootPath))
+	{
+		PackageEntry entry;
+		entry.sourcePath = dirEntry.path();
+		entry.path = dirEntry.path().lexically_relative(rootPath).generic_string();
+		auto status = dirEntry.symlink_status();
+		entry.type = status.type();
+		entry.perms = GetNormalizedPerms(entry.type, status.permissions());
+		if(entry.type == std::filesystem::file_type::regular)
+			entry.size = dirEntry.file_size();
+		else if(entry.type == std::filesystem::file_type::symlink)
+			entry.linkTarget = std::filesystem::read_symlink(dirEntry.path()).generic_string();
+		else if(entry.type != std::filesystem::file_type::directory)
+			continue;
+		entries.push_back(std::move(entry));
+	}
+	std::ranges::sort(entries, { }, &PackageEntry::path);
+	return entries;
+}
+
+// Writes a reproducible (ustar, with pax headers for the long paths) tar archive
+// Every entry is owned by root:root, and has the same mtime
+class TarWriter
+{
+private:
+	std::ofstream m_stream;
+	std::int64_t m_mtime;
+	std::uint64_t m_size { 0 };
+
+	// Octal number right aligned in the field (with a trailing NUL), e.g. "0000644\0" for a field of 8 bytes
+	static void WriteOctal(char* field, std::size_t fieldSize, std::uint64_t value)
+	{
+		auto str = std::format("{:0{}o}", value, fieldSize - 1);
+		std::memcpy(field, str.data(), std::min(str.size(), fieldSize - 1));
+	}
+
+	static void WriteString(char* field, std::size_t fieldSize, std::string_view str)
+	{
+		std::memcpy(field, str.data(), std::min(str.size(), fieldSize));
+	}
+
+	void Write(const char* data, std::size_t size)
+	{
+		m_stream.write(data, static_cast<std::streamsize>(size));
+		m_size += size;
+	}
+
+	void WritePadding(std::size_t size)
+	{
+		static constexpr char zeros[gTarBlockSize] = { };
+		while(size)
+		{
+			std::size_t count = std::min(size, gTarBlockSize);
+			Write(zeros, count);
+			size -= count;
+		}
+	}
+
+	void WriteHeader(std::string_view path, char typeFlag, std::uint64_t mode, std::uint64_t size, std::string_view linkTarget)
+	{
+		char header[gTarBlockSize] = { };
+		WriteString(header, 100, path);
+		WriteOctal(header + 100, 8, mode);
+		WriteOctal(header + 108, 8, 0);
+		WriteOctal(header + 116, 8, 0);
+		WriteOctal(header + 124, 12, size);
+		WriteOctal(header + 136, 12, static_cast<std::uint64_t>(m_mtime));
+		header[156] = typeFlag;
+		WriteString(header + 157, 100, linkTarget);
+		WriteString(header + 257, 6, std::string_view { "ustar\0", 6 });
+		WriteString(header + 263, 2, "00");
+		WriteString(header + 265, 32, "root");
+		WriteString(header + 297, 32, "root");
+		// The checksum is computed with the checksum field filled with spaces
+		std::memset(header + 148, ' ', 8);
+		std::uint64_t checksum = 0;
+		for(char ch : header)
+			checksum += static_cast<unsigned char>(ch);
+		WriteOctal(header + 148, 7, checksum);
+		Write(header, sizeof(header));
+	}
+
+	// The paths (and the link targets) longer than 100 characters go into a pax extended header, which precedes the entry
+	void WritePaxHeader(std::string_view path, std::string_view linkTarget)
+	{
+		std::string records;
+		auto addRecord = [&records](std::string_view key, std::string_view value)
+		{
+			// "<length> <key>=<value>\n", where the length includes its own digits
+			std::size_t length = key.size() + value.size() + 3;
+			std::size_t digitCount = std::to_string(length).size();
+			while(std::to_string(length + digitCount).size() != digitCount)
+				++digitCount;
+			records.append(std::format("{} {}={}\n", length + digitCount, key, value));
+		};
+		if(path.size() > 100)
+			addRecord("path", path);
+		if(linkTarget.size() > 100)
+			addRecord("linkpath", linkTarget);
+		if(records.empty())
+			return;
+		WriteHeader("././@PaxHeader", 'x', 0644, records.size(), "");
+		Write(records.data(), records.size());
+		WritePadding((gTarBlockSize - records.size() % gTarBlockSize) % gTarBlockSize);
+	}
+
+public:
+	TarWriter(const std::filesystem::path& filePath, std::int64_t mtime) : m_stream(filePath, std::ios_base::binary | std::ios_base::trunc), m_mtime(mtime) { }
+
+	bool IsOpen() const { return m_stream.is_open(); }
+	// Number of bytes written so far
+	std::uint64_t GetSize() const noexcept { return m_size; }
+
+	// pathPrefix: prepended to the path of the entry, e.g. "./" for the Debian packages
+	void AddEntry(const PackageEntry& entry, std::string_view pathPrefix = "")
+	{
+		std::string path = std::format("{}{}", pathPrefix, entry.path);
+		std::uint64_t mode = static_cast<std::uint64_t>(entry.perms & std::filesystem::perms::mask);
+		switch(entry.type)
+		{
+			case std::filesystem::file_type::directory:
+			{
+				if(!path.ends_with('/'))
+					path.push_back('/');
+				WritePaxHeader(path, "");
+				WriteHeader(path, '5', mode, 0, "");
+				break;
+			}
+			case std::filesystem::file_type::symlink:
+			{
+				WritePaxHeader(path, entry.linkTarget);
+				WriteHeader(path, '2', 0777, 0, entry.linkTarget);
+				break;
+			}
+			default:
+			{
+				WritePaxHeader(path, "");
+				WriteHeader(path, '0', mode, entry.size, "");
+				std::ifstream stream(entry.sourcePath, std::ios_base::binary);
+				if(!stream.is_open())
+					throw std::runtime_error(std::format("Failed to open {}", entry.sourcePath.string()));
+				std::string buffer(gCopyChunkSize, '\0');
+				std::uint64_t remainingSize = entry.size;
+				while(remainingSize && stream.read(buffer.data(), static_cast<std::streamsize>(std::min<std::uint64_t>(remainingSize, buffer.size()))))
+				{
+					Write(buffer.data(), static_cast<std::size_t>(stream.gcount()));
+					remainingSize -= static_cast<std::uint64_t>(stream.gcount());
+				}
+				if(remainingSize)
+					throw std::runtime_error(std::format("{} has changed while it was being archived", entry.sourcePath.string()));
+				WritePadding((gTarBlockSize - entry.size % gTarBlockSize) % gTarBlockSize);
+				break;
+			}
+		}
+	}
+
+	// A regular file whose content is given
+	void AddFile(std::string_view path, std::string_view content, std::uint64_t mode = 0644)
+	{
+		WritePaxHeader(path, "");
+		WriteHeader(path, '0', mode, content.size(), "");
+		Write(content.data(), content.size());
+		WritePadding((gTarBlockSize - content.size() % gTarBlockSize) % gTarBlockSize);
+	}
+
+	void AddDirectory(std::string_view path, std::uint64_t mode = 0755)
+	{
+		WriteHeader(path, '5', mode, 0, "");
+	}
+
+	// Returns false if the archive couldn't be written
+	bool Finish()
+	{
+		// Two zero blocks mark the end of the archive
+		WritePadding(2 * gTarBlockSize);
+		WritePadding((gTarRecordSize - m_size % gTarRecordSize) % gTarRecordSize);
+		m_stream.close();
+		return !m_stream.fail();
+	}
+};
+
+// Returns the fixed mtime of the archive entries, SOURCE_DATE_EPOCH (see https://reproducible-builds.org/specs/source-date-epoch/) or 0
+static std::int64_t GetSourceDateEpoch()
+{
+	if(const char* value = std::getenv("SOURCE_DATE_EPOCH"); value && *value)
+	{
+		try
+		{
+			return std::stoll(value);
+		}
+		catch(const std::exception&)
+		{
+			spdlog::warn("SOURCE_DATE_EPOCH={} isn't a number, 0 is used instead", value);
+		}
+	}
+	return 0;
+}
+
+// Returns full path of the executable, the environment variable (e.g. OBJCOPY) takes the precedence
+static std::optional<std::string> FindTool(std::string_view name, const char* envVarName = nullptr)
+{
+	if(const char* path = envVarName ? std::getenv(envVarName) : nullptr; path && *path)
+		return { path };
+	if(auto paths = invoke::FindExecutable(name); paths && paths->size())
+		return { SelectPath(paths.value()) };
+	return { };
+}
+
+// Returns true if the file is an ELF binary (of the native byte order) having the DWARF debug info, i.e. its .debug_info section
+// The binaries without the debug info (e.g. stripped ones) are left as is, there is nothing to split.
+static bool HasElfDebugInfo(const std::filesystem::path& filePath)
+{
+	std::ifstream stream(filePath, std::ios_base::binary);
+	unsigned char ident[16] = { };
+	if(!stream.read(reinterpret_cast<char*>(ident), sizeof(ident)) || std::memcmp(ident, "\x7f" "ELF", 4) != 0)
+		return false;
+	bool is64Bit = ident[4] == 2;
+	// ELFDATA2LSB or ELFDATA2MSB must match the native byte order, the cross compiled binaries of the other byte order are left as is
+	if(ident[5] != ((std::endian::native == std::endian::little) ? 1 : 2))
+		return false;
+	auto readAt = [&stream]<typename T>(std::uint64_t offset, T& value) -> bool
+	{
+		stream.seekg(static_cast<std::streamoff>(offset));
+		return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+	};
+	std::uint64_t sectionHeadersOffset = 0;
+	std::uint16_t sectionHeaderSize = 0, sectionCount = 0, namesSectionIndex = 0;
+	bool isRead = is64Bit ? readAt(0x28, sectionHeadersOffset) : [&]() { std::uint32_t offset = 0; bool result = readAt(0x20, offset); sectionHeadersOffset = offset; return result; }();
+	std::uint64_t sizesOffset = is64Bit ? 0x3a : 0x2e;
+	isRead = isRead && readAt(sizesOffset, sectionHeaderSize) && readAt(sizesOffset + 2, sectionCount) && readAt(sizesOffset + 4, namesSectionIndex);
+	if(!isRead || !sectionHeadersOffset || namesSectionIndex >= sectionCount)
+		return false;
+	// Returns { sh_name, sh_offset, sh_size } of the section
+	auto readSection = [&](std::uint16_t index, std::uint32_t& nameOffset, std::uint64_t& offset, std::uint64_t& size) -> bool
+	{
+		std::uint64_t headerOffset = sectionHeadersOffset + std::uint64_t { index } * sectionHeaderSize;
+		if(is64Bit)
+			return readAt(headerOffset, nameOffset) && readAt(headerOffset + 0x18, offset) && readAt(headerOffset + 0x20, size);
+		std::uint32_t offset32 = 0, size32 = 0;
+		bool result = readAt(headerOffset, nameOffset) && readAt(headerOffset + 0x10, offset32) && readAt(headerOffset + 0x14, size32);
+		offset = offset32;
+		size = size32;
+		return result;
+	};
+	std::uint32_t nameOffset = 0;
+	std::uint64_t namesOffset = 0, namesSize = 0;
+	if(!readSection(namesSectionIndex, nameOffset, namesOffset, namesSize) || namesSize > 16 * gMiB)
+		return false;
+	std::string names(namesSize, '\0');
+	stream.seekg(static_cast<std::streamoff>(namesOffset));
+	if(!stream.read(names.data(), static_cast<std::streamsize>(names.size())))
+		return false;
+	for(std::uint16_t i = 0; i < sectionCount; ++i)
+	{
+		std::uint64_t offset = 0, size = 0;
+		if(!readSection(i, nameOffset, offset, size) || nameOffset >= names.size())
+			continue;
+		std::string_view name { names.c_str() + nameOffset };
+		if(name == ".debug_info" || name == ".zdebug_info")
+			return true;
+	}
+	return false;
+}
+
+// A binary whose debug info is split into debugPath
+struct DebugSplitItem
+{
+	std::filesystem::path binaryPath;
+	std::filesystem::path debugPath;
+	std::uint64_t size { 0 };
+	bool isFailed { false };
+};
+
+// Splits the debug info of the staged ELF binaries into the debug staging directory in parallel, the binaries are stripped of it and get a .gnu_debuglink
+// Returns the number of the binaries split, or null if any of them couldn't be split
+static std::optional<std::size_t> SplitDebugInfo(const std::string& objcopyPath, const std::vector<PackageEntry>& entries, const std::filesystem::path& debugStagePath, unsigned int jobCount)
+{
+	std::vector<DebugSplitItem> items;
+	for(const auto& entry : entries)
+	{
+		if(entry.type != std::filesystem::file_type::regular || entry.path.starts_with(gDebugDirPath) || !HasElfDebugInfo(entry.sourcePath))
+			continue;
+		DebugSplitItem item;
+		item.binaryPath = entry.sourcePath;
+		item.debugPath = debugStagePath / gDebugDirPath / std::format("{}.debug", entry.path);
+		item.size = entry.size;
+		items.push_back(std::move(item));
+	}
+	// The large binaries first, so that a large binary doesn't start last and stretch the total time
+	std::ranges::sort(items, std::ranges::greater { }, &DebugSplitItem::size);
+	std::atomic<std::size_t> nextIndex { 0 };
+	{
+		std::vector<std::jthread> workers;
+		for(unsigned int i = 0; i < std::min<std::size_t>(jobCount, items.size()); ++i)
+			workers.emplace_back([&]()
+			{
+				for(std::size_t index; (index = nextIndex.fetch_add(1)) < items.size();)
+				{
+					DebugSplitItem& item = items[index];
+					std::error_code errorCode;
+					std::filesystem::create_directories(item.debugPath.parent_path(), errorCode);
+					item.isFailed = RunProcess({ objcopyPath, "--only-keep-debug", item.binaryPath.string(), item.debugPath.string() }).exitCode != 0
+									|| RunProcess({ objcopyPath, "--strip-debug", std::format("--add-gnu-debuglink={}", item.debugPath.string()), item.binaryPath.string() }).exitCode != 0;
+				}
+			});
+	}
+	std::size_t failedCount = 0;
+	for(const auto& item : items)
+		if(item.isFailed)
+		{
+			spdlog::error("Failed to split the debug info of {}", item.binaryPath.string());
+			++failedCount;
+		}
+	if(failedCount)
+		return { };
+	return { items.size() };
+}
+
+// Name of the Debian package: lower case, and '_' isn't allowed
+static std::string GetDebPackageName(std::string_view canonicalName)
+{
+	std::string name;
+	for(char ch : canonicalName)
+		name.push_back(ch == '_' ? '-' : static_cast<char>(std::tolower(static_cast<unsigned char>(ch))));
+	return name;
+}
+
+// Returns the Debian architecture of the host, e.g. amd64
+static std::string GetDebArchitecture()
+{
+	if(auto architecture = RunCmdCaptureOutput({ "dpkg", "--print-architecture" }))
+		return architecture.value();
+	std::string machine = RunCmdCaptureOutput({ "uname", "-m" }).value_or("unknown");
+	static constexpr std::pair<std::string_view, std::string_view> architectures[] =
+	{
+		{ "x86_64", "amd64" }, { "aarch64", "arm64" }, { "i686", "i386" }, { "i386", "i386" }, { "armv7l", "armhf" }, { "riscv64", "riscv64" }, { "ppc64le", "ppc64el" }
+	};
+	for(const auto& [unameMachine, architecture] : architectures)
+		if(machine == unameMachine)
+			return std::string { architecture };
+	return machine;
+}
+
+// Metadata of the package, taken from build_master.json and meson's introspection data
+struct PackageInfo
+{
+	std::string name;
+	std::string version;
+	std::string description;
+	std::string maintainer;
+	std::string architecture;
+};
+
+// Returns path of the debug package corresponding to the package, e.g. foo-1.0.tar.zst -> foo-1.0-dbg.tar.zst, foo_1.0_amd64.deb -> foo-dbgsym_1.0_amd64.deb
+static std::filesystem::path GetDebugPackagePath(const std::filesystem::path& packagePath, PackageFormat format, const PackageInfo& info)
+{
+	if(format == PackageFormat::Deb)
+		return packagePath.parent_path() / std::format("{}-dbgsym_{}_{}.deb", GetDebPackageName(info.name), info.version, info.architecture);
+	std::string fileName = packagePath.filename().string();
+	std::string_view extension = (format == PackageFormat::TarZst) ? ".tar.zst" : ".tar.xz";
+	std::string stem = fileName.ends_with(extension) ? fileName.substr(0, fileName.size() - extension.size()) : fileName;
+	return packagePath.parent_path() / std::format("{}-dbg{}", stem, extension);
+}
+
+// Compresses the file in place (it is replaced with <path>.zst or <path>.xz) with the multi threaded zstd or xz
+// The output of both doesn't depend on the number of threads: zstd splits the input into the same jobs regardless of it,
+// and xz is given a fixed block size (the multi threaded xz compresses the blocks independently)
+// NOTE: xz -T1 falls back to the single threaded mode (its output differs), so xz is given at least 2 threads
+static std::optional<std::filesystem::path> CompressFile(const std::string& compressorPath, PackageFormat format, const std::filesystem::path& filePath, unsigned int jobCount, int level)
+{
+	std::vector<std::string> args { compressorPath, "-q", "-f", std::format("-T{}", (format == PackageFormat::TarZst) ? jobCount : std::max(jobCount, 2u)) };
+	std::filesystem::path outputPath = filePath;
+	if(format == PackageFormat::TarZst)
+	{
+		level = level ? level : 19;
+		if(level > 19)
+			args.push_back("--ultra");
+		args.insert(args.end(), { std::format("-{}", level), "--rm", "--no-progress" });
+		outputPath += ".zst";
+	}
+	else
+	{
+		args.insert(args.end(), { std::format("-{}", level ? level : 6), "--block-size=16MiB" });
+		outputPath += ".xz";
+	}
+	args.push_back(filePath.string());
+	if(RunProcess(args).exitCode != 0)
+		return { };
+	return { outputPath };
+}
+
+// Appends a member to the ar archive (of a Debian package), all of its metadata is fixed
+static void WriteArMember(std::ofstream& stream, std::string_view name, std::string_view content, std::int64_t mtime)
+{
+	// name (16), mtime (12), uid (6), gid (6), mode (8), size (10), and "`\n"
+	stream << std::format("{:<16}{:<12}{:<6}{:<6}{:<8}{:<10}`\n", name, mtime, 0, 0, 100644, content.size());
+	stream.write(content.data(), static_cast<std::streamsize>(content.size()));
+	if(content.size() % 2)
+		stream << '\n';
+}
+
+static std::optional<std::string> LoadBinaryFileOrNull(const std::filesystem::path& filePath)
+{
+	std::ifstream stream(filePath, std::ios_base::binary);
+	if(!stream.is_open())
+		return { };
+	return { std::string { std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() } };
+}
+
+// Sizes and times of packaging the entries, for the report
+struct ArchiveStats
+{
+	std::uint64_t inputSize { 0 };
+	std::uint64_t outputSize { 0 };
+	double archiveTime { 0 };
+	double compressTime { 0 };
+};
+
+// Writes the entries into a compressed tarball at packagePath
+// pathPrefix: prepended to the paths of the entries
+static std::optional<ArchiveStats> WriteTarball(const std::vector<PackageEntry>& entries, const std::filesystem::path& packagePath, std::string_view pathPrefix,
+												const std::string& compressorPath, PackageFormat format, unsigned int jobCount, int level, std::int64_t mtime,
+												const std::function<void(TarWriter&)>& addExtraEntries = { })
+{
+	ArchiveStats stats;
+	auto startTime = std::chrono::steady_clock::now();
+	auto tarPath = packagePath.parent_path() / std::format(".{}.build_master-tmp.tar", packagePath.filename().string());
+	{
+		TarWriter writer(tarPath, mtime);
+		if(!writer.IsOpen())
+		{
+			spdlog::error("Failed to create {}", tarPath.string());
+			return { };
+		}
+		if(addExtraEntries)
+			addExtraEntries(writer);
+		for(const auto& entry : entries)
+			writer.AddEntry(entry, pathPrefix);
+		if(!writer.Finish())
+		{
+			spdlog::error("Failed to write {}", tarPath.string());
+			return { };
+		}
+		stats.inputSize = writer.GetSize();
+	}
+	auto archiveEndTime = std::chrono::steady_clock::now();
+	stats.archiveTime = std::chrono::duration<double>(archiveEndTime - startTime).count();
+	auto compressedPath = CompressFile(compressorPath, format == PackageFormat::Deb ? PackageFormat::TarXz : format, tarPath, jobCount, level);
+	std::error_code errorCode;
+	if(!compressedPath)
+	{
+		std::filesystem::remove(tarPath, errorCode);
+		spdlog::error("Failed to compress {}", tarPath.string());
+		return { };
+	}
+	std::filesystem::rename(compressedPath.value(), packagePath);
+	stats.compressTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - archiveEndTime).count();
+	stats.outputSize = std::filesystem::file_size(packagePath);
+	return { stats };
+}
+
+// Writes a Debian package (ar archive of debian-binary, control.tar.xz, and data.tar.xz) at packagePath
+static std::optional<ArchiveStats> WriteDebPackage(const std::vector<PackageEntry>& entries, const std::filesystem::path& packagePath, const PackageInfo& info,
+													std::string_view packageName, std::string_view extraControlFields,
+													const std::string& compressorPath, unsigned int jobCount, int level, std::int64_t mtime)
+{
+	std::uint64_t installedSize = 0;
+	for(const auto& entry : entries)
+		installedSize += entry.size;
+	std::string description = info.description;
+	std::ranges::replace(description, '\n', ' ');
+	std::string control = std::format("Package: {}\nVersion: {}\nArchitecture: {}\nMaintainer: {}\nInstalled-Size: {}\n{}Description: {}\n",
+										packageName, info.version, info.architecture, info.maintainer, (installedSize + 1023) / 1024, extraControlFields, description);
+
+	auto dataPath = packagePath.parent_path() / std::format(".{}.data.tar.xz", packagePath.filename().string());
+	auto controlPath = packagePath.parent_path() / std::format(".{}.control.tar.xz", packagePath.filename().string());
+	auto stats = WriteTarball(entries, dataPath, "./", compressorPath, PackageFormat::Deb, jobCount, level, mtime, [](TarWriter& writer) { writer.AddDirectory("./"); });
+	auto controlStats = stats ? WriteTarball({ }, controlPath, "./", compressorPath, PackageFormat::Deb, 1, level, mtime, [&control](TarWriter& writer)
+	{
+		writer.AddDirectory("./");
+		writer.AddFile("./control", control);
+	}) : std::nullopt;
+	std::optional<std::string> data, controlArchive;
+	if(controlStats)
+	{
+		data = LoadBinaryFileOrNull(dataPath);
+		controlArchive = LoadBinaryFileOrNull(controlPath);
+	}
+	std::error_code errorCode;
+	std::filesystem::remove(dataPath, errorCode);
+	std::filesystem::remove(controlPath, errorCode);
+	if(!data || !controlArchive)
+		return { };
+
+	std::ofstream stream(packagePath, std::ios_base::binary | std::ios_base::trunc);
+	stream << "!<arch>\n";
+	WriteArMember(stream, "debian-binary", "2.0\n", mtime);
+	WriteArMember(stream, "control.tar.xz", controlArchive.value(), mtime);
+	WriteArMember(stream, "data.tar.xz", data.value(), mtime);
+	stream.close();
+	if(stream.fail())
+	{
+		spdlog::error("Failed to write {}", packagePath.string());
+		return { };
+	}
+	stats->inputSize += controlStats->inputSize;
+	stats->compressTime += controlStats->compressTime;
+	stats->archiveTime += controlStats->archiveTime;
+	stats->outputSize = std::filesystem::file_size(packagePath);
+	return stats;
+}
+
+static std::optional<ArchiveStats> WritePackage(const std::vector<PackageEntry>& entries, const std::filesystem::path& packagePath, PackageFormat format, const PackageInfo& info,
+												bool isDebugPackage, const std::string& compressorPath, unsigned int jobCount, int level, std::int64_t mtime)
+{
+	if(format != PackageFormat::Deb)
+		return WriteTarball(entries, packagePath, "", compressorPath, format, jobCount, level, mtime);
+	std::string packageName = GetDebPackageName(info.name);
+	if(!isDebugPackage)
+		return WriteDebPackage(entries, packagePath, info, packageName, "", compressorPath, jobCount, level, mtime);
+	return WriteDebPackage(entries, packagePath, info, std::format("{}-dbgsym", packageName), std::format("Depends: {} (= {})\nSection: debug\nPriority: optional\n", packageName, info.version),
+							compressorPath, jobCount, level, mtime);
+}
+
+static void ReportArchive(const std::filesystem::path& packagePath, const ArchiveStats& stats)
+{
+	double time = stats.archiveTime + stats.compressTime;
+	spdlog::info("{}: {:.1f} MiB -> {:.1f} MiB ({:.1f}%) in {:.2f}s (archive {:.2f}s, compress {:.2f}s), {:.1f} MiB/s",
+					packagePath.string(), stats.inputSize / gMiB, stats.outputSize / gMiB, stats.inputSize ? 100.0 * stats.outputSize / stats.inputSize : 0.0,
+					time, stats.archiveTime, stats.compressTime, time > 0 ? stats.inputSize / gMiB / time : 0.0);
+}
+
+int RunPackage(std::string_view directory, const PackageCommandArgs& args)
+{
+	PackageFormat format;
+	if(args.format == "tar.zst")
+		format = PackageFormat::TarZst;
+	else if(args.format == "tar.xz")
+		format = PackageFormat::TarXz;
+	else if(args.format == "deb")
+		format = PackageFormat::Deb;
+	else
+	{
+		spdlog::error("Unknown package format '{}', it must be one of tar.zst, tar.xz, or deb", args.format);
+		return EXIT_FAILURE;
+	}
+	std::string_view compressorName = (format == PackageFormat::TarZst) ? "zstd" : "xz";
+	auto compressorPath = FindTool(compressorName);
+	if(!compressorPath)
+	{
+		spdlog::error("{} isn't found, please install it", compressorName);
+		return EXIT_FAILURE;
+	}
+
+	auto buildDirectory = GetPathStrRelativeToDir(directory, args.buildDirectory);
+	auto projectInfoFilePath = std::filesystem::path(buildDirectory) / "meson-info" / "intro-projectinfo.json";
+	if(!std::filesystem::exists(projectInfoFilePath))
+	{
+		spdlog::error("{} isn't configured, please configure it first with 'build_master meson setup {}'", buildDirectory, args.buildDirectory);
+		return EXIT_FAILURE;
+	}
+	auto startTime = std::chrono::steady_clock::now();
+
+	// The staging directory is recreated, so that the files which are no longer installed don't end up in the package
+	auto stagePath = std::filesystem::absolute(GetPathStrRelativeToDir(buildDirectory, gPackageStageDirPath)).lexically_normal();
+	auto debugStagePath = std::filesystem::absolute(GetPathStrRelativeToDir(buildDirectory, gPackageDebugStageDirPath)).lexically_normal();
+	std::filesystem::remove_all(stagePath);
+	std::filesystem::remove_all(debugStagePath);
+	std::vector<std::string> mesonArgs { "install", "-C", args.buildDirectory, "--destdir", stagePath.string(), "--quiet" };
+	if(args.isNoRebuild)
+		mesonArgs.push_back("--no-rebuild");
+	if(int exitCode = RunMesonCmd(directory, mesonArgs); exitCode != 0)
+		return exitCode;
+	std::vector<PackageEntry> entries = CollectEntries(stagePath);
+	std::uint64_t stagedSize = 0;
+	for(const auto& entry : entries)
+		stagedSize += entry.size;
+	auto stageEndTime = std::chrono::steady_clock::now();
+	spdlog::info("Staged {} entries ({:.1f} MiB) in {:.2f}s", entries.size(), stagedSize / gMiB, std::chrono::duration<double>(stageEndTime - startTime).count());
+
+	unsigned int jobCount = args.jobCount ? args.jobCount : std::max(std::thread::hardware_concurrency(), 1u);
+	if(!args.isNoSplitDebug)
+	{
+		if(auto objcopyPath = FindTool("objcopy", "OBJCOPY"))
+		{
+			auto splitCount = SplitDebugInfo(objcopyPath.value(), entries, debugStagePath, jobCount);
+			if(!splitCount)
+				return EXIT_FAILURE;
+			// The binaries have been stripped, so their sizes have changed
+			if(splitCount.value())
+				entries = CollectEntries(stagePath);
+			spdlog::info("Split the debug info of {} binaries in {:.2f}s with {} jobs", splitCount.value(),
+							std::chrono::duration<double>(std::chrono::steady_clock::now() - stageEndTime).count(), jobCount);
+		}
+		else
+			spdlog::warn("objcopy isn't found, the debug info is left in the binaries");
+	}
+
+	json buildMasterJson = ParseBuildMasterJson(directory);
+	json projectInfoJson = ParseJsonFile(projectInfoFilePath.string());
+	PackageInfo info;
+	info.name = GetJsonKeyValue<std::string>(buildMasterJson, "canonical_name");
+	info.version = GetJsonKeyValue<std::string>(projectInfoJson, "version", "0");
+	// meson reports 'undefined' if project() has no version
+	if(info.version.empty() || !std::isdigit(static_cast<unsigned char>(info.version.front())))
+		info.version = "0";
+	info.description = GetJsonKeyValue<std::string>(buildMasterJson, "description", "Description not provided");
+	info.maintainer = GetJsonKeyValue<std::string>(buildMasterJson, "maintainer", "Unknown <unknown@localhost>");
+	if(format == PackageFormat::Deb)
+		info.architecture = GetDebArchitecture();
+
+	std::filesystem::path packagePath;
+	if(!args.outputPath.empty())
+		packagePath = std::filesystem::path(GetPathStrRelativeToDir(directory, args.outputPath));
+	else if(format == PackageFormat::Deb)
+		packagePath = std::filesystem::path(buildDirectory) / std::format("{}_{}_{}.deb", GetDebPackageName(info.name), info.version, info.architecture);
+	else
+		packagePath = std::filesystem::path(buildDirectory) / std::format("{}-{}.{}", info.name, info.version, args.format);
+	if(packagePath.has_parent_path())
+		std::filesystem::create_directories(packagePath.parent_path());
+
+	std::int64_t mtime = GetSourceDateEpoch();
+	try
+	{
+		auto stats = WritePackage(entries, packagePath, format, info, false, compressorPath.value(), jobCount, args.compressionLevel, mtime);
+		if(!stats)
+			return EXIT_FAILURE;
+		ReportArchive(packagePath, stats.value());
+		std::vector<PackageEntry> debugEntries = CollectEntries(debugStagePath);
+		auto debugPackagePath = GetDebugPackagePath(packagePath, format, info);
+		std::error_code errorCode;
+		std::filesystem::remove(debugPackagePath, errorCode);
+		if(debugEntries.size())
+		{
+			auto debugStats = WritePackage(debugEntries, debugPackagePath, format, info, true, compressorPath.value(), jobCount, args.compressionLevel, mtime);
+			if(!debugStats)
+				return EXIT_FAILURE;
+			ReportArchive(debugPackagePath, debugStats.value());
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		spdlog::error("{}", exception.what());
+		return EXIT_FAILURE;
+	}
+	spdlog::info("Packaged in {:.2f}s", std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+	return EXIT_SUCCESS;
+}
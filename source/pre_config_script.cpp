@@ -5,6 +5,7 @@
 #include <spdlog/spdlog.h>
 #include <invoke/invoke.hpp>
 #include <cstdlib>
+#include <format>
 
 static constexpr std::string_view gBash = "bash";
 
@@ -15,10 +16,7 @@ static std::optional<bool> RunPreConfigScript(const json& buildMasterJson, std::
 		spdlog::info(logMsg);
 		std::optional<std::vector<std::string>> bashPaths = invoke::FindExecutable(gBash);
 		if(!bashPaths)
-		{
-			spdlog::error("No path found for {}", gBash);
-			exit(EXIT_FAILURE);
-		}
+			throw PreConfigScriptError(std::format("No path found for {}", gBash));
 		std::string bashPath = SelectPath(bashPaths.value()); 
 		auto returnCode = invoke::Exec({ bashPath, result.value() }, directory, isRoot);
 		return { returnCode == 0 };
@@ -26,10 +24,8 @@ static std::optional<bool> RunPreConfigScript(const json& buildMasterJson, std::
 	return { };
 }
 
-bool RunPreConfigScript(std::string_view directory)
+bool RunPreConfigScript(const json& buildMasterJson, std::string_view directory)
 {
-	json buildMasterJson = ParseBuildMasterJson(directory);
-
 	// Run pre_config_hook	
 	auto result1 = RunPreConfigScript(buildMasterJson, directory, "pre_config_hook", "Running pre-config hook script");
 	if(result1)
@@ -52,3 +48,16 @@ bool RunPreConfigScript(std::string_view directory)
 
 	return result1 || result2;
 }
+
+bool RunPreConfigScript(std::string_view directory)
+{
+	try
+	{
+		return RunPreConfigScript(ParseBuildMasterJson(directory), directory);
+	}
+	catch(const PreConfigScriptError& error)
+	{
+		spdlog::error(error.what());
+		exit(EXIT_FAILURE);
+	}
+}
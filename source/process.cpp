@@ -0,0 +1,354 @@
+#include <build_master/process.hpp>
+
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <format>
+#include <string>
+#include <cstdio>
+#include <cctype>
+
+#ifdef _WIN32
+#	include <build_master/misc.hpp> // for QuoteShellArg()
+#	include <windows.h>
+#else
+#	include <unistd.h>
+#	include <fcntl.h>
+#	include <signal.h>
+#	include <sys/wait.h>
+#	include <sys/resource.h>
+#	include <sys/stat.h>
+#	include <cstdlib>
+#	include <cerrno>
+extern char** environ;
+#endif
+
+static void TrimTrailingSpaces(std::string& str)
+{
+	while(str.size() && std::isspace(static_cast<unsigned char>(str.back())))
+		str.pop_back();
+}
+
+#ifdef _WIN32
+
+std::optional<std::string> RunCmdCaptureOutput(const std::vector<std::string>& args)
+{
+	std::string cmdLine;
+	for(const auto& arg : args)
+		cmdLine.append(QuoteShellArg(arg)).append(" ");
+	SECURITY_ATTRIBUTES securityAttributes { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+	HANDLE readPipe = nullptr;
+	HANDLE writePipe = nullptr;
+	if(!CreatePipe(&readPipe, &writePipe, &securityAttributes, 0))
+		return { };
+	// Only the write end is inherited by the child
+	SetHandleInformation(readPipe, HANDLE_FLAG_INHERIT, 0);
+	HANDLE nullFile = CreateFileA("NUL", GENERIC_WRITE, FILE_SHARE_WRITE, &securityAttributes, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	STARTUPINFOA startupInfo { };
+	startupInfo.cb = sizeof(startupInfo);
+	startupInfo.dwFlags |= STARTF_USESTDHANDLES;
+	startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+	startupInfo.hStdOutput = writePipe;
+	startupInfo.hStdError = nullFile;
+	PROCESS_INFORMATION processInfo { };
+	BOOL isCreated = CreateProcessA(nullptr, cmdLine.data(), nullptr, nullptr, TRUE, 0, nullptr, nullptr, &startupInfo, &processInfo);
+	// Otherwise the read end wouldn't see the end of the output once the child exits
+	CloseHandle(writePipe);
+	if(nullFile != INVALID_HANDLE_VALUE)
+		CloseHandle(nullFile);
+	if(!isCreated)
+	{
+		CloseHandle(readPipe);
+		return { };
+	}
+	std::string output;
+	char buffer[512];
+	DWORD readSize = 0;
+	while(ReadFile(readPipe, buffer, sizeof(buffer), &readSize, nullptr) && readSize)
+		output.append(buffer, readSize);
+	CloseHandle(readPipe);
+	WaitForSingleObject(processInfo.hProcess, INFINITE);
+	DWORD exitCode = 1;
+	GetExitCodeProcess(processInfo.hProcess, &exitCode);
+	CloseHandle(processInfo.hThread);
+	CloseHandle(processInfo.hProcess);
+	if(exitCode != 0)
+		return { };
+	TrimTrailingSpaces(output);
+	return { std::move(output) };
+}
+
+ProcessResult RunProcess(const std::vector<std::string>& args, std::string_view workDirectory, const std::vector<std::pair<std::string, std::string>>& env, std::string_view outputFilePath, double timeout)
+{
+	ProcessResult result;
+	std::string cmdLine;
+	for(const auto& arg : args)
+		cmdLine.append(QuoteShellArg(arg)).append(" ");
+
+	// Environment block: the inherited variables followed by the given ones, each null terminated
+	std::string envBlock;
+	if(env.size())
+	{
+		LPCH envStrings = GetEnvironmentStringsA();
+		for(LPCH str = envStrings; *str; str += strlen(str) + 1)
+			envBlock.append(str).push_back('\0');
+		FreeEnvironmentStringsA(envStrings);
+		for(const auto& [name, value] : env)
+			envBlock.append(std::format("{}={}", name, value)).push_back('\0');
+		envBlock.push_back('\0');
+	}
+
+	STARTUPINFOA startupInfo { };
+	startupInfo.cb = sizeof(startupInfo);
+	HANDLE outputFile = INVALID_HANDLE_VALUE;
+	if(outputFilePath.size())
+	{
+		SECURITY_ATTRIBUTES securityAttributes { sizeof(SECURITY_ATTRIBUTES), nullptr, TRUE };
+		outputFile = CreateFileA(std::string { outputFilePath }.c_str(), GENERIC_WRITE, FILE_SHARE_READ, &securityAttributes, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		startupInfo.dwFlags |= STARTF_USESTDHANDLES;
+		startupInfo.hStdInput = GetStdHandle(STD_INPUT_HANDLE);
+		startupInfo.hStdOutput = outputFile;
+		startupInfo.hStdError = outputFile;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+	PROCESS_INFORMATION processInfo { };
+	std::string workDirectoryStr { workDirectory };
+	BOOL isCreated = CreateProcessA(nullptr, cmdLine.data(), nullptr, nullptr, TRUE, 0, envBlock.size() ? envBlock.data() : nullptr,
+									workDirectoryStr.size() ? workDirectoryStr.c_str() : nullptr, &startupInfo, &processInfo);
+	if(outputFile != INVALID_HANDLE_VALUE)
+		CloseHandle(outputFile);
+	if(!isCreated)
+		return result;
+	DWORD waitTime = (timeout > 0) ? static_cast<DWORD>(timeout * 1000) : INFINITE;
+	if(WaitForSingleObject(processInfo.hProcess, waitTime) == WAIT_TIMEOUT)
+	{
+		TerminateProcess(processInfo.hProcess, 1);
+		WaitForSingleObject(processInfo.hProcess, INFINITE);
+		result.isTimedOut = true;
+	}
+	else
+	{
+		DWORD exitCode = 0;
+		GetExitCodeProcess(processInfo.hProcess, &exitCode);
+		result.exitCode = static_cast<int>(exitCode);
+	}
+	result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	// In 100 nanosecond intervals, only of the process itself (its descendants aren't accounted on Windows)
+	FILETIME creationTime, exitTime, kernelTime, userTime;
+	if(GetProcessTimes(processInfo.hProcess, &creationTime, &exitTime, &kernelTime, &userTime))
+	{
+		auto toSeconds = [](const FILETIME& time) { return ((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) / 1e7; };
+		result.userTime = toSeconds(userTime);
+		result.systemTime = toSeconds(kernelTime);
+	}
+	CloseHandle(processInfo.hThread);
+	CloseHandle(processInfo.hProcess);
+	return result;
+}
+
+int ExecProcess(const std::vector<std::string>& args)
+{
+	std::fflush(stdout);
+	return RunProcess(args).exitCode;
+}
+
+#else // _WIN32
+
+int ExecProcess(const std::vector<std::string>& args)
+{
+	std::vector<char*> argv;
+	argv.reserve(args.size() + 1);
+	for(const auto& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+	// Anything buffered would be lost once the process image is replaced
+	std::fflush(nullptr);
+	execvp(argv[0], argv.data());
+	return -1;
+}
+
+// Returns the environment of the child process, "NAME=value" strings: the inherited variables, and the given ones (overriding the inherited ones)
+static std::vector<std::string> GetChildEnvironment(const std::vector<std::pair<std::string, std::string>>& env)
+{
+	std::vector<std::string> envStrings;
+	for(char** str = environ; *str; ++str)
+	{
+		std::string_view envString { *str };
+		std::string_view name = envString.substr(0, envString.find('='));
+		if(std::ranges::none_of(env, [name](const auto& pair) { return pair.first == name; }))
+			envStrings.emplace_back(envString);
+	}
+	for(const auto& [name, value] : env)
+		envStrings.push_back(std::format("{}={}", name, value));
+	return envStrings;
+}
+
+// Returns the path of the executable as execvp() would find it, but in PATH of the child's environment
+// The name is returned as is if it has a '/', or if it isn't found (then execve() fails)
+// workDirectory: the child runs in it, so the relative paths (of PATH) are looked up relative to it
+static std::string FindExecutablePath(const std::string& name, const std::vector<std::string>& envStrings, std::string_view workDirectory)
+{
+	if(name.find('/') != std::string::npos)
+		return name;
+	// Same as the default search path of execvp() in glibc
+	std::string_view pathValue = "/bin:/usr/bin";
+	for(const auto& envString : envStrings)
+		if(envString.starts_with("PATH="))
+			pathValue = std::string_view { envString }.substr(5);
+	while(true)
+	{
+		auto separatorPos = pathValue.find(':');
+		std::string_view dirPath = pathValue.substr(0, separatorPos);
+		// An empty element means the current directory
+		std::string filePath = std::format("{}/{}", dirPath.empty() ? "." : dirPath, name);
+		std::string checkedFilePath = (workDirectory.size() && !filePath.starts_with('/')) ? std::format("{}/{}", workDirectory, filePath) : filePath;
+		struct stat fileStat { };
+		if(stat(checkedFilePath.c_str(), &fileStat) == 0 && S_ISREG(fileStat.st_mode) && access(checkedFilePath.c_str(), X_OK) == 0)
+			return filePath;
+		if(separatorPos == std::string_view::npos)
+			return name;
+		pathValue.remove_prefix(separatorPos + 1);
+	}
+}
+
+ProcessResult RunProcess(const std::vector<std::string>& args, std::string_view workDirectory, const std::vector<std::pair<std::string, std::string>>& env, std::string_view outputFilePath, double timeout)
+{
+	ProcessResult result;
+	std::vector<char*> argv;
+	argv.reserve(args.size() + 1);
+	for(const auto& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+	// Everything the child needs is prepared here, as the child of a multi-threaded process may only make async-signal-safe calls until execve()
+	// (setenv() and the PATH lookup of execvp() allocate, which could deadlock on a malloc lock held by another thread at the time of fork())
+	std::vector<std::string> envStrings = GetChildEnvironment(env);
+	std::vector<char*> envp;
+	envp.reserve(envStrings.size() + 1);
+	for(auto& envString : envStrings)
+		envp.push_back(envString.data());
+	envp.push_back(nullptr);
+	std::string executablePath = FindExecutablePath(args[0], envStrings, workDirectory);
+	std::string workDirectoryStr { workDirectory };
+	std::string outputFilePathStr { outputFilePath };
+
+	auto startTime = std::chrono::steady_clock::now();
+	pid_t pid = fork();
+	if(pid < 0)
+		return result;
+	if(pid == 0)
+	{
+		// Child process, only async-signal-safe calls from here on: chdir(), open(), dup2(), close(), setpgid(), execve(), and _exit()
+		if(workDirectoryStr.size() && chdir(workDirectoryStr.c_str()) != 0)
+			_exit(127);
+		if(outputFilePathStr.size())
+		{
+			int fd = open(outputFilePathStr.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if(fd < 0)
+				_exit(127);
+			dup2(fd, STDOUT_FILENO);
+			dup2(fd, STDERR_FILENO);
+			close(fd);
+		}
+		// Put the child into its own process group, so that the whole group can be killed on timeout
+		if(timeout > 0)
+			setpgid(0, 0);
+		execve(executablePath.c_str(), argv.data(), envp.data());
+		_exit(127);
+	}
+
+	int status = 0;
+	// wait4() reports the peak RSS of the child, including its descendants which it has waited for
+	struct rusage usage { };
+	if(timeout <= 0)
+		wait4(pid, &status, 0, &usage);
+	else
+	{
+		auto deadline = startTime + std::chrono::duration<double>(timeout);
+		auto pollInterval = std::chrono::microseconds(500);
+		while(wait4(pid, &status, WNOHANG, &usage) == 0)
+		{
+			if(std::chrono::steady_clock::now() >= deadline)
+			{
+				kill(-pid, SIGKILL);
+				kill(pid, SIGKILL);
+				wait4(pid, &status, 0, &usage);
+				result.isTimedOut = true;
+				break;
+			}
+			std::this_thread::sleep_for(pollInterval);
+			// Short processes are reaped quickly, and the long ones don't keep the CPU busy
+			pollInterval = std::min(pollInterval * 2, std::chrono::microseconds(20000));
+		}
+	}
+	result.wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+	result.userTime = usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6;
+	result.systemTime = usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+#ifdef __APPLE__
+	// In bytes on macOS
+	result.peakMemory = static_cast<std::uint64_t>(usage.ru_maxrss);
+#else
+	// In kilobytes on Linux and BSDs
+	result.peakMemory = static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;
+#endif
+	if(!result.isTimedOut && WIFEXITED(status))
+		result.exitCode = WEXITSTATUS(status);
+	return result;
+}
+
+std::optional<std::string> RunCmdCaptureOutput(const std::vector<std::string>& args)
+{
+	std::vector<char*> argv;
+	argv.reserve(args.size() + 1);
+	for(const auto& arg : args)
+		argv.push_back(const_cast<char*>(arg.c_str()));
+	argv.push_back(nullptr);
+	// Same as RunProcess(), the child doesn't allocate between fork() and execve()
+	std::vector<std::string> envStrings = GetChildEnvironment({ });
+	std::string executablePath = FindExecutablePath(args[0], envStrings, "");
+	int pipeFds[2];
+	if(pipe(pipeFds) != 0)
+		return { };
+	pid_t pid = fork();
+	if(pid < 0)
+	{
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		return { };
+	}
+	if(pid == 0)
+	{
+		// Child process, stdout goes into the pipe, and stderr is discarded
+		dup2(pipeFds[1], STDOUT_FILENO);
+		close(pipeFds[0]);
+		close(pipeFds[1]);
+		if(int nullFd = open("/dev/null", O_WRONLY); nullFd >= 0)
+		{
+			dup2(nullFd, STDERR_FILENO);
+			close(nullFd);
+		}
+		execve(executablePath.c_str(), argv.data(), environ);
+		_exit(127);
+	}
+	// Otherwise the read end wouldn't see the end of the output once the child exits
+	close(pipeFds[1]);
+	std::string output;
+	char buffer[512];
+	while(true)
+	{
+		ssize_t readSize = read(pipeFds[0], buffer, sizeof(buffer));
+		if(readSize > 0)
+			output.append(buffer, static_cast<std::size_t>(readSize));
+		else if(readSize == 0 || errno != EINTR)
+			break;
+	}
+	close(pipeFds[0]);
+	int status = 0;
+	while(waitpid(pid, &status, 0) < 0 && errno == EINTR) { }
+	if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+		return { };
+	TrimTrailingSpaces(output);
+	return { std::move(output) };
+}
+
+#endif // otherwise platforms
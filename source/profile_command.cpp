@@ -0,0 +1,382 @@
+#include <build_master/profile_command.hpp>
+#include <build_master/build_command.hpp> // for RunBuild()
+#include <build_master/meson_build_gen.hpp> // for RegenerateMesonBuildScript()
+#include <build_master/invoke_meson.hpp> // for RunMesonCmd()
+#include <build_master/pre_config_script.hpp> // for RunPreConfigScript()
+#include <build_master/artifact_cache.hpp> // for PreparePrebuiltDependencies()
+#include <build_master/dependency_probe.hpp> // for ProbeDependencies()
+#include <build_master/process.hpp> // for RunProcess()
+#include <build_master/json_parse.hpp> // for ParseJsonFile(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), SelectPath(), ComputeContentHash(), and OverwriteTextFile()
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cctype>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <map>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+#include <spdlog/spdlog.h>
+#include <invoke/invoke.hpp> // for invoke::FindExecutable()
+
+// meson has no 'profile' buildtype, the generated meson.build treats a debugoptimized build directory as such if it has gProfileStampFileName
+// (see MESON_BUILD_TEMPLATE_STR), so the other debugoptimized build directories are left as they are
+static constexpr std::string_view gProfileBuildType = "debugoptimized";
+static constexpr std::string_view gProfileStampFileName = "build_master_profile.stamp";
+static constexpr std::string_view gProfileOutputDirPath = "meson-logs/build_master_profile";
+
+// Folded stacks, "<comm>;<outermost frame>;...;<innermost frame>" and the number of samples of it
+// Sorted, so that the stacks sharing a prefix are adjacent (the flamegraph merges them)
+using FoldedStacks = std::map<std::string, std::uint64_t>;
+
+// Sets up the build directory for the profile build if it isn't set up yet
+// A build directory configured otherwise (not by 'build_master profile') is refused rather than reconfigured, it is the user's (e.g. 'build')
+// Returns false if meson has failed, or the build directory has been refused
+static bool ConfigureProfileBuild(std::string_view directory, std::string_view buildDirectory, const ProfileCommandArgs& args)
+{
+	auto buildDirectoryPath = std::filesystem::path(buildDirectory);
+	bool isProfileBuild = std::filesystem::exists(buildDirectoryPath / gProfileStampFileName);
+	if(std::filesystem::exists(buildDirectoryPath / "meson-private" / "coredata.dat"))
+	{
+		if(!isProfileBuild)
+			spdlog::error("{} is configured, but not for the profile build, pass a dedicated build directory with -C (it is set up if it doesn't exist)", args.buildDirectory);
+		return isProfileBuild;
+	}
+	// The stamp is written first, so that meson.build sees it at the first configuration already
+	std::error_code errorCode;
+	std::filesystem::create_directories(buildDirectoryPath, errorCode);
+	if(!std::ofstream(buildDirectoryPath / gProfileStampFileName))
+	{
+		spdlog::error("Failed to create {}", (buildDirectoryPath / gProfileStampFileName).string());
+		return false;
+	}
+	// Same as 'build_master meson setup'
+	RegenerateMesonBuildScript(directory);
+	PreparePrebuiltDependencies(directory, true);
+	RunPreConfigScript(directory);
+	ProbeDependencies(directory);
+	return RunMesonCmd(directory, { "setup", args.buildDirectory, std::format("--buildtype={}", gProfileBuildType), "-Dstrip=false" }) == 0;
+}
+
+// Returns path of the executable built for the target, from <build directory>/meson-info/intro-targets.json
+static std::string GetExecutablePath(std::string_view buildDirectory, std::string_view targetName)
+{
+	auto introFilePath = GetPathStrRelativeToDir(buildDirectory, "meson-info/intro-targets.json");
+	for(const auto& targetJson : ParseJsonFile(introFilePath))
+	{
+		if(GetJsonKeyValue<std::string>(targetJson, "name") != targetName)
+			continue;
+		auto fileNames = GetJsonKeyValue<std::vector<std::string>>(targetJson, "filename", std::vector<std::string> { });
+		if(GetJsonKeyValue<std::string>(targetJson, "type") != "executable" || fileNames.empty())
+		{
+			spdlog::error("Target {} is not an executable", targetName);
+			exit(EXIT_FAILURE);
+		}
+		return fileNames.front();
+	}
+	spdlog::error("No such target: {}", targetName);
+	exit(EXIT_FAILURE);
+}
+
+// Strips the offset ("+0x1a") from a symbol of perf script, unknown symbols are replaced with the name of their module ("[libc.so.6]")
+static std::string GetFrameName(std::string_view symbol, std::string_view module)
+{
+	if(symbol == "[unknown]" && module.size() && module != "[unknown]")
+		return std::format("[{}]", std::filesystem::path(module).filename().string());
+	auto offsetPos = symbol.rfind("+0x");
+	if(offsetPos != std::string_view::npos && offsetPos > 0)
+		symbol = symbol.substr(0, offsetPos);
+	std::string name { symbol };
+	// ';' separates the frames of a folded stack
+	std::replace(name.begin(), name.end(), ';', ':');
+	return name;
+}
+
+// Returns the command name of a sample's header line of perf script, "my_app 12345/12345 [002] 1234.5678: 1001001 cycles:u:" or "my_app 12345 ..."
+static std::string_view GetSampleCommandName(std::string_view line)
+{
+	for(std::size_t i = 1; i + 1 < line.size(); ++i)
+	{
+		if(!std::isspace(static_cast<unsigned char>(line[i])))
+			continue;
+		// The command name may contain spaces, it ends where the pid begins
+		std::size_t j = i;
+		while(j < line.size() && std::isspace(static_cast<unsigned char>(line[j])))
+			++j;
+		std::size_t k = j;
+		while(k < line.size() && std::isdigit(static_cast<unsigned char>(line[k])))
+			++k;
+		if(k > j && (k == line.size() || line[k] == '/' || std::isspace(static_cast<unsigned char>(line[k]))))
+			return line.substr(0, i);
+		i = j - 1;
+	}
+	return line;
+}
+
+// Folds the call graphs of the default output of 'perf script', same as stackcollapse-perf.pl of the FlameGraph scripts
+// Each sample is a header line followed by its frames (innermost first) indented, "\t    55d4c0a1b2c3 compute+0x1a (/path/to/my_app)", and an empty line
+static FoldedStacks FoldPerfScriptOutput(const std::string& scriptFilePath)
+{
+	FoldedStacks stacks;
+	std::ifstream stream(scriptFilePath);
+	std::string commandName;
+	std::vector<std::string> frames;
+	auto flushSample = [&]()
+	{
+		if(frames.size())
+		{
+			std::string stack = commandName;
+			for(auto it = frames.rbegin(); it != frames.rend(); ++it)
+				stack.append(";").append(*it);
+			++stacks[stack];
+		}
+		frames.clear();
+	};
+	for(std::string line; std::getline(stream, line);)
+	{
+		if(line.size() && line.back() == '\r')
+			line.pop_back();
+		std::string_view view = line;
+		if(view.empty() || view.front() == '#')
+		{
+			flushSample();
+			continue;
+		}
+		if(!std::isspace(static_cast<unsigned char>(view.front())))
+		{
+			flushSample();
+			commandName = GetSampleCommandName(view);
+			std::replace(commandName.begin(), commandName.end(), ';', ':');
+			continue;
+		}
+		// A frame: <address> <symbol> (<module>)
+		auto beginPos = view.find_first_not_of(" \t");
+		auto symbolPos = view.find(' ', beginPos);
+		if(symbolPos == std::string_view::npos)
+			continue;
+		std::string_view rest = view.substr(symbolPos + 1);
+		std::string_view module;
+		auto modulePos = rest.rfind(" (");
+		if(modulePos != std::string_view::npos && rest.back() == ')')
+		{
+			module = rest.substr(modulePos + 2, rest.size() - modulePos - 3);
+			rest = rest.substr(0, modulePos);
+		}
+		frames.push_back(GetFrameName(rest, module));
+	}
+	flushSample();
+	return stacks;
+}
+
+static std::string EscapeXml(std::string_view str)
+{
+	std::string escaped;
+	escaped.reserve(str.size());
+	for(char ch : str)
+		switch(ch)
+		{
+			case '&': escaped.append("&amp;"); break;
+			case '<': escaped.append("&lt;"); break;
+			case '>': escaped.append("&gt;"); break;
+			case '"': escaped.append("&quot;"); break;
+			default: escaped.push_back(ch);
+		}
+	return escaped;
+}
+
+// Renders the folded stacks as an SVG flamegraph (the callers at the bottom, the width of a frame is proportional to its samples)
+// The frames are merged the same way as flamegraph.pl does it, the adjacent (sorted) stacks sharing a prefix share those frames.
+static std::string RenderFlamegraph(const FoldedStacks& stacks, std::string_view title)
+{
+	struct Frame
+	{
+		std::string_view name;
+		std::size_t depth;
+		std::uint64_t begin;
+		std::uint64_t end;
+	};
+	std::vector<Frame> frames;
+	std::vector<Frame> openFrames { { "all", 0, 0, 0 } };
+	std::uint64_t sampleCount = 0;
+	std::size_t maxDepth = 0;
+	for(const auto& [stack, count] : stacks)
+	{
+		std::vector<std::string_view> names { "all" };
+		for(std::size_t pos = 0; pos <= stack.size();)
+		{
+			auto endPos = std::min(stack.find(';', pos), stack.size());
+			names.push_back(std::string_view { stack }.substr(pos, endPos - pos));
+			pos = endPos + 1;
+		}
+		std::size_t commonDepth = 0;
+		while(commonDepth < names.size() && commonDepth < openFrames.size() && openFrames[commonDepth].name == names[commonDepth])
+			++commonDepth;
+		for(; openFrames.size() > commonDepth; openFrames.pop_back())
+			frames.push_back({ openFrames.back().name, openFrames.size() - 1, openFrames.back().begin, sampleCount });
+		for(std::size_t depth = commonDepth; depth < names.size(); ++depth)
+			openFrames.push_back({ names[depth], depth, sampleCount, 0 });
+		maxDepth = std::max(maxDepth, names.size() - 1);
+		sampleCount += count;
+	}
+	for(; openFrames.size(); openFrames.pop_back())
+		frames.push_back({ openFrames.back().name, openFrames.size() - 1, openFrames.back().begin, sampleCount });
+
+	constexpr double imageWidth = 1200, padding = 10, frameHeight = 16, fontWidth = 0.59, fontSize = 12;
+	double imageHeight = (maxDepth + 1) * frameHeight + 3 * padding + 2 * fontSize;
+	double scale = (imageWidth - 2 * padding) / std::max<std::uint64_t>(sampleCount, 1);
+	std::string svg;
+	svg.append(std::format("<?xml version=\"1.0\" standalone=\"no\"?>\n"
+							"<svg version=\"1.1\" width=\"{0}\" height=\"{1}\" viewBox=\"0 0 {0} {1}\" xmlns=\"http://www.w3.org/2000/svg\">\n"
+							"<rect x=\"0\" y=\"0\" width=\"100%\" height=\"100%\" fill=\"#f8f8f8\"/>\n"
+							"<text x=\"{2}\" y=\"{3}\" font-family=\"Verdana\" font-size=\"{4}\" text-anchor=\"middle\">{5}</text>\n"
+							"<g font-family=\"Verdana\" font-size=\"{6}\">\n",
+							imageWidth, imageHeight, imageWidth / 2, padding + fontSize + 2, fontSize + 5, EscapeXml(title), fontSize - 1));
+	for(const auto& frame : frames)
+	{
+		double x = padding + frame.begin * scale;
+		double width = (frame.end - frame.begin) * scale;
+		// Too narrow to be seen
+		if(width < 0.1)
+			continue;
+		double y = imageHeight - padding - (frame.depth + 1) * frameHeight;
+		// "hot" palette of flamegraph.pl, the color is derived from the name so that a function has the same color everywhere
+		std::uint64_t hash = ComputeContentHash(frame.name);
+		unsigned int red = 205 + hash % 50, green = (hash >> 16) % 230, blue = (hash >> 32) % 55;
+		std::string name = EscapeXml(frame.name);
+		svg.append(std::format("<g><title>{} ({} samples, {:.2f}%)</title><rect x=\"{:.1f}\" y=\"{:.1f}\" width=\"{:.1f}\" height=\"{}\" fill=\"rgb({},{},{})\" rx=\"2\" ry=\"2\"/>",
+								name, frame.end - frame.begin, 100.0 * (frame.end - frame.begin) / std::max<std::uint64_t>(sampleCount, 1),
+								x, y, width, frameHeight - 1, red, green, blue));
+		// The label is truncated to the width of the frame
+		std::size_t maxCharCount = static_cast<std::size_t>(width / (fontSize * fontWidth));
+		if(maxCharCount >= 3)
+		{
+			std::string_view label = frame.name;
+			std::string truncated;
+			if(label.size() > maxCharCount)
+				label = (truncated = std::format("{}..", label.substr(0, maxCharCount - 2)));
+			svg.append(std::format("<text x=\"{:.1f}\" y=\"{:.1f}\">{}</text>", x + 3, y + frameHeight - 4, EscapeXml(label)));
+		}
+		svg.append("</g>\n");
+	}
+	svg.append("</g>\n</svg>\n");
+	return svg;
+}
+
+// Prints the functions with the most samples of their own (self), along with the samples of them and their callees (total)
+static void PrintHotFunctions(const FoldedStacks& stacks, unsigned int topCount)
+{
+	struct FunctionSamples
+	{
+		std::uint64_t self { 0 };
+		std::uint64_t total { 0 };
+	};
+	std::unordered_map<std::string_view, FunctionSamples> functions;
+	std::uint64_t sampleCount = 0;
+	std::unordered_set<std::string_view> stackFunctions;
+	for(const auto& [stack, count] : stacks)
+	{
+		sampleCount += count;
+		stackFunctions.clear();
+		// The first element is the command name, not a function
+		std::size_t pos = stack.find(';');
+		std::string_view name;
+		while(pos != std::string::npos)
+		{
+			auto endPos = stack.find(';', pos + 1);
+			name = std::string_view { stack }.substr(pos + 1, (endPos == std::string::npos ? stack.size() : endPos) - pos - 1);
+			// Recursive functions are counted only once per stack
+			if(stackFunctions.insert(name).second)
+				functions[name].total += count;
+			pos = endPos;
+		}
+		if(name.size())
+			functions[name].self += count;
+	}
+	std::vector<std::pair<std::string_view, FunctionSamples>> sortedFunctions(functions.begin(), functions.end());
+	std::sort(sortedFunctions.begin(), sortedFunctions.end(), [](const auto& left, const auto& right)
+	{
+		return (left.second.self != right.second.self) ? (left.second.self > right.second.self) : (left.second.total > right.second.total);
+	});
+	if(sortedFunctions.size() > topCount)
+		sortedFunctions.resize(topCount);
+	std::cout << std::format("\n{:>8}  {:>8}  {:>9}  {}\n", "Self", "Total", "Samples", "Function");
+	for(const auto& [name, samples] : sortedFunctions)
+		std::cout << std::format("{:>7.2f}%  {:>7.2f}%  {:>9}  {}\n", 100.0 * samples.self / sampleCount, 100.0 * samples.total / sampleCount, samples.self, name);
+	std::cout << std::format("\nSamples: {}\n", sampleCount);
+}
+
+int RunProfile(std::string_view directory, const ProfileCommandArgs& args)
+{
+	auto perfPaths = invoke::FindExecutable("perf");
+	if(!perfPaths)
+	{
+		spdlog::error("Couldn't find perf, please install it (linux-tools, or linux-perf package of the distribution)");
+		return EXIT_FAILURE;
+	}
+	std::string perfPath = SelectPath(perfPaths.value());
+
+	auto buildDirectory = GetPathStrRelativeToDir(directory, args.buildDirectory);
+	if(!ConfigureProfileBuild(directory, buildDirectory, args))
+	{
+		spdlog::error("Failed to configure {} for the profile build", args.buildDirectory);
+		return EXIT_FAILURE;
+	}
+	BuildCommandArgs buildArgs;
+	buildArgs.buildDirectory = args.buildDirectory;
+	buildArgs.targetNames = { args.targetName };
+	if(int exitCode = RunBuild(directory, buildArgs); exitCode != 0)
+		return exitCode;
+
+	std::string executablePath = GetExecutablePath(buildDirectory, args.targetName);
+	auto outputDirPath = std::filesystem::path(GetPathStrRelativeToDir(buildDirectory, gProfileOutputDirPath));
+	std::filesystem::create_directories(outputDirPath);
+	auto perfDataFilePath = (outputDirPath / std::format("{}.perf.data", args.targetName)).string();
+	std::filesystem::remove(perfDataFilePath);
+
+	// The call graphs are walked through the frame pointers (kept by the profile build), which is much cheaper than --call-graph=dwarf
+	std::vector<std::string> perfArgs { perfPath, "record", "-F", std::to_string(args.frequency), "-g", "-o", perfDataFilePath, "--", executablePath };
+	perfArgs.insert(perfArgs.end(), args.targetArgs.begin(), args.targetArgs.end());
+	spdlog::info("Profiling {}", executablePath);
+	ProcessResult result = RunProcess(perfArgs);
+	if(!std::filesystem::exists(perfDataFilePath))
+	{
+		spdlog::error("perf record has failed (exit code: {}), the value of /proc/sys/kernel/perf_event_paranoid might need to be lowered", result.exitCode);
+		return EXIT_FAILURE;
+	}
+	if(result.exitCode != 0)
+		spdlog::warn("{} has exited with code {}", args.targetName, result.exitCode);
+
+	auto scriptFilePath = (outputDirPath / std::format("{}.perf.txt", args.targetName)).string();
+	if(RunProcess({ perfPath, "script", "-i", perfDataFilePath }, "", { }, scriptFilePath).exitCode != 0)
+	{
+		spdlog::error("perf script has failed, see {}", scriptFilePath);
+		return EXIT_FAILURE;
+	}
+	FoldedStacks stacks = FoldPerfScriptOutput(scriptFilePath);
+	std::filesystem::remove(scriptFilePath);
+	if(stacks.empty())
+	{
+		spdlog::error("No samples have been recorded for {}", args.targetName);
+		return EXIT_FAILURE;
+	}
+
+	std::string foldedStacks;
+	for(const auto& [stack, count] : stacks)
+		foldedStacks.append(std::format("{} {}\n", stack, count));
+	auto foldedFilePath = (outputDirPath / std::format("{}.folded", args.targetName)).string();
+	OverwriteTextFile(foldedFilePath, foldedStacks);
+	auto svgFilePath = (outputDirPath / std::format("{}.svg", args.targetName)).string();
+	OverwriteTextFile(svgFilePath, RenderFlamegraph(stacks, std::format("Flame Graph: {}", args.targetName)));
+
+	PrintHotFunctions(stacks, args.topCount);
+	spdlog::info("Folded stacks: {}", foldedFilePath);
+	spdlog::info("Flamegraph: {}", svgFilePath);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,337 @@
+#include <build_master/report_command.hpp>
+#include <build_master/process.hpp> // for RunProcess()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir()
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iterator>
+#include <span>
+#include <cctype>
+
+#include <spdlog/spdlog.h>
+
+// A record of build_master_resource_log.bin, it is followed by the output path and the source path (not null terminated)
+// The fields are in the native byte order, the log is read on the machine which has written it
+struct ResourceLogRecord
+{
+	std::uint32_t magic;
+	std::uint16_t outputPathSize;
+	std::uint16_t sourcePathSize;
+	std::uint64_t wallTime;
+	std::uint64_t userTime;
+	std::uint64_t systemTime;
+	// In bytes, 0 if it isn't known (Windows)
+	std::uint64_t peakMemory;
+	std::uint64_t outputSize;
+	std::int32_t exitCode;
+	std::uint32_t flags;
+};
+static_assert(sizeof(ResourceLogRecord) == 56, "ResourceLogRecord is written as it is, it must not have padding");
+
+// "BMR1", also the version of the record layout
+static constexpr std::uint32_t gResourceLogRecordMagic = 0x31524d42;
+// Set in ResourceLogRecord::flags if the job has linked (it doesn't have -c)
+static constexpr std::uint32_t gLinkRecordFlag = 1;
+// The times are recorded in microseconds
+static constexpr double gMicroseconds = 1e6;
+static constexpr double gKiB = 1024;
+static constexpr double gMiB = 1024 * 1024;
+
+static constexpr std::string_view gSourceFileExtensions[] = { ".c", ".cc", ".cpp", ".cxx", ".c++", ".C", ".m", ".mm", ".s", ".S", ".sx", ".cppm", ".ixx", ".cu" };
+
+static bool IsSourceFile(std::string_view path)
+{
+	auto dotPos = path.rfind('.');
+	return (dotPos != std::string_view::npos) && std::ranges::find(gSourceFileExtensions, path.substr(dotPos)) != std::end(gSourceFileExtensions);
+}
+
+// Splits the content of a response file into the arguments, the same as GCC and Clang do:
+// separated by whitespace, quoted with ' or ", and \ escapes the next character
+static std::vector<std::string> SplitResponseFile(std::string_view content)
+{
+	std::vector<std::string> args;
+	std::string arg;
+	bool isInArg = false;
+	char quote = 0;
+	for(std::size_t i = 0; i < content.size(); ++i)
+	{
+		char ch = content[i];
+		if(ch == '\\' && (i + 1) < content.size())
+		{
+			arg.push_back(content[++i]);
+			isInArg = true;
+		}
+		else if(quote)
+		{
+			if(ch == quote)
+				quote = 0;
+			else
+				arg.push_back(ch);
+		}
+		else if(ch == '\'' || ch == '"')
+		{
+			quote = ch;
+			isInArg = true;
+		}
+		else if(std::isspace(static_cast<unsigned char>(ch)))
+		{
+			if(isInArg)
+				args.push_back(std::move(arg));
+			arg.clear();
+			isInArg = false;
+		}
+		else
+		{
+			arg.push_back(ch);
+			isInArg = true;
+		}
+	}
+	if(isInArg)
+		args.push_back(std::move(arg));
+	return args;
+}
+
+// Returns the arguments with the response files (@<file>, meson passes the long command lines in them) replaced by their arguments
+// Only used to find -o, -c, and the source file, the compiler gets the original arguments. A response file which can't be read is kept as it is.
+static std::vector<std::string> ExpandResponseFiles(const std::vector<std::string>& args)
+{
+	std::vector<std::string> expandedArgs;
+	expandedArgs.reserve(args.size());
+	for(const auto& arg : args)
+	{
+		std::ifstream stream;
+		if(arg.starts_with('@') && arg.size() > 1)
+			stream.open(arg.substr(1), std::ios_base::binary);
+		if(!stream)
+		{
+			expandedArgs.push_back(arg);
+			continue;
+		}
+		std::string content { std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+		std::ranges::move(SplitResponseFile(content), std::back_inserter(expandedArgs));
+	}
+	return expandedArgs;
+}
+
+static std::uint64_t ToMicroseconds(double seconds)
+{
+	return static_cast<std::uint64_t>(seconds * gMicroseconds);
+}
+
+int RunCcWrap(const std::vector<std::string>& args)
+{
+	if(args.empty())
+	{
+		std::cerr << "Error: build_master cc-wrap expects the compiler and its arguments\n";
+		return EXIT_FAILURE;
+	}
+	std::vector<std::string> expandedArgs = ExpandResponseFiles(args);
+	std::string_view outputPath, sourcePath;
+	bool isCompile = false;
+	for(std::size_t i = 1; i < expandedArgs.size(); ++i)
+	{
+		std::string_view arg { expandedArgs[i] };
+		if(arg == "-o" && (i + 1) < expandedArgs.size())
+			outputPath = expandedArgs[++i];
+		else if(arg.starts_with("-o") && arg.size() > 2)
+			outputPath = arg.substr(2);
+		else if(arg == "-c")
+			isCompile = true;
+		else if(!arg.starts_with('-') && IsSourceFile(arg))
+			sourcePath = arg;
+	}
+
+	ProcessResult result = RunProcess(args);
+	// Not started at all, or terminated by a signal
+	if(result.exitCode == -1)
+		std::cerr << std::format("Error: {} has failed to run (or has been terminated)\n", args[0]);
+	if(outputPath.empty())
+		return (result.exitCode == -1) ? EXIT_FAILURE : result.exitCode;
+
+	ResourceLogRecord record { };
+	record.magic = gResourceLogRecordMagic;
+	record.outputPathSize = static_cast<std::uint16_t>(std::min<std::size_t>(outputPath.size(), UINT16_MAX));
+	record.sourcePathSize = static_cast<std::uint16_t>(std::min<std::size_t>(sourcePath.size(), UINT16_MAX));
+	record.wallTime = ToMicroseconds(result.wallTime);
+	record.userTime = ToMicroseconds(result.userTime);
+	record.systemTime = ToMicroseconds(result.systemTime);
+	record.peakMemory = result.peakMemory;
+	std::error_code errorCode;
+	record.outputSize = (result.exitCode == 0) ? std::filesystem::file_size(outputPath, errorCode) : 0;
+	if(errorCode)
+		record.outputSize = 0;
+	record.exitCode = result.exitCode;
+	record.flags = isCompile ? 0 : gLinkRecordFlag;
+	std::string recordData(sizeof(record), '\0');
+	std::memcpy(recordData.data(), &record, sizeof(record));
+	recordData.append(outputPath.substr(0, record.outputPathSize)).append(sourcePath.substr(0, record.sourcePathSize));
+
+	// Append mode (O_APPEND) and unbuffered, so that the record goes into a single write() call at the end of the file,
+	// the parallel jobs don't interleave their records then. The log is only a diagnostic, the build doesn't fail if it can't be written.
+	if(std::FILE* file = std::fopen(gResourceLogFileName.data(), "ab"))
+	{
+		std::setvbuf(file, nullptr, _IONBF, 0);
+		std::fwrite(recordData.data(), 1, recordData.size(), file);
+		std::fclose(file);
+	}
+	return (result.exitCode == -1) ? EXIT_FAILURE : result.exitCode;
+}
+
+// A job as read from the log
+struct ResourceLogEntry
+{
+	ResourceLogRecord record;
+	std::string outputPath;
+	std::string sourcePath;
+};
+
+// Aggregated resource usage of the jobs of a target or of a directory
+struct ResourceUsage
+{
+	std::size_t jobCount { 0 };
+	std::uint64_t wallTime { 0 };
+	std::uint64_t userTime { 0 };
+	std::uint64_t systemTime { 0 };
+	// Of the most memory hungry job
+	std::uint64_t peakMemory { 0 };
+	std::uint64_t outputSize { 0 };
+
+	void Add(const ResourceLogRecord& record)
+	{
+		++jobCount;
+		wallTime += record.wallTime;
+		userTime += record.userTime;
+		systemTime += record.systemTime;
+		peakMemory = std::max(peakMemory, record.peakMemory);
+		outputSize += record.outputSize;
+	}
+};
+
+// Returns the latest record of each output, in the order they have been written
+// Reading stops at the first invalid or truncated record (e.g. an interrupted write), the records before it are still reported
+static std::vector<ResourceLogEntry> LoadResourceLog(const std::filesystem::path& logFilePath)
+{
+	std::ifstream stream(logFilePath, std::ios::binary);
+	std::string data { std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>() };
+	std::vector<ResourceLogEntry> entries;
+	std::map<std::string, std::size_t, std::less<>> entryIndices;
+	std::size_t pos = 0;
+	while(pos < data.size())
+	{
+		ResourceLogEntry entry;
+		if(data.size() - pos < sizeof(entry.record))
+			break;
+		std::memcpy(&entry.record, data.data() + pos, sizeof(entry.record));
+		std::size_t recordSize = sizeof(entry.record) + entry.record.outputPathSize + entry.record.sourcePathSize;
+		if(entry.record.magic != gResourceLogRecordMagic || data.size() - pos < recordSize)
+			break;
+		pos += sizeof(entry.record);
+		entry.outputPath = data.substr(pos, entry.record.outputPathSize);
+		pos += entry.record.outputPathSize;
+		entry.sourcePath = data.substr(pos, entry.record.sourcePathSize);
+		pos += entry.record.sourcePathSize;
+		if(auto it = entryIndices.find(entry.outputPath); it != entryIndices.end())
+			entries[it->second] = std::move(entry);
+		else
+		{
+			entryIndices.emplace(entry.outputPath, entries.size());
+			entries.push_back(std::move(entry));
+		}
+	}
+	if(pos < data.size())
+		spdlog::warn("{} has an invalid record at offset {}, the rest of it is ignored", logFilePath.string(), pos);
+	return entries;
+}
+
+// Returns the target the output belongs to, objects are in <target output>.p/ (meson's layout), the links output the target itself
+// Example: sub/libfoo.so.p/source_foo.cpp.o -> sub/libfoo.so
+static std::string GetTargetOfOutput(std::string_view outputPath)
+{
+	if(auto pos = outputPath.find(".p/"); pos != std::string_view::npos)
+		return std::string { outputPath.substr(0, pos) };
+	return std::string { outputPath };
+}
+
+static void PrintResourceUsageTable(std::string_view title, const std::map<std::string, ResourceUsage>& usages)
+{
+	std::vector<std::pair<std::string_view, const ResourceUsage*>> sortedUsages;
+	std::size_t nameWidth = title.size();
+	for(const auto& [name, usage] : usages)
+	{
+		sortedUsages.push_back({ name, &usage });
+		nameWidth = std::max(nameWidth, name.size());
+	}
+	std::ranges::stable_sort(sortedUsages, std::ranges::greater { }, [](const auto& pair) { return pair.second->wallTime; });
+	std::cout << std::format("\n{:<{}}  {:>5}  {:>10}  {:>10}  {:>10}  {:>10}  {:>12}\n", title, nameWidth, "Jobs", "Wall", "User", "Sys", "Peak RSS", "Output");
+	for(const auto& [name, usage] : sortedUsages)
+		std::cout << std::format("{:<{}}  {:>5}  {:>9.2f}s  {:>9.2f}s  {:>9.2f}s  {:>6.1f} MiB  {:>8.1f} KiB\n", name, nameWidth, usage->jobCount,
+								usage->wallTime / gMicroseconds, usage->userTime / gMicroseconds, usage->systemTime / gMicroseconds,
+								usage->peakMemory / gMiB, usage->outputSize / gKiB);
+}
+
+int RunReport(std::string_view directory, const ReportCommandArgs& args)
+{
+	auto buildDirectoryPath = std::filesystem::path(GetPathStrRelativeToDir(directory, args.buildDirectory));
+	auto logFilePath = buildDirectoryPath / gResourceLogFileName;
+	if(!std::filesystem::exists(logFilePath))
+	{
+		spdlog::error("{} doesn't exist, set \"resource_accounting\" : true in build_master.json and reconfigure the build directory (the jobs are recorded as they run)",
+						logFilePath.string());
+		return EXIT_FAILURE;
+	}
+	std::vector<ResourceLogEntry> entries = LoadResourceLog(logFilePath);
+
+	std::error_code errorCode;
+	auto projectPath = std::filesystem::absolute(directory.empty() ? "." : directory, errorCode).lexically_normal();
+	auto absoluteBuildDirectoryPath = std::filesystem::absolute(buildDirectoryPath, errorCode).lexically_normal();
+	std::map<std::string, ResourceUsage> targetUsages, directoryUsages;
+	// Compile jobs, with their source paths relative to the project
+	std::vector<std::pair<const ResourceLogRecord*, std::string>> compileJobs;
+	std::size_t failCount = 0;
+	for(const auto& entry : entries)
+	{
+		// The failed jobs haven't produced anything (and may have failed early), they would skew the numbers
+		if(entry.record.exitCode != 0)
+		{
+			++failCount;
+			continue;
+		}
+		targetUsages[GetTargetOfOutput(entry.outputPath)].Add(entry.record);
+		if(entry.record.flags & gLinkRecordFlag)
+			continue;
+		// The source paths are relative to the build directory (the working directory of the jobs), they are reported relative to the project
+		auto sourcePath = (absoluteBuildDirectoryPath / entry.sourcePath).lexically_normal();
+		auto relativeSourcePath = sourcePath.lexically_relative(projectPath);
+		if(!relativeSourcePath.empty() && *relativeSourcePath.begin() != "..")
+			sourcePath = relativeSourcePath;
+		auto directoryPath = sourcePath.parent_path().generic_string();
+		directoryUsages[directoryPath.empty() ? "." : directoryPath].Add(entry.record);
+		compileJobs.push_back({ &entry.record, entry.sourcePath.empty() ? entry.outputPath : sourcePath.generic_string() });
+	}
+
+	std::cout << std::format("{} jobs recorded in {} (the latest of each output){}\n", entries.size(), logFilePath.string(),
+							failCount ? std::format(", {} failed jobs are left out", failCount) : std::string { });
+	PrintResourceUsageTable("Target", targetUsages);
+	PrintResourceUsageTable("Directory (compile jobs)", directoryUsages);
+	if(args.topCount && compileJobs.size())
+	{
+		std::size_t topCount = std::min<std::size_t>(args.topCount, compileJobs.size());
+		std::ranges::partial_sort(compileJobs, compileJobs.begin() + topCount, std::ranges::greater { }, [](const auto& job) { return job.first->peakMemory; });
+		std::cout << std::format("\n{:>10}  {:>10}  {:>10}  {:>10}  Translation unit (top {} by peak RSS)\n", "Peak RSS", "Wall", "User", "Sys", topCount);
+		for(const auto& [record, sourcePath] : std::span(compileJobs).first(topCount))
+			std::cout << std::format("{:>6.1f} MiB  {:>9.2f}s  {:>9.2f}s  {:>9.2f}s  {}\n", record->peakMemory / gMiB, record->wallTime / gMicroseconds,
+									record->userTime / gMicroseconds, record->systemTime / gMicroseconds, sourcePath);
+	}
+	return EXIT_SUCCESS;
+}
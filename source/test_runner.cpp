@@ -0,0 +1,295 @@
+#include <build_master/test_runner.hpp>
+#include <build_master/meson_build_gen.hpp> // for RegenerateMesonBuildScript()
+#include <build_master/invoke_meson.hpp> // for RunMesonCmd()
+#include <build_master/process.hpp> // for RunProcess()
+#include <build_master/json_parse.hpp> // for ParseJsonFile(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), WriteTextFileIfChanged(), and ComputeContentHash()
+
+#include <iostream>
+#include <cstdlib>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <spdlog/spdlog.h>
+
+static constexpr std::string_view gTestDurationsFileName = "build_master_test_durations.json";
+static constexpr std::string_view gTestLogsDirPath = "meson-logs/build_master_test";
+// Exit code of a test which means the test has been skipped (same as meson and automake)
+static constexpr int gSkipExitCode = 77;
+
+enum class TestStatus
+{
+	Ok,
+	Fail,
+	Skip,
+	Timeout
+};
+
+struct TestCase
+{
+	std::string name;
+	std::vector<std::string> cmd;
+	std::vector<std::pair<std::string, std::string>> env;
+	std::string workDirectory;
+	// In seconds, 0 means no timeout
+	double timeout;
+	bool isParallel;
+	// Duration recorded in the previous runs (in seconds), or an estimate if it has never been run
+	double expectedDuration;
+	TestStatus status { TestStatus::Fail };
+	double duration { 0 };
+};
+
+// Loads the tests registered with meson from <build directory>/meson-info/intro-tests.json
+static std::vector<TestCase> LoadTests(std::string_view buildDirectory)
+{
+	auto introFilePath = GetPathStrRelativeToDir(buildDirectory, "meson-info/intro-tests.json");
+	if(!std::filesystem::exists(introFilePath))
+	{
+		spdlog::error("{} doesn't exist, please configure the build directory first with 'build_master meson setup {}'", introFilePath, buildDirectory);
+		exit(EXIT_FAILURE);
+	}
+	std::vector<TestCase> tests;
+	for(const auto& testJson : ParseJsonFile(introFilePath))
+	{
+		TestCase test;
+		test.name = GetJsonKeyValue<std::string>(testJson, "name");
+		test.cmd = GetJsonKeyValue<std::vector<std::string>>(testJson, "cmd");
+		json envJson = GetJsonKeyValue<json>(testJson, "env", json::object());
+		for(const auto& [name, value] : envJson.items())
+			test.env.push_back({ name, value.template get<std::string>() });
+		auto workDirectory = GetJsonKeyValueOrNull<json>(testJson, "workdir");
+		test.workDirectory = (workDirectory && workDirectory->is_string()) ? workDirectory->template get<std::string>() : std::string { buildDirectory };
+		test.timeout = std::max(GetJsonKeyValue<double>(testJson, "timeout", 0), 0.0);
+		test.isParallel = GetJsonKeyValue<bool>(testJson, "is_parallel", true);
+		tests.push_back(std::move(test));
+	}
+	return tests;
+}
+
+static std::unordered_map<std::string, double> LoadTestDurations(std::string_view filePath)
+{
+	std::unordered_map<std::string, double> durations;
+	if(!std::filesystem::exists(filePath))
+		return durations;
+	try
+	{
+		json durationsJson = ParseJsonFile(filePath);
+		for(const auto& [name, value] : durationsJson.items())
+			durations.insert({ name, value.template get<double>() });
+	} catch(const std::exception& except)
+	{
+		spdlog::warn("Ignoring malformed test durations file {}, {}", filePath, except.what());
+	}
+	return durations;
+}
+
+static void SaveTestDurations(std::string_view filePath, std::unordered_map<std::string, double> durations, const std::vector<TestCase>& tests)
+{
+	for(const auto& test : tests)
+	{
+		// Skipped and timed out tests don't tell anything about their actual duration
+		if(test.status == TestStatus::Ok || test.status == TestStatus::Fail)
+			durations[test.name] = test.duration;
+	}
+	// Sorted by name, so that the file diffs nicely if it is committed to be shared among CI shards
+	json durationsJson = json::object();
+	std::vector<std::pair<std::string, double>> sortedDurations { durations.begin(), durations.end() };
+	std::ranges::sort(sortedDurations);
+	for(const auto& [name, duration] : sortedDurations)
+		durationsJson[name] = duration;
+	WriteTextFileIfChanged(filePath, durationsJson.dump(4));
+}
+
+// Parses "i/N" into { i - 1, N }
+static std::pair<std::size_t, std::size_t> ParseShard(std::string_view shardStr)
+{
+	std::size_t index = 0, count = 0;
+	auto slashPos = shardStr.find('/');
+	try
+	{
+		if(slashPos != std::string_view::npos)
+		{
+			index = std::stoul(std::string { shardStr.substr(0, slashPos) });
+			count = std::stoul(std::string { shardStr.substr(slashPos + 1) });
+		}
+	} catch(const std::exception&) { }
+	if(index == 0 || count == 0 || index > count)
+	{
+		spdlog::error("Invalid value {} for --shard, expected i/N where 1 <= i <= N", shardStr);
+		exit(EXIT_FAILURE);
+	}
+	return { index - 1, count };
+}
+
+// Orders the tests by expected duration (longest first), ties are broken by the name so that every shard computes the same order
+static void SortLongestFirst(std::vector<TestCase>& tests)
+{
+	std::ranges::sort(tests, [](const TestCase& a, const TestCase& b)
+	{
+		if(a.expectedDuration != b.expectedDuration)
+			return a.expectedDuration > b.expectedDuration;
+		return a.name < b.name;
+	});
+}
+
+// Greedy longest-processing-time partitioning, each test (longest first) goes to the shard with the least total expected duration
+// tests must already be sorted with SortLongestFirst()
+static std::vector<TestCase> SelectShard(std::vector<TestCase>&& tests, std::size_t shardIndex, std::size_t shardCount)
+{
+	std::vector<double> shardLoads(shardCount, 0);
+	std::vector<TestCase> shardTests;
+	for(auto& test : tests)
+	{
+		auto it = std::ranges::min_element(shardLoads);
+		*it += test.expectedDuration;
+		if(static_cast<std::size_t>(std::distance(shardLoads.begin(), it)) == shardIndex)
+			shardTests.push_back(std::move(test));
+	}
+	return shardTests;
+}
+
+// Each test goes to the shard selected by the hash of its name, used if the shards don't share a durations file
+// The recorded durations differ among the build directories of the shards (each records only its own tests), so they would compute different partitions,
+// whereas the name hash gives the same partition everywhere (though not balanced by the durations)
+static std::vector<TestCase> SelectShardByNameHash(std::vector<TestCase>&& tests, std::size_t shardIndex, std::size_t shardCount)
+{
+	std::erase_if(tests, [shardIndex, shardCount](const TestCase& test) { return (ComputeContentHash(test.name) % shardCount) != shardIndex; });
+	return std::move(tests);
+}
+
+static std::string_view GetStatusStr(TestStatus status)
+{
+	switch(status)
+	{
+		case TestStatus::Ok: return "OK";
+		case TestStatus::Fail: return "FAIL";
+		case TestStatus::Skip: return "SKIP";
+		case TestStatus::Timeout: return "TIMEOUT";
+	}
+	return "";
+}
+
+static std::string GetLogFileName(std::string_view testName)
+{
+	std::string fileName { testName };
+	std::ranges::replace_if(fileName, [](char ch) { return ch == '/' || ch == '\\' || ch == ':' || ch == ' '; }, '_');
+	return fileName.append(".txt");
+}
+
+// directory: value passed to --directory flag
+int RunTests(std::string_view directory, const TestCommandArgs& args)
+{
+	auto buildDirectory = GetPathStrRelativeToDir(directory, args.buildDirectory);
+	if(!args.isNoRebuild)
+	{
+		RegenerateMesonBuildScript(directory);
+		if(int exitCode = RunMesonCmd(directory, { "compile", "-C", args.buildDirectory }); exitCode != 0)
+		{
+			spdlog::error("Failed to build the project, not running the tests");
+			return exitCode;
+		}
+	}
+
+	std::vector<TestCase> tests = LoadTests(buildDirectory);
+	if(args.testNames.size())
+	{
+		std::unordered_set<std::string_view> names { args.testNames.begin(), args.testNames.end() };
+		std::erase_if(tests, [&names](const TestCase& test) { return !names.contains(test.name); });
+	}
+
+	// Tests which have never been run are assumed to be as long as the longest known one, so that they are started early
+	auto durationsFilePath = args.durationsFilePath.size() ? args.durationsFilePath : GetPathStrRelativeToDir(buildDirectory, gTestDurationsFileName);
+	auto durations = LoadTestDurations(durationsFilePath);
+	double maxKnownDuration = 0;
+	for(const auto& [name, duration] : durations)
+		maxKnownDuration = std::max(maxKnownDuration, duration);
+	if(maxKnownDuration == 0)
+		maxKnownDuration = 1;
+	for(auto& test : tests)
+	{
+		auto it = durations.find(test.name);
+		test.expectedDuration = (it != durations.end()) ? it->second : maxKnownDuration;
+	}
+
+	SortLongestFirst(tests);
+	if(args.shard.size())
+	{
+		auto [shardIndex, shardCount] = ParseShard(args.shard);
+		bool isSharedDurations = args.durationsFilePath.size();
+		tests = isSharedDurations ? SelectShard(std::move(tests), shardIndex, shardCount) : SelectShardByNameHash(std::move(tests), shardIndex, shardCount);
+		std::cout << std::format("Info: shard {}/{} runs {} tests{}\n", shardIndex + 1, shardCount, tests.size(),
+									isSharedDurations ? "" : " (partitioned by the name hashes, pass --durations-file to balance the shards by the durations)");
+	}
+	if(tests.empty())
+	{
+		std::cout << "Info: No tests to run\n";
+		return EXIT_SUCCESS;
+	}
+
+	auto logsDirPath = std::filesystem::path(buildDirectory) / gTestLogsDirPath;
+	std::filesystem::create_directories(logsDirPath);
+
+	std::mutex outputMutex;
+	std::size_t finishedCount = 0;
+	auto runTest = [&](TestCase& test)
+	{
+		auto logFilePath = (logsDirPath / GetLogFileName(test.name)).string();
+		ProcessResult result = RunProcess(test.cmd, test.workDirectory, test.env, logFilePath, test.timeout);
+		test.duration = result.wallTime;
+		if(result.isTimedOut)
+			test.status = TestStatus::Timeout;
+		else if(result.exitCode == gSkipExitCode)
+			test.status = TestStatus::Skip;
+		else
+			test.status = (result.exitCode == 0) ? TestStatus::Ok : TestStatus::Fail;
+		std::lock_guard<std::mutex> lock(outputMutex);
+		++finishedCount;
+		std::cout << std::format("{:>4}/{} {:<40} {:<8} {:.2f}s\n", finishedCount, tests.size(), test.name, GetStatusStr(test.status), test.duration);
+		if(test.status == TestStatus::Fail || test.status == TestStatus::Timeout)
+			std::cout << std::format("     log: {}\n", logFilePath);
+	};
+
+	auto startTime = std::chrono::steady_clock::now();
+	// Parallel tests first, longest first, then the exclusive ones one by one
+	std::vector<TestCase*> parallelTests, serialTests;
+	for(auto& test : tests)
+		(test.isParallel ? parallelTests : serialTests).push_back(&test);
+	unsigned int jobCount = args.jobCount ? args.jobCount : std::max(std::thread::hardware_concurrency(), 1u);
+	jobCount = std::min<unsigned int>(jobCount, std::max<std::size_t>(parallelTests.size(), 1));
+	{
+		std::atomic<std::size_t> nextIndex = 0;
+		std::vector<std::jthread> workers;
+		for(unsigned int i = 0; i < jobCount; ++i)
+			workers.emplace_back([&]()
+			{
+				for(std::size_t index; (index = nextIndex.fetch_add(1)) < parallelTests.size();)
+					runTest(*parallelTests[index]);
+			});
+	}
+	for(TestCase* test : serialTests)
+		runTest(*test);
+	double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+	SaveTestDurations(durationsFilePath, std::move(durations), tests);
+
+	std::size_t counts[4] = { };
+	double totalDuration = 0;
+	for(const auto& test : tests)
+	{
+		++counts[static_cast<std::size_t>(test.status)];
+		totalDuration += test.duration;
+	}
+	std::cout << std::format("\nOk: {}, Fail: {}, Skipped: {}, Timeout: {}\n", counts[0], counts[1], counts[2], counts[3]);
+	std::cout << std::format("Total test time: {:.2f}s, wall time: {:.2f}s ({} jobs)\n", totalDuration, wallTime, jobCount);
+	return (counts[static_cast<std::size_t>(TestStatus::Fail)] || counts[static_cast<std::size_t>(TestStatus::Timeout)]) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
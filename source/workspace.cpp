@@ -0,0 +1,241 @@
+#include <build_master/workspace.hpp>
+#include <build_master/meson_build_gen.hpp> // for TryRegenerateMesonBuildScript()
+#include <build_master/invoke_meson.hpp> // for InvokeMeson()
+#include <build_master/pre_config_script.hpp> // for RunPreConfigScript()
+#include <build_master/dependency_probe.hpp> // for ProbeDependencies()
+#include <build_master/artifact_cache.hpp> // for PreparePrebuiltDependencies()
+#include <build_master/json_parse.hpp> // for ParseJsonFile(), and GetJsonKeyValue<>()
+#include <build_master/misc.hpp> // for GetPathStrRelativeToDir(), and WriteTextFileIfChanged()
+#include <build_master/version.hpp>
+
+#include <iostream>
+#include <cstdlib>
+#include <format>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <future>
+#include <unordered_map>
+#include <set>
+
+#include <spdlog/spdlog.h>
+
+static constexpr std::string_view gWorkspaceJsonFilePath = "build_master_workspace.json";
+static constexpr std::string_view gSubprojectsDirPath = "subprojects";
+
+struct WorkspaceProject
+{
+	// Directory of the project, relative to the workspace directory (or absolute)
+	std::string directory;
+	// Name of the subproject, it is the canonical_name of the project
+	std::string canonicalName;
+	// Names of the library targets, dependency() calls with these names (in other projects) resolve to these targets
+	std::vector<std::string> providedDependencies;
+	// Names passed to dependency() calls in this project, i.e. project and target level, including platform specific ones
+	std::vector<std::string> requiredDependencies;
+};
+
+static void CollectDependencyNames(const json& jsonObj, std::vector<std::string>& names)
+{
+	for(std::string_view keyName : { "dependencies", "windows_dependencies", "linux_dependencies", "darwin_dependencies" })
+	{
+		auto it = jsonObj.find(keyName);
+		if(it == jsonObj.end())
+			continue;
+		for(const auto& value : it.value())
+			names.push_back(value.template get<std::string>());
+	}
+}
+
+static bool IsLibraryTarget(const json& targetJson)
+{
+	return GetJsonKeyValue<bool>(targetJson, "is_static_library", false)
+		|| GetJsonKeyValue<bool>(targetJson, "is_shared_library", false)
+		|| GetJsonKeyValue<bool>(targetJson, "is_header_only_library", false);
+}
+
+// directory: value passed to --directory flag
+static std::vector<WorkspaceProject> LoadWorkspaceProjects(std::string_view directory, std::string& workspaceName)
+{
+	auto workspaceJsonFilePath = GetPathStrRelativeToDir(directory, gWorkspaceJsonFilePath);
+	if(!std::filesystem::exists(workspaceJsonFilePath))
+	{
+		spdlog::error("{} doesn't exist", workspaceJsonFilePath);
+		exit(EXIT_FAILURE);
+	}
+	json workspaceJson = ParseJsonFile(workspaceJsonFilePath);
+	workspaceName = GetJsonKeyValue<std::string>(workspaceJson, "workspace_name", "workspace");
+	std::vector<WorkspaceProject> projects;
+	for(const auto& value : GetJsonKeyValue<json>(workspaceJson, "projects"))
+	{
+		WorkspaceProject project;
+		project.directory = GetPathStrRelativeToDir(directory, value.template get<std::string>());
+		if(!std::filesystem::exists(GetBuildMasterJsonFilePath(project.directory)))
+		{
+			spdlog::error("No build_master.json found in the project directory {}", project.directory);
+			exit(EXIT_FAILURE);
+		}
+		if(std::filesystem::equivalent(project.directory, directory.empty() ? "." : directory))
+		{
+			spdlog::error("Project directory {} can't be the workspace directory itself", project.directory);
+			exit(EXIT_FAILURE);
+		}
+		json buildMasterJson = ParseBuildMasterJson(project.directory);
+		project.canonicalName = GetJsonKeyValue<std::string>(buildMasterJson, "canonical_name");
+		CollectDependencyNames(buildMasterJson, project.requiredDependencies);
+		for(const auto& targetJson : GetJsonKeyValue<json>(buildMasterJson, "targets", json::array()))
+		{
+			CollectDependencyNames(targetJson, project.requiredDependencies);
+			if(IsLibraryTarget(targetJson))
+				project.providedDependencies.push_back(GetJsonKeyValue<std::string>(targetJson, "name"));
+		}
+		projects.push_back(std::move(project));
+	}
+	return projects;
+}
+
+// Sorts the projects such that each project comes after all of the projects it depends on
+// The order given in build_master_workspace.json is preserved among the independent projects
+static std::vector<const WorkspaceProject*> SortProjectsByDependencies(const std::vector<WorkspaceProject>& projects)
+{
+	std::unordered_map<std::string_view, std::size_t> providers;
+	std::unordered_map<std::string_view, std::size_t> canonicalNames;
+	for(std::size_t i = 0; i < projects.size(); ++i)
+	{
+		if(!canonicalNames.insert({ projects[i].canonicalName, i }).second)
+		{
+			spdlog::error("More than one project in the workspace have the canonical_name: {}", projects[i].canonicalName);
+			exit(EXIT_FAILURE);
+		}
+		for(const auto& name : projects[i].providedDependencies)
+		{
+			if(auto result = providers.insert({ name, i }); !result.second)
+			{
+				spdlog::error("Library target {} is defined in both {} and {}", name, projects[result.first->second].directory, projects[i].directory);
+				exit(EXIT_FAILURE);
+			}
+		}
+	}
+	std::vector<const WorkspaceProject*> sortedProjects;
+	// 0: not visited, 1: being visited, 2: visited
+	std::vector<int> states(projects.size(), 0);
+	auto visit = [&](auto& self, std::size_t index) -> void
+	{
+		if(states[index] == 2)
+			return;
+		if(states[index] == 1)
+		{
+			spdlog::error("Circular dependency detected among the workspace projects, involving {}", projects[index].directory);
+			exit(EXIT_FAILURE);
+		}
+		states[index] = 1;
+		for(const auto& name : projects[index].requiredDependencies)
+			if(auto it = providers.find(name); it != providers.end() && it->second != index)
+				self(self, it->second);
+		states[index] = 2;
+		sortedProjects.push_back(&projects[index]);
+	};
+	for(std::size_t i = 0; i < projects.size(); ++i)
+		visit(visit, i);
+	return sortedProjects;
+}
+
+// Meson looks for subprojects only in the 'subprojects' directory of the root project, so each project is linked there
+static void LinkSubproject(const std::filesystem::path& subprojectsDirPath, const WorkspaceProject& project)
+{
+	auto linkPath = subprojectsDirPath / project.canonicalName;
+	auto targetPath = std::filesystem::relative(std::filesystem::absolute(project.directory), std::filesystem::absolute(subprojectsDirPath));
+	if(std::filesystem::is_symlink(linkPath))
+	{
+		if(std::filesystem::read_symlink(linkPath) == targetPath)
+			return;
+		std::filesystem::remove(linkPath);
+	}
+	else if(std::filesystem::exists(linkPath))
+	{
+		spdlog::error("{} already exists and it is not a link to {}, please remove it first", linkPath.string(), project.directory);
+		exit(EXIT_FAILURE);
+	}
+	try
+	{
+		std::filesystem::create_directory_symlink(targetPath, linkPath);
+	} catch(const std::exception& except)
+	{
+		spdlog::error("Failed to link {} to {}, {}", linkPath.string(), targetPath.string(), except.what());
+		exit(EXIT_FAILURE);
+	}
+}
+
+// directory: value passed to --directory flag
+static void GenerateWorkspaceMesonBuildScript(std::string_view directory, std::string_view workspaceName, const std::vector<const WorkspaceProject*>& sortedProjects)
+{
+	auto subprojectsDirPath = std::filesystem::path(GetPathStrRelativeToDir(directory, gSubprojectsDirPath));
+	std::filesystem::create_directories(subprojectsDirPath);
+	std::ostringstream stream;
+	stream << std::format("#------------- Generated By Build Master {} ------------------\n\n", BUILDMASTER_VERSION_STRING);
+	stream << std::format("project('{}', 'c', 'cpp',\n  meson_version: '>=1.1'\n)\n\n", workspaceName);
+	stream << "# Projects are configured in the dependency order, so that dependency() calls in a project\n";
+	stream << "# resolve to the library targets (overridden with meson.override_dependency()) of the preceding projects\n";
+	for(const auto* project : sortedProjects)
+	{
+		LinkSubproject(subprojectsDirPath, *project);
+		stream << std::format("subproject('{}')\n", project->canonicalName);
+	}
+	auto mesonBuildScriptFilePath = GetPathStrRelativeToDir(directory, "meson.build");
+	if(WriteTextFileIfChanged(mesonBuildScriptFilePath, stream.str()))
+		std::cout << std::format("Generated {}", mesonBuildScriptFilePath) << "\n";
+}
+
+// build_master workspace
+// directory: value passed to --directory flag
+void InvokeMesonWorkspace(std::string_view directory, const std::vector<std::string>& args)
+{
+	std::string workspaceName;
+	std::vector<WorkspaceProject> projects = LoadWorkspaceProjects(directory, workspaceName);
+	std::vector<const WorkspaceProject*> sortedProjects = SortProjectsByDependencies(projects);
+
+	// Projects are independent of each other at the generation time, so generate them in parallel
+	// Each one reports into its own stream, they are printed (and the errors are reported) here in the declaration order once all of them have finished
+	std::vector<std::ostringstream> outputs(projects.size());
+	std::vector<std::future<void>> futures;
+	futures.reserve(projects.size());
+	for(std::size_t i = 0; i < projects.size(); ++i)
+		futures.push_back(std::async(std::launch::async, [&project = projects[i], &output = outputs[i]]() { TryRegenerateMesonBuildScript(project.directory, false, true, output); }));
+	bool isFailed = false;
+	for(std::size_t i = 0; i < projects.size(); ++i)
+	{
+		try
+		{
+			futures[i].get();
+			std::cout << outputs[i].str();
+		}
+		catch(const ProjectModelError& error)
+		{
+			std::cout << outputs[i].str();
+			std::cerr << std::format("Error: {}: {}", projects[i].directory, error.what()) << "\n";
+			isFailed = true;
+		}
+	}
+	if(isFailed)
+		exit(EXIT_FAILURE);
+
+	GenerateWorkspaceMesonBuildScript(directory, workspaceName, sortedProjects);
+
+	// Pre-config hooks may install dependencies required by the next projects, so run them in the dependency order
+	bool isSetup = args.size() == 0 || args[0] == "setup";
+	for(const auto* project : sortedProjects)
+	{
+		PreparePrebuiltDependencies(project->directory, isSetup);
+		if(isSetup)
+			RunPreConfigScript(project->directory);
+	}
+	std::set<std::string> providedDependencies;
+	for(const auto& project : projects)
+		providedDependencies.insert(project.providedDependencies.begin(), project.providedDependencies.end());
+	for(const auto* project : sortedProjects)
+		ProbeDependencies(project->directory, providedDependencies);
+
+	// The whole workspace is just one meson project now, so it builds with one ninja invocation
+	InvokeMeson(directory, args, false);
+}
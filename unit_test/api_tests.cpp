@@ -0,0 +1,266 @@
+// Tests and benchmarks of the in-process API (include/build_master/api.hpp), they run without spawning build_master
+// $ api_tests                  runs the tests
+// $ api_tests --benchmark      runs the tests, then measures how many times per second the meson.build is generated, and how many allocations it makes
+// new_delete.cpp is linked in, so the heap allocations made by libbuild_master are counted (see alloc_stats.hpp)
+#include <build_master/api.hpp>
+#include <build_master/alloc_stats.hpp> // for GetAllocationCount(), and GetAllocatedSize()
+
+#include <chrono>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+static int gFailureCount = 0;
+
+#define EXPECT(condition) \
+	do \
+	{ \
+		if(!(condition)) \
+		{ \
+			std::cerr << std::format("{}:{}: Failed: {}\n", __FILE__, __LINE__, #condition); \
+			++gFailureCount; \
+		} \
+	} while(false)
+
+// Returns true if callable throws build_master::Error
+static bool IsThrowingError(const std::function<void()>& callable)
+{
+	try
+	{
+		callable();
+	}
+	catch(const build_master::Error&)
+	{
+		return true;
+	}
+	return false;
+}
+
+// Sample project (like the one 'build_master init' creates) in a temporary directory, removed at the end
+class SampleProject
+{
+private:
+	std::filesystem::path m_directory;
+
+public:
+	SampleProject() : m_directory(std::filesystem::temp_directory_path() / std::format("build_master_api_tests_{}", std::chrono::steady_clock::now().time_since_epoch().count()))
+	{
+		std::filesystem::create_directories(m_directory / "source");
+		std::filesystem::create_directories(m_directory / "include");
+		std::ofstream { m_directory / "source" / "main.cpp" } << "int main() { return 0; }\n";
+		std::ofstream { m_directory / "source" / "kernels.c" } << "int dot(void) { return 0; }\n";
+	}
+	~SampleProject()
+	{
+		std::error_code errorCode;
+		std::filesystem::remove_all(m_directory, errorCode);
+	}
+
+	std::string GetDirectory() const { return m_directory.string(); }
+	// targets: json array elements of "targets", other: extra keys of the root object
+	static std::string GetJsonText(std::string_view targets, std::string_view other = "")
+	{
+		return std::format("{{\n"
+							"\t// Comments are allowed as in build_master.json\n"
+							"\t\"project_name\" : \"Sample\",\n"
+							"\t\"canonical_name\" : \"sample\",\n"
+							"\t\"include_dirs\" : \"include\",\n"
+							"{}"
+							"\t\"targets\" : [ {} ]\n"
+							"}}\n", other, targets);
+	}
+};
+
+static constexpr std::string_view gExecutableTarget = R"({ "name" : "sample", "is_executable" : true, "sources" : [ "source/main.cpp" ] })";
+static constexpr std::string_view gLibraryTarget = R"({ "name" : "kernels", "is_static_library" : true, "sources" : [ "source/kernels.c" ] })";
+
+static void TestGenerate(const SampleProject& project)
+{
+	auto model = build_master::ProjectModel::Parse(SampleProject::GetJsonText(gExecutableTarget), project.GetDirectory());
+	EXPECT(model.GetName() == "Sample");
+	EXPECT(model.GetTargetNames() == std::vector<std::string> { "sample" });
+	EXPECT(model.GetDirectory() == project.GetDirectory());
+	build_master::StringOutputSink sink;
+	build_master::GenerateMesonBuild(model, sink);
+	EXPECT(sink.rootScript.find("project('Sample'") != std::string::npos);
+	EXPECT(sink.rootScript.find("executable(") != std::string::npos);
+	EXPECT(sink.rootScript.find("'source/main.cpp'") != std::string::npos);
+	EXPECT(sink.targetScripts.empty());
+	// Nothing is written into the project's directory
+	EXPECT(!std::filesystem::exists(std::filesystem::path(project.GetDirectory()) / "meson.build"));
+
+	// Same model, same script
+	build_master::StringOutputSink otherSink;
+	build_master::GenerateMesonBuild(model, otherSink);
+	EXPECT(sink.rootScript == otherSink.rootScript);
+}
+
+static void TestSplitGenerate(const SampleProject& project)
+{
+	auto model = build_master::ProjectModel::Parse(SampleProject::GetJsonText(std::format("{}, {}", gLibraryTarget, gExecutableTarget), "\t\"split_meson_build\" : true,\n"), project.GetDirectory());
+	build_master::StringOutputSink sink;
+	build_master::GenerateMesonBuild(model, sink);
+	EXPECT(sink.targetScripts.size() == 2);
+	if(sink.targetScripts.size() == 2)
+	{
+		EXPECT(sink.targetScripts[0].first == "kernels");
+		EXPECT(sink.targetScripts[0].second.find("static_library(") != std::string::npos);
+		EXPECT(sink.targetScripts[1].first == "sample");
+	}
+	EXPECT(sink.rootScript.find("subdir(") != std::string::npos);
+}
+
+static void TestErrors(const SampleProject& project)
+{
+	// Malformed json
+	EXPECT(IsThrowingError([&]() { build_master::ProjectModel::Parse("{ \"project_name\" : ", project.GetDirectory()); }));
+	// Missing source file
+	EXPECT(IsThrowingError([&]()
+	{
+		build_master::ProjectModel::Parse(SampleProject::GetJsonText(R"({ "name" : "sample", "is_executable" : true, "sources" : [ "source/missing.cpp" ] })"), project.GetDirectory());
+	}));
+	// Missing file of "simd_sources"
+	EXPECT(IsThrowingError([&]()
+	{
+		build_master::ProjectModel::Parse(SampleProject::GetJsonText(R"({ "name" : "sample", "is_executable" : true, "sources" : [ "source/main.cpp" ],)"
+																		R"( "simd_sources" : { "files" : [ "source/missing.c" ], "isa" : [ "avx2" ], "functions" : [ "dot" ] } })"),
+											project.GetDirectory());
+	}));
+	// Missing build_master.json
+	EXPECT(IsThrowingError([&]() { build_master::ProjectModel::Load(project.GetDirectory()); }));
+	// Unknown instruction set, it is reported while generating, not while parsing
+	auto model = build_master::ProjectModel::Parse(SampleProject::GetJsonText(R"({ "name" : "sample", "is_executable" : true, "sources" : [ "source/main.cpp" ],)"
+																				R"( "simd_sources" : { "files" : [ "source/kernels.c" ], "isa" : [ "avx9" ], "functions" : [ "dot" ] } })"),
+													project.GetDirectory());
+	build_master::StringOutputSink sink;
+	EXPECT(IsThrowingError([&]() { build_master::GenerateMesonBuild(model, sink); }));
+}
+
+static void TestLoad(const SampleProject& project)
+{
+	std::ofstream { std::filesystem::path(project.GetDirectory()) / "build_master.json" } << SampleProject::GetJsonText(gExecutableTarget);
+	auto model = build_master::ProjectModel::Load(project.GetDirectory());
+	EXPECT(model.GetTargetNames() == std::vector<std::string> { "sample" });
+	// No hooks are given
+	EXPECT(!build_master::RunPreConfigHooks(model));
+	std::filesystem::remove(std::filesystem::path(project.GetDirectory()) / "build_master.json");
+}
+
+static void TestPreConfigHooks(const SampleProject& project)
+{
+#ifndef _WIN32
+	auto directoryPath = std::filesystem::path(project.GetDirectory());
+	std::ofstream { directoryPath / "hook.sh" } << "touch hook_has_run\n";
+	// The hooks of the parsed json are run, there is no build_master.json in the directory
+	auto model = build_master::ProjectModel::Parse(SampleProject::GetJsonText(gExecutableTarget, "\t\"pre_config_hook\" : \"hook.sh\",\n"), project.GetDirectory());
+	EXPECT(build_master::RunPreConfigHooks(model));
+	EXPECT(std::filesystem::exists(directoryPath / "hook_has_run"));
+	std::filesystem::remove(directoryPath / "hook.sh");
+	std::filesystem::remove(directoryPath / "hook_has_run");
+#else
+	static_cast<void>(project);
+#endif
+}
+
+// Returns json text of a project with targetCount executable targets, each having its own source file (written into the project's directory)
+static std::string WriteManyTargetsProject(const SampleProject& project, std::size_t targetCount)
+{
+	auto sourceDirPath = std::filesystem::path(project.GetDirectory()) / "source";
+	std::string targets;
+	for(std::size_t i = 0; i < targetCount; ++i)
+	{
+		std::ofstream { sourceDirPath / std::format("target_{}.c", i) } << "int main() { return 0; }\n";
+		targets.append(std::format(R"({}{{ "name" : "target_{}", "is_executable" : true, "sources" : [ "source/target_{}.c" ], "include_dirs" : [ "source" ],)"
+									R"( "dependencies" : [ "threads" ], "defines" : [ "-DTARGET_{}" ], "linux_link_args" : [ "-lm" ] }})", i ? ", " : "", i, i, i));
+	}
+	return SampleProject::GetJsonText(targets);
+}
+
+// { allocations, allocated bytes } made while generating meson.build of the model (excluding parsing of build_master.json)
+static std::pair<std::size_t, std::size_t> CountGenerationAllocations(const build_master::ProjectModel& model, build_master::StringOutputSink& sink)
+{
+	std::size_t allocationCount = GetAllocationCount();
+	std::size_t allocatedSize = GetAllocatedSize();
+	build_master::GenerateMesonBuild(model, sink);
+	return { GetAllocationCount() - allocationCount, GetAllocatedSize() - allocatedSize };
+}
+
+// The allocations made per target stay bounded, the output is formatted directly into a single buffer, only the unique target lists allocate
+static void TestGenerationAllocations(const SampleProject& project)
+{
+	auto smallModel = build_master::ProjectModel::Parse(WriteManyTargetsProject(project, 50), project.GetDirectory());
+	auto largeModel = build_master::ProjectModel::Parse(WriteManyTargetsProject(project, 200), project.GetDirectory());
+	build_master::StringOutputSink sink;
+	std::size_t smallCount = CountGenerationAllocations(smallModel, sink).first;
+	std::size_t largeCount = CountGenerationAllocations(largeModel, sink).first;
+	// Zero means new_delete.cpp isn't linked in
+	EXPECT(smallCount > 0);
+	EXPECT(largeCount < smallCount + 8 * 150);
+	if(largeCount >= smallCount + 8 * 150)
+		std::cerr << std::format("{} allocations for 50 targets, {} allocations for 200 targets\n", smallCount, largeCount);
+}
+
+// Reports the number of iterations of callable per second, it runs for about a second
+template<typename Callable>
+static void Benchmark(std::string_view name, const Callable& callable)
+{
+	using Clock = std::chrono::steady_clock;
+	std::size_t iterationCount = 0;
+	auto startTime = Clock::now();
+	std::chrono::duration<double> elapsedTime { };
+	while(elapsedTime < std::chrono::seconds(1))
+	{
+		for(std::size_t i = 0; i < 64; ++i)
+			callable();
+		iterationCount += 64;
+		elapsedTime = Clock::now() - startTime;
+	}
+	std::cout << std::format("{}: {:.0f} per second ({:.1f} us each)\n", name, iterationCount / elapsedTime.count(), elapsedTime.count() * 1e6 / iterationCount);
+}
+
+static void RunBenchmarks(const SampleProject& project)
+{
+	std::string targets { gLibraryTarget };
+	for(int i = 0; i < 32; ++i)
+		targets.append(std::format(R"(, {{ "name" : "sample{}", "is_executable" : true, "sources" : [ "source/main.cpp" ], "link_with" : [ "kernels" ] }})", i));
+	std::string jsonText = SampleProject::GetJsonText(targets);
+	auto model = build_master::ProjectModel::Parse(jsonText, project.GetDirectory());
+	build_master::StringOutputSink sink;
+	Benchmark("parse (33 targets)", [&]() { build_master::ProjectModel::Parse(jsonText, project.GetDirectory()); });
+	Benchmark("generate (33 targets)", [&]() { build_master::GenerateMesonBuild(model, sink); });
+	for(std::size_t targetCount : { 100, 1000, 5000 })
+	{
+		auto largeModel = build_master::ProjectModel::Parse(WriteManyTargetsProject(project, targetCount), project.GetDirectory());
+		auto [allocationCount, allocatedSize] = CountGenerationAllocations(largeModel, sink);
+		std::cout << std::format("generate ({} targets): {} allocations ({:.2f} per target, {:.1f} KiB), {:.1f} KiB generated\n",
+									targetCount, allocationCount, static_cast<double>(allocationCount) / targetCount, allocatedSize / 1024.0, sink.rootScript.size() / 1024.0);
+	}
+}
+
+int main(int argc, const char* argv[])
+{
+	SampleProject project;
+	TestGenerate(project);
+	TestSplitGenerate(project);
+	TestErrors(project);
+	TestLoad(project);
+	TestPreConfigHooks(project);
+	TestGenerationAllocations(project);
+	if(gFailureCount)
+	{
+		std::cerr << std::format("{} check(s) failed\n", gFailureCount);
+		return EXIT_FAILURE;
+	}
+	std::cout << std::format("All tests passed (build_master {})\n", build_master::GetVersionString());
+	if(argc > 1 && std::string_view { argv[1] } == "--benchmark")
+		RunBenchmarks(project);
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,276 @@
+# This script measures performance of the build_master executable (black box), it doesn't fail on slow results unless stated otherwise
+# NOTE: Number of repetitions can be controlled by BENCH_REPEAT environment variable
+# NOTE: The startup latency budget (see STARTUP_BUDGET_MS) is enforced, it can be scaled for slow machines with BENCH_BUDGET_SCALE environment variable
+
+import unittest
+import time
+import json
+import os
+import logging
+import statistics
+import subprocess
+import shutil
+import test_base
+
+logging.basicConfig(level=logging.INFO)
+
+BENCH_REPEAT = int(os.environ.get('BENCH_REPEAT', '5'))
+
+# Startup latency budget (median, in milliseconds) of the invocations the tooling makes most frequently
+# 'meson --help' and 'cc-wrap true' are the overheads of going through build_master, i.e. excluding the time taken by meson and the compiler themselves
+STARTUP_BUDGET_MS = {
+    '--version' : 10.0,
+    '--update-meson-build' : 20.0,
+    'meson --help' : 30.0,
+    'cc-wrap true' : 10.0
+}
+
+# Writes a synthetic project with 'target_count' executable targets, each having its own source file
+def write_synthetic_project(directory, target_count, is_split = False):
+    os.makedirs(os.path.join(directory, 'source'), exist_ok = True)
+    os.makedirs(os.path.join(directory, 'include'), exist_ok = True)
+    targets = []
+    for i in range(target_count):
+        source = f'source/target_{i}.c'
+        with open(os.path.join(directory, source), 'w') as file:
+            file.write('int main() { return 0; }\n')
+        targets.append({ 'name' : f'target_{i}', 'is_executable' : True, 'sources' : [ source ], 'include_dirs' : [ 'include' ], 'defines' : [ f'-DTARGET_{i}' ] })
+    config = { 'project_name' : 'Synthetic', 'canonical_name' : 'synthetic', 'include_dirs' : [ 'include' ], 'split_meson_build' : is_split, 'targets' : targets }
+    with open(os.path.join(directory, 'build_master.json'), 'w') as file:
+        json.dump(config, file, indent = 4)
+    return config
+
+# Writes a sample project for the C++20 modules: a library exporting a module (its code is inline, and it includes a few heavy standard headers),
+# and an executable with 'consumer_count' sources importing it, or including the same code as a header in header mode (see "module_sources")
+def write_modules_project(directory, consumer_count):
+    os.makedirs(os.path.join(directory, 'source'), exist_ok = True)
+    os.makedirs(os.path.join(directory, 'include'), exist_ok = True)
+    heavy_includes = '#include <algorithm>\n#include <functional>\n#include <map>\n#include <memory>\n#include <string>\n#include <unordered_map>\n#include <vector>\n'
+    code = 'namespace shapes { inline std::string describe(int id) { std::map<int, std::string> names { { id, std::string(static_cast<std::size_t>(id % 8 + 1), \'s\') } }; return names[id]; } }\n'
+    with open(os.path.join(directory, 'include/shapes.hpp'), 'w') as file:
+        file.write('#pragma once\n' + heavy_includes + code)
+    with open(os.path.join(directory, 'source/shapes.cppm'), 'w') as file:
+        file.write('module;\n' + heavy_includes + 'export module shapes;\nexport ' + code)
+    with open(os.path.join(directory, 'source/shapes.cpp'), 'w') as file:
+        file.write('int shapes_version() { return 1; }\n')
+    sources = [ 'source/main.cpp' ]
+    with open(os.path.join(directory, 'source/main.cpp'), 'w') as file:
+        file.write('int main() { return 0; }\n')
+    for i in range(consumer_count):
+        sources.append(f'source/consumer_{i}.cpp')
+        with open(os.path.join(directory, sources[-1]), 'w') as file:
+            file.write('#ifdef BUILD_MASTER_CXX_MODULES\nimport shapes;\n#else\n#include "shapes.hpp"\n#endif\n'
+                       f'int consumer_{i}() {{ return static_cast<int>(shapes::describe({i}).size()); }}\n')
+    config = { 'project_name' : 'Modules', 'canonical_name' : 'modules', 'include_dirs' : [ 'include' ], 'targets' : [
+        { 'name' : 'shapes', 'is_static_library' : True, 'sources' : [ 'source/shapes.cpp' ], 'module_sources' : [ 'source/shapes.cppm' ] },
+        { 'name' : 'app', 'is_executable' : True, 'sources' : sources, 'link_with' : [ 'shapes' ] }
+    ] }
+    with open(os.path.join(directory, 'build_master.json'), 'w') as file:
+        json.dump(config, file, indent = 4)
+    return config
+
+# Returns the median wall time (in milliseconds) of calling 'func' BENCH_REPEAT number of times
+def measure_ms(func):
+    samples = []
+    for _ in range(BENCH_REPEAT):
+        start = time.perf_counter()
+        func()
+        samples.append((time.perf_counter() - start) * 1000.0)
+    return statistics.median(samples)
+
+# Runs the command repeatedly (after a few warmup runs) the way hyperfine does, returns the wall times in milliseconds
+def measure_startup_ms(cmd, cwd, run_count):
+    samples = []
+    for i in range(run_count + 3):
+        start = time.perf_counter()
+        result = subprocess.run(cmd, cwd = cwd, stdout = subprocess.DEVNULL, stderr = subprocess.DEVNULL)
+        elapsed_ms = (time.perf_counter() - start) * 1000.0
+        if result.returncode != 0:
+            raise RuntimeError(f'{cmd} has failed with exit code {result.returncode}')
+        if i >= 3:
+            samples.append(elapsed_ms)
+    return samples
+
+class Benchmarks(test_base.TestBase):
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        return
+
+    def run_success(self, args):
+        output = self.run_with_args(args)
+        self.assert_return_success(output)
+        return output
+
+    # Generation and meson re-configure time after editing only one target, for both monolithic and split meson.build
+    def test_single_target_edit(self):
+        target_count = int(os.environ.get('BENCH_TARGET_COUNT', '300'))
+        directory = self._working_dir.name
+        results = { }
+        for is_split in [False, True]:
+            self.cleanupArtifacts()
+            config = write_synthetic_project(directory, target_count, is_split)
+            self.run_success(['--update-meson-build', '--force'])
+            self.run_success(['meson', 'setup', 'build'])
+            json_path = os.path.join(directory, 'build_master.json')
+            edit_count = [0]
+            def edit_and_generate():
+                edit_count[0] += 1
+                config['targets'][0]['defines'] = [ f'-DEDIT_{edit_count[0]}' ]
+                with open(json_path, 'w') as file:
+                    json.dump(config, file, indent = 4)
+                self.run_success(['--update-meson-build'])
+            generation_ms = measure_ms(edit_and_generate)
+            def edit_and_reconfigure():
+                edit_and_generate()
+                self.run_success(['meson', 'setup', 'build', '--reconfigure'])
+            reconfigure_ms = measure_ms(edit_and_reconfigure)
+            results['split' if is_split else 'monolithic'] = (generation_ms, reconfigure_ms)
+        logging.info(f'Single target edit with {target_count} targets (median of {BENCH_REPEAT} runs)')
+        logging.info(f'{"mode":<12} {"generation (ms)":>16} {"generation + meson reconfigure (ms)":>36}')
+        for mode, (generation_ms, reconfigure_ms) in results.items():
+            logging.info(f'{mode:<12} {generation_ms:>16.1f} {reconfigure_ms:>36.1f}')
+        self.cleanupArtifacts()
+        return
+
+    # Size of the generated meson.build and meson configure time for many near-identical targets (per-module tests, for example),
+    # with and without sharing the identical lists across the targets
+    def test_list_deduplication(self):
+        target_count = int(os.environ.get('BENCH_TARGET_COUNT', '300'))
+        directory = self._working_dir.name
+        results = { }
+        for is_deduplicate in [False, True]:
+            self.cleanupArtifacts()
+            config = write_synthetic_project(directory, target_count)
+            config['deduplicate_lists'] = is_deduplicate
+            for target in config['targets']:
+                target['defines'] = [ '-DUNIT_TEST' ]
+                target['linux_link_args'] = [ '-lm', '-lpthread' ]
+            with open(os.path.join(directory, 'build_master.json'), 'w') as file:
+                json.dump(config, file, indent = 4)
+            self.run_success(['--update-meson-build', '--force'])
+            size_kib = os.path.getsize(os.path.join(directory, 'meson.build')) / 1024.0
+            def configure():
+                self.run_success(['meson', 'setup', 'build', '--wipe'] if os.path.exists(os.path.join(directory, 'build')) else ['meson', 'setup', 'build'])
+            configure_ms = measure_ms(configure)
+            results['deduplicated' if is_deduplicate else 'plain'] = (size_kib, configure_ms)
+        logging.info(f'List deduplication with {target_count} targets (median of {BENCH_REPEAT} runs)')
+        logging.info(f'{"mode":<14} {"meson.build (KiB)":>18} {"meson setup (ms)":>18}')
+        for mode, (size_kib, configure_ms) in results.items():
+            logging.info(f'{mode:<14} {size_kib:>18.1f} {configure_ms:>18.1f}')
+        self.assertLess(results['deduplicated'][0], results['plain'][0])
+        self.cleanupArtifacts()
+        return
+
+    # Latency of a no-op incremental build, 'build' executes ninja directly whereas 'meson compile' starts python and meson first
+    def test_build_latency(self):
+        target_count = int(os.environ.get('BENCH_TARGET_COUNT', '300'))
+        write_synthetic_project(self._working_dir.name, target_count)
+        self.run_success(['meson', 'setup', 'build'])
+        self.run_success(['build', '-C', 'build'])
+        results = { }
+        results['build'] = measure_ms(lambda: self.run_success(['build', '-C', 'build']))
+        results['meson compile'] = measure_ms(lambda: self.run_success(['meson', 'compile', '-C', 'build']))
+        logging.info(f'No-op build with {target_count} targets (median of {BENCH_REPEAT} runs)')
+        logging.info(f'{"command":<14} {"latency (ms)":>14}')
+        for command, latency_ms in results.items():
+            logging.info(f'{command:<14} {latency_ms:>14.1f}')
+        self.cleanupArtifacts()
+        return
+
+    # Fresh configure time of the direct ninja backend ('configure') against meson ('meson setup'), both from an empty build directory
+    def test_fresh_configure(self):
+        target_count = int(os.environ.get('BENCH_TARGET_COUNT', '300'))
+        directory = self._working_dir.name
+        write_synthetic_project(directory, target_count)
+        self.run_success(['--update-meson-build', '--force'])
+        def fresh_configure(args, build_directory):
+            shutil.rmtree(os.path.join(directory, build_directory), ignore_errors = True)
+            self.run_success(args)
+        results = { }
+        results['configure'] = measure_ms(lambda: fresh_configure(['configure', '-C', 'build-direct'], 'build-direct'))
+        results['meson setup'] = measure_ms(lambda: fresh_configure(['meson', 'setup', 'build'], 'build'))
+        logging.info(f'Fresh configure with {target_count} targets (median of {BENCH_REPEAT} runs)')
+        logging.info(f'{"command":<14} {"configure (ms)":>16}')
+        for command, configure_ms in results.items():
+            logging.info(f'{command:<14} {configure_ms:>16.1f}')
+        logging.info(f'Speedup: {results["meson setup"] / results["configure"]:.1f}x')
+        self.cleanupArtifacts()
+        return
+
+    # Cold compile of a sample project importing a module vs. including the same (heavy) header, with the direct ninja backend
+    # It is skipped if the C++ compiler doesn't support the modules
+    def test_cxx_modules_compile_time(self):
+        consumer_count = int(os.environ.get('BENCH_CONSUMER_COUNT', '32'))
+        directory = self._working_dir.name
+        write_modules_project(directory, consumer_count)
+        def cold_build(build_directory):
+            shutil.rmtree(os.path.join(directory, build_directory), ignore_errors = True)
+            self.run_success(['configure', '-C', build_directory])
+            self.run_success(['build', '-C', build_directory])
+        output = self.run_success(['configure', '-C', 'build-modules'])
+        if not any('C++20 modules are built' in line for line in output.stdout + (output.stderr or [])):
+            self.skipTest('The C++ compiler doesn\'t support C++20 modules')
+        results = { }
+        results['modules'] = measure_ms(lambda: cold_build('build-modules'))
+        os.environ['BUILD_MASTER_CXX_MODULES'] = '0'
+        try:
+            results['header mode'] = measure_ms(lambda: cold_build('build-headers'))
+        finally:
+            del os.environ['BUILD_MASTER_CXX_MODULES']
+        logging.info(f'Cold configure and compile of {consumer_count} sources (median of {BENCH_REPEAT} runs)')
+        logging.info(f'{"mode":<12} {"build (ms)":>12}')
+        for mode, build_ms in results.items():
+            logging.info(f'{mode:<12} {build_ms:>12.1f}')
+        logging.info(f'Speedup: {results["header mode"] / results["modules"]:.1f}x')
+        self.cleanupArtifacts()
+        return
+
+    # Cold start latency of the most frequent invocations, it fails if any of them exceeds its budget in STARTUP_BUDGET_MS
+    def test_startup_latency(self):
+        run_count = int(os.environ.get('BENCH_STARTUP_RUNS', '50'))
+        budget_scale = float(os.environ.get('BENCH_BUDGET_SCALE', '1.0'))
+        directory = self._working_dir.name
+        write_synthetic_project(directory, 10)
+        self.run_success(['--update-meson-build', '--force'])
+        executable = self._executable
+        samples = { }
+        samples['--version'] = measure_startup_ms([executable, '--version'], directory, run_count)
+        samples['--update-meson-build'] = measure_startup_ms([executable, '--update-meson-build'], directory, run_count)
+        samples['meson --help'] = measure_startup_ms([executable, 'meson', '--help'], directory, run_count)
+        samples['build_master_meson --help'] = measure_startup_ms(['build_master_meson', '--help'], directory, run_count)
+        # cc-wrap runs for every compile and link job, 'true' has no -o so nothing is recorded
+        samples['cc-wrap true'] = measure_startup_ms([executable, 'cc-wrap', 'true'], directory, run_count)
+        samples['true'] = measure_startup_ms(['true'], directory, run_count)
+        logging.info(f'Startup latency ({run_count} runs)')
+        logging.info(f'{"command":<28} {"mean ± σ (ms)":>18} {"median (ms)":>12} {"min (ms)":>10} {"max (ms)":>10}')
+        for command, values in samples.items():
+            mean_stddev = f'{statistics.mean(values):.1f} ± {statistics.stdev(values):.1f}'
+            logging.info(f'{command:<28} {mean_stddev:>18} {statistics.median(values):>12.1f} {min(values):>10.1f} {max(values):>10.1f}')
+        medians = { command : statistics.median(values) for command, values in samples.items() }
+        medians['meson --help'] -= medians.pop('build_master_meson --help')
+        medians['cc-wrap true'] -= medians.pop('true')
+        for command, budget_ms in STARTUP_BUDGET_MS.items():
+            self.assertLessEqual(medians[command], budget_ms * budget_scale, f'Startup latency of \'{command}\' exceeds its budget')
+        self.cleanupArtifacts()
+        return
+
+    # Generation time of meson.build for large configs
+    # NOTE: the heap allocations made while generating are reported by 'meson test -C build --benchmark' (see unit_test/api_tests.cpp), build_master doesn't count them
+    def test_generation_time(self):
+        target_counts = [ int(count) for count in os.environ.get('BENCH_TARGET_COUNTS', '100,1000,5000').split(',') ]
+        directory = self._working_dir.name
+        results = { }
+        for target_count in target_counts:
+            self.cleanupArtifacts()
+            write_synthetic_project(directory, target_count)
+            generate_ms = measure_ms(lambda: self.run_success(['--update-meson-build', '--force']))
+            results[target_count] = (generate_ms, os.path.getsize(os.path.join(directory, 'meson.build')) / 1024.0)
+        logging.info(f'meson.build generation (median of {BENCH_REPEAT} runs)')
+        logging.info(f'{"targets":>8} {"generation (ms)":>16} {"meson.build (KiB)":>18}')
+        for target_count, (generate_ms, size_kib) in results.items():
+            logging.info(f'{target_count:>8} {generate_ms:>16.1f} {size_kib:>18.1f}')
+        self.cleanupArtifacts()
+        return
+
+if __name__ == '__main__':
+    unittest.main()
@@ -7,6 +7,9 @@ import logging
 import tempfile
 import test_base
 import os
+import json
+import shutil
+import subprocess
 
 class PreliminaryTests(test_base.TestBase):
     def __init__(self, *args, **kwargs):
@@ -93,5 +96,608 @@ class PreliminaryTests(test_base.TestBase):
         self.run_test_init_directory(True)
         return
 
+    # Applies the mutator to build_master.json of the working directory (or of the given directory)
+    def modify_project(self, mutator, directory = None):
+        json_path = os.path.join(directory if directory else self._working_dir.name, 'build_master.json')
+        with open(json_path) as file:
+            config = json.load(file)
+        mutator(config)
+        with open(json_path, 'w') as file:
+            json.dump(config, file, indent = 4)
+        return
+
+    # Initializes a new project and applies the mutator to its build_master.json, returns the output of init
+    def with_modified_project(self, mutator, is_cpp = True):
+        output = self.run_with_args(['init', '--name=MyProject', '--canonical_name=myproject'] + (['--create-cpp'] if is_cpp else []))
+        self.assert_return_success(output)
+        self.modify_project(mutator)
+        return output
+
+    # Generates per-target meson.build fragments and checks that only the edited target's fragment is rewritten
+    def test_split_meson_build(self):
+        def mutate(config):
+            config['split_meson_build'] = True
+            config['targets'].append({ 'name' : 'myproject_lib', 'is_static_library' : True, 'sources' : [ 'source/main.cpp' ] })
+        output = self.with_modified_project(mutate)
+
+        self.check_meson_build_script()
+        output.assert_exists_file('.build_master/targets/myproject/meson.build')
+        output.assert_exists_file('.build_master/targets/myproject_lib/meson.build')
+
+        lib_script = os.path.join(self._working_dir.name, '.build_master/targets/myproject_lib/meson.build')
+        lib_script_time = os.path.getmtime(lib_script)
+        self.modify_project(lambda config: config['targets'][0].update({ 'defines' : [ '-DMY_DEFINE' ] }))
+        output = self.run_with_args(['--update-meson-build'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'^Info: 1 out of 2 target scripts are regenerated$')
+        self.assertEqual(lib_script_time, os.path.getmtime(lib_script))
+
+        self.cleanupArtifacts()
+        return
+
+    def test_test_targets(self):
+        self.with_modified_project(lambda config: config['targets'][0].update({ 'is_test' : True, 'test_timeout' : 60 }))
+
+        self.check_meson_build_script()
+        output = self.run_with_args(['test', '-C', 'build', '--shard', '1/1'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'^Ok: 1, Fail: 0, Skipped: 0, Timeout: 0$')
+        output.assert_exists_file('build/build_master_test_durations.json')
+
+        self.cleanupArtifacts()
+        return
+
+    def test_benchmark_targets(self):
+        self.with_modified_project(lambda config: config['targets'][0].update({ 'is_benchmark' : True }))
+
+        # The build directory is configured as debug, but benchmarks are always built with the release defines
+        self.check_meson_build_script()
+        output = self.run_with_args(['bench', '-C', 'build', '--repetitions', '2'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'^myproject\s+')
+        output.assert_exists_file('.build_master/bench_history.json')
+        with open(os.path.join(self._working_dir.name, 'build/meson-logs/build_master_bench/myproject.txt')) as file:
+            self.assertIn('Build mode: Release', file.read())
+
+        self.cleanupArtifacts()
+        return
+
+    def test_build_command(self):
+        output = self.run_with_args(['init', '--name=MyProject', '--canonical_name=myproject', '--create-cpp'])
+        self.assert_return_success(output)
+        self.check_meson_build_script()
+
+        # meson.build is upto date and the build directory is configured, so ninja is executed directly (with the number of jobs chosen from the memory)
+        output = self.run_with_args(['build', '-C', 'build', 'myproject'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'Command: \S*(ninja|samu)\S* -C \S*build -j \d+ myproject')
+        output.assert_exists_file('build/myproject')
+        output.assert_exists_file('build/build_master_job_memory.json')
+
+        # build_master.json has changed, so meson.build is regenerated and it goes through meson compile
+        self.modify_project(lambda config: config['targets'][0].update({ 'defines' : [ '-DMY_DEFINE' ] }))
+        output = self.run_with_args(['build', '-C', 'build'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'Building with meson compile, meson.build has been regenerated')
+
+        # Compile and link jobs of a heavy target run in a ninja pool limited by the memory they need
+        self.modify_project(lambda config: config['targets'][0].update({ 'heavy' : True, 'memory_hint_mb' : 1024 }))
+        output = self.run_with_args(['build', '-C', 'build'])
+        self.assert_return_success(output)
+        output = self.run_with_args(['build', '-C', 'build'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'heavy jobs at most \(~1024 MiB each\)')
+        with open(os.path.join(self._working_dir.name, 'build', 'build.ninja')) as file:
+            build_ninja = file.read()
+        self.assertIn('pool build_master_heavy_pool', build_ninja)
+        self.assertIn(' pool = build_master_heavy_pool', build_ninja)
+
+        self.cleanupArtifacts()
+        return
+
+    # The direct ninja backend configures the build directory without meson, and build.ninja regenerates itself when build_master.json changes
+    def test_configure_command(self):
+        output = self.run_with_args(['init', '--name=MyProject', '--canonical_name=myproject', '--create-cpp'])
+        self.assert_return_success(output)
+        output = self.run_with_args(['configure', '-C', 'build-direct', '--buildtype', 'release'])
+        self.assert_return_success(output)
+        output.assert_exists_file('build-direct/build.ninja')
+        output.assert_exists_file('build-direct/build_master_ninja.json')
+        self.assertFalse(os.path.exists(os.path.join(self._working_dir.name, 'build-direct', 'meson-private')))
+
+        output = self.run_with_args(['build', '-C', 'build-direct', 'myproject'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'Command: \S*(ninja|samu)\S* -C \S*build-direct -j \d+ myproject')
+        output.assert_exists_file('build-direct/myproject')
+
+        # build.ninja regenerates itself without running the pre-config hooks
+        with open(os.path.join(self._working_dir.name, 'hook.sh'), 'w') as file:
+            file.write('touch hook_has_run\n')
+        def mutate(config):
+            config['targets'][0]['defines'] = [ '-DMY_DEFINE' ]
+            config['pre_config_hook'] = 'hook.sh'
+        self.modify_project(mutate)
+        output = self.run_with_args(['build', '-C', 'build-direct'])
+        self.assert_return_success(output)
+        with open(os.path.join(self._working_dir.name, 'build-direct', 'build.ninja')) as file:
+            ninja_script = file.read()
+        self.assertIn('-DMY_DEFINE', ninja_script)
+        self.assertRegex(ninja_script, r'configure -C \S+ --buildtype release --regenerate')
+        self.assertFalse(os.path.exists(os.path.join(self._working_dir.name, 'hook_has_run')))
+
+        # Tests and environment variables need meson, all of the reasons are reported at once
+        def mutate(config):
+            del config['pre_config_hook']
+            config['targets'][0].update({ 'is_test' : True, 'include_dirs' : [ 'env:SDK_PATH' ] })
+        self.modify_project(mutate)
+        output = self.run_with_args(['configure', '-C', 'build-rejected'])
+        self.assertNotEqual(output.returncode, 0)
+        self.assert_string_matches_any_regex(output.stdout, r'tests are registered with and run by meson')
+        self.assert_string_matches_any_regex(output.stdout, r"'env:SDK_PATH' in \"include_dirs\" is not a literal")
+        self.assertFalse(os.path.exists(os.path.join(self._working_dir.name, 'build-rejected')))
+
+        self.cleanupArtifacts()
+        return
+
+    # "linker" selects the first working linker at configure time, and the link times are reported by the build
+    def test_linker_selection(self):
+        self.with_modified_project(lambda config: config.update({ 'linker' : 'auto' }))
+        output = self.run_with_args(['meson', 'setup', 'build-linker'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'Linker: (mold|lld|gold|default)')
+        output = self.run_with_args(['configure', '-C', 'build-linker-direct'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'Linker: (mold|lld|gold|default)')
+        output = self.run_with_args(['build', '-C', 'build-linker-direct'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'Link times:')
+        self.assert_string_matches_any_regex(output.stdout, r'\d+\.\d{3} s  myproject$')
+
+        self.modify_project(lambda config: config.update({ 'linker' : 'ld' }))
+        output = self.run_with_args(['configure', '-C', 'build-linker-rejected'])
+        self.assertNotEqual(output.returncode, 0)
+        self.assert_string_matches_any_regex(output.stdout, r'"linker" must be one of auto, mold, lld, gold, or bfd')
+
+        self.cleanupArtifacts()
+        return
+
+    # The module interfaces are compiled before their importers (also of the targets linking with the library), in header mode they are left out
+    def test_cxx_modules(self):
+        os.makedirs(os.path.join(self._working_dir.name, 'source'))
+        os.makedirs(os.path.join(self._working_dir.name, 'include'))
+        code = 'namespace greeting { inline int answer() { return 42; } }\n'
+        with open(os.path.join(self._working_dir.name, 'include/greeting.hpp'), 'w') as file:
+            file.write('#pragma once\n' + code)
+        with open(os.path.join(self._working_dir.name, 'source/greeting.cppm'), 'w') as file:
+            file.write('export module greeting;\nexport import :detail;\nexport ' + code)
+        with open(os.path.join(self._working_dir.name, 'source/greeting_detail.cppm'), 'w') as file:
+            file.write('export module greeting:detail;\nexport inline int detail_answer() { return 42; }\n')
+        with open(os.path.join(self._working_dir.name, 'source/version.cpp'), 'w') as file:
+            file.write('int greeting_version() { return 1; }\n')
+        with open(os.path.join(self._working_dir.name, 'source/main.cpp'), 'w') as file:
+            file.write('#ifdef BUILD_MASTER_CXX_MODULES\nimport greeting;\nconst char* mode = "modules";\n#else\n#include "greeting.hpp"\nconst char* mode = "headers";\n#endif\n'
+                       '#include <cstdio>\nint main() { std::printf("%s %d\\n", mode, greeting::answer()); return 0; }\n')
+        config = { 'project_name' : 'Modules', 'canonical_name' : 'modules', 'include_dirs' : [ 'include' ], 'targets' : [
+            { 'name' : 'greeting', 'is_static_library' : True, 'sources' : [ 'source/version.cpp' ], 'module_sources' : [ 'source/greeting.cppm', 'source/greeting_detail.cppm' ] },
+            { 'name' : 'app', 'is_executable' : True, 'sources' : [ 'source/main.cpp' ], 'link_with' : [ 'greeting' ] }
+        ] }
+        with open(os.path.join(self._working_dir.name, 'build_master.json'), 'w') as file:
+            json.dump(config, file, indent = 4)
+
+        output = self.run_with_args(['configure', '-C', 'build-direct'])
+        self.assert_return_success(output)
+        is_modules = any('C++20 modules are built' in line for line in output.stdout)
+        with open(os.path.join(self._working_dir.name, 'build-direct', 'build.ninja')) as file:
+            build_script = file.read()
+        if is_modules:
+            # The primary interface imports its partition
+            self.assertRegex(build_script, r'build \S*greeting.cppm.o \| \S+: cpp_COMPILER \S+greeting.cppm \| \S+greeting-detail.(gcm|pcm)')
+            self.assertRegex(build_script, r'build \S*main.cpp.o: cpp_COMPILER \S+main.cpp \| \S+greeting.(gcm|pcm)')
+        output = self.run_with_args(['build', '-C', 'build-direct'])
+        self.assert_return_success(output)
+        result = subprocess.run([os.path.join(self._working_dir.name, 'build-direct', 'app')], capture_output = True, text = True)
+        self.assertEqual(result.stdout.strip(), 'modules 42' if is_modules else 'headers 42')
+
+        os.environ['BUILD_MASTER_CXX_MODULES'] = '0'
+        try:
+            output = self.run_with_args(['configure', '-C', 'build-headers'])
+        finally:
+            del os.environ['BUILD_MASTER_CXX_MODULES']
+        self.assert_return_success(output)
+        output = self.run_with_args(['build', '-C', 'build-headers'])
+        self.assert_return_success(output)
+        result = subprocess.run([os.path.join(self._working_dir.name, 'build-headers', 'app')], capture_output = True, text = True)
+        self.assertEqual(result.stdout.strip(), 'headers 42')
+
+        self.cleanupArtifacts()
+        return
+
+    # "dev_fast_link" builds the static libraries as shared libraries in the debug builds, the release builds still link them statically
+    def test_dev_fast_link(self):
+        os.makedirs(os.path.join(self._working_dir.name, 'source'))
+        os.makedirs(os.path.join(self._working_dir.name, 'include'))
+        with open(os.path.join(self._working_dir.name, 'include/core.hpp'), 'w') as file:
+            file.write('#pragma once\nstruct Core { int value(); virtual ~Core(); };\n')
+        with open(os.path.join(self._working_dir.name, 'source/core.cpp'), 'w') as file:
+            file.write('#include <core.hpp>\nint Core::value() { return 42; }\nCore::~Core() { }\n')
+        with open(os.path.join(self._working_dir.name, 'source/main.cpp'), 'w') as file:
+            file.write('#include <core.hpp>\n#include <cstdio>\nint main() { Core core; std::printf("%d\\n", core.value()); return 0; }\n')
+        config = { 'project_name' : 'FastLink', 'canonical_name' : 'fastlink', 'dev_fast_link' : True, 'include_dirs' : [ 'include' ], 'targets' : [
+            { 'name' : 'core', 'is_static_library' : True, 'sources' : [ 'source/core.cpp' ] },
+            { 'name' : 'app', 'is_executable' : True, 'sources' : [ 'source/main.cpp' ], 'link_with' : [ 'core' ] }
+        ] }
+        with open(os.path.join(self._working_dir.name, 'build_master.json'), 'w') as file:
+            json.dump(config, file, indent = 4)
+
+        for build_dir, build_type, library in [ ('build-debug', 'debug', 'libcore.so'), ('build-release', 'release', 'libcore.a') ]:
+            output = self.run_with_args(['meson', 'setup', build_dir, '--buildtype', build_type])
+            self.assert_return_success(output)
+            output = self.run_with_args(['build', '-C', build_dir])
+            self.assert_return_success(output)
+            output.assert_exists_file(os.path.join(build_dir, library))
+            result = subprocess.run([os.path.join(self._working_dir.name, build_dir, 'app')], capture_output = True, text = True)
+            self.assertEqual(result.stdout.strip(), '42')
+
+        # Same with the direct ninja backend
+        output = self.run_with_args(['configure', '-C', 'build-direct'])
+        self.assert_return_success(output)
+        output = self.run_with_args(['build', '-C', 'build-direct'])
+        self.assert_return_success(output)
+        output.assert_exists_file('build-direct/libcore.so')
+        result = subprocess.run([os.path.join(self._working_dir.name, 'build-direct', 'app')], capture_output = True, text = True)
+        self.assertEqual(result.stdout.strip(), '42')
+
+        self.cleanupArtifacts()
+        return
+
+    # "resource_accounting" runs the compile and link jobs through 'build_master cc-wrap', 'build_master report' aggregates what it has recorded
+    def test_resource_accounting(self):
+        output = self.run_with_args(['init', '--name=MyProject', '--canonical_name=myproject', '--create-cpp'])
+        self.assert_return_success(output)
+        output = self.run_with_args(['report', '-C', 'build'])
+        self.assertNotEqual(output.returncode, 0)
+
+        self.modify_project(lambda config: config.update({ 'resource_accounting' : True }))
+        for build_dir, command in [ ('build-accounted', ['meson', 'setup', 'build-accounted']), ('build-accounted-direct', ['configure', '-C', 'build-accounted-direct']) ]:
+            output = self.run_with_args(command)
+            self.assert_return_success(output)
+            output = self.run_with_args(['build', '-C', build_dir])
+            self.assert_return_success(output)
+            output.assert_exists_file(os.path.join(build_dir, 'build_master_resource_log.bin'))
+            output = self.run_with_args(['report', '-C', build_dir])
+            self.assert_return_success(output)
+            # One compile job and one link job
+            self.assert_string_matches_any_regex(output.stdout, r'^myproject\s+2\s+')
+            self.assert_string_matches_any_regex(output.stdout, r'^source\s+1\s+')
+            self.assert_string_matches_any_regex(output.stdout, r'MiB .* source/main\.cpp$')
+
+        self.cleanupArtifacts()
+        return
+
+    # The simd_sources are compiled once per instruction set, and the best variant is picked at load time
+    def test_simd_sources(self):
+        simd_sources = { 'files' : [ 'source/kernels.c' ], 'isa' : [ 'avx2', 'sse4.2' ], 'functions' : [ 'which_isa' ] }
+        output = self.with_modified_project(lambda config: config['targets'][0].update({ 'simd_sources' : simd_sources }), is_cpp = False)
+        with open(os.path.join(self._working_dir.name, 'source/kernels.c'), 'w') as file:
+            file.write('const char* which_isa(void)\n{\n'
+                       '#if defined(__AVX2__)\n\treturn "avx2";\n'
+                       '#elif defined(__SSE4_2__)\n\treturn "sse4.2";\n'
+                       '#else\n\treturn "baseline";\n#endif\n}\n')
+        with open(os.path.join(self._working_dir.name, 'source/main.c'), 'w') as file:
+            file.write('#include <stdio.h>\nconst char* which_isa(void);\nint main(void) { printf("ISA: %s\\n", which_isa()); return 0; }\n')
+
+        self.check_meson_build_script()
+        output.assert_exists_file('.build_master/simd/myproject_dispatch.c')
+        with open(os.path.join(self._working_dir.name, '.build_master/simd/myproject_dispatch.c')) as file:
+            self.assertIn('ifunc("which_isa_resolver_bm_internal__")', file.read())
+        output = self.run_with_args(['build', '-C', 'build'])
+        self.assert_return_success(output)
+        result = subprocess.run([os.path.join(self._working_dir.name, 'build', 'myproject')], capture_output = True, text = True)
+        self.assertEqual(result.returncode, 0)
+        self.assertRegex(result.stdout, r'^ISA: (avx2|sse4\.2|baseline)$')
+
+        self.modify_project(lambda config: config['targets'][0]['simd_sources'].update({ 'isa' : [ 'avx9' ] }))
+        output = self.run_with_args(['--update-meson-build'])
+        self.assertNotEqual(output.returncode, 0)
+
+        self.cleanupArtifacts()
+        return
+
+    # The packages are reproducible, packaging the same staged files again produces the identical bytes
+    def test_package_command(self):
+        if shutil.which('zstd') is None:
+            self.skipTest('zstd isn\'t installed')
+        self.with_modified_project(lambda config: config['targets'][0].update({ 'is_install' : True }))
+        self.check_meson_build_script()
+        output = self.run_with_args(['package', '-C', 'build', '--format=tar.zst'])
+        self.assert_return_success(output)
+        packages = [ name for name in os.listdir(os.path.join(self._working_dir.name, 'build')) if name.endswith('.tar.zst') and not name.endswith('-dbg.tar.zst') ]
+        self.assertEqual(len(packages), 1)
+        package_path = os.path.join(self._working_dir.name, 'build', packages[0])
+        with open(package_path, 'rb') as file:
+            content = file.read()
+        listing = subprocess.run(f'zstd -dc {package_path} | tar -tv', shell = True, capture_output = True, text = True)
+        self.assertEqual(listing.returncode, 0)
+        lines = [ line for line in listing.stdout.split('\n') if line ]
+        self.assertTrue(any(line.endswith('bin/myproject') and line.startswith('-rwxr-xr-x') for line in lines), listing.stdout)
+        # The modes don't depend on the umask of the packager
+        self.assertTrue(all(line.startswith('drwxr-xr-x') for line in lines if line.startswith('d')), listing.stdout)
+
+        output = self.run_with_args(['package', '-C', 'build', '--format=tar.zst', '-j', '1', '--no-rebuild'])
+        self.assert_return_success(output)
+        with open(package_path, 'rb') as file:
+            self.assertEqual(file.read(), content)
+
+        self.cleanupArtifacts()
+        return
+
+    # All of the configurations are set up and built in parallel, each one into its own build directory
+    def test_matrix_command(self):
+        self.with_modified_project(lambda config: config.update({ 'configurations' : [
+            { 'name' : 'debug', 'options' : [ '--buildtype=debug' ] },
+            { 'name' : 'release', 'options' : [ '--buildtype=release' ], 'build_directory' : 'build-rel' }
+        ] }))
+        output = self.run_with_args(['matrix', '-j', '2'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'debug\s+1\s+\S+s\s+\S+s\s+PASS')
+        self.assert_string_matches_any_regex(output.stdout, r'release\s+1\s+\S+s\s+\S+s\s+PASS')
+        self.assert_string_matches_any_regex(output.stdout, r'Passed: 2, Failed: 0')
+        output.assert_exists_file('build-debug/myproject')
+        output.assert_exists_file('build-rel/myproject')
+        output.assert_exists_file('.build_master/matrix/release_compile.txt')
+
+        # Already configured directories are reconfigured, and a broken configuration fails the command
+        self.modify_project(lambda config: config['configurations'].append({ 'name' : 'broken', 'options' : [ '-Dno_such_option=true' ] }))
+        output = self.run_with_args(['matrix'])
+        self.assertNotEqual(output.returncode, 0)
+        self.assert_string_matches_any_regex(output.stdout, r'broken\s+\d+\s+\S+s\s+\S+s\s+FAIL \(setup\)')
+        self.assert_string_matches_any_regex(output.stdout, r'Passed: 2, Failed: 1')
+
+        self.cleanupArtifacts()
+        return
+
+    # Only the installed files whose content has changed are rewritten, the others keep their mtimes
+    def test_install_command(self):
+        self.with_modified_project(lambda config: config.update({ 'install_header_dirs' : [ 'include/myproject' ] }))
+        header_dir = os.path.join(self._working_dir.name, 'include', 'myproject')
+        os.makedirs(header_dir)
+        for name in [ 'a.h', 'b.h', 'c.h' ]:
+            with open(os.path.join(header_dir, name), 'w') as file:
+                file.write(f'#pragma once\n// {name}\n')
+        self.check_meson_build_script()
+
+        dest_dir = os.path.join(self._working_dir.name, 'dest')
+        output = self.run_with_args(['install', '-C', 'build', '--destdir', dest_dir])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'Installed 3 files .*skipped 0 unchanged files')
+        installed_headers = [ os.path.join(root, name) for root, _, names in os.walk(dest_dir) for name in names ]
+        self.assertEqual(sorted(os.path.basename(path) for path in installed_headers), [ 'a.h', 'b.h', 'c.h' ])
+        mtimes = { path : os.stat(path).st_mtime_ns for path in installed_headers }
+
+        # b.h is touched (but unchanged) and c.h is modified, only c.h is rewritten
+        os.utime(os.path.join(header_dir, 'b.h'))
+        with open(os.path.join(header_dir, 'c.h'), 'a') as file:
+            file.write('int c;\n')
+        output = self.run_with_args(['install', '-C', 'build', '--destdir', dest_dir])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'Installed 1 files .*skipped 2 unchanged files')
+        for path, mtime in mtimes.items():
+            if path.endswith('c.h'):
+                with open(path) as file:
+                    self.assertIn('int c;', file.read())
+            else:
+                self.assertEqual(os.stat(path).st_mtime_ns, mtime)
+
+        self.cleanupArtifacts()
+        return
+
+    # The profile variant is built into its own build directory, and the executable's samples are folded into a flamegraph
+    @unittest.skipIf(shutil.which('perf') is None, 'perf is not installed')
+    def test_profile_command(self):
+        output = self.run_with_args(['init', '--name=MyProject', '--canonical_name=myproject', '--create-cpp'])
+        self.assert_return_success(output)
+        with open(os.path.join(self._working_dir.name, 'source', 'main.cpp'), 'w') as file:
+            file.write('#include <cstdlib>\n'
+                       'static volatile unsigned long sink;\n'
+                       '__attribute__((noinline)) static void spin(unsigned long count) { for(unsigned long i = 0; i < count; ++i) sink += i; }\n'
+                       'int main(int argc, char** argv) { spin(argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1); return 0; }\n')
+        output = self.run_with_args(['profile', '--top', '5', 'myproject', '--', '300000000'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'^\s*\d+\.\d+%\s+\d+\.\d+%\s+\d+\s+\S*spin')
+        output.assert_exists_file('build-profile/meson-logs/build_master_profile/myproject.folded')
+        output.assert_exists_file('build-profile/meson-logs/build_master_profile/myproject.svg')
+        with open(os.path.join(self._working_dir.name, 'build-profile', 'meson-info', 'intro-buildoptions.json')) as file:
+            build_options = json.load(file)
+        self.assertEqual(next(option['value'] for option in build_options if option['name'] == 'buildtype'), 'debugoptimized')
+
+        # A build directory which isn't set up by 'build_master profile' isn't reconfigured
+        self.check_meson_build_script()
+        output = self.run_with_args(['profile', '-C', 'build', 'myproject'])
+        self.assertNotEqual(output.returncode, 0)
+        self.assert_string_matches_any_regex(output.stdout, r'not for the profile build')
+
+        self.cleanupArtifacts()
+        return
+
+    # A prebuilt dependency is built once, then restored from the artifact cache (into a fresh checkout) instead of being rebuilt
+    def test_prebuilt_dependency_cache(self):
+        self.with_modified_project(lambda config: config.update({ 'prebuilt_dependencies' : [ { 'name' : 'foo', 'sources' : [ 'deps/foo' ], 'script' : 'build_foo.sh' } ] }))
+        os.makedirs(os.path.join(self._working_dir.name, 'deps', 'foo'))
+        with open(os.path.join(self._working_dir.name, 'deps', 'foo', 'foo.c'), 'w') as file:
+            file.write('int foo(void) { return 1; }\n')
+        with open(os.path.join(self._working_dir.name, 'build_foo.sh'), 'w') as file:
+            file.write('echo built >> build_count.txt\n'
+                        'mkdir -p "$BUILD_MASTER_PREFIX/lib/pkgconfig" "$BUILD_MASTER_PREFIX/include"\n'
+                        'echo "int foo(void);" > "$BUILD_MASTER_PREFIX/include/foo.h"\n'
+                        'printf "prefix=$BUILD_MASTER_PREFIX\\nName: foo\\nDescription: foo\\nVersion: 1.0\\nCflags: -I\\${prefix}/include\\n" > "$BUILD_MASTER_PREFIX/lib/pkgconfig/foo.pc"\n')
+
+        cache_dir = tempfile.TemporaryDirectory()
+        os.environ['BUILD_MASTER_CACHE_DIR'] = cache_dir.name
+        try:
+            output = self.run_with_args(['--execute-pre-config-hook'])
+            self.assert_return_success(output)
+            self.assert_string_matches_any_regex(output.stdout, r'Building prebuilt dependency foo, artifact foo-[0-9a-f]{16} is not in the cache')
+            output.assert_exists_file('.build_master/prebuilt/foo/include/foo.h')
+
+            # Fresh checkout, the artifact is restored and the .pc file points to the new prefix
+            shutil.rmtree(os.path.join(self._working_dir.name, '.build_master'))
+            output = self.run_with_args(['--execute-pre-config-hook'])
+            self.assert_return_success(output)
+            self.assert_string_matches_any_regex(output.stdout, r'Restored prebuilt dependency foo from the artifact cache')
+            with open(os.path.join(self._working_dir.name, 'build_count.txt')) as file:
+                self.assertEqual(file.read().count('built'), 1)
+            with open(os.path.join(self._working_dir.name, '.build_master/prebuilt/foo/lib/pkgconfig/foo.pc')) as file:
+                self.assertRegex(file.readline(), r'^prefix=/.*\.build_master/prebuilt/foo$')
+
+            # Changing the sources of the dependency changes the key
+            with open(os.path.join(self._working_dir.name, 'deps', 'foo', 'foo.c'), 'a') as file:
+                file.write('int bar(void) { return 2; }\n')
+            output = self.run_with_args(['--execute-pre-config-hook'])
+            self.assert_return_success(output)
+            self.assert_string_matches_any_regex(output.stdout, r'Building prebuilt dependency foo')
+
+            output = self.run_with_args(['cache', 'stats'])
+            self.assert_return_success(output)
+            self.assert_string_matches_any_regex(output.stdout, r'^Hits: 1 \(downloaded: 0\), misses: 2, hit rate: 33.3%$')
+            # A limit of 0 means unlimited, evict keeps everything then
+            os.environ['BUILD_MASTER_CACHE_MAX_SIZE_MB'] = '0'
+            try:
+                output = self.run_with_args(['cache', 'evict'])
+            finally:
+                del os.environ['BUILD_MASTER_CACHE_MAX_SIZE_MB']
+            self.assert_return_success(output)
+            self.assert_string_matches_any_regex(output.stdout, r'is unlimited, nothing to evict$')
+            output = self.run_with_args(['cache', 'clear'])
+            self.assert_return_success(output)
+            self.assert_string_matches_any_regex(output.stdout, r'^Info: 2 artifacts evicted from ')
+        finally:
+            del os.environ['BUILD_MASTER_CACHE_DIR']
+            cache_dir.cleanup()
+
+        self.cleanupArtifacts()
+        return
+
+    # Writes build_master.json and the sources of a single target project into <working dir>/<name>
+    def write_single_target_project(self, name, target, sources):
+        directory = os.path.join(self._working_dir.name, name)
+        for path, content in sources.items():
+            os.makedirs(os.path.dirname(os.path.join(directory, path)), exist_ok = True)
+            with open(os.path.join(directory, path), 'w') as file:
+                file.write(content)
+        config = { 'project_name' : name, 'canonical_name' : name, 'targets' : [ dict(target, name = name, sources = [ path for path in sources if path.endswith('.c') ]) ] }
+        with open(os.path.join(directory, 'build_master.json'), 'w') as file:
+            json.dump(config, file, indent = 4)
+        return directory
+
+    # The workspace configures the projects as subprojects in the dependency order, the library targets are registered with meson.override_dependency()
+    # only while the project is generated for the workspace. The dependency probe leaves the workspace's libraries to meson, even if a .pc file provides them.
+    def test_workspace(self):
+        lib_dir = self.write_single_target_project('mylib', { 'is_static_library' : True, 'include_dirs' : [ 'include' ] },
+                                                    { 'include/mylib.h' : 'int mylib(void);\n', 'source/mylib.c' : 'int mylib(void) { return 0; }\n' })
+        app_dir = self.write_single_target_project('myapp', { 'is_executable' : True, 'dependencies' : [ 'mylib', 'fakedep' ] },
+                                                    { 'source/main.c' : '#include <mylib.h>\nint main() { return mylib(); }\n' })
+        self.modify_project(lambda config: config.update({ 'dependency_probe_cache' : True }), app_dir)
+        pc_dir = os.path.join(self._working_dir.name, 'pkgconfig')
+        os.makedirs(pc_dir)
+        for name in [ 'mylib', 'fakedep' ]:
+            with open(os.path.join(pc_dir, f'{name}.pc'), 'w') as file:
+                file.write(f'Name: {name}\nDescription: {name}\nVersion: 1.2.3\nCflags: -DFAKE_{name.upper()}\nLibs:\n')
+        os.makedirs(os.path.join(self._working_dir.name, 'ws'))
+        with open(os.path.join(self._working_dir.name, 'ws', 'build_master_workspace.json'), 'w') as file:
+            json.dump({ 'workspace_name' : 'MyStack', 'projects' : [ '../myapp', '../mylib' ] }, file, indent = 4)
+        os.environ['PKG_CONFIG_PATH'] = pc_dir
+        try:
+            output = self.run_with_args(['--directory=ws', 'workspace', 'setup', 'build'])
+        finally:
+            del os.environ['PKG_CONFIG_PATH']
+        self.assert_return_success(output)
+        with open(os.path.join(self._working_dir.name, 'ws', 'meson.build')) as file:
+            root_script = file.read()
+        self.assertRegex(root_script, r"(?s)subproject\('mylib'\).*subproject\('myapp'\)")
+        with open(os.path.join(lib_dir, 'meson.build')) as file:
+            self.assertIn("meson.override_dependency('mylib', mylib_dep)", file.read())
+        with open(os.path.join(app_dir, 'meson.build')) as file:
+            self.assertIn("('mylib' in resolved_dependencies_bm_internal__ ? resolved_dependencies_bm_internal__['mylib'] : dependency('mylib'))", file.read())
+        if shutil.which('pkg-config'):
+            with open(os.path.join(app_dir, '.build_master', 'dependencies', 'meson.build')) as file:
+                probe_script = file.read()
+            self.assertIn("'fakedep' : declare_dependency(version : '1.2.3', compile_args : ['-DFAKE_FAKEDEP'], link_args : [])", probe_script)
+            self.assertNotIn("'mylib'", probe_script)
+
+        # Built on its own, the project is regenerated without the overrides
+        output = self.run_with_args(['--directory=mylib', '--update-meson-build'])
+        self.assert_return_success(output)
+        with open(os.path.join(lib_dir, 'meson.build')) as file:
+            self.assertNotIn('override_dependency', file.read())
+
+        self.cleanupArtifacts()
+        return
+
+    # The generated meson.build spawns no process at the configure time, the install directory of the .pc files is snapshotted by build_master
+    def test_no_configure_time_commands(self):
+        self.with_modified_project(lambda config: config['targets'].append({ 'name' : 'myproject_lib', 'is_static_library' : True, 'sources' : [ 'source/main.cpp' ] }))
+        output = self.run_with_args(['--update-meson-build', '--force'])
+        self.assert_return_success(output)
+        with open(os.path.join(self._working_dir.name, 'meson.build')) as file:
+            self.assertNotIn('run_command', file.read())
+        if shutil.which('pkg-config'):
+            output.assert_exists_file('.build_master/pkg_config_dir')
+
+        self.cleanupArtifacts()
+        return
+
+    # The literal vars are folded into the target lists and aren't declared in meson.build, the vars holding meson expressions are left to meson
+    def test_literal_var_folding(self):
+        os.makedirs(os.path.join(self._working_dir.name, 'source'))
+        for source in [ 'main.c', 'util.c' ]:
+            with open(os.path.join(self._working_dir.name, 'source', source), 'w') as file:
+                file.write('int util(void) { return 0; }\n' if source == 'util.c' else 'int main() { return 0; }\n')
+        config = { 'project_name' : 'Folding', 'canonical_name' : 'folding',
+                    'vars' : { 'common_sources' : [ 'source/util.c' ], 'all_sources' : [ '$common_sources', 'source/main.c' ], 'prefix' : "get_option('prefix')" },
+                    'targets' : [ { 'name' : 'folding', 'is_executable' : True, 'sources' : [ '$all_sources' ] } ] }
+        with open(os.path.join(self._working_dir.name, 'build_master.json'), 'w') as file:
+            json.dump(config, file, indent = 4)
+        output = self.run_with_args(['--update-meson-build', '--force'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r'^Info: 2 out of 3 vars are folded$')
+        with open(os.path.join(self._working_dir.name, 'meson.build')) as file:
+            script = file.read()
+        self.assertIn("'source/util.c'", script)
+        self.assertIn("'source/main.c'", script)
+        self.assertNotRegex(script, r'(?m)^(common_sources|all_sources) =')
+        self.assertRegex(script, r"(?m)^prefix = get_option\('prefix'\)$")
+
+        self.cleanupArtifacts()
+        return
+
+    # The missing sources are reported at once, as a warning while generating meson.build (pre_config_hook may generate them yet),
+    # and as an error by 'configure', which checks them after running the hooks. The other platforms' sources aren't checked.
+    def test_missing_source_paths(self):
+        other_platform = 'darwin' if sys.platform.startswith('linux') else 'linux'
+        def mutate(config):
+            target = config['targets'][0]
+            target['sources'] += [ 'source/missing_1.cpp', 'source/missing_2.cpp' ]
+            target[f'{other_platform}_sources'] = [ 'source/other_platform.cpp' ]
+        self.with_modified_project(mutate)
+        output = self.run_with_args(['--update-meson-build', '--force'])
+        self.assert_return_success(output)
+        self.assert_string_matches_any_regex(output.stdout, r"^Warning: 2 source file\(s\) or include directories referenced in build_master.json don't exist:$")
+        self.assert_string_matches_any_regex(output.stdout, r"^\tsource/missing_1.cpp \(target 'myproject'\)$")
+        self.assert_string_matches_any_regex(output.stdout, r"^\tsource/missing_2.cpp \(target 'myproject'\)$")
+        self.assertFalse(any('other_platform.cpp' in line for line in output.stdout))
+        output = self.run_with_args(['configure', '-C', 'build-missing'])
+        self.assertNotEqual(output.returncode, 0)
+
+        # Generated by the hook before the sources are checked
+        with open(os.path.join(self._working_dir.name, 'generate_sources.sh'), 'w') as file:
+            file.write('touch source/missing_1.cpp source/missing_2.cpp\n')
+        self.modify_project(lambda config: config.update({ 'pre_config_hook' : 'generate_sources.sh' }))
+        output = self.run_with_args(['configure', '-C', 'build-generated'])
+        self.assert_string_matches_any_regex(output.stdout, r'Running pre-config hook script')
+        self.assertFalse(any("don't exist" in line for line in output.stdout))
+
+        self.cleanupArtifacts()
+        return
+
 if __name__ == '__main__':
     unittest.main()
\ No newline at end of file
@@ -1,5 +1,7 @@
 # This script performs black box testing for build_master executable
 # NOTE: We could have also implemented this test in Bash Scripts with Unix Tools such as diff but I found working with Python more promising.
+# NOTE: Benchmark mode (RealWorldBenchmarks) is enabled with REAL_WORLD_BENCH=1, it measures generation, 'meson setup', cold compile and no-op compile of each project,
+#       and fails if any of them has regressed against the baseline, see the environment variables below
 
 import unittest
 import subprocess
@@ -9,6 +11,10 @@ import tempfile
 import test_base
 import os
 import logging
+import json
+import shutil
+import statistics
+import time
 
 logging.basicConfig(level=logging.DEBUG)
 
@@ -27,6 +33,21 @@ git_repos = [
     'https://github.com/ravi688/NetSocket.git'
 ]
 
+# Benchmark mode
+# REAL_WORLD_BENCH=1 enables it
+# BENCH_REPEAT: number of repetitions (each one in a fresh copy of the cloned project), the median is compared against the baseline
+# REAL_WORLD_BASELINE: path of the baseline json file, by default unit_test/real_world_baseline.json
+# REAL_WORLD_UPDATE_BASELINE=1 writes the measured medians into the baseline instead of comparing against it
+# REAL_WORLD_TOLERANCE: allowed slowdown relative to the baseline, 0.25 means 25% slower
+# REAL_WORLD_TOLERANCE_MS: allowed slowdown in milliseconds on top of it, so that the noise in the short phases (like the no-op compile) isn't reported
+BENCH_REPEAT = int(os.environ.get('BENCH_REPEAT', '3'))
+REAL_WORLD_BASELINE = os.environ.get('REAL_WORLD_BASELINE', os.path.join(os.path.dirname(os.path.abspath(__file__)), 'real_world_baseline.json'))
+REAL_WORLD_TOLERANCE = float(os.environ.get('REAL_WORLD_TOLERANCE', '0.25'))
+REAL_WORLD_TOLERANCE_MS = float(os.environ.get('REAL_WORLD_TOLERANCE_MS', '50'))
+
+# Phases measured for each project, in the order they are run
+PHASES = [ 'generate', 'meson setup', 'cold compile', 'no-op compile' ]
+
 # git clone <url> into <directory>
 # build_master --update-meson-build
 # build_master meson setup build
@@ -55,5 +76,88 @@ class RealWorldTests(test_base.TestBase):
             self.clone_build_compile(https_url)
         return
 
+# Returns the name a project is recorded with in the baseline, e.g. 'HPML' for https://github.com/ravi688/HPML.git
+def get_project_name(https_url):
+    return os.path.basename(https_url).removesuffix('.git')
+
+# Returns the medians exceeding their baseline by more than the tolerance, as [ (project, phase, median (ms), baseline (ms)) ]
+def find_regressions(medians, baseline):
+    regressions = []
+    for project, phases in medians.items():
+        for phase, median_ms in phases.items():
+            baseline_ms = baseline.get(project, { }).get(phase)
+            if baseline_ms is not None and median_ms > baseline_ms * (1.0 + REAL_WORLD_TOLERANCE) + REAL_WORLD_TOLERANCE_MS:
+                regressions.append((project, phase, median_ms, baseline_ms))
+    return regressions
+
+# For each project: clone once, then for each repetition copy it into a fresh temporary directory and time the phases in PHASES
+# ccache is disabled, so that the cold compile is really cold
+class RealWorldBenchmarks(test_base.TestBase):
+    def __init__(self, *args, **kwargs):
+        super().__init__(*args, **kwargs)
+        return
+
+    # Runs build_master in the project's directory, returns the wall time in milliseconds
+    def run_timed(self, args, directory):
+        start = time.perf_counter()
+        result = subprocess.run([self._executable] + args, cwd = directory, stdout = subprocess.PIPE, stderr = subprocess.STDOUT, text = True)
+        elapsed_ms = (time.perf_counter() - start) * 1000.0
+        self.assertEqual(result.returncode, 0, f'build_master {" ".join(args)} has failed in {directory}:\n{result.stdout}')
+        return elapsed_ms
+
+    def measure_project(self, clone_directory):
+        samples = { phase : [] for phase in PHASES }
+        for _ in range(BENCH_REPEAT):
+            with tempfile.TemporaryDirectory() as temp_dir:
+                directory = os.path.join(temp_dir, 'project')
+                shutil.copytree(clone_directory, directory, symlinks = True, ignore = shutil.ignore_patterns('.git'))
+                samples['generate'].append(self.run_timed(['--update-meson-build', '--force'], directory))
+                samples['meson setup'].append(self.run_timed(['meson', 'setup', 'build'], directory))
+                samples['cold compile'].append(self.run_timed(['build', '-C', 'build'], directory))
+                samples['no-op compile'].append(self.run_timed(['build', '-C', 'build'], directory))
+        return { phase : statistics.median(values) for phase, values in samples.items() }
+
+    def test_configure_compile_time(self):
+        if os.environ.get('REAL_WORLD_BENCH') != '1':
+            self.skipTest('Benchmark mode is enabled with REAL_WORLD_BENCH=1')
+        os.environ['CCACHE_DISABLE'] = '1'
+        medians = { }
+        try:
+            # MeshLib is listed twice
+            for https_url in dict.fromkeys(git_repos):
+                with tempfile.TemporaryDirectory() as clone_directory:
+                    output = self.run_cmd_with_args('git', ['clone', '--depth', '1', https_url, clone_directory])
+                    self.assertEqual(output.returncode, 0)
+                    medians[get_project_name(https_url)] = self.measure_project(clone_directory)
+        finally:
+            del os.environ['CCACHE_DISABLE']
+
+        baseline = { }
+        if os.path.exists(REAL_WORLD_BASELINE):
+            with open(REAL_WORLD_BASELINE) as file:
+                baseline = json.load(file)
+        logging.info(f'Configure and compile time (median of {BENCH_REPEAT} runs, baseline in parentheses)')
+        logging.info(f'{"project":<14}' + ''.join(f' {phase + " (ms)":>26}' for phase in PHASES))
+        for project, phases in medians.items():
+            cells = []
+            for phase in PHASES:
+                baseline_ms = baseline.get(project, { }).get(phase)
+                cells.append(f'{phases[phase]:.1f}' + (f' ({baseline_ms:.1f})' if baseline_ms is not None else ''))
+            logging.info(f'{project:<14}' + ''.join(f' {cell:>26}' for cell in cells))
+
+        if os.environ.get('REAL_WORLD_UPDATE_BASELINE') == '1':
+            with open(REAL_WORLD_BASELINE, 'w') as file:
+                json.dump(medians, file, indent = 4)
+            logging.info(f'Baseline is written into {REAL_WORLD_BASELINE}')
+            return
+        if not baseline:
+            logging.info(f'{REAL_WORLD_BASELINE} doesn\'t exist, run with REAL_WORLD_UPDATE_BASELINE=1 to record it')
+            return
+        regressions = find_regressions(medians, baseline)
+        for project, phase, median_ms, baseline_ms in regressions:
+            logging.error(f'{project}: {phase} takes {median_ms:.1f} ms, baseline is {baseline_ms:.1f} ms (tolerance: {REAL_WORLD_TOLERANCE * 100:.0f}% + {REAL_WORLD_TOLERANCE_MS:.0f} ms)')
+        self.assertFalse(regressions, f'{len(regressions)} phase(s) have regressed against {REAL_WORLD_BASELINE}')
+        return
+
 if __name__ == '__main__':
     unittest.main()
\ No newline at end of file